@@ -129,6 +129,7 @@ int  bx_parse_usb_port_params(const char *context, bx_bool devopt,
 int  bx_write_param_list(FILE *fp, bx_list_c *base, const char *optname, bx_bool multiline);
 int  bx_write_usb_options(FILE *fp, int maxports, bx_list_c *base);
 Bit32u crc32(const Bit8u *buf, int len);
+Bit32u crc32c(Bit32u crc, Bit64u data, unsigned len);
 // for param-tree testing only
 void print_tree(bx_param_c *node, int level = 0);
 
@@ -187,6 +188,16 @@ void print_tree(bx_param_c *node, int level = 0);
 #define BX_CLEAR_INTR()             bx_pc_system.clear_INTR()
 #define BX_HRQ                      bx_pc_system.HRQ
 
+// Serializes device, APIC and timer accesses issued by CPUs when each
+// CPU is simulated on its own host thread (see bx_pc_system.smp_threads)
+#if BX_SUPPORT_SMP
+#define BX_LOCK_IO()                bx_pc_system.lock_io()
+#define BX_UNLOCK_IO()              bx_pc_system.unlock_io()
+#else
+#define BX_LOCK_IO()
+#define BX_UNLOCK_IO()
+#endif
+
 #if BX_SUPPORT_SMP
 #define BX_CPU(x)                   (bx_cpu_array[x])
 #else
@@ -256,6 +267,11 @@ typedef class BOCHSAPI logfunctions
   // default log actions for all devices, declared and initialized
   // in logio.cc.
   BOCHSAPI_CYGONLY static int default_onoff[N_LOGLEV];
+  // messages per emulated second reported for each device (0 = no limit)
+  BOCHSAPI_CYGONLY static unsigned rate_limit;
+  Bit64u rate_second;
+  unsigned rate_count, rate_dropped;
+  bx_bool rate_exceeded(int level);
 public:
   logfunctions(void);
   logfunctions(class iofunctions *);
@@ -289,6 +305,7 @@ public:
     assert (loglev >= 0 && loglev < N_LOGLEV);
     return default_onoff[loglev];
   }
+  static void set_rate_limit(unsigned limit) { rate_limit = limit; }
 } logfunc_t;
 
 #define BX_LOGPREFIX_SIZE 51
@@ -298,8 +315,13 @@ class BOCHSAPI iofunctions {
   char logprefix[BX_LOGPREFIX_SIZE];
   FILE *logfd;
   class logfunctions *log;
+  struct bx_log_ring_t *ring; // asynchronous output, see logio.cc
+  bx_bool binary;
   void init(void);
   void flush(void);
+  int format_prefix(char *buf, int size, int level, const char *prefix);
+  int format_record(char *buf, int size, int level, const char *prefix, const char *fmt, va_list ap);
+  void async_out(int level, const char *prefix, const char *fmt, va_list ap);
 
 // Log Class types
 public:
@@ -316,6 +338,8 @@ public:
   void init_log(FILE *fs);
   void exit_log();
   void set_log_prefix(const char *prefix);
+  void set_log_mode(bx_bool async, bx_bool binary_format);
+  void drain_log_ring(void);
   int get_n_logfns() const { return n_logfn; }
   logfunc_t *get_logfn(int index) { return logfn_list[index]; }
   void add_logfn(logfunc_t *fn);
@@ -444,6 +468,7 @@ BOCHSAPI extern Bit32u apic_id_mask;
 
 #include "memory/memory.h"
 #include "pc_system.h"
+#include "bxthread.h"
 #include "gui/gui.h"
 
 /* --- EXTERNS --- */
@@ -891,6 +891,18 @@ void bx_dbg_print_mmx_state(void)
   }
 }
 
+void bx_dbg_print_cache_stats(void)
+{
+  BX_CPU_C *cpu = BX_CPU(dbg_cpu);
+  Bit64u lookups = cpu->iCache.stats.lookups;
+  Bit64u misses = cpu->iCache.stats.misses;
+
+  dbg_printf("ICACHE lookups: " FMT_LL "u, misses: " FMT_LL "u, hit rate = %6.2f%%\n",
+      lookups, misses, lookups ? (lookups-misses) * 100.0 / lookups : 0.0);
+  dbg_printf("ICACHE flushes: " FMT_LL "u, evictions: " FMT_LL "u, SMC invalidations: " FMT_LL "u\n",
+      cpu->iCache.stats.flushes, cpu->iCache.stats.evictions, cpu->iCache.stats.smc);
+}
+
 void bx_dbg_print_fpu_state(void)
 {
 #if BX_SUPPORT_FPU
@@ -1155,6 +1167,10 @@ void bx_dbg_info_registers_command(int which_regs_mask)
   else if (which_regs_mask & BX_INFO_SSE_REGS) {
     bx_dbg_print_sse_state();
   }
+
+  if (which_regs_mask & BX_INFO_CACHE_STATS) {
+    bx_dbg_print_cache_stats();
+  }
 }
 
 //
@@ -1421,7 +1437,7 @@ void bx_dbg_xlate_address(bx_lin_address laddr)
 
 void bx_dbg_tlb_lookup(bx_lin_address laddr)
 {
-  Bit32u index = BX_TLB_INDEX_OF(laddr, 0);
+  Bit32u index = BX_CPU(dbg_cpu)->TLB_index_of(laddr, 0);
   char cpu_param_name[16];
   sprintf(cpu_param_name, "TLB.entry%d", index);
   bx_dbg_show_param_command(cpu_param_name);
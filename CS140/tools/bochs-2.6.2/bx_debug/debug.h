@@ -269,6 +269,7 @@ void bx_dbg_quit_command(void);
 #define BX_INFO_MMX_REGS 0x04
 #define BX_INFO_SSE_REGS 0x08
 #define BX_INFO_AVX_REGS 0x10
+#define BX_INFO_CACHE_STATS 0x20
 void bx_dbg_info_registers_command(int);
 void bx_dbg_info_ivt_command(unsigned from, unsigned to);
 void bx_dbg_info_idt_command(unsigned from, unsigned to);
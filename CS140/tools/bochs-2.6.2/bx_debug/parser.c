@@ -3873,6 +3873,7 @@ yyreduce:
 #line 1144 "parser.y"
     {
          dbg_printf("info break - show information about current breakpoint status\n");
+         dbg_printf("info cpu - show all CPU registers and the trace cache statistics\n");
          dbg_printf("info idt - show interrupt descriptor table\n");
          dbg_printf("info ivt - show interrupt vector table\n");
          dbg_printf("info gdt - show global descriptor table\n");
@@ -3890,7 +3891,7 @@ yyreduce:
   case 218:
 
 /* Line 1806 of yacc.c  */
-#line 1159 "parser.y"
+#line 1160 "parser.y"
     {
          dbg_printf("show <command> - toggles show symbolic info (calls to begin with)\n");
          dbg_printf("show - shows current show mode\n");
@@ -3907,7 +3908,7 @@ yyreduce:
   case 219:
 
 /* Line 1806 of yacc.c  */
-#line 1171 "parser.y"
+#line 1172 "parser.y"
     {
          dbg_printf("calc|? <expr> - calculate a expression and display the result.\n");
          dbg_printf("    'expr' can reference any general-purpose and segment\n");
@@ -3922,7 +3923,7 @@ yyreduce:
   case 220:
 
 /* Line 1806 of yacc.c  */
-#line 1181 "parser.y"
+#line 1182 "parser.y"
     {
          bx_dbg_print_help();
          free((yyvsp[(1) - (3)].sval));free((yyvsp[(2) - (3)].sval));
@@ -3932,7 +3933,7 @@ yyreduce:
   case 221:
 
 /* Line 1806 of yacc.c  */
-#line 1186 "parser.y"
+#line 1187 "parser.y"
     {
          bx_dbg_print_help();
          free((yyvsp[(1) - (2)].sval));
@@ -3942,7 +3943,7 @@ yyreduce:
   case 222:
 
 /* Line 1806 of yacc.c  */
-#line 1194 "parser.y"
+#line 1195 "parser.y"
     {
      bx_dbg_calc_command((yyvsp[(2) - (3)].uval));
      free((yyvsp[(1) - (3)].sval));
@@ -3952,343 +3953,343 @@ yyreduce:
   case 223:
 
 /* Line 1806 of yacc.c  */
-#line 1211 "parser.y"
+#line 1212 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (1)].uval); }
     break;
 
   case 224:
 
 /* Line 1806 of yacc.c  */
-#line 1212 "parser.y"
+#line 1213 "parser.y"
     { (yyval.uval) = bx_dbg_get_symbol_value((yyvsp[(1) - (1)].sval)); free((yyvsp[(1) - (1)].sval));}
     break;
 
   case 225:
 
 /* Line 1806 of yacc.c  */
-#line 1213 "parser.y"
+#line 1214 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg8l_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 226:
 
 /* Line 1806 of yacc.c  */
-#line 1214 "parser.y"
+#line 1215 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg8h_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 227:
 
 /* Line 1806 of yacc.c  */
-#line 1215 "parser.y"
+#line 1216 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg16_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 228:
 
 /* Line 1806 of yacc.c  */
-#line 1216 "parser.y"
+#line 1217 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg32_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 229:
 
 /* Line 1806 of yacc.c  */
-#line 1217 "parser.y"
+#line 1218 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg64_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 230:
 
 /* Line 1806 of yacc.c  */
-#line 1218 "parser.y"
+#line 1219 "parser.y"
     { (yyval.uval) = bx_dbg_get_selector_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 231:
 
 /* Line 1806 of yacc.c  */
-#line 1219 "parser.y"
+#line 1220 "parser.y"
     { (yyval.uval) = bx_dbg_get_ip (); }
     break;
 
   case 232:
 
 /* Line 1806 of yacc.c  */
-#line 1220 "parser.y"
+#line 1221 "parser.y"
     { (yyval.uval) = bx_dbg_get_eip(); }
     break;
 
   case 233:
 
 /* Line 1806 of yacc.c  */
-#line 1221 "parser.y"
+#line 1222 "parser.y"
     { (yyval.uval) = bx_dbg_get_instruction_pointer(); }
     break;
 
   case 234:
 
 /* Line 1806 of yacc.c  */
-#line 1222 "parser.y"
+#line 1223 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) + (yyvsp[(3) - (3)].uval); }
     break;
 
   case 235:
 
 /* Line 1806 of yacc.c  */
-#line 1223 "parser.y"
+#line 1224 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) - (yyvsp[(3) - (3)].uval); }
     break;
 
   case 236:
 
 /* Line 1806 of yacc.c  */
-#line 1224 "parser.y"
+#line 1225 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) * (yyvsp[(3) - (3)].uval); }
     break;
 
   case 237:
 
 /* Line 1806 of yacc.c  */
-#line 1225 "parser.y"
+#line 1226 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) / (yyvsp[(3) - (3)].uval); }
     break;
 
   case 238:
 
 /* Line 1806 of yacc.c  */
-#line 1226 "parser.y"
+#line 1227 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) >> (yyvsp[(3) - (3)].uval); }
     break;
 
   case 239:
 
 /* Line 1806 of yacc.c  */
-#line 1227 "parser.y"
+#line 1228 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) << (yyvsp[(3) - (3)].uval); }
     break;
 
   case 240:
 
 /* Line 1806 of yacc.c  */
-#line 1228 "parser.y"
+#line 1229 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) | (yyvsp[(3) - (3)].uval); }
     break;
 
   case 241:
 
 /* Line 1806 of yacc.c  */
-#line 1229 "parser.y"
+#line 1230 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) ^ (yyvsp[(3) - (3)].uval); }
     break;
 
   case 242:
 
 /* Line 1806 of yacc.c  */
-#line 1230 "parser.y"
+#line 1231 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) & (yyvsp[(3) - (3)].uval); }
     break;
 
   case 243:
 
 /* Line 1806 of yacc.c  */
-#line 1231 "parser.y"
+#line 1232 "parser.y"
     { (yyval.uval) = !(yyvsp[(2) - (2)].uval); }
     break;
 
   case 244:
 
 /* Line 1806 of yacc.c  */
-#line 1232 "parser.y"
+#line 1233 "parser.y"
     { (yyval.uval) = -(yyvsp[(2) - (2)].uval); }
     break;
 
   case 245:
 
 /* Line 1806 of yacc.c  */
-#line 1233 "parser.y"
+#line 1234 "parser.y"
     { (yyval.uval) = (yyvsp[(2) - (3)].uval); }
     break;
 
   case 246:
 
 /* Line 1806 of yacc.c  */
-#line 1239 "parser.y"
+#line 1240 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (1)].uval); }
     break;
 
   case 247:
 
 /* Line 1806 of yacc.c  */
-#line 1240 "parser.y"
+#line 1241 "parser.y"
     { (yyval.uval) = bx_dbg_get_symbol_value((yyvsp[(1) - (1)].sval)); free((yyvsp[(1) - (1)].sval));}
     break;
 
   case 248:
 
 /* Line 1806 of yacc.c  */
-#line 1241 "parser.y"
+#line 1242 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg8l_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 249:
 
 /* Line 1806 of yacc.c  */
-#line 1242 "parser.y"
+#line 1243 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg8h_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 250:
 
 /* Line 1806 of yacc.c  */
-#line 1243 "parser.y"
+#line 1244 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg16_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 251:
 
 /* Line 1806 of yacc.c  */
-#line 1244 "parser.y"
+#line 1245 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg32_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 252:
 
 /* Line 1806 of yacc.c  */
-#line 1245 "parser.y"
+#line 1246 "parser.y"
     { (yyval.uval) = bx_dbg_get_reg64_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 253:
 
 /* Line 1806 of yacc.c  */
-#line 1246 "parser.y"
+#line 1247 "parser.y"
     { (yyval.uval) = bx_dbg_get_selector_value((yyvsp[(1) - (1)].uval)); }
     break;
 
   case 254:
 
 /* Line 1806 of yacc.c  */
-#line 1247 "parser.y"
+#line 1248 "parser.y"
     { (yyval.uval) = bx_dbg_get_ip (); }
     break;
 
   case 255:
 
 /* Line 1806 of yacc.c  */
-#line 1248 "parser.y"
+#line 1249 "parser.y"
     { (yyval.uval) = bx_dbg_get_eip(); }
     break;
 
   case 256:
 
 /* Line 1806 of yacc.c  */
-#line 1249 "parser.y"
+#line 1250 "parser.y"
     { (yyval.uval) = bx_dbg_get_instruction_pointer(); }
     break;
 
   case 257:
 
 /* Line 1806 of yacc.c  */
-#line 1250 "parser.y"
+#line 1251 "parser.y"
     { (yyval.uval) = bx_dbg_get_laddr ((yyvsp[(1) - (3)].uval), (yyvsp[(3) - (3)].uval)); }
     break;
 
   case 258:
 
 /* Line 1806 of yacc.c  */
-#line 1251 "parser.y"
+#line 1252 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) + (yyvsp[(3) - (3)].uval); }
     break;
 
   case 259:
 
 /* Line 1806 of yacc.c  */
-#line 1252 "parser.y"
+#line 1253 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) - (yyvsp[(3) - (3)].uval); }
     break;
 
   case 260:
 
 /* Line 1806 of yacc.c  */
-#line 1253 "parser.y"
+#line 1254 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) * (yyvsp[(3) - (3)].uval); }
     break;
 
   case 261:
 
 /* Line 1806 of yacc.c  */
-#line 1254 "parser.y"
+#line 1255 "parser.y"
     { (yyval.uval) = ((yyvsp[(3) - (3)].uval) != 0) ? (yyvsp[(1) - (3)].uval) / (yyvsp[(3) - (3)].uval) : 0; }
     break;
 
   case 262:
 
 /* Line 1806 of yacc.c  */
-#line 1255 "parser.y"
+#line 1256 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) >> (yyvsp[(3) - (3)].uval); }
     break;
 
   case 263:
 
 /* Line 1806 of yacc.c  */
-#line 1256 "parser.y"
+#line 1257 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) << (yyvsp[(3) - (3)].uval); }
     break;
 
   case 264:
 
 /* Line 1806 of yacc.c  */
-#line 1257 "parser.y"
+#line 1258 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) | (yyvsp[(3) - (3)].uval); }
     break;
 
   case 265:
 
 /* Line 1806 of yacc.c  */
-#line 1258 "parser.y"
+#line 1259 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) ^ (yyvsp[(3) - (3)].uval); }
     break;
 
   case 266:
 
 /* Line 1806 of yacc.c  */
-#line 1259 "parser.y"
+#line 1260 "parser.y"
     { (yyval.uval) = (yyvsp[(1) - (3)].uval) & (yyvsp[(3) - (3)].uval); }
     break;
 
   case 267:
 
 /* Line 1806 of yacc.c  */
-#line 1260 "parser.y"
+#line 1261 "parser.y"
     { (yyval.uval) = !(yyvsp[(2) - (2)].uval); }
     break;
 
   case 268:
 
 /* Line 1806 of yacc.c  */
-#line 1261 "parser.y"
+#line 1262 "parser.y"
     { (yyval.uval) = -(yyvsp[(2) - (2)].uval); }
     break;
 
   case 269:
 
 /* Line 1806 of yacc.c  */
-#line 1262 "parser.y"
+#line 1263 "parser.y"
     { (yyval.uval) = bx_dbg_lin_indirect((yyvsp[(2) - (2)].uval)); }
     break;
 
   case 270:
 
 /* Line 1806 of yacc.c  */
-#line 1263 "parser.y"
+#line 1264 "parser.y"
     { (yyval.uval) = bx_dbg_phy_indirect((yyvsp[(2) - (2)].uval)); }
     break;
 
   case 271:
 
 /* Line 1806 of yacc.c  */
-#line 1264 "parser.y"
+#line 1265 "parser.y"
     { (yyval.uval) = (yyvsp[(2) - (3)].uval); }
     break;
 
@@ -4526,7 +4527,7 @@ yyreturn:
 
 
 /* Line 2067 of yacc.c  */
-#line 1267 "parser.y"
+#line 1268 "parser.y"
 
 
 #endif  /* if BX_DEBUGGER */
@@ -0,0 +1,84 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "bochs.h"
+#include "bxthread.h"
+
+#ifndef WIN32
+
+void bx_init_recursive_mutex(pthread_mutex_t *mutex)
+{
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+#endif
+
+void bx_create_event(bx_thread_event_t *thread_ev)
+{
+#ifdef WIN32
+  thread_ev->event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+  pthread_mutex_init(&thread_ev->mutex, NULL);
+  pthread_cond_init(&thread_ev->cond, NULL);
+  thread_ev->signaled = 0;
+#endif
+}
+
+void bx_destroy_event(bx_thread_event_t *thread_ev)
+{
+#ifdef WIN32
+  CloseHandle(thread_ev->event);
+#else
+  pthread_cond_destroy(&thread_ev->cond);
+  pthread_mutex_destroy(&thread_ev->mutex);
+#endif
+}
+
+void bx_set_event(bx_thread_event_t *thread_ev)
+{
+#ifdef WIN32
+  SetEvent(thread_ev->event);
+#else
+  pthread_mutex_lock(&thread_ev->mutex);
+  thread_ev->signaled = 1;
+  pthread_cond_signal(&thread_ev->cond);
+  pthread_mutex_unlock(&thread_ev->mutex);
+#endif
+}
+
+void bx_wait_for_event(bx_thread_event_t *thread_ev)
+{
+#ifdef WIN32
+  WaitForSingleObject(thread_ev->event, INFINITE);
+#else
+  pthread_mutex_lock(&thread_ev->mutex);
+  while (! thread_ev->signaled)
+    pthread_cond_wait(&thread_ev->cond, &thread_ev->mutex);
+  thread_ev->signaled = 0;
+  pthread_mutex_unlock(&thread_ev->mutex);
+#endif
+}
@@ -0,0 +1,179 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Portable host thread, mutex, event and atomic operation wrappers.
+// Requires the Bit*u types from config.h and <windows.h> on WIN32, both
+// of them are provided by bochs.h.
+
+#ifndef BX_THREAD_H
+#define BX_THREAD_H
+
+#ifdef WIN32
+
+#define BX_THREAD_VAR(name) HANDLE (name)
+#define BX_THREAD_FUNC(name,arg) DWORD WINAPI name(LPVOID arg)
+#define BX_THREAD_EXIT return 0
+#define BX_THREAD_CREATE(name,arg,var) \
+    do { DWORD threadID; (var) = CreateThread(NULL, 0, name, arg, 0, &threadID); } while(0)
+#define BX_THREAD_JOIN(var) \
+    do { WaitForSingleObject((var), INFINITE); CloseHandle(var); } while(0)
+#define BX_MUTEX(mutex) CRITICAL_SECTION (mutex)
+#define BX_INIT_MUTEX(mutex) InitializeCriticalSection(&(mutex))
+#define BX_FINI_MUTEX(mutex) DeleteCriticalSection(&(mutex))
+#define BX_LOCK(mutex) EnterCriticalSection(&(mutex))
+#define BX_UNLOCK(mutex) LeaveCriticalSection(&(mutex))
+#define BX_MSLEEP(val) msleep(val)
+
+#else
+
+#include <pthread.h>
+
+#define BX_THREAD_VAR(name) pthread_t (name)
+#define BX_THREAD_FUNC(name,arg) void *name(void *arg)
+#define BX_THREAD_EXIT return NULL
+#define BX_THREAD_CREATE(name,arg,var) \
+    pthread_create(&(var), NULL, name, arg)
+#define BX_THREAD_JOIN(var) pthread_join((var), NULL)
+#define BX_MUTEX(mutex) pthread_mutex_t (mutex)
+// Mutexes are recursive like the WIN32 critical sections
+#define BX_INIT_MUTEX(mutex) bx_init_recursive_mutex(&(mutex))
+#define BX_FINI_MUTEX(mutex) pthread_mutex_destroy(&(mutex))
+#define BX_LOCK(mutex) pthread_mutex_lock(&(mutex))
+#define BX_UNLOCK(mutex) pthread_mutex_unlock(&(mutex))
+#define BX_MSLEEP(val) usleep((val)*1000)
+
+extern void bx_init_recursive_mutex(pthread_mutex_t *mutex);
+
+#endif
+
+// Auto-reset event: bx_wait_for_event() blocks until another thread calls
+// bx_set_event() and consumes the signal.
+typedef struct {
+#ifdef WIN32
+  HANDLE event;
+#else
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int signaled;
+#endif
+} bx_thread_event_t;
+
+extern void bx_create_event(bx_thread_event_t *thread_ev);
+extern void bx_destroy_event(bx_thread_event_t *thread_ev);
+extern void bx_set_event(bx_thread_event_t *thread_ev);
+extern void bx_wait_for_event(bx_thread_event_t *thread_ev);
+
+// Atomic operations on memory shared between host threads
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+BX_CPP_INLINE Bit32u bx_atomic_or32(volatile Bit32u *ptr, Bit32u val)
+{
+  return (Bit32u) _InterlockedOr((volatile long *) ptr, (long) val);
+}
+
+BX_CPP_INLINE Bit32u bx_atomic_and32(volatile Bit32u *ptr, Bit32u val)
+{
+  return (Bit32u) _InterlockedAnd((volatile long *) ptr, (long) val);
+}
+
+BX_CPP_INLINE Bit32u bx_atomic_xchg32(volatile Bit32u *ptr, Bit32u val)
+{
+  return (Bit32u) _InterlockedExchange((volatile long *) ptr, (long) val);
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas8(volatile Bit8u *ptr, Bit8u oldval, Bit8u newval)
+{
+  return _InterlockedCompareExchange8((volatile char *) ptr, (char) newval, (char) oldval) == (char) oldval;
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas16(volatile Bit16u *ptr, Bit16u oldval, Bit16u newval)
+{
+  return _InterlockedCompareExchange16((volatile short *) ptr, (short) newval, (short) oldval) == (short) oldval;
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas32(volatile Bit32u *ptr, Bit32u oldval, Bit32u newval)
+{
+  return _InterlockedCompareExchange((volatile long *) ptr, (long) newval, (long) oldval) == (long) oldval;
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas64(volatile Bit64u *ptr, Bit64u oldval, Bit64u newval)
+{
+  return _InterlockedCompareExchange64((volatile __int64 *) ptr, (__int64) newval, (__int64) oldval) == (__int64) oldval;
+}
+
+BX_CPP_INLINE void bx_memory_barrier(void)
+{
+  MemoryBarrier();
+}
+
+#else
+
+BX_CPP_INLINE Bit32u bx_atomic_or32(volatile Bit32u *ptr, Bit32u val)
+{
+  return __sync_fetch_and_or(ptr, val);
+}
+
+BX_CPP_INLINE Bit32u bx_atomic_and32(volatile Bit32u *ptr, Bit32u val)
+{
+  return __sync_fetch_and_and(ptr, val);
+}
+
+BX_CPP_INLINE Bit32u bx_atomic_xchg32(volatile Bit32u *ptr, Bit32u val)
+{
+  Bit32u oldval;
+  do {
+    oldval = *ptr;
+  } while (! __sync_bool_compare_and_swap(ptr, oldval, val));
+  return oldval;
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas8(volatile Bit8u *ptr, Bit8u oldval, Bit8u newval)
+{
+  return __sync_bool_compare_and_swap(ptr, oldval, newval);
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas16(volatile Bit16u *ptr, Bit16u oldval, Bit16u newval)
+{
+  return __sync_bool_compare_and_swap(ptr, oldval, newval);
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas32(volatile Bit32u *ptr, Bit32u oldval, Bit32u newval)
+{
+  return __sync_bool_compare_and_swap(ptr, oldval, newval);
+}
+
+BX_CPP_INLINE bx_bool bx_atomic_cas64(volatile Bit64u *ptr, Bit64u oldval, Bit64u newval)
+{
+  return __sync_bool_compare_and_swap(ptr, oldval, newval);
+}
+
+BX_CPP_INLINE void bx_memory_barrier(void)
+{
+  __sync_synchronize();
+}
+
+#endif
+
+#endif
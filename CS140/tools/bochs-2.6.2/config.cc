@@ -408,7 +408,38 @@ void bx_init_options()
       "Maximum amount of instructions allowed to execute before returning control to another CPU.",
       BX_SMP_QUANTUM_MIN, BX_SMP_QUANTUM_MAX,
       16);
+  new bx_param_bool_c(cpu_param,
+      "smp_threads", "Host thread per CPU in SMP simulation",
+      "Simulate each CPU in its own host thread (faster on multi-core hosts)",
+      0);
+#endif
+  new bx_param_num_c(cpu_param,
+      "icache_size", "Trace cache size (K entries)",
+      "Number of entries in the instruction trace cache of each CPU, in K (rounded down to a power of 2)",
+      4, 4096,
+      256);
+#if BX_SUPPORT_JIT
+  new bx_param_num_c(cpu_param,
+      "jit_threshold", "Trace executions before translation",
+      "Number of times a trace is interpreted before it is translated into host code (0 disables translation)",
+      0, 1000000,
+      64);
 #endif
+  new bx_param_filename_c(cpu_param,
+      "trace_cache",
+      "Persistent trace cache file",
+      "Decoded instruction traces are loaded from this file at startup and saved to it at exit",
+      "", BX_PATHNAME_LEN);
+  new bx_param_num_c(cpu_param,
+      "tlb_size", "L1 TLB size (entries)",
+      "Number of entries in the 4-way set associative L1 TLB of each CPU (rounded down to a power of 2)",
+      64, 4096,
+      1024);
+  new bx_param_num_c(cpu_param,
+      "tlb_l2_size", "L2 TLB size (entries)",
+      "Number of 4K page entries in the L2 TLB of each CPU (rounded down to a power of 2)",
+      256, 65536,
+      8192);
   new bx_param_bool_c(cpu_param,
       "reset_on_triple_fault", "Enable CPU reset on triple fault",
       "Enable CPU reset if triple fault occured (highly recommended)",
@@ -600,7 +631,7 @@ void bx_init_options()
   new bx_param_bool_c(cpuid_param,
       "pcid", "PCID support in long mode",
       "Support for process context ID (PCID) in long mode",
-      0);
+      1);
   new bx_param_bool_c(cpuid_param,
       "fsgsbase", "FS/GS BASE access instructions support",
       "FS/GS BASE access instructions support in long mode",
@@ -669,6 +700,30 @@ void bx_init_options()
       1, 2048,
       BX_DEFAULT_MEM_MEGS);
   host_ramsize->set_ask_format("Enter host memory size (MB): [%d] ");
+
+#if BX_HAVE_SYS_MMAN_H
+  bx_param_bool_c *rammap = new bx_param_bool_c(ram,
+      "mmap",
+      "Map guest RAM",
+      "Allocate guest RAM as one memory mapped region",
+      0);
+  path = new bx_param_filename_c(ram,
+      "file",
+      "RAM backing file",
+      "Pathname of the file backing the memory mapped guest RAM",
+      "", BX_PATHNAME_LEN);
+  path->set_format("RAM backing file: %s");
+  path->set_ask_format("Enter RAM backing file name: [%s] ");
+  path->set_extension("ram");
+  deplist = new bx_list_c(NULL);
+  deplist->add(path);
+  rammap->set_dependent_list(deplist);
+#endif
+  new bx_param_bool_c(ram,
+      "incremental",
+      "Incremental RAM snapshots",
+      "Save only the RAM pages changed since the previous checkpoint",
+      0);
   ram->set_options(ram->SERIES_ASK);
 
   path = new bx_param_filename_c(rom,
@@ -1366,6 +1421,21 @@ void bx_init_options()
         BX_ATA_TRANSLATION_NONE);
       translation->set_ask_format("Enter translation type: [%s]");
 
+      bx_param_bool_c *async = new bx_param_bool_c(menu,
+        "async",
+        "Asynchronous I/O",
+        "Access the disk image from a host thread while the simulation continues",
+        0);
+      async->set_ask_format("Use asynchronous disk I/O? [%s] ");
+
+      bx_param_num_c *cache = new bx_param_num_c(menu,
+        "cache",
+        "Block cache size (KB)",
+        "Size of the in-memory block cache in front of the disk image (0 = disabled)",
+        0, BX_MAX_BIT32U,
+        1024);
+      cache->set_ask_format("Enter block cache size in KB: [%d] ");
+
       // the master/slave menu depends on the ATA channel's enabled flag
       enabled->get_dependent_list()->add(menu);
       // the type selector depends on the ATA channel's enabled flag
@@ -1373,7 +1443,7 @@ void bx_init_options()
 
       // all items depend on the drive type
       type->set_dependent_list(menu->clone(), 0);
-      type->set_dependent_bitmap(BX_ATA_DEVICE_DISK, 0x7e6);
+      type->set_dependent_bitmap(BX_ATA_DEVICE_DISK, 0x1fe6);
       type->set_dependent_bitmap(BX_ATA_DEVICE_CDROM, 0x30a);
 
       type->set_handler(bx_param_handler);
@@ -1548,6 +1618,28 @@ void bx_init_options()
       "%t%e%d", BX_PATHNAME_LEN);
   prefix->set_ask_format("Enter log prefix: [%s] ");
 
+  new bx_param_bool_c(menu,
+      "async",
+      "Asynchronous log output",
+      "Write the log file from a separate thread",
+      0);
+
+  static const char *log_format_names[] = { "text", "binary", NULL };
+  new bx_param_enum_c(menu,
+      "format",
+      "Log file format",
+      "Format of the log file",
+      log_format_names,
+      BX_LOG_FORMAT_TEXT,
+      BX_LOG_FORMAT_TEXT);
+
+  new bx_param_num_c(menu,
+      "rate_limit",
+      "Log rate limit",
+      "Maximum number of messages reported per device and emulated second (0 = no limit)",
+      0, BX_MAX_BIT32U,
+      0);
+
   path = new bx_param_filename_c(menu,
       "debugger_filename",
       "Debugger Log filename",
@@ -2424,10 +2516,25 @@ static int parse_line_formatted(const char *context, int num_params, char *param
       PARSE_ERR(("%s: floppy_bootsig_check directive malformed.", context));
     }
   } else if (!strcmp(params[0], "log")) {
-    if (num_params != 2) {
+    if (num_params < 2) {
       PARSE_ERR(("%s: log directive has wrong # args.", context));
     }
     SIM->get_param_string(BXPN_LOG_FILENAME)->set(params[1]);
+    for (i=2; i<num_params; i++) {
+      if (!strncmp(params[i], "async=", 6)) {
+        if (parse_param_bool(params[i], 6, BXPN_LOG_ASYNC) < 0) {
+          PARSE_ERR(("%s: log directive malformed.", context));
+        }
+      } else if (!strncmp(params[i], "format=", 7)) {
+        if (!SIM->get_param_enum(BXPN_LOG_FORMAT)->set_by_name(&params[i][7])) {
+          PARSE_ERR(("%s: log directive malformed.", context));
+        }
+      } else if (!strncmp(params[i], "rate_limit=", 11)) {
+        SIM->get_param_num(BXPN_LOG_RATE_LIMIT)->set(atol(&params[i][11]));
+      } else {
+        PARSE_ERR(("%s: unknown parameter for log directive.", context));
+      }
+    }
   } else if (!strcmp(params[0], "logprefix")) {
     if (num_params != 2) {
       PARSE_ERR(("%s: logprefix directive has wrong # args.", context));
@@ -2511,6 +2618,21 @@ static int parse_line_formatted(const char *context, int num_params, char *param
         SIM->get_param_num(BXPN_HOST_MEM_SIZE)->set(atol(&params[i][5]));
       } else if (!strncmp(params[i], "guest=", 6)) {
         SIM->get_param_num(BXPN_MEM_SIZE)->set(atol(&params[i][6]));
+      } else if (!strncmp(params[i], "mmap=", 5)) {
+#if BX_HAVE_SYS_MMAN_H
+        SIM->get_param_bool(BXPN_MEM_MMAP)->set(atol(&params[i][5]));
+#else
+        if (atol(&params[i][5]))
+          PARSE_ERR(("%s: memory mapped guest RAM not supported on this host", context));
+#endif
+      } else if (!strncmp(params[i], "file=", 5)) {
+#if BX_HAVE_SYS_MMAN_H
+        SIM->get_param_string(BXPN_MEM_FILE)->set(&params[i][5]);
+#else
+        PARSE_ERR(("%s: RAM backing file not supported on this host", context));
+#endif
+      } else if (!strncmp(params[i], "incremental=", 12)) {
+        SIM->get_param_bool(BXPN_MEM_INCREMENTAL)->set(atol(&params[i][12]));
       } else {
         PARSE_ERR(("%s: memory directive malformed.", context));
       }
@@ -3160,7 +3282,11 @@ int bx_write_log_options(FILE *fp, bx_list_c *base)
   bx_param_num_c *mparam;
   int action, def_action, level, mod;
 
-  fprintf(fp, "log: %s\n", SIM->get_param_string("filename", base)->getptr());
+  fprintf(fp, "log: %s, async=%d, format=%s, rate_limit=%u\n",
+    SIM->get_param_string("filename", base)->getptr(),
+    SIM->get_param_bool("async", base)->get(),
+    SIM->get_param_enum("format", base)->get_selected(),
+    (unsigned) SIM->get_param_num("rate_limit", base)->get());
   fprintf(fp, "logprefix: %s\n", SIM->get_param_string("prefix", base)->getptr());
 
   strcpy(pname, "general.logfn");
@@ -3249,8 +3375,20 @@ int bx_write_configuration(const char *rc, int overwrite)
     fprintf(fp, ", options=\"%s\"\n", sparam->getptr());
   else
     fprintf(fp, "\n");
-  fprintf(fp, "memory: host=%d, guest=%d\n", SIM->get_param_num(BXPN_HOST_MEM_SIZE)->get(),
+  fprintf(fp, "memory: host=%d, guest=%d", SIM->get_param_num(BXPN_HOST_MEM_SIZE)->get(),
     SIM->get_param_num(BXPN_MEM_SIZE)->get());
+#if BX_HAVE_SYS_MMAN_H
+  if (SIM->get_param_bool(BXPN_MEM_MMAP)->get()) {
+    fprintf(fp, ", mmap=1");
+    sparam = SIM->get_param_string(BXPN_MEM_FILE);
+    if (!sparam->isempty())
+      fprintf(fp, ", file=\"%s\"", sparam->getptr());
+  }
+#endif
+  if (SIM->get_param_bool(BXPN_MEM_INCREMENTAL)->get()) {
+    fprintf(fp, ", incremental=1");
+  }
+  fprintf(fp, "\n");
   sparam = SIM->get_param_string(BXPN_ROM_PATH);
   if (!sparam->isempty()) {
     fprintf(fp, "romimage: file=\"%s\"", sparam->getptr());
@@ -3323,13 +3461,22 @@ int bx_write_configuration(const char *rc, int overwrite)
     SIM->get_param_string(BXPN_VGA_EXTENSION)->getptr(),
     SIM->get_param_num(BXPN_VGA_UPDATE_FREQUENCY)->get());
 #if BX_SUPPORT_SMP
-  fprintf(fp, "cpu: count=%u:%u:%u, ips=%u, quantum=%d, ",
+  fprintf(fp, "cpu: count=%u:%u:%u, ips=%u, quantum=%d, smp_threads=%d, ",
     SIM->get_param_num(BXPN_CPU_NPROCESSORS)->get(), SIM->get_param_num(BXPN_CPU_NCORES)->get(),
     SIM->get_param_num(BXPN_CPU_NTHREADS)->get(), SIM->get_param_num(BXPN_IPS)->get(),
-    SIM->get_param_num(BXPN_SMP_QUANTUM)->get());
+    SIM->get_param_num(BXPN_SMP_QUANTUM)->get(), SIM->get_param_bool(BXPN_SMP_THREADS)->get());
 #else
   fprintf(fp, "cpu: count=1, ips=%u, ", SIM->get_param_num(BXPN_IPS)->get());
 #endif
+  fprintf(fp, "icache_size=%u, tlb_size=%u, tlb_l2_size=%u, ",
+    SIM->get_param_num(BXPN_ICACHE_SIZE)->get(), SIM->get_param_num(BXPN_TLB_SIZE)->get(),
+    SIM->get_param_num(BXPN_TLB_L2_SIZE)->get());
+#if BX_SUPPORT_JIT
+  fprintf(fp, "jit_threshold=%u, ", SIM->get_param_num(BXPN_JIT_THRESHOLD)->get());
+#endif
+  sparam = SIM->get_param_string(BXPN_TRACE_CACHE_PATH);
+  if (!sparam->isempty())
+    fprintf(fp, "trace_cache=\"%s\", ", sparam->getptr());
   fprintf(fp, "model=%s, reset_on_triple_fault=%d, cpuid_limit_winnt=%d",
     SIM->get_param_enum(BXPN_CPU_MODEL)->get_selected(),
     SIM->get_param_bool(BXPN_RESET_ON_TRIPLE_FAULT)->get(),
@@ -869,6 +869,9 @@ accessOK:
           pageWriteStampTable.decWriteStamp(pAddr, 1);
           data = *hostAddr;
           BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+          BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
           BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
           BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 1, CPL, BX_READ, (Bit8u*) &data);
           return data;
@@ -919,6 +922,9 @@ accessOK:
           pageWriteStampTable.decWriteStamp(pAddr, 2);
           ReadHostWordFromLittleEndian(hostAddr, data);
           BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+          BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
           BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
           BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 2, CPL, BX_READ, (Bit8u*) &data);
           return data;
@@ -979,6 +985,9 @@ accessOK:
           pageWriteStampTable.decWriteStamp(pAddr, 4);
           ReadHostDWordFromLittleEndian(hostAddr, data);
           BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+          BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
           BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
           BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 4, CPL, BX_READ, (Bit8u*) &data);
           return data;
@@ -1039,6 +1048,9 @@ accessOK:
           pageWriteStampTable.decWriteStamp(pAddr, 8);
           ReadHostQWordFromLittleEndian(hostAddr, data);
           BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+          BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
           BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
           BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 8, CPL, BX_READ, (Bit8u*) &data);
           return data;
@@ -1077,6 +1089,13 @@ BX_CPU_C::write_RMW_virtual_byte(Bit8u val8)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit8u *hostAddr = (Bit8u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_pc_system.smp_threads) {
+      if (! bx_atomic_cas8(hostAddr, (Bit8u) BX_CPU_THIS_PTR address_xlation.rmw_data, val8))
+        restart_RMW();
+    }
+    else
+#endif
     *hostAddr = val8;
   }
   else {
@@ -1091,6 +1110,16 @@ BX_CPU_C::write_RMW_virtual_word(Bit16u val16)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit16u *hostAddr = (Bit16u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_pc_system.smp_threads) {
+      Bit16u oldval, newval;
+      WriteHostWordToLittleEndian(&oldval, (Bit16u) BX_CPU_THIS_PTR address_xlation.rmw_data);
+      WriteHostWordToLittleEndian(&newval, val16);
+      if (! bx_atomic_cas16(hostAddr, oldval, newval))
+        restart_RMW();
+    }
+    else
+#endif
     WriteHostWordToLittleEndian(hostAddr, val16);
     BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
         BX_CPU_THIS_PTR address_xlation.paddress1, 2, BX_WRITE, 0, (Bit8u*) &val16);
@@ -1125,6 +1154,16 @@ BX_CPU_C::write_RMW_virtual_dword(Bit32u val32)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit32u *hostAddr = (Bit32u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_pc_system.smp_threads) {
+      Bit32u oldval, newval;
+      WriteHostDWordToLittleEndian(&oldval, (Bit32u) BX_CPU_THIS_PTR address_xlation.rmw_data);
+      WriteHostDWordToLittleEndian(&newval, val32);
+      if (! bx_atomic_cas32(hostAddr, oldval, newval))
+        restart_RMW();
+    }
+    else
+#endif
     WriteHostDWordToLittleEndian(hostAddr, val32);
     BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
         BX_CPU_THIS_PTR address_xlation.paddress1, 4, BX_WRITE, 0, (Bit8u*) &val32);
@@ -1171,6 +1210,16 @@ BX_CPU_C::write_RMW_virtual_qword(Bit64u val64)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit64u *hostAddr = (Bit64u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_pc_system.smp_threads) {
+      Bit64u oldval, newval;
+      WriteHostQWordToLittleEndian(&oldval, (Bit64u) BX_CPU_THIS_PTR address_xlation.rmw_data);
+      WriteHostQWordToLittleEndian(&newval, val64);
+      if (! bx_atomic_cas64(hostAddr, oldval, newval))
+        restart_RMW();
+    }
+    else
+#endif
     WriteHostQWordToLittleEndian(hostAddr, val64);
     BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
         BX_CPU_THIS_PTR address_xlation.paddress1, 8, BX_WRITE, 0, (Bit8u*) &val64);
@@ -1211,6 +1260,24 @@ BX_CPU_C::write_RMW_virtual_qword(Bit64u val64)
   }
 }
 
+#if BX_SUPPORT_SMP
+
+// With every CPU simulated on its own host thread the R-M-W result is
+// committed with host compare-and-swap.  If another CPU modified the memory
+// operand since it was read, the instruction is executed again.
+void BX_CPU_C::restart_RMW(void)
+{
+  RIP = BX_CPU_THIS_PTR prev_rip;
+  if (BX_CPU_THIS_PTR speculative_rsp) {
+    RSP = BX_CPU_THIS_PTR prev_rsp;
+    BX_CPU_THIS_PTR speculative_rsp = 0;
+  }
+
+  longjmp(BX_CPU_THIS_PTR jmp_buf_env, 1); // go back to main decode loop
+}
+
+#endif
+
 //
 // Write data to new stack, these methods are required for emulation
 // correctness but not performance critical.
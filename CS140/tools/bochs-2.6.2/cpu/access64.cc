@@ -702,6 +702,9 @@ BX_CPU_C::read_RMW_virtual_byte_64(unsigned s, Bit64u offset)
       pageWriteStampTable.decWriteStamp(pAddr, 1);
       data = *hostAddr;
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
       BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 1, CPL, BX_READ, (Bit8u*) &data);
       return data;
@@ -742,6 +745,9 @@ BX_CPU_C::read_RMW_virtual_word_64(unsigned s, Bit64u offset)
       pageWriteStampTable.decWriteStamp(pAddr, 2);
       ReadHostWordFromLittleEndian(hostAddr, data);
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
       BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 2, CPL, BX_READ, (Bit8u*) &data);
       return data;
@@ -796,6 +802,9 @@ BX_CPU_C::read_RMW_virtual_dword_64(unsigned s, Bit64u offset)
       pageWriteStampTable.decWriteStamp(pAddr, 4);
       ReadHostDWordFromLittleEndian(hostAddr, data);
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
       BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 4, CPL, BX_READ, (Bit8u*) &data);
       return data;
@@ -850,6 +859,9 @@ BX_CPU_C::read_RMW_virtual_qword_64(unsigned s, Bit64u offset)
       pageWriteStampTable.decWriteStamp(pAddr, 8);
       ReadHostQWordFromLittleEndian(hostAddr, data);
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
       BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 8, CPL, BX_READ, (Bit8u*) &data);
       return data;
@@ -287,11 +287,102 @@ BX_CPP_INLINE Bit32u AES_RotWord(Bit32u x)
   return (x >> 8) | (x << 24);
 }
 
+//
+// The AES and carry-less multiplication instructions are executed with
+// the host AES-NI and PCLMULQDQ instructions when the host CPU has them,
+// the portable code above is the fallback.
+//
+
+#if BX_HOST_X86_INSN
+
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+
+static bx_bool host_has_aes = 0, host_has_pclmul = 0;
+
+// decided once at startup
+static struct bx_host_aes_init_t {
+  bx_host_aes_init_t() {
+    Bit32u features = bx_get_host_cpu_features();
+    // AES-NI capable processors also have SSSE3 (PSHUFB)
+    host_has_aes = (features & BX_HOST_CPU_AES) && (features & BX_HOST_CPU_SSSE3);
+    host_has_pclmul = (features & BX_HOST_CPU_PCLMUL) != 0;
+  }
+} bx_host_aes_init;
+
+BX_CPP_INLINE __m128i xmm_to_host(const BxPackedXmmRegister &reg)
+{
+  return _mm_loadu_si128((const __m128i *) &reg);
+}
+
+BX_CPP_INLINE void host_to_xmm(BxPackedXmmRegister &reg, __m128i val)
+{
+  _mm_storeu_si128((__m128i *) &reg, val);
+}
+
+__attribute__((target("aes,sse2")))
+static void host_aesimc(BxPackedXmmRegister &op)
+{
+  host_to_xmm(op, _mm_aesimc_si128(xmm_to_host(op)));
+}
+
+__attribute__((target("aes,sse2")))
+static void host_aesenc(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  host_to_xmm(op1, _mm_aesenc_si128(xmm_to_host(op1), xmm_to_host(op2)));
+}
+
+__attribute__((target("aes,sse2")))
+static void host_aesenclast(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  host_to_xmm(op1, _mm_aesenclast_si128(xmm_to_host(op1), xmm_to_host(op2)));
+}
+
+__attribute__((target("aes,sse2")))
+static void host_aesdec(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  host_to_xmm(op1, _mm_aesdec_si128(xmm_to_host(op1), xmm_to_host(op2)));
+}
+
+__attribute__((target("aes,sse2")))
+static void host_aesdeclast(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  host_to_xmm(op1, _mm_aesdeclast_si128(xmm_to_host(op1), xmm_to_host(op2)));
+}
+
+// S-box applied to all 16 bytes: AESENCLAST with a zero round key does
+// ShiftRows and SubBytes, the ShiftRows is undone in advance
+__attribute__((target("aes,ssse3")))
+static void host_aes_subbytes(BxPackedXmmRegister &op)
+{
+  const __m128i inv_shift_rows = _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3);
+  __m128i state = _mm_shuffle_epi8(xmm_to_host(op), inv_shift_rows);
+  host_to_xmm(op, _mm_aesenclast_si128(state, _mm_setzero_si128()));
+}
+
+// the immediate of PCLMULQDQ is an instruction operand, the qwords are
+// selected before and the host instruction always multiplies the low ones
+__attribute__((target("pclmul,sse2")))
+static void host_pclmulqdq(BxPackedXmmRegister &r, Bit64u a, Bit64u b)
+{
+  __m128i va = _mm_cvtsi32_si128((int) a), vb = _mm_cvtsi32_si128((int) b);
+  va = _mm_unpacklo_epi32(va, _mm_cvtsi32_si128((int)(a >> 32)));
+  vb = _mm_unpacklo_epi32(vb, _mm_cvtsi32_si128((int)(b >> 32)));
+  host_to_xmm(r, _mm_clmulepi64_si128(va, vb, 0x00));
+}
+
+#endif
+
 /* 66 0F 38 DB */
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESIMC_VdqWdqR(bxInstruction_c *i)
 {
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
 
+#if BX_HOST_X86_INSN
+  if (host_has_aes)
+    host_aesimc(op);
+  else
+#endif
   AES_InverseMixColumns(op);
 
   BX_WRITE_XMM_REGZ(i->dst(), op, i->getVL());
@@ -304,12 +395,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESENC_VdqHdqWdqR(bxInstruction_c
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_ShiftRows(op1);
-  AES_SubstituteBytes(op1);
-  AES_MixColumns(op1);
+#if BX_HOST_X86_INSN
+  if (host_has_aes) {
+    host_aesenc(op1, op2);
+  }
+  else
+#endif
+  {
+    AES_ShiftRows(op1);
+    AES_SubstituteBytes(op1);
+    AES_MixColumns(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -321,11 +420,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESENCLAST_VdqHdqWdqR(bxInstructio
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_ShiftRows(op1);
-  AES_SubstituteBytes(op1);
+#if BX_HOST_X86_INSN
+  if (host_has_aes) {
+    host_aesenclast(op1, op2);
+  }
+  else
+#endif
+  {
+    AES_ShiftRows(op1);
+    AES_SubstituteBytes(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -337,12 +444,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESDEC_VdqHdqWdqR(bxInstruction_c
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_InverseShiftRows(op1);
-  AES_InverseSubstituteBytes(op1);
-  AES_InverseMixColumns(op1);
+#if BX_HOST_X86_INSN
+  if (host_has_aes) {
+    host_aesdec(op1, op2);
+  }
+  else
+#endif
+  {
+    AES_InverseShiftRows(op1);
+    AES_InverseSubstituteBytes(op1);
+    AES_InverseMixColumns(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -354,11 +469,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESDECLAST_VdqHdqWdqR(bxInstructio
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_InverseShiftRows(op1);
-  AES_InverseSubstituteBytes(op1);
+#if BX_HOST_X86_INSN
+  if (host_has_aes) {
+    host_aesdeclast(op1, op2);
+  }
+  else
+#endif
+  {
+    AES_InverseShiftRows(op1);
+    AES_InverseSubstituteBytes(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -372,9 +495,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESKEYGENASSIST_VdqWdqIbR(bxInstru
 
   Bit32u rcon32 = i->Ib();
 
-  result.xmm32u(0) = AES_SubWord(op.xmm32u(1));
+#if BX_HOST_X86_INSN
+  if (host_has_aes) {
+    host_aes_subbytes(op);
+    result.xmm32u(0) = op.xmm32u(1);
+    result.xmm32u(2) = op.xmm32u(3);
+  }
+  else
+#endif
+  {
+    result.xmm32u(0) = AES_SubWord(op.xmm32u(1));
+    result.xmm32u(2) = AES_SubWord(op.xmm32u(3));
+  }
   result.xmm32u(1) = AES_RotWord(result.xmm32u(0)) ^ rcon32;
-  result.xmm32u(2) = AES_SubWord(op.xmm32u(3));
   result.xmm32u(3) = AES_RotWord(result.xmm32u(2)) ^ rcon32;
 
   BX_WRITE_XMM_REGZ(i->dst(), result, i->getVL());
@@ -401,6 +534,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::PCLMULQDQ_VdqHdqWdqIbR(bxInstructi
   // B determined by imm8[4]
   Bit64u b = op2.xmm64u((imm8 >> 4) & 1);
 
+#if BX_HOST_X86_INSN
+  if (host_has_pclmul) {
+    host_pclmulqdq(r, a.xmm64u(0), b);
+    BX_WRITE_XMM_REGZ(i->dst(), r, i->getVL());
+    BX_NEXT_INSTR(i);
+  }
+#endif
+
   r.xmm64u(0) = 0;
   r.xmm64u(1) = 0;
 
@@ -316,14 +316,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VADDPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_addps, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_addps(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_addps(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -336,14 +341,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VADDPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
   
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_addpd, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_addpd(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_addpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -386,14 +396,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMULPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_mulps, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_mulps(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_mulps(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -406,14 +421,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMULPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_mulpd, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_mulpd(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_mulpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -591,14 +611,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VSUBPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_subps, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_subps(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_subps(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -611,14 +636,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VSUBPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_subpd, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_subpd(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_subpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -733,14 +763,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VDIVPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_divps, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_divps(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_divps(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -753,14 +788,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VDIVPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  int flags = host_pfp_avx(host_divpd, &op1, &op2, len, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_divpd(&op1.avx128(n), &op2.avx128(n), status);
+    for (unsigned n=0; n < len; n++) {
+      sse_divpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
+
+    flags = status.float_exception_flags;
   }
 
-  check_exceptionsSSE(status.float_exception_flags);
+  check_exceptionsSSE(flags);
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -24,27 +24,27 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
-#define InstrumentICACHE 0
-
-#if InstrumentICACHE
-static unsigned iCacheLookups=0;
-static unsigned iCacheMisses=0;
-
-#define InstrICache_StatsMask 0xffffff
-
-#define InstrICache_Stats() {\
-  if ((iCacheLookups & InstrICache_StatsMask) == 0) { \
-    BX_INFO(("ICACHE lookups: %u, misses: %u, hit rate = %6.2f%% ", \
-          iCacheLookups, \
-          iCacheMisses,  \
-          (iCacheLookups-iCacheMisses) * 100.0f / iCacheLookups)); \
-    iCacheLookups = iCacheMisses = 0; \
-  } \
+#if BX_SUPPORT_JIT
+
+// Run the trace from translated code, translate it first if it became hot.
+// Returns 0 if the trace has to be interpreted.
+BX_CPP_INLINE bx_bool BX_CPU_C::jitExecute(bxICacheEntry_c *entry)
+{
+  if (entry->jitGeneration != BX_CPU_THIS_PTR jitCache.generation) {
+    if (! BX_CPU_THIS_PTR jitCache.enabled()) return 0;
+    if (++entry->jitCount < BX_CPU_THIS_PTR jitCache.threshold) return 0;
+    jitTranslate(entry);
+  }
+
+  // the translated code does not expect a timer to fire inside of the trace
+  if (BX_SMP_PROCESSORS == 1 && bx_pc_system.getNumCpuTicksLeftNextEvent() <= entry->tlen)
+    return 0;
+
+  BX_CPU_THIS_PTR jitCache.stats.executions++;
+  entry->jitCode(BX_CPU_THIS);
+  return 1;
 }
-#define InstrICache_Increment(v) (v)++
-#else
-#define InstrICache_Stats()
-#define InstrICache_Increment(v)
+
 #endif
 
 void BX_CPU_C::cpu_loop(void)
@@ -112,6 +112,14 @@ void BX_CPU_C::cpu_loop(void)
     }
 #else // BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS == 0
 
+#if BX_SUPPORT_JIT
+    if (jitExecute(entry)) {
+      // clear stop trace magic indication that probably was set by repeat or branch32/64
+      BX_CPU_THIS_PTR async_event &= ~BX_ASYNC_EVENT_STOP_TRACE;
+      continue;
+    }
+#endif
+
     bxInstruction_c *last = i + (entry->tlen);
 
     for(;;) {
@@ -139,6 +147,10 @@ void BX_CPU_C::cpu_loop(void)
       if (BX_CPU_THIS_PTR async_event) break;
 
       if (++i == last) {
+#if BX_SUPPORT_JIT
+        // the next trace might be translated, look it up in the outer loop
+        break;
+#endif
         entry = getICacheEntry();
         i = entry->i;
         last = i + (entry->tlen);
@@ -162,6 +174,10 @@ void BX_CPU_C::cpu_run_trace(void)
     return;
   }
 
+  // serve TLB/trace cache invalidations and startup IPIs posted by other
+  // CPU threads, they must be done before the CPU fetches the next trace
+  if (BX_CPU_THIS_PTR remote_request) handleRemoteRequests();
+
   // check on events which occurred for previous instructions (traps)
   // and ones which are asynchronous to the CPU (hardware interrupts)
   if (BX_CPU_THIS_PTR async_event) {
@@ -169,6 +185,8 @@ void BX_CPU_C::cpu_run_trace(void)
       // If request to return to caller ASAP.
       return;
     }
+
+    if (BX_CPU_THIS_PTR remote_request) handleRemoteRequests();
   }
 
   bxICacheEntry_c *entry = getICacheEntry();
@@ -186,6 +204,14 @@ void BX_CPU_C::cpu_run_trace(void)
     BX_CPU_THIS_PTR async_event &= ~BX_ASYNC_EVENT_STOP_TRACE;
   }
 #else
+#if BX_SUPPORT_JIT
+  if (jitExecute(entry)) {
+    // clear stop trace magic indication that probably was set by repeat or branch32/64
+    BX_CPU_THIS_PTR async_event &= ~BX_ASYNC_EVENT_STOP_TRACE;
+    return;
+  }
+#endif
+
   bxInstruction_c *last = i + (entry->tlen);
 
   for(;;) {
@@ -219,8 +245,7 @@ bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
     eipBiased = RIP + BX_CPU_THIS_PTR eipPageBias;
   }
 
-  InstrICache_Increment(iCacheLookups);
-  InstrICache_Stats();
+  BX_CPU_THIS_PTR iCache.stats.lookups++;
 
   bx_phy_address pAddr = BX_CPU_THIS_PTR pAddrFetchPage + eipBiased;
   bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
@@ -229,7 +254,7 @@ bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
   {
     // iCache miss. No validated instruction with matching fetch parameters
     // is in the iCache.
-    InstrICache_Increment(iCacheMisses);
+    BX_CPU_THIS_PTR iCache.stats.misses++;
     entry = serveICacheMiss(entry, (Bit32u) eipBiased, pAddr);
   }
 
@@ -241,15 +266,20 @@ bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
 // The function is called after taken branch instructions and tries to link the branch to the next trace
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::linkTrace(bxInstruction_c *i)
 {
-#if BX_SUPPORT_SMP
-  if (BX_SMP_PROCESSORS > 1)
-    return;
-#endif
-
+  // remote requests posted by other CPUs also stop the trace here
   if (BX_CPU_THIS_PTR async_event) return;
 
   Bit32u delta = (Bit32u) (BX_CPU_THIS_PTR icount - BX_CPU_THIS_PTR icount_last_sync);
-  if(delta >= bx_pc_system.getNumCpuTicksLeftNextEvent())
+#if BX_SUPPORT_SMP
+  if (BX_SMP_PROCESSORS > 1) {
+    // the timers and the other CPUs only advance between the quantums,
+    // keep the linked traces within the quantum of this CPU
+    if (delta >= BX_CPU_THIS_PTR icount_link_limit)
+      return;
+  }
+  else
+#endif
+  if (delta >= bx_pc_system.getNumCpuTicksLeftNextEvent())
     return;
 
   bxInstruction_c *next = i->getNextTrace();
@@ -273,15 +303,15 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::linkTrace(bxInstruction_c *i)
     return;
   }
 
-  InstrICache_Increment(iCacheLookups);
-  InstrICache_Stats();
-
   bx_phy_address pAddr = BX_CPU_THIS_PTR pAddrFetchPage + eipBiased;
   bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
 
   if (entry != NULL) // link traces - handle only hit cases
   {
-    i->setNextTrace(entry->i);
+    // misses are counted when the trace is looked up again by cpu_loop
+    BX_CPU_THIS_PTR iCache.stats.lookups++;
+    if (BX_CPU_THIS_PTR iCache.register_link(i, entry->i))
+      i->setNextTrace(entry->i);
     i = entry->i;
     BX_EXECUTE_INSTRUCTION(i);
   }
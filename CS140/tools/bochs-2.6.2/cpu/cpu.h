@@ -730,17 +730,32 @@ typedef struct
 #include "instr.h"
 #include "lazy_flags.h"
 
-// BX_TLB_SIZE: Number of entries in TLB
-// BX_TLB_INDEX_OF(lpf): This macro is passed the linear page frame
-//   (top 20 bits of the linear address.  It must map these bits to
-//   one of the TLB cache slots, given the size of BX_TLB_SIZE.
-//   There will be a many-to-one mapping to each TLB cache slot.
-//   When there are collisions, the old entry is overwritten with
-//   one for the newest access.
-
-#define BX_TLB_SIZE 1024
-#define BX_TLB_MASK ((BX_TLB_SIZE-1) << 12)
-#define BX_TLB_INDEX_OF(lpf, len) ((((unsigned)(lpf) + (len)) & BX_TLB_MASK) >> 12)
+// The TLB is organized in two levels:
+//
+// L1: BX_TLB_WAYS-way set associative cache of 4K translations which is
+//   used by the memory access fast paths.  The number of entries can be
+//   changed by the "tlb_size" CPU option.
+// L2: larger direct mapped cache of 4K translations plus a small fully
+//   associative cache of large (2M/4M/1G) page translations, consulted
+//   before walking the page tables on L1 miss.  The L2 is flushed by
+//   advancing a generation counter instead of clearing every entry.
+// L2 entries are tagged with the address space (PCID, VPID/ASID) they were
+//   created in, so switching back to one of the BX_TLB_CONTEXTS recently
+//   used address spaces finds its translations still cached.
+//
+// BX_TLB_INDEX_OF(lpf, len): This macro is passed the linear address and
+//   returns the index of the L1 TLB entry caching it.  The set is selected
+//   by the last byte of the access so accesses crossing a page boundary
+//   always miss.  If no way in the set matches, the entry to be replaced
+//   is returned.
+
+#define BX_TLB_SIZE 1024  // default L1 size, must be a power of 2
+#define BX_TLB_WAYS 4     // must be a power of 2
+#define BX_TLB_INDEX_OF(lpf, len) (BX_CPU_THIS_PTR TLB_index_of((lpf), (len)))
+
+#define BX_TLB_L2_SIZE 8192  // default L2 size, must be a power of 2
+#define BX_TLB_LARGE_ENTRIES 32
+#define BX_TLB_CONTEXTS 8
 
 typedef bx_ptr_equiv_t bx_hostpageaddr_t;
 
@@ -752,6 +767,25 @@ typedef struct {
   Bit32u lpf_mask;      // linear address mask of the page size
 } bx_TLB_entry;
 
+typedef struct {
+  bx_address lpf;       // linear page frame (base of the large page)
+  bx_phy_address ppf;   // physical page frame (base of the large page)
+  Bit32u accessBits;    // all the accesses granted so far by page walks
+  Bit32u lpf_mask;      // linear address mask of the page size
+  Bit32u gen;           // TLB generation when the entry was created
+  Bit32u gen_nonglobal;
+} bx_TLB_L2_entry;
+
+typedef struct {
+  Bit64u root;          // EPT/nested paging root of a tagged guest
+  Bit32u vpid;          // VPID or ASID of a tagged guest, 0 otherwise
+  Bit32u pcid;          // BX_TLB_NO_CONTEXT for unused slot
+  Bit32u gen;           // generations of the address space
+  Bit32u gen_nonglobal;
+} bx_TLB_context;
+
+#define BX_TLB_NO_CONTEXT 0xffffffff
+
 #if BX_SUPPORT_X86_64
   #define LPF_MASK BX_CONST64(0xfffffffffffff000)
 #else
@@ -772,6 +806,7 @@ typedef struct {
 
 #define PAGE_OFFSET(laddr) ((Bit32u)(laddr) & 0xfff)
 
+#include "jit.h"
 #include "icache.h"
 
 // general purpose register
@@ -969,6 +1004,11 @@ public: // for now...
 
   Bit64u icount;
   Bit64u icount_last_sync;
+#if BX_SUPPORT_SMP
+  // Number of instructions the CPU may execute through linked traces after
+  // the last sync, set by the SMP main loop from the CPU's quantum
+  Bit32u icount_link_limit;
+#endif
 
 #define BX_INHIBIT_INTERRUPTS        0x01
 #define BX_INHIBIT_DEBUG             0x02
@@ -1133,12 +1173,21 @@ public: // for now...
   Bit32u  async_event;
 
   BX_SMF BX_CPP_INLINE void signal_event(Bit32u event) {
+#if BX_SUPPORT_SMP
+    // events could be signaled by other host threads in threaded SMP mode
+    bx_atomic_or32(&BX_CPU_THIS_PTR pending_event, event);
+#else
     BX_CPU_THIS_PTR pending_event |= event;
+#endif
     if (! is_masked_event(event)) BX_CPU_THIS_PTR async_event = 1;
   }
 
   BX_SMF BX_CPP_INLINE void clear_event(Bit32u event) {
+#if BX_SUPPORT_SMP
+    bx_atomic_and32(&BX_CPU_THIS_PTR pending_event, ~event);
+#else
     BX_CPU_THIS_PTR pending_event &= ~event;
+#endif
   }
 
   BX_SMF BX_CPP_INLINE void mask_event(Bit32u event) {
@@ -1166,6 +1215,27 @@ public: // for now...
 
 #define BX_ASYNC_EVENT_STOP_TRACE (1<<31)
 
+#if BX_SUPPORT_SMP
+  // When every CPU is simulated on its own host thread, state owned by the
+  // CPU (TLB, trace cache) could not be modified by other threads directly.
+  // Such requests are posted here and served by the CPU itself before
+  // executing the next trace.
+#define BX_REMOTE_REQ_TLB_FLUSH    (1<<0)
+#define BX_REMOTE_REQ_ICACHE_FLUSH (1<<1)
+#define BX_REMOTE_REQ_SMC          (1<<2)
+#define BX_REMOTE_REQ_SIPI         (1<<3)
+  volatile Bit32u remote_request;
+
+  unsigned remote_sipi_vector;
+
+#define BX_REMOTE_SMC_QUEUE_SIZE 16
+  unsigned remote_smc_count;
+  struct {
+    bx_phy_address pAddr;
+    Bit32u mask;
+  } remote_smc[BX_REMOTE_SMC_QUEUE_SIZE];
+#endif
+
 #if BX_X86_DEBUGGER
   bx_bool  in_repeat;
 #endif
@@ -1220,10 +1290,29 @@ public: // for now...
 
   // for paging
   struct {
-    bx_TLB_entry entry[BX_TLB_SIZE] BX_CPP_AlignN(16);
+    bx_TLB_entry *entry;  // L1, (set_mask+1) sets of BX_TLB_WAYS entries
+    unsigned size;
+    unsigned set_mask;
+    Bit8u *next_way;      // round robin replacement pointer of every set
 #if BX_CPU_LEVEL >= 5
     bx_bool split_large;
 #endif
+    bx_TLB_L2_entry *l2;
+    unsigned l2_mask;
+    // L2 holds 4K pieces of large pages (only when these are not
+    // physically contiguous, e.g. under EPT), INVLPG must flush the L2
+    bx_bool l2_split_large;
+    bx_TLB_L2_entry large[BX_TLB_LARGE_ENTRIES];
+    unsigned next_large;
+    Bit32u gen;           // current L2 generations
+    Bit32u gen_nonglobal;
+    // recently used address spaces, the L2 entries of the current one are
+    // indexed with l2_hash added (except global pages)
+    bx_TLB_context context[BX_TLB_CONTEXTS];
+    unsigned cur_context;
+    unsigned next_context;
+    unsigned l2_hash;
+    Bit32u next_gen;
   } TLB;
 
 #define BX_TLB_ENTRY_OF(lpf) (&BX_CPU_THIS_PTR TLB.entry[BX_TLB_INDEX_OF((lpf), 0)])
@@ -1238,6 +1327,9 @@ public: // for now...
   // this structure should be aligned on a 32-byte boundary to be friendly
   // with the host cache lines.
   bxICache_c iCache BX_CPP_AlignN(32);
+#if BX_SUPPORT_JIT
+  bxJitCache_c jitCache;
+#endif
   Bit32u fetchModeMask;
 
   struct {
@@ -1254,6 +1346,11 @@ public: // for now...
                               // is greated than 2 (the maximum possible for
                               // normal cases) it is a native pointer and is used
                               // for a direct write access.
+#if BX_SUPPORT_SMP
+    Bit64u rmw_data;          // Value read through the native host pointer by
+                              // the R-M-W instruction, the write is committed
+                              // only if memory still holds it (threaded SMP).
+#endif
   } address_xlation;
 
   BX_SMF void setEFlags(Bit32u val) BX_CPP_AttrRegparmN(1);
@@ -3647,6 +3744,10 @@ public: // for now...
   BX_SMF bxICacheEntry_c *serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBiased, bx_phy_address pAddr);
   BX_SMF bxICacheEntry_c* getICacheEntry(void);
   BX_SMF bx_bool mergeTraces(bxICacheEntry_c *entry, bxInstruction_c *i, bx_phy_address pAddr);
+#if BX_SUPPORT_JIT
+  BX_SMF BX_CPP_INLINE bx_bool jitExecute(bxICacheEntry_c *entry);
+  BX_SMF void jitTranslate(bxICacheEntry_c *entry);
+#endif
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
   BX_SMF BX_INSF_TYPE linkTrace(bxInstruction_c *i) BX_CPP_AttrRegparmN(1);
 #endif
@@ -3949,12 +4050,18 @@ public: // for now...
        bx_descriptor_t *descriptor, bx_address rip, Bit8u cpl);
 
 #if BX_SUPPORT_REPEAT_SPEEDUPS
+  BX_SMF bx_bool FastRepLinearAddr(unsigned seg, bx_address offset, unsigned rw, bx_address *laddr);
+
   BX_SMF Bit32u FastRepMOVSB(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
        unsigned dstSeg, bx_address dstOff, Bit32u  byteCount);
   BX_SMF Bit32u FastRepMOVSW(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
        unsigned dstSeg, bx_address dstOff, Bit32u  wordCount);
   BX_SMF Bit32u FastRepMOVSD(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
        unsigned dstSeg, bx_address dstOff, Bit32u dwordCount);
+#if BX_SUPPORT_X86_64
+  BX_SMF Bit32u FastRepMOVSQ(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
+       unsigned dstSeg, bx_address dstOff, Bit32u qwordCount);
+#endif
 
   BX_SMF Bit32u FastRepSTOSB(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff,
        Bit8u  val, Bit32u  byteCount);
@@ -3962,6 +4069,10 @@ public: // for now...
        Bit16u val, Bit32u  wordCount);
   BX_SMF Bit32u FastRepSTOSD(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff,
        Bit32u val, Bit32u dwordCount);
+#if BX_SUPPORT_X86_64
+  BX_SMF Bit32u FastRepSTOSQ(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff,
+       Bit64u val, Bit32u qwordCount);
+#endif
 
   BX_SMF Bit32u FastRepINSW(bxInstruction_c *i, bx_address dstOff,
        Bit16u port, Bit32u wordCount);
@@ -4012,9 +4123,18 @@ public: // for now...
 
 #if BX_CPU_LEVEL >= 6
   BX_SMF void TLB_flushNonGlobal(void);
+  BX_SMF void TLB_flushPCID(Bit32u pcid);
 #endif
+  BX_SMF void TLB_init(void);
   BX_SMF void TLB_flush(void);
+  BX_SMF void TLB_L1_flush(bx_bool global);
   BX_SMF void TLB_invlpg(bx_address laddr);
+  BX_SMF BX_CPP_INLINE unsigned TLB_index_of(bx_address laddr, unsigned len);
+  BX_SMF void TLB_L2_flush(bx_bool global);
+  BX_SMF void TLB_get_context(bx_TLB_context *ctx);
+  BX_SMF void TLB_switch_context(bx_bool vm_switch);
+  BX_SMF bx_TLB_L2_entry *TLB_L2_lookup(bx_address laddr, bx_phy_address *paddress);
+  BX_SMF void TLB_L2_update(bx_address laddr, bx_phy_address paddress, Bit32u lpf_mask, Bit32u accessBits);
   BX_SMF void inhibit_interrupts(unsigned mask);
   BX_SMF bx_bool interrupts_inhibited(unsigned mask);
   BX_SMF const char *strseg(bx_segment_reg_t *seg);
@@ -4063,7 +4183,7 @@ public: // for now...
   BX_SMF void shutdown(void);
   BX_SMF void enter_sleep_state(unsigned state);
   BX_SMF void handleCpuModeChange(void);
-  BX_SMF void handleCpuContextChange(void);
+  BX_SMF void handleCpuContextChange(bx_bool vm_switch);
   BX_SMF void handleInterruptMaskChange(void);
 #if BX_CPU_LEVEL >= 4
   BX_SMF void handleAlignmentCheck(void);
@@ -4166,6 +4286,13 @@ public: // for now...
   BX_SMF void    deliver_NMI(void);
   BX_SMF void    deliver_SMI(void);
   BX_SMF void    deliver_SIPI(unsigned vector);
+  BX_SMF void    process_SIPI(unsigned vector);
+#if BX_SUPPORT_SMP
+  BX_SMF void    post_remote_request(Bit32u request);
+  BX_SMF void    post_remote_smc(bx_phy_address pAddr, Bit32u mask);
+  BX_SMF void    handleRemoteRequests(void);
+  BX_SMF void    restart_RMW(void) BX_CPP_AttrNoReturn();
+#endif
   BX_SMF void    debug(bx_address offset);
 #if BX_DISASM
   BX_SMF void    debug_disasm_instruction(bx_address offset);
@@ -4509,6 +4636,21 @@ BX_CPP_INLINE void BX_CPU_C::prepareXSAVE(void)
 // bit 2 - SSE_OK
 // bit 3 - AVX_OK
 //
+BX_CPP_INLINE unsigned BX_CPU_C::TLB_index_of(bx_address laddr, unsigned len)
+{
+  unsigned set = (((unsigned)(laddr) + len) >> 12) & BX_CPU_THIS_PTR TLB.set_mask;
+  unsigned index = set * BX_TLB_WAYS;
+  bx_address lpf = LPFOf(laddr);
+
+  for (unsigned way=0; way < BX_TLB_WAYS; way++, index++) {
+    // bit [11] of the TLB lpf used for TLB_NoHostPtr valid indication
+    if (AlignedAccessLPFOf(BX_CPU_THIS_PTR TLB.entry[index].lpf, 0x7ff) == lpf)
+      return index;
+  }
+
+  return set * BX_TLB_WAYS + BX_CPU_THIS_PTR TLB.next_way[set];
+}
+
 // updateFetchModeMask - has to be called everytime 
 //   CS.L / CS.D_B / CR0.PE, CR0.TS or CR0.EM / CR4.OSFXSR / CR4.OSXSAVE changes
 //
@@ -30,93 +30,41 @@
 
 // 3-byte opcodes
 
-#define CRC32_POLYNOMIAL BX_CONST64(0x11edc6f41)
-
-// primitives for CRC32 usage
-BX_CPP_INLINE Bit8u BitReflect8(Bit8u val8)
-{
-  return ((val8 & 0x80) >> 7) |
-         ((val8 & 0x40) >> 5) |
-         ((val8 & 0x20) >> 3) |
-         ((val8 & 0x10) >> 1) |
-         ((val8 & 0x08) << 1) |
-         ((val8 & 0x04) << 3) |
-         ((val8 & 0x02) << 5) |
-         ((val8 & 0x01) << 7);
-}
-
-BX_CPP_INLINE Bit16u BitReflect16(Bit16u val16)
-{
-  return ((Bit16u)(BitReflect8(val16 & 0xff)) << 8) | BitReflect8(val16 >> 8);
-}
-
-BX_CPP_INLINE Bit32u BitReflect32(Bit32u val32)
-{
-  return ((Bit32u)(BitReflect16(val32 & 0xffff)) << 16) | BitReflect16(val32 >> 16);
-}
-
-static Bit32u mod2_64bit(Bit64u divisor, Bit64u dividend)
-{
-  Bit64u remainder = dividend >> 32;
-
-  for (int bitpos=31; bitpos>=0; bitpos--) {
-    // copy one more bit from the dividend
-    remainder = (remainder << 1) | ((dividend >> bitpos) & 1);
-
-    // if MSB is set, then XOR divisor and get new remainder
-    if (((remainder >> 32) & 1) == 1) {
-      remainder ^= divisor;
-    }
-  }
-
-  return (Bit32u) remainder;
-}
+// The CRC-32C computation itself is shared with the rest of Bochs, it uses
+// the host CRC32 instruction when available or slicing-by-8 tables (crc.cc)
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEbR(bxInstruction_c *i)
 {
   Bit8u op1 = BX_READ_8BIT_REGx(i->src(), i->extend8bitL());
-
   Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
 
-  Bit64u tmp1 = ((Bit64u) BitReflect8 (op1)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) <<  8;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2 = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+  op2 = crc32c(op2, op1, 1);
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEwR(bxInstruction_c *i)
 {
-  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
   Bit16u op1 = BX_READ_16BIT_REG(i->src());
+  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
 
-  Bit64u tmp1 = ((Bit64u) BitReflect16(op1)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) << 16;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2 = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+  op2 = crc32c(op2, op1, 2);
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEdR(bxInstruction_c *i)
 {
-  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
   Bit32u op1 = BX_READ_32BIT_REG(i->src());
+  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
 
-  Bit64u tmp1 = ((Bit64u) BitReflect32(op1)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) << 32;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2 = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+  op2 = crc32c(op2, op1, 4);
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
@@ -125,20 +73,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEdR(bxInstruction_c *i)
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEqR(bxInstruction_c *i)
 {
-  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
   Bit64u op1 = BX_READ_64BIT_REG(i->src());
+  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
 
-  Bit64u tmp1 = ((Bit64u) BitReflect32(op1 & 0xffffffff)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) << 32;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2  = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
-  tmp1 = ((Bit64u) BitReflect32(op1 >> 32)) << 32;
-  tmp2 = ((Bit64u) op2) << 32;
-  tmp3 = tmp1 ^ tmp2;
-  op2  = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+  op2 = crc32c(op2, op1, 8);
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
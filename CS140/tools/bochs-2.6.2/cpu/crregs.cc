@@ -1261,6 +1261,8 @@ bx_bool BX_CPU_C::SetCR4(bxInstruction_c *i, bx_address val)
   if (! check_CR4(val)) return 0;
 
 #if BX_CPU_LEVEL >= 6
+  bx_bool flush_tlb = 0;
+
   // Modification of PGE,PAE,PSE,PCIDE,SMEP flushes TLB cache according to docs.
   if ((val & BX_CR4_FLUSH_TLB_MASK) != (BX_CPU_THIS_PTR cr4.val32 & BX_CR4_FLUSH_TLB_MASK)) {
     // reload PDPTR if needed
@@ -1281,7 +1283,7 @@ bx_bool BX_CPU_C::SetCR4(bxInstruction_c *i, bx_address val)
       }
     }
 #endif
-    TLB_flush(); // Flush Global entries also.
+    flush_tlb = 1;
   }
 #endif
 
@@ -1299,6 +1301,11 @@ bx_bool BX_CPU_C::SetCR4(bxInstruction_c *i, bx_address val)
   BX_CPU_THIS_PTR cr4.set32((Bit32u) val);
 
 #if BX_CPU_LEVEL >= 6
+  // flushed with the new CR4 in place, the current TLB context takes its
+  // PCID from CR3 only while CR4.PCIDE is set
+  if (flush_tlb)
+    TLB_flush(); // Flush Global entries also.
+
   handleSseModeChange();
 #if BX_SUPPORT_AVX
   handleAvxModeChange();
@@ -1312,7 +1319,15 @@ bx_bool BX_CPU_C::SetCR4(bxInstruction_c *i, bx_address val)
 bx_bool BX_CPP_AttrRegparmN(1) BX_CPU_C::SetCR3(bx_address val)
 {
 #if BX_SUPPORT_X86_64
+  bx_bool noflush = 0;
+
   if (long_mode()) {
+    // with CR4.PCIDE set, CR3[63] keeps the TLB entries of the new PCID
+    if (BX_CPU_THIS_PTR cr4.get_PCIDE()) {
+      noflush = (val >> 63) & 1;
+      val &= BX_CONST64(0x7fffffffffffffff);
+    }
+
     if (! IsValidPhyAddr(val)) {
       BX_ERROR(("SetCR3(): Attempt to write to reserved bits of CR3 !"));
       return 0;
@@ -1322,6 +1337,17 @@ bx_bool BX_CPP_AttrRegparmN(1) BX_CPU_C::SetCR3(bx_address val)
 
   BX_CPU_THIS_PTR cr3 = val;
 
+#if BX_SUPPORT_X86_64
+  // the TLB entries are tagged with PCID, only those of the new PCID
+  // are flushed
+  if (BX_CPU_THIS_PTR cr4.get_PCIDE()) {
+    TLB_switch_context(0);
+    if (! noflush)
+      TLB_flushNonGlobal();
+    return 1;
+  }
+#endif
+
   // flush TLB even if value does not change
 #if BX_CPU_LEVEL >= 6
   if (BX_CPU_THIS_PTR cr4.get_PGE())
@@ -1407,7 +1433,9 @@ void BX_CPU_C::WriteCR8(bxInstruction_c *i, bx_address val)
   }
 #endif
 
+  BX_LOCK_IO();
   BX_CPU_THIS_PTR lapic.set_tpr(tpr);
+  BX_UNLOCK_IO();
 }
 
 Bit32u BX_CPU_C::ReadCR8(bxInstruction_c *i)
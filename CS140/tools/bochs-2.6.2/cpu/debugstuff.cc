@@ -23,6 +23,7 @@
 #define NEED_CPU_REG_SHORTCUTS 1
 #include "bochs.h"
 #include "cpu.h"
+#include "tracecache.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
 #if BX_DISASM
@@ -390,4 +391,28 @@ void BX_CPU_C::dbg_get_idtr(bx_dbg_global_sreg_t *sreg)
 void BX_CPU_C::atexit(void)
 {
   debug(BX_CPU_THIS_PTR prev_rip);
+
+  Bit64u lookups = BX_CPU_THIS_PTR iCache.stats.lookups;
+  Bit64u misses = BX_CPU_THIS_PTR iCache.stats.misses;
+  BX_INFO(("ICACHE lookups: " FMT_LL "u, misses: " FMT_LL "u, hit rate = %6.2f%%",
+      lookups, misses, lookups ? (lookups-misses) * 100.0 / lookups : 0.0));
+  BX_INFO(("ICACHE flushes: " FMT_LL "u, evictions: " FMT_LL "u, SMC invalidations: " FMT_LL "u",
+      BX_CPU_THIS_PTR iCache.stats.flushes, BX_CPU_THIS_PTR iCache.stats.evictions,
+      BX_CPU_THIS_PTR iCache.stats.smc));
+  if (BX_CPU_ID == 0 && traceCacheStore.enabled()) {
+    BX_INFO(("TRACE CACHE loaded: " FMT_LL "u, hits: " FMT_LL "u, new traces: " FMT_LL "u",
+        traceCacheStore.stats.loaded, traceCacheStore.stats.hits, traceCacheStore.stats.stored));
+    if (! traceCacheStore.save())
+      BX_ERROR(("could not write trace cache file '%s'", traceCacheStore.get_path()));
+  }
+#if BX_SUPPORT_JIT
+  if (BX_CPU_THIS_PTR jitCache.enabled()) {
+    BX_INFO(("JIT translations: " FMT_LL "u (" FMT_LL "u instructions inlined, " FMT_LL "u with fast path, " FMT_LL "u called), flushes: " FMT_LL "u",
+        BX_CPU_THIS_PTR jitCache.stats.translations, BX_CPU_THIS_PTR jitCache.stats.inlined,
+        BX_CPU_THIS_PTR jitCache.stats.fast, BX_CPU_THIS_PTR jitCache.stats.called,
+        BX_CPU_THIS_PTR jitCache.stats.flushes));
+    BX_INFO(("JIT translated trace executions: " FMT_LL "u",
+        BX_CPU_THIS_PTR jitCache.stats.executions));
+  }
+#endif
 }
@@ -68,7 +68,9 @@ bx_bool BX_CPU_C::handleWaitForEvent(void)
 
     if (BX_HRQ && BX_DBG_ASYNC_DMA) {
       // handle DMA also when CPU is halted
+      BX_LOCK_IO();
       DEV_dma_raise_hlda();
+      BX_UNLOCK_IO();
     }
 
     // for multiprocessor simulation, even if this CPU is halted we still
@@ -95,7 +97,8 @@ bx_bool BX_CPU_C::handleWaitForEvent(void)
       return 1; // Return to caller of cpu_loop.
     }
 
-    BX_TICKN(10); // when in HLT run time faster for single CPU
+    // when in HLT skip to the next timer event for single CPU
+    bx_pc_system.idle();
   }
 
   return 0;
@@ -125,6 +128,8 @@ void BX_CPU_C::InterruptAcknowledge(void)
   }
 #endif
 
+  BX_LOCK_IO();
+
   // NOTE: similar code in ::take_irq()
 #if BX_SUPPORT_APIC
   if (is_pending(BX_EVENT_PENDING_LAPIC_INTR))
@@ -134,6 +139,8 @@ void BX_CPU_C::InterruptAcknowledge(void)
     // if no local APIC, always acknowledge the PIC.
     vector = DEV_pic_iac(); // may set INTR with next interrupt
 
+  BX_UNLOCK_IO();
+
   BX_CPU_THIS_PTR EXT = 1; /* external event */
 #if BX_SUPPORT_VMX
   VMexit_Event(BX_EXTERNAL_INTERRUPT, vector, 0, 0);
@@ -325,7 +332,9 @@ bx_bool BX_CPU_C::handleAsyncEvent(void)
   else if (BX_HRQ && BX_DBG_ASYNC_DMA) {
     // NOTE: similar code in ::take_dma()
     // assert Hold Acknowledge (HLDA) and go into a bus hold state
+    BX_LOCK_IO();
     DEV_dma_raise_hlda();
+    BX_UNLOCK_IO();
   }
 
   if (BX_CPU_THIS_PTR get_TF())
@@ -388,6 +397,23 @@ bx_bool BX_CPU_C::interrupts_inhibited(unsigned mask)
 }
 
 void BX_CPU_C::deliver_SIPI(unsigned vector)
+{
+#if BX_SUPPORT_SMP
+  if (bx_pc_system.smp_threads) {
+    // the CPU might be running on another host thread, it will process
+    // the startup IPI by itself
+    BX_LOCK_IO();
+    BX_CPU_THIS_PTR remote_sipi_vector = vector;
+    post_remote_request(BX_REMOTE_REQ_SIPI);
+    BX_UNLOCK_IO();
+    return;
+  }
+#endif
+
+  process_SIPI(vector);
+}
+
+void BX_CPU_C::process_SIPI(unsigned vector)
 {
   if (BX_CPU_THIS_PTR activity_state == BX_ACTIVITY_STATE_WAIT_FOR_SIPI) {
 #if BX_SUPPORT_VMX
@@ -432,6 +458,61 @@ void BX_CPU_C::clear_INTR(void)
   clear_event(BX_EVENT_PENDING_INTR);
 }
 
+#if BX_SUPPORT_SMP
+
+void BX_CPU_C::post_remote_request(Bit32u request)
+{
+  bx_atomic_or32(&BX_CPU_THIS_PTR remote_request, request);
+  // make the CPU leave the currently executed trace
+  bx_atomic_or32(&BX_CPU_THIS_PTR async_event, BX_ASYNC_EVENT_STOP_TRACE);
+}
+
+void BX_CPU_C::post_remote_smc(bx_phy_address pAddr, Bit32u mask)
+{
+  BX_LOCK_IO();
+  unsigned n = BX_CPU_THIS_PTR remote_smc_count;
+  if (n < BX_REMOTE_SMC_QUEUE_SIZE) {
+    BX_CPU_THIS_PTR remote_smc[n].pAddr = pAddr;
+    BX_CPU_THIS_PTR remote_smc[n].mask = mask;
+    BX_CPU_THIS_PTR remote_smc_count = n + 1;
+    post_remote_request(BX_REMOTE_REQ_SMC);
+  }
+  else {
+    // too many pending invalidations, drop the whole trace cache instead
+    post_remote_request(BX_REMOTE_REQ_ICACHE_FLUSH);
+  }
+  BX_UNLOCK_IO();
+}
+
+void BX_CPU_C::handleRemoteRequests(void)
+{
+  BX_LOCK_IO();
+
+  Bit32u request = bx_atomic_xchg32(&BX_CPU_THIS_PTR remote_request, 0);
+
+  if (request & BX_REMOTE_REQ_ICACHE_FLUSH) {
+    BX_CPU_THIS_PTR iCache.flushICacheEntries();
+  }
+  else if (request & BX_REMOTE_REQ_SMC) {
+    for (unsigned n=0; n < BX_CPU_THIS_PTR remote_smc_count; n++)
+      BX_CPU_THIS_PTR iCache.handleSMC(BX_CPU_THIS_PTR remote_smc[n].pAddr,
+                                       BX_CPU_THIS_PTR remote_smc[n].mask);
+  }
+  BX_CPU_THIS_PTR remote_smc_count = 0;
+
+  unsigned sipi_vector = BX_CPU_THIS_PTR remote_sipi_vector;
+
+  BX_UNLOCK_IO();
+
+  if (request & BX_REMOTE_REQ_TLB_FLUSH)
+    TLB_flush();
+
+  if (request & BX_REMOTE_REQ_SIPI)
+    process_SIPI(sipi_vector);
+}
+
+#endif
+
 #if BX_DEBUGGER
 
 void BX_CPU_C::dbg_take_dma(void)
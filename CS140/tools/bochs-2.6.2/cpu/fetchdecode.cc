@@ -23,6 +23,7 @@
 #define NEED_CPU_REG_SHORTCUTS 1
 #include "bochs.h"
 #include "cpu.h"
+#include "tracecache.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
 ///////////////////////////
@@ -2034,6 +2035,31 @@ const char *get_bx_opcode_name(Bit16u ia_opcode)
   return (ia_opcode < BX_IA_LAST) ? BxOpcodeNamesTable[ia_opcode] : 0;
 }
 
+// Used to validate the persistent trace cache: the handlers are hashed
+// relative to BxError, so the hash only changes with the executable and
+// with the CPU features (see init_FetchDecodeTables)
+Bit32u get_bx_opcode_table_hash(void)
+{
+  BxExecutePtr_tR base_handler = &BX_CPU_C::BxError;
+  bx_ptr_equiv_t base = bx_handler_address(&base_handler);
+
+  Bit32u hash = 2166136261U; // FNV-1a
+  for (unsigned n=0; n < BX_IA_LAST; n++) {
+    bx_ptr_equiv_t val[3];
+    val[0] = bx_handler_address(&BxOpcodesTable[n].execute1);
+    val[1] = bx_handler_address(&BxOpcodesTable[n].execute2);
+    if (val[0]) val[0] -= base;
+    if (val[1]) val[1] -= base;
+    val[2] = 0;
+    memcpy(&val[2], BxOpcodesTable[n].src, 4);
+    const Bit8u *p = (const Bit8u *) val;
+    for (unsigned k=0; k < (sizeof(bx_ptr_equiv_t)*2+4); k++)
+      hash = (hash ^ p[k]) * 16777619U;
+  }
+
+  return hash;
+}
+
 void BX_CPU_C::init_FetchDecodeTables(void)
 {
   static Bit64u BxOpcodeFeatures[BX_IA_LAST] =
@@ -24,14 +24,145 @@
 #define NEED_CPU_REG_SHORTCUTS 1
 #include "bochs.h"
 #include "cpu.h"
+#include "tracecache.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
 #include "param_names.h"
 
 bxPageWriteStampTable pageWriteStampTable;
 
+void bxICache_c::init(unsigned entries)
+{
+  cleanup();
+
+  entryMask = entries - 1;
+  entry = new bxICacheEntry_c[entries];
+
+  mpSegmentSize = BxICacheMemPool(entries) / BX_ICACHE_POOL_SEGMENTS;
+  mpoolSize = mpSegmentSize * BX_ICACHE_POOL_SEGMENTS;
+  mpool = new bxInstruction_c[mpoolSize];
+  // every trace holds at least one instruction
+  segTraceOwner = new Bit32u[mpoolSize];
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  segLinksMax = mpSegmentSize / 4;
+  segLinkSource = new bxInstruction_c*[segLinksMax * BX_ICACHE_POOL_SEGMENTS];
+#endif
+
+  flushICacheEntries();
+  memset(&stats, 0, sizeof(stats));
+}
+
+void bxICache_c::cleanup(void)
+{
+  delete [] entry;
+  entry = NULL;
+  delete [] mpool;
+  mpool = NULL;
+  delete [] segTraceOwner;
+  segTraceOwner = NULL;
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  delete [] segLinkSource;
+  segLinkSource = NULL;
+#endif
+}
+
+void bxICache_c::flushICacheEntries(void)
+{
+  bxICacheEntry_c* e = entry;
+  unsigned i;
+
+  for (i=0; i<=entryMask; i++, e++) {
+    e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
+    e->traceMask = 0;
+  }
+
+  nextPageSplitIndex = 0;
+  for (i=0;i<BX_ICACHE_PAGE_SPLIT_ENTRIES;i++)
+    pageSplitIndex[i].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
+
+  nextVictimCacheIndex = 0;
+  for (i=0;i<BX_ICACHE_VICTIM_ENTRIES;i++)
+    victimCache[i].vc_entry.pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
+
+  for (i=0;i<BX_ICACHE_POOL_SEGMENTS;i++) {
+    segTraces[i] = 0;
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+    segLinks[i] = 0;
+#endif
+  }
+
+  mpindex = 0;
+  mpSegment = 0;
+  mpSegmentEnd = mpSegmentSize;
+
+  stats.flushes++;
+}
+
+// Recycle the oldest pool segment: every trace decoded into it is dropped
+// and every trace link pointing into it is broken.
+void bxICache_c::evict_segment(void)
+{
+  unsigned i;
+
+  mpSegment = (mpSegment + 1) & (BX_ICACHE_POOL_SEGMENTS-1);
+  mpindex = mpSegment * mpSegmentSize;
+  mpSegmentEnd = mpindex + mpSegmentSize;
+
+  const bxInstruction_c *start = &mpool[mpindex], *end = &mpool[mpSegmentEnd];
+
+  // the entry could have been replaced by a newer trace living in another
+  // segment, check the trace pointer before invalidating
+  const Bit32u *owner = &segTraceOwner[mpindex];
+  for (i=0; i < segTraces[mpSegment]; i++) {
+    bxICacheEntry_c *e = &entry[owner[i]];
+    if (e->i >= start && e->i < end)
+      e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
+  }
+  segTraces[mpSegment] = 0;
+
+  for (i=0;i<BX_ICACHE_VICTIM_ENTRIES;i++) {
+    bxICacheEntry_c *e = &victimCache[i].vc_entry;
+    if (e->i >= start && e->i < end)
+      e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
+  }
+
+  for (i=0;i<BX_ICACHE_PAGE_SPLIT_ENTRIES;i++) {
+    if (pageSplitIndex[i].ppf != BX_ICACHE_INVALID_PHY_ADDRESS) {
+      const bxInstruction_c *ti = pageSplitIndex[i].e->i;
+      if (ti >= start && ti < end)
+        pageSplitIndex[i].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
+    }
+  }
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  // the link source might live in a segment recycled since the link was
+  // made, only clear it if it still points into this segment
+  bxInstruction_c **link = &segLinkSource[mpSegment * segLinksMax];
+  for (i=0; i < segLinks[mpSegment]; i++) {
+    const bxInstruction_c *next = link[i]->getNextTrace();
+    if (next >= start && next < end)
+      link[i]->setNextTrace(NULL);
+  }
+  segLinks[mpSegment] = 0;
+#endif
+
+  stats.evictions++;
+}
+
 void flushICaches(void)
 {
+#if BX_SUPPORT_SMP
+  if (bx_pc_system.smp_threads) {
+    // Trace caches are owned by the CPU threads, every CPU flushes its own
+    // cache before executing the next trace.  The write stamps are left
+    // intact as other CPUs could be marking new traces concurrently; stale
+    // stamps only cause an extra invalidation.
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+      BX_CPU(i)->post_remote_request(BX_REMOTE_REQ_ICACHE_FLUSH);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
     BX_CPU(i)->iCache.flushICacheEntries();
     BX_CPU(i)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
@@ -42,6 +173,14 @@ void flushICaches(void)
 
 void handleSMC(bx_phy_address pAddr, Bit32u mask)
 {
+#if BX_SUPPORT_SMP
+  if (bx_pc_system.smp_threads) {
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+      BX_CPU(i)->post_remote_smc(pAddr, mask);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
     BX_CPU(i)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
     BX_CPU(i)->iCache.handleSMC(pAddr, mask);
@@ -64,6 +203,19 @@ void genDummyICacheEntry(bxInstruction_c *i)
 
 #endif
 
+// Add a new trace to the persistent trace cache
+static void storeTrace(const bxICache_c *iCache, Bit32u fetchModeMask, const Bit8u *fetchPtr, const bxICacheEntry_c *entry)
+{
+  unsigned tlen = entry->tlen;
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  // drop the end of trace opcode copied together with a merged trace
+  if (tlen > 0 && entry->i[tlen-1].getIaOpcode() == BX_INSERTED_OPCODE) tlen--;
+#endif
+  BX_LOCK_IO();
+  traceCacheStore.insert(fetchModeMask, fetchPtr, entry->i, tlen, iCache);
+  BX_UNLOCK_IO();
+}
+
 bxICacheEntry_c* BX_CPU_C::serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBiased, bx_phy_address pAddr)
 {
   entry = BX_CPU_THIS_PTR iCache.get_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
@@ -76,6 +228,10 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBia
   // trace from incoming instruction bytes stream !
   entry->pAddr = pAddr;
   entry->traceMask = 0;
+#if BX_SUPPORT_JIT
+  entry->jitCount = 0;
+  entry->jitGeneration = 0;
+#endif
 
   unsigned remainingInPage = BX_CPU_THIS_PTR eipPageWindowSize - eipBiased;
   const Bit8u *fetchPtr = BX_CPU_THIS_PTR eipFetchPtr + eipBiased;
@@ -89,10 +245,45 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBia
   // Don't allow traces longer than cpu_loop can execute
   static unsigned quantum =
 #if BX_SUPPORT_SMP
-    (BX_SMP_PROCESSORS > 1) ? SIM->get_param_num(BXPN_SMP_QUANTUM)->get() :
+    (BX_SMP_PROCESSORS > 1 && ! bx_pc_system.smp_threads) ? SIM->get_param_num(BXPN_SMP_QUANTUM)->get() :
 #endif
     BX_MAX_TRACE_LENGTH;
- 
+
+  if (traceCacheStore.enabled()) {
+    // the same instruction bytes were decoded by a previous run
+    unsigned tlen = 0;
+    BX_LOCK_IO();
+    bxTraceRecord_t *rec = traceCacheStore.lookup(BX_CPU_THIS_PTR fetchModeMask, fetchPtr, remainingInPage);
+    if (rec != NULL) {
+      tlen = (rec->tlen > quantum) ? quantum : rec->tlen;
+      memcpy(i, rec->instr(), sizeof(bxInstruction_c) * tlen);
+    }
+    BX_UNLOCK_IO();
+
+    if (tlen > 0) {
+      for (unsigned n=0; n < tlen; n++, i++) {
+        unsigned iLen = i->ilen();
+        BX_INSTR_OPCODE(BX_CPU_ID, i, fetchPtr, iLen,
+           BX_CPU_THIS_PTR sregs[BX_SEG_REG_CS].cache.u.segment.d_b, long64_mode());
+        traceMask |= 1 <<  (pageOffset >> 7);
+        traceMask |= 1 << ((pageOffset + iLen - 1) >> 7);
+        pageOffset += iLen;
+        fetchPtr += iLen;
+      }
+      entry->tlen = tlen;
+      entry->traceMask = traceMask;
+      pageWriteStampTable.markICacheMask(entry->pAddr, entry->traceMask);
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+      entry->tlen++; /* Add the inserted end of trace opcode */
+      genDummyICacheEntry(i);
+#endif
+      BX_CPU_THIS_PTR iCache.commit_trace(entry);
+      return entry;
+    }
+  }
+
+  const Bit8u *traceStart = fetchPtr;
+
   for (unsigned n=0;n < quantum;n++)
   {
 #if BX_SUPPORT_X86_64
@@ -158,7 +349,9 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBia
       if (mergeTraces(entry, i, pAddr)) {
           entry->traceMask |= traceMask;
           pageWriteStampTable.markICacheMask(pAddr, entry->traceMask);
-          BX_CPU_THIS_PTR iCache.commit_trace(entry->tlen);
+          if (traceCacheStore.enabled())
+            storeTrace(&BX_CPU_THIS_PTR iCache, BX_CPU_THIS_PTR fetchModeMask, traceStart, entry);
+          BX_CPU_THIS_PTR iCache.commit_trace(entry);
           return entry;
       }
     }
@@ -170,12 +363,15 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBia
 
   pageWriteStampTable.markICacheMask(pAddr, entry->traceMask);
 
+  if (traceCacheStore.enabled())
+    storeTrace(&BX_CPU_THIS_PTR iCache, BX_CPU_THIS_PTR fetchModeMask, traceStart, entry);
+
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
   entry->tlen++; /* Add the inserted end of trace opcode */
   genDummyICacheEntry(i);
 #endif
 
-  BX_CPU_THIS_PTR iCache.commit_trace(entry->tlen);
+  BX_CPU_THIS_PTR iCache.commit_trace(entry);
 
   return entry;
 }
@@ -199,6 +395,19 @@ bx_bool BX_CPU_C::mergeTraces(bxICacheEntry_c *entry, bxInstruction_c *i, bx_phy
 #endif
 
     memcpy(i, e->i, sizeof(bxInstruction_c)*max_length);
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+    // the copied trace could be already linked to another trace, the new
+    // copy of the link must be known to the pool segment it points to
+    for (unsigned n=0; n < max_length; n++) {
+      bxInstruction_c *next = i[n].getNextTrace();
+      if (BX_CPU_THIS_PTR iCache.in_pool(next)) {
+        if (! BX_CPU_THIS_PTR iCache.register_link(i+n, next))
+          i[n].setNextTrace(NULL);
+      }
+    }
+#endif
+
     entry->tlen += max_length;
     BX_ASSERT(entry->tlen <= BX_MAX_TRACE_LENGTH);
 
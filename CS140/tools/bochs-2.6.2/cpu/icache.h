@@ -48,17 +48,28 @@ public:
     return fineGranularityMapping[hash(pAddr)];
   }
 
+  // the whole table, indexed by hash(), for the JIT translated stores
+  BX_CPP_INLINE const Bit32u *getFineGranularityMappingTable(void) const
+  {
+    return fineGranularityMapping;
+  }
+
   BX_CPP_INLINE void markICache(bx_phy_address pAddr, unsigned len)
   {
     Bit32u mask  = 1 << (PAGE_OFFSET((Bit32u) pAddr) >> 7);
            mask |= 1 << (PAGE_OFFSET((Bit32u) pAddr + len - 1) >> 7);
 
-    fineGranularityMapping[hash(pAddr)] |= mask;
+    markICacheMask(pAddr, mask);
   }
 
   BX_CPP_INLINE void markICacheMask(bx_phy_address pAddr, Bit32u mask)
   {
+#if BX_SUPPORT_SMP
+    // the table is shared by all CPUs which might run on separate threads
+    bx_atomic_or32(&fineGranularityMapping[hash(pAddr)], mask);
+#else
     fineGranularityMapping[hash(pAddr)] |= mask;
+#endif
   }
 
   // whole page is being altered
@@ -67,8 +78,13 @@ public:
     Bit32u index = hash(pAddr);
 
     if (fineGranularityMapping[index]) {
+#if BX_SUPPORT_SMP
+      bx_atomic_and32(&fineGranularityMapping[index], 0);
+      handleSMC(pAddr, 0xffffffff); // one of the CPUs might be running trace from this page
+#else
       handleSMC(pAddr, 0xffffffff); // one of the CPUs might be running trace from this page
       fineGranularityMapping[index] = 0;
+#endif
     }
   }
 
@@ -82,9 +98,16 @@ public:
               mask |= 1 << (PAGE_OFFSET((Bit32u) pAddr + len - 1) >> 7);
 
        if (fineGranularityMapping[index] & mask) {
+#if BX_SUPPORT_SMP
+          // clear the stamp first, a trace marked concurrently by another
+          // CPU thread must never be left without protection
+          bx_atomic_and32(&fineGranularityMapping[index], ~mask);
+          handleSMC(pAddr, mask);
+#else
           // one of the CPUs might be running trace from this page
           handleSMC(pAddr, mask);
           fineGranularityMapping[index] &= ~mask;
+#endif
        }       
     }
   }
@@ -101,8 +124,15 @@ BX_CPP_INLINE void bxPageWriteStampTable::resetWriteStamps(void)
 
 extern bxPageWriteStampTable pageWriteStampTable;
 
-#define BxICacheEntries (256 * 1024)  // Must be a power of 2.
-#define BxICacheMemPool (576 * 1024)
+// The number of trace cache entries is set by the "icache_size" CPU
+// option.  The instruction pool is sized relative to the number of
+// entries.
+#define BxICacheMemPool(entries) ((entries) / 4 * 9)
+
+// The instruction pool is split into segments which are recycled in FIFO
+// order: when the pool runs out of space only the traces living in the
+// oldest segment are dropped instead of flushing the whole trace cache.
+#define BX_ICACHE_POOL_SEGMENTS 8 /* must be power of two */
 
 #define BX_MAX_TRACE_LENGTH 32
 
@@ -113,6 +143,12 @@ struct bxICacheEntry_c
 
   Bit32u tlen;          // Trace length in instructions
   bxInstruction_c *i;
+
+#if BX_SUPPORT_JIT
+  Bit32u jitCount;      // Executions of the trace while interpreted
+  Bit32u jitGeneration; // Code buffer generation jitCode belongs to
+  bxJitCode_t jitCode;  // Translated trace
+#endif
 };
 
 #define BX_ICACHE_INVALID_PHY_ADDRESS (bx_phy_address(-1))
@@ -131,10 +167,26 @@ BX_CPP_INLINE void flushSMC(bxICacheEntry_c *e)
 
 class BOCHSAPI bxICache_c {
 public:
-  bxICacheEntry_c entry[BxICacheEntries];
-  bxInstruction_c mpool[BxICacheMemPool];
+  bxICacheEntry_c *entry;
+  Bit32u entryMask;     // number of entries - 1
+  bxInstruction_c *mpool;
+  unsigned mpoolSize;
   unsigned mpindex;
 
+  // Pool segments; traces never cross a segment boundary
+  unsigned mpSegmentSize;
+  unsigned mpSegment;   // segment currently being filled
+  unsigned mpSegmentEnd;
+  // For every segment: indices of the entries owning traces allocated in it
+  Bit32u *segTraceOwner;
+  unsigned segTraces[BX_ICACHE_POOL_SEGMENTS];
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  // For every segment: instructions in other segments linked into it
+  bxInstruction_c **segLinkSource;
+  unsigned segLinksMax;
+  unsigned segLinks[BX_ICACHE_POOL_SEGMENTS];
+#endif
+
 #define BX_ICACHE_PAGE_SPLIT_ENTRIES 8 /* must be power of two */
   struct pageSplitEntryIndex {
     bx_phy_address ppf; // Physical address of 2nd page of the trace 
@@ -149,30 +201,59 @@ public:
   } victimCache[BX_ICACHE_VICTIM_ENTRIES];
   int nextVictimCacheIndex;
 
+  // Trace cache statistics
+  struct {
+    Bit64u lookups;
+    Bit64u misses;
+    Bit64u flushes;     // complete trace cache flushes
+    Bit64u evictions;   // pool segments recycled
+    Bit64u smc;         // traces invalidated by self modifying code
+  } stats;
+
 public:
-  bxICache_c() { flushICacheEntries(); }
+  bxICache_c(): entry(NULL), mpool(NULL), segTraceOwner(NULL)
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+    , segLinkSource(NULL)
+#endif
+  {
+    memset(&stats, 0, sizeof(stats));
+  }
+ ~bxICache_c() { cleanup(); }
+
+  void init(unsigned entries);
+  void cleanup(void);
 
-  BX_CPP_INLINE static unsigned hash(bx_phy_address pAddr, unsigned fetchModeMask)
+  BX_CPP_INLINE unsigned hash(bx_phy_address pAddr, unsigned fetchModeMask) const
   {
-//  return ((pAddr + (pAddr << 2) + (pAddr>>6)) & (BxICacheEntries-1)) ^ fetchModeMask;
-    return ((pAddr) & (BxICacheEntries-1)) ^ fetchModeMask;
+//  return ((pAddr + (pAddr << 2) + (pAddr>>6)) & entryMask) ^ fetchModeMask;
+    return ((pAddr) & entryMask) ^ fetchModeMask;
   }
 
   BX_CPP_INLINE void alloc_trace(bxICacheEntry_c *e)
   {
     // took +1 garbend for instruction chaining speedup (end-of-trace opcode)
-    if ((mpindex + BX_MAX_TRACE_LENGTH + 1) > BxICacheMemPool) {
-      flushICacheEntries();
+    if ((mpindex + BX_MAX_TRACE_LENGTH + 1) > mpSegmentEnd) {
+      evict_segment();
     }
     e->i = &mpool[mpindex];
     e->tlen = 0;
   }
 
-  BX_CPP_INLINE void commit_trace(unsigned len) { mpindex += len; }
+  BX_CPP_INLINE void register_trace(bxICacheEntry_c *e)
+  {
+    segTraceOwner[mpSegment * mpSegmentSize + segTraces[mpSegment]++] = (Bit32u)(e - entry);
+  }
+
+  BX_CPP_INLINE void commit_trace(bxICacheEntry_c *e)
+  {
+    mpindex += e->tlen;
+    register_trace(e);
+  }
 
   BX_CPP_INLINE void commit_page_split_trace(bx_phy_address paddr, bxICacheEntry_c *entry)
   {
     mpindex += entry->tlen;
+    register_trace(entry);
 
     // register page split entry
     if (pageSplitIndex[nextPageSplitIndex].ppf != BX_ICACHE_INVALID_PHY_ADDRESS)
@@ -184,6 +265,31 @@ public:
     nextPageSplitIndex = (nextPageSplitIndex+1) & (BX_ICACHE_PAGE_SPLIT_ENTRIES-1);
   }
 
+  BX_CPP_INLINE bx_bool in_pool(const bxInstruction_c *i) const
+  {
+    return i >= mpool && i < mpool + mpoolSize;
+  }
+
+  BX_CPP_INLINE unsigned segment_of(const bxInstruction_c *i) const
+  {
+    return (unsigned)(i - mpool) / mpSegmentSize;
+  }
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  // Returns false if the link could not be recorded and must not be made
+  BX_CPP_INLINE bx_bool register_link(bxInstruction_c *from, bxInstruction_c *to)
+  {
+    unsigned seg = segment_of(to);
+    // links inside one segment are dropped together with the segment
+    if (seg == segment_of(from)) return 1;
+    if (segLinks[seg] >= segLinksMax) return 0;
+    segLinkSource[seg * segLinksMax + segLinks[seg]++] = from;
+    return 1;
+  }
+#endif
+
+  void evict_segment(void);
+
   BX_CPP_INLINE bxICacheEntry_c *lookup_victim_cache(bx_phy_address pAddr, Bit32u fetchModeMask)
   {
     for (int i=0; i < BX_ICACHE_VICTIM_ENTRIES;i++) {
@@ -207,7 +313,7 @@ public:
 
   BX_CPP_INLINE void handleSMC(bx_phy_address pAddr, Bit32u mask);
 
-  BX_CPP_INLINE void flushICacheEntries(void);
+  void flushICacheEntries(void);
 
   BX_CPP_INLINE bxICacheEntry_c* get_entry(bx_phy_address pAddr, unsigned fetchModeMask)
   {
@@ -224,27 +330,6 @@ public:
   }
 };
 
-BX_CPP_INLINE void bxICache_c::flushICacheEntries(void)
-{
-  bxICacheEntry_c* e = entry;
-  unsigned i;
-
-  for (i=0; i<BxICacheEntries; i++, e++) {
-    e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
-    e->traceMask = 0;
-  }
-
-  nextPageSplitIndex = 0;
-  for (i=0;i<BX_ICACHE_PAGE_SPLIT_ENTRIES;i++)
-    pageSplitIndex[i].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
-
-  nextVictimCacheIndex = 0;
-  for (i=0;i<BX_ICACHE_VICTIM_ENTRIES;i++)
-    victimCache[i].vc_entry.pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
-
-  mpindex = 0;
-}
-
 BX_CPP_INLINE void bxICache_c::handleSMC(bx_phy_address pAddr, Bit32u mask)
 {
   Bit32u pAddrIndex = bxPageWriteStampTable::hash(pAddr);
@@ -288,6 +373,7 @@ BX_CPP_INLINE void bxICache_c::handleSMC(bx_phy_address pAddr, Bit32u mask)
     for (unsigned index=0; index < 128; index++, e++) {
       if (pAddrIndex == bxPageWriteStampTable::hash(e->pAddr) && (e->traceMask & mask) != 0) {
         flushSMC(e);
+        stats.smc++;
       }
     }
   }
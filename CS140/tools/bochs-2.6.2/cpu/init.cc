@@ -23,6 +23,7 @@
 #define NEED_CPU_REG_SHORTCUTS 1
 #include "bochs.h"
 #include "cpu.h"
+#include "tracecache.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
 #include "param_names.h"
@@ -53,6 +54,10 @@ BX_CPU_C::BX_CPU_C(unsigned id): bx_cpuid(id)
 #if BX_SUPPORT_SVM
   svm_extensions_bitmask = 0;
 #endif
+#if BX_SUPPORT_SMP
+  remote_request = 0;
+  remote_smc_count = 0;
+#endif
 
   srand(time(NULL)); // initialize random generator for RDRAND/RDSEED
 }
@@ -106,6 +111,30 @@ void BX_CPU_C::initialize(void)
 
   init_FetchDecodeTables(); // must be called after init_isa_features_bitmask()
 
+  // trace cache size must be a power of 2
+  unsigned icache_entries = SIM->get_param_num(BXPN_ICACHE_SIZE)->get() * 1024;
+  while (icache_entries & (icache_entries-1))
+    icache_entries &= icache_entries-1;
+  BX_CPU_THIS_PTR iCache.init(icache_entries);
+
+  if (BX_CPU_ID == 0) {
+    // decoded traces are shared by all CPUs, the decoding depends on the
+    // CPU model
+    const char *path = SIM->get_param_string(BXPN_TRACE_CACHE_PATH)->getptr();
+    Bit64u features = BX_CPU_THIS_PTR isa_extensions_bitmask * 31 + BX_CPU_THIS_PTR cpu_extensions_bitmask;
+    if (traceCacheStore.load(path, features) < 0)
+      BX_INFO(("trace cache file '%s' was written by another Bochs binary or CPU model, ignored", path));
+    else if (traceCacheStore.enabled())
+      BX_INFO(("trace cache file '%s': " FMT_LL "u traces loaded", path, traceCacheStore.stats.loaded));
+  }
+
+#if BX_SUPPORT_JIT
+  if (! BX_CPU_THIS_PTR jitCache.init(SIM->get_param_num(BXPN_JIT_THRESHOLD)->get()))
+    BX_ERROR(("JIT: could not allocate the code buffer, traces will be interpreted"));
+#endif
+
+  TLB_init();
+
 #if BX_CONFIGURE_MSRS
   for (unsigned n=0; n < BX_MSR_MAX_INDEX; n++) {
     BX_CPU_THIS_PTR msrs[n] = 0;
@@ -410,7 +439,7 @@ void BX_CPU_C::register_state(void)
 #if BX_CPU_LEVEL >= 5
   BXRS_PARAM_BOOL(tlb, split_large, TLB.split_large);
 #endif
-  for (n=0; n<BX_TLB_SIZE; n++) {
+  for (n=0; n<BX_CPU_THIS_PTR TLB.size; n++) {
     sprintf(name, "entry%d", n);
     bx_list_c *tlb_entry = new bx_list_c(tlb, name);
     BXRS_HEX_PARAM_FIELD(tlb_entry, lpf, TLB.entry[n].lpf);
@@ -518,7 +547,7 @@ void BX_CPU_C::param_restore(bx_param_c *param, Bit64s val)
 
 void BX_CPU_C::after_restore_state(void)
 {
-  handleCpuContextChange();
+  handleCpuContextChange(0);
 
   BX_CPU_THIS_PTR prev_rip = RIP;
 
@@ -573,6 +602,9 @@ void BX_CPU_C::reset(unsigned source)
   if (source == BX_RESET_HARDWARE)
     BX_CPU_THIS_PTR icount = 0;
   BX_CPU_THIS_PTR icount_last_sync = BX_CPU_THIS_PTR icount;
+#if BX_SUPPORT_SMP
+  BX_CPU_THIS_PTR icount_link_limit = 0;
+#endif
 
   BX_CPU_THIS_PTR inhibit_mask = 0;
   BX_CPU_THIS_PTR inhibit_icount = 0;
@@ -919,7 +951,7 @@ void BX_CPU_C::reset(unsigned source)
   }
 #endif
 
-  handleCpuContextChange();
+  handleCpuContextChange(0);
 
 #if BX_CPU_LEVEL >= 4
   BX_CPU_THIS_PTR cpuid->dump_cpuid();
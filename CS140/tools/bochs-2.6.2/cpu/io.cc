@@ -39,15 +39,10 @@ Bit32u BX_CPU_C::FastRepINSW(bxInstruction_c *i, bx_address dstOff, Bit16u port,
   Bit8u *hostAddrDst;
   unsigned count;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[BX_SEG_REG_ES];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
+  bx_address laddrDst;
+  if (! FastRepLinearAddr(BX_SEG_REG_ES, dstOff, BX_WRITE, &laddrDst))
     return 0;
 
-  bx_address laddrDst = get_laddr32(BX_SEG_REG_ES, dstOff);
   // check that the address is word aligned
   if (laddrDst & 1) return 0;
 
@@ -112,15 +107,10 @@ Bit32u BX_CPU_C::FastRepOUTSW(bxInstruction_c *i, unsigned srcSeg, bx_address sr
   Bit8u *hostAddrSrc;
   unsigned count;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
+  bx_address laddrSrc;
+  if (! FastRepLinearAddr(srcSeg, srcOff, BX_READ, &laddrSrc))
     return 0;
 
-  bx_address laddrSrc = get_laddr32(srcSeg, srcOff);
   // check that the address is word aligned
   if (laddrSrc & 1) return 0;
 
@@ -361,17 +351,50 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSW32_YwDX(bxInstruction_c *i)
 // 16-bit operand size, 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSW64_YwDX(bxInstruction_c *i)
 {
-  // trigger any segment or page faults before reading from IO port
-  Bit16u value16 = read_RMW_virtual_word_64(BX_SEG_REG_ES, RDI);
+  Bit16u value16 = 0;
+  Bit64u rdi = RDI;
+  unsigned incr = 2;
 
-  value16 = BX_INP(DX, 2);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u wordCount = (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX;
+    BX_ASSERT(wordCount > 0);
+    wordCount = FastRepINSW(i, rdi, DX, wordCount);
+    if (wordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.
+      BX_TICKN(wordCount-1);
+      RCX -= (wordCount-1);
+      incr = wordCount << 1; // count * 2.
+    }
+    else {
+      // trigger any segment or page faults before reading from IO port
+      value16 = read_RMW_virtual_word_64(BX_SEG_REG_ES, rdi);
 
-  write_RMW_virtual_word(value16);
+      value16 = BX_INP(DX, 2);
+
+      write_RMW_virtual_word(value16);
+    }
+  }
+  else
+#endif
+  {
+    // trigger any segment or page faults before reading from IO port
+    value16 = read_RMW_virtual_word_64(BX_SEG_REG_ES, rdi);
+
+    value16 = BX_INP(DX, 2);
+
+    write_RMW_virtual_word(value16);
+  }
 
   if (BX_CPU_THIS_PTR get_DF())
-    RDI -= 2;
+    RDI = rdi - incr;
   else
-    RDI += 2;
+    RDI = rdi + incr;
 }
 
 #endif
@@ -600,13 +623,40 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSW32_DXXw(bxInstruction_c *i)
 // 16-bit operand size, 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSW64_DXXw(bxInstruction_c *i)
 {
-  Bit16u value16 = read_virtual_word_64(i->seg(), RSI);
-  BX_OUTP(DX, value16, 2);
+  Bit16u value16;
+  Bit64u rsi = RSI;
+  unsigned incr = 2;
+
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event) {
+    Bit32u wordCount = (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX;
+    wordCount = FastRepOUTSW(i, i->seg(), rsi, DX, wordCount);
+    if (wordCount) {
+      // Decrement RCX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      BX_TICKN(wordCount-1); // Main cpu loop also decrements one more.
+      RCX -= (wordCount-1);
+      incr = wordCount << 1; // count * 2.
+    }
+    else {
+      value16 = read_virtual_word_64(i->seg(), rsi);
+      BX_OUTP(DX, value16, 2);
+    }
+  }
+  else
+#endif
+  {
+    value16 = read_virtual_word_64(i->seg(), rsi);
+    BX_OUTP(DX, value16, 2);
+  }
 
   if (BX_CPU_THIS_PTR get_DF())
-    RSI -= 2;
+    RSI = rsi - incr;
   else
-    RSI += 2;
+    RSI = rsi + incr;
 }
 
 #endif
@@ -0,0 +1,961 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//   Copyright (c) 2013 The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#define NEED_CPU_REG_SHORTCUTS 1
+#include "bochs.h"
+#include "cpu.h"
+#define LOG_THIS BX_CPU_THIS_PTR
+
+#if BX_SUPPORT_JIT
+
+#include <stddef.h>
+#include <sys/mman.h>
+
+bx_bool bxJitCache_c::init(Bit32u thresh)
+{
+  cleanup();
+
+  threshold = thresh;
+  if (threshold == 0) return 1; // translation disabled
+
+  void *ptr = mmap(NULL, BX_JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) return 0;
+
+  buffer = (Bit8u *) ptr;
+  used = 0;
+  generation++;
+  return 1;
+}
+
+void bxJitCache_c::cleanup(void)
+{
+  if (buffer != NULL) {
+    munmap(buffer, BX_JIT_CODE_BUFFER_SIZE);
+    buffer = NULL;
+    // forget all translations made with the old buffer
+    generation++;
+  }
+}
+
+// Instructions translated into inline host code.  The handlers are matched
+// by their address, so the translation always agrees with the decoder.
+
+enum {
+  BX_JIT_MOV,
+  BX_JIT_ADD,
+  BX_JIT_SUB,
+  BX_JIT_AND,
+  BX_JIT_OR,
+  BX_JIT_XOR,
+  BX_JIT_CMP,
+  BX_JIT_TEST,
+  BX_JIT_INC,
+  BX_JIT_DEC,
+  BX_JIT_NOP
+};
+
+enum {
+  BX_JIT_SRC_NONE,
+  BX_JIT_SRC_REG,  // i->src()
+  BX_JIT_SRC_ID,   // i->Id(), sign extended for 64-bit operations
+  BX_JIT_SRC_IQ    // i->Iq()
+};
+
+static const struct bxJitInlineOp {
+  BxExecutePtr_tR handler;
+  Bit8u op;
+  Bit8u size;
+  Bit8u src;
+} jitInlineOps[] = {
+  { &BX_CPU_C::NOP,        BX_JIT_NOP,   0, BX_JIT_SRC_NONE },
+
+  { &BX_CPU_C::MOV_GdEdR,  BX_JIT_MOV,  32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::MOV_ERXId,  BX_JIT_MOV,  32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::ADD_GdEdR,  BX_JIT_ADD,  32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::ADD_EdIdR,  BX_JIT_ADD,  32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::SUB_GdEdR,  BX_JIT_SUB,  32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::SUB_EdIdR,  BX_JIT_SUB,  32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::AND_GdEdR,  BX_JIT_AND,  32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::AND_EdIdR,  BX_JIT_AND,  32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::OR_GdEdR,   BX_JIT_OR,   32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::OR_EdIdR,   BX_JIT_OR,   32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::XOR_GdEdR,  BX_JIT_XOR,  32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::XOR_EdIdR,  BX_JIT_XOR,  32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::CMP_GdEdR,  BX_JIT_CMP,  32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::CMP_EdIdR,  BX_JIT_CMP,  32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::TEST_EdGdR, BX_JIT_TEST, 32, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::TEST_EdIdR, BX_JIT_TEST, 32, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::INC_ERX,    BX_JIT_INC,  32, BX_JIT_SRC_NONE },
+  { &BX_CPU_C::DEC_ERX,    BX_JIT_DEC,  32, BX_JIT_SRC_NONE },
+
+  { &BX_CPU_C::MOV_GqEqR,  BX_JIT_MOV,  64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::MOV_EqIdR,  BX_JIT_MOV,  64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::MOV_RRXIq,  BX_JIT_MOV,  64, BX_JIT_SRC_IQ   },
+  { &BX_CPU_C::ADD_GqEqR,  BX_JIT_ADD,  64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::ADD_EqIdR,  BX_JIT_ADD,  64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::SUB_GqEqR,  BX_JIT_SUB,  64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::SUB_EqIdR,  BX_JIT_SUB,  64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::AND_GqEqR,  BX_JIT_AND,  64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::AND_EqIdR,  BX_JIT_AND,  64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::OR_GqEqR,   BX_JIT_OR,   64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::OR_EqIdR,   BX_JIT_OR,   64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::XOR_GqEqR,  BX_JIT_XOR,  64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::XOR_EqIdR,  BX_JIT_XOR,  64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::CMP_GqEqR,  BX_JIT_CMP,  64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::CMP_EqIdR,  BX_JIT_CMP,  64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::TEST_EqGqR, BX_JIT_TEST, 64, BX_JIT_SRC_REG  },
+  { &BX_CPU_C::TEST_EqIdR, BX_JIT_TEST, 64, BX_JIT_SRC_ID   },
+  { &BX_CPU_C::INC_EqR,    BX_JIT_INC,  64, BX_JIT_SRC_NONE },
+  { &BX_CPU_C::DEC_EqR,    BX_JIT_DEC,  64, BX_JIT_SRC_NONE }
+};
+
+static const bxJitInlineOp *jitFindInlineOp(const bxInstruction_c *i)
+{
+  for (unsigned n=0; n < sizeof(jitInlineOps)/sizeof(jitInlineOps[0]); n++) {
+    if (i->execute1 == jitInlineOps[n].handler) {
+      const bxJitInlineOp *op = &jitInlineOps[n];
+      if (op->op != BX_JIT_NOP) {
+        if (i->dst() >= BX_GENERAL_REGISTERS) return NULL;
+        if (op->src == BX_JIT_SRC_REG && i->src() >= BX_GENERAL_REGISTERS) return NULL;
+      }
+      return op;
+    }
+  }
+
+  return NULL;
+}
+
+// Instructions with an inline fast path for the common case, they call
+// their handler only when the fast path does not apply at run time.
+
+enum {
+  BX_JIT_JCC,      // conditional branch, x86 condition code in cond
+  BX_JIT_LOAD,     // MOV Gd, [base+disp]
+  BX_JIT_STORE     // MOV [base+disp], Gd
+};
+
+static const struct bxJitFastOp {
+  BxExecutePtr_tR handler;
+  Bit8u op;
+  Bit8u size;
+  Bit8u cond;
+} jitFastOps[] = {
+  { &BX_CPU_C::JO_Jd,       BX_JIT_JCC,   32, 0x0 },
+  { &BX_CPU_C::JNO_Jd,      BX_JIT_JCC,   32, 0x1 },
+  { &BX_CPU_C::JB_Jd,       BX_JIT_JCC,   32, 0x2 },
+  { &BX_CPU_C::JNB_Jd,      BX_JIT_JCC,   32, 0x3 },
+  { &BX_CPU_C::JZ_Jd,       BX_JIT_JCC,   32, 0x4 },
+  { &BX_CPU_C::JNZ_Jd,      BX_JIT_JCC,   32, 0x5 },
+  { &BX_CPU_C::JBE_Jd,      BX_JIT_JCC,   32, 0x6 },
+  { &BX_CPU_C::JNBE_Jd,     BX_JIT_JCC,   32, 0x7 },
+  { &BX_CPU_C::JS_Jd,       BX_JIT_JCC,   32, 0x8 },
+  { &BX_CPU_C::JNS_Jd,      BX_JIT_JCC,   32, 0x9 },
+  { &BX_CPU_C::JP_Jd,       BX_JIT_JCC,   32, 0xA },
+  { &BX_CPU_C::JNP_Jd,      BX_JIT_JCC,   32, 0xB },
+  { &BX_CPU_C::JL_Jd,       BX_JIT_JCC,   32, 0xC },
+  { &BX_CPU_C::JNL_Jd,      BX_JIT_JCC,   32, 0xD },
+  { &BX_CPU_C::JLE_Jd,      BX_JIT_JCC,   32, 0xE },
+  { &BX_CPU_C::JNLE_Jd,     BX_JIT_JCC,   32, 0xF },
+
+  { &BX_CPU_C::JO_Jq,       BX_JIT_JCC,   64, 0x0 },
+  { &BX_CPU_C::JNO_Jq,      BX_JIT_JCC,   64, 0x1 },
+  { &BX_CPU_C::JB_Jq,       BX_JIT_JCC,   64, 0x2 },
+  { &BX_CPU_C::JNB_Jq,      BX_JIT_JCC,   64, 0x3 },
+  { &BX_CPU_C::JZ_Jq,       BX_JIT_JCC,   64, 0x4 },
+  { &BX_CPU_C::JNZ_Jq,      BX_JIT_JCC,   64, 0x5 },
+  { &BX_CPU_C::JBE_Jq,      BX_JIT_JCC,   64, 0x6 },
+  { &BX_CPU_C::JNBE_Jq,     BX_JIT_JCC,   64, 0x7 },
+  { &BX_CPU_C::JS_Jq,       BX_JIT_JCC,   64, 0x8 },
+  { &BX_CPU_C::JNS_Jq,      BX_JIT_JCC,   64, 0x9 },
+  { &BX_CPU_C::JP_Jq,       BX_JIT_JCC,   64, 0xA },
+  { &BX_CPU_C::JNP_Jq,      BX_JIT_JCC,   64, 0xB },
+  { &BX_CPU_C::JL_Jq,       BX_JIT_JCC,   64, 0xC },
+  { &BX_CPU_C::JNL_Jq,      BX_JIT_JCC,   64, 0xD },
+  { &BX_CPU_C::JLE_Jq,      BX_JIT_JCC,   64, 0xE },
+  { &BX_CPU_C::JNLE_Jq,     BX_JIT_JCC,   64, 0xF },
+
+  { &BX_CPU_C::MOV32_GdEdM, BX_JIT_LOAD,  32, 0   },
+  { &BX_CPU_C::MOV32_EdGdM, BX_JIT_STORE, 32, 0   }
+};
+
+static const bxJitFastOp *jitFindFastOp(const bxInstruction_c *i)
+{
+  for (unsigned n=0; n < sizeof(jitFastOps)/sizeof(jitFastOps[0]); n++) {
+    if (i->execute1 == jitFastOps[n].handler) {
+      const bxJitFastOp *op = &jitFastOps[n];
+      if (op->op == BX_JIT_LOAD || op->op == BX_JIT_STORE) {
+        // only the [base+disp32] and [disp32] addressing forms
+        if (i->ResolveModrm != &BX_CPU_C::BxResolve32Base) return NULL;
+        if (op->op == BX_JIT_LOAD && i->dst() >= BX_GENERAL_REGISTERS) return NULL;
+        if (op->op == BX_JIT_STORE && i->src() >= BX_GENERAL_REGISTERS) return NULL;
+        if (i->sibBase() >= BX_GENERAL_REGISTERS && i->sibBase() != BX_NIL_REGISTER) return NULL;
+      }
+      return op;
+    }
+  }
+
+  return NULL;
+}
+
+#if BX_USE_CPU_SMF == 0
+// Used when the handler address cannot be taken from the member pointer
+static void jitCallHandler(BX_CPU_C *cpu, bxInstruction_c *i)
+{
+  (cpu->*(i->execute1))(i);
+}
+#endif
+
+// Host x86-64 code emitter
+
+enum {
+  JIT_RAX = 0, JIT_RCX = 1, JIT_RDX = 2, JIT_RBX = 3,
+  JIT_RSI = 6, JIT_RDI = 7, JIT_R8 = 8, JIT_R9 = 9, JIT_R10 = 10, JIT_R12 = 12
+};
+
+// ALU opcodes of the "op r/m, reg" form and the matching /digit of the
+// "op r/m, imm32" (0x81) form
+#define JIT_ALU_ADD 0x01
+#define JIT_ALU_OR  0x09
+#define JIT_ALU_AND 0x21
+#define JIT_ALU_SUB 0x29
+#define JIT_ALU_XOR 0x31
+#define JIT_ALU_CMP 0x39
+#define JIT_ALU_TEST 0x85
+#define JIT_ALU_MOV 0x89
+#define JIT_ALU_LOAD 0x8B
+
+// "op reg, r/m" forms
+#define JIT_ALU_ADD_RM 0x03
+#define JIT_ALU_AND_RM 0x23
+#define JIT_ALU_CMP_RM 0x3B
+
+#define JIT_IMM_ADD 0
+#define JIT_IMM_OR  1
+#define JIT_IMM_AND 4
+#define JIT_IMM_SUB 5
+#define JIT_IMM_CMP 7
+
+class bxJitEmitter {
+public:
+  Bit8u *p;
+
+  bxJitEmitter(Bit8u *code): p(code) {}
+
+  void byte(Bit8u b) { *p++ = b; }
+  void dword(Bit32u d) { memcpy(p, &d, 4); p += 4; }
+  void qword(Bit64u q) { memcpy(p, &q, 8); p += 8; }
+
+  void rex(unsigned w, unsigned reg, unsigned rm) {
+    Bit8u prefix = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+    if (prefix != 0x40) byte(prefix);
+  }
+
+  // op rm, reg (register direct)
+  void rr(Bit8u opcode, unsigned w, unsigned rm, unsigned reg) {
+    rex(w, reg, rm);
+    byte(opcode);
+    byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+  }
+  // op [base+disp32], reg or op reg, [base+disp32], base must not be rsp/r12
+  void rmb(Bit8u opcode, unsigned w, unsigned reg, unsigned base, Bit32u disp) {
+    rex(w, reg, base);
+    byte(opcode);
+    byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    dword(disp);
+  }
+  // op [rbx+disp32], reg or op reg, [rbx+disp32]
+  void rm(Bit8u opcode, unsigned w, unsigned reg, Bit32u disp) {
+    rmb(opcode, w, reg, JIT_RBX, disp);
+  }
+  // op rm, imm32 (0x81 group)
+  void ri(unsigned digit, unsigned w, unsigned rm, Bit32u imm) {
+    rex(w, 0, rm);
+    byte(0x81);
+    byte(0xc0 | (digit << 3) | (rm & 7));
+    dword(imm);
+  }
+  void shift(unsigned digit, unsigned w, unsigned rm, Bit8u count) {
+    rex(w, 0, rm);
+    byte(0xc1);
+    byte(0xc0 | (digit << 3) | (rm & 7));
+    byte(count);
+  }
+  // shift rm by cl
+  void shift_cl(unsigned digit, unsigned w, unsigned rm) {
+    rex(w, 0, rm);
+    byte(0xd3);
+    byte(0xc0 | (digit << 3) | (rm & 7));
+  }
+  // reg = rm * imm32
+  void imul(unsigned reg, unsigned rm, Bit32u imm) {
+    rex(0, reg, rm);
+    byte(0x69);
+    byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+    dword(imm);
+  }
+  // eax = condition code cc of the host flags
+  void set_flag(Bit8u cc) {
+    byte(0x0f); byte(0x90 | cc); byte(0xc0);  // setcc al
+    byte(0x0f); byte(0xb6); byte(0xc0);       // movzx eax, al
+  }
+  void not_r(unsigned w, unsigned rm) {
+    rex(w, 0, rm);
+    byte(0xf7);
+    byte(0xc0 | (2 << 3) | (rm & 7));
+  }
+  void mov_imm32(unsigned reg, Bit32u imm) {
+    rex(0, 0, reg);
+    byte(0xb8 | (reg & 7));
+    dword(imm);
+  }
+  void mov_simm32(unsigned reg, Bit32u imm) {
+    rex(1, 0, reg);
+    byte(0xc7);
+    byte(0xc0 | (reg & 7));
+    dword(imm);
+  }
+  void mov_imm64(unsigned reg, Bit64u imm) {
+    rex(1, 0, reg);
+    byte(0xb8 | (reg & 7));
+    qword(imm);
+  }
+  // mov qword [rbx+disp32], simm32
+  void store_imm(Bit32u disp, Bit32u imm) {
+    rex(1, 0, JIT_RBX);
+    byte(0xc7);
+    byte(0x80 | JIT_RBX);
+    dword(disp);
+    dword(imm);
+  }
+  // [rbx+disp32] <op>= simm32, qword or dword
+  void mem_imm(unsigned digit, Bit32u disp, Bit32u imm, unsigned w = 1) {
+    rex(w, 0, JIT_RBX);
+    byte(0x81);
+    byte(0x80 | (digit << 3) | JIT_RBX);
+    dword(disp);
+    dword(imm);
+  }
+  void movsxd(unsigned reg, unsigned rm) {
+    rex(1, reg, rm);
+    byte(0x63);
+    byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+  }
+  void call(const void *target) {
+    mov_imm64(JIT_RAX, (Bit64u) target);
+    byte(0xff); byte(0xd0);            // call rax
+  }
+  // conditional or unconditional rel32 jump, returns the location to patch
+  Bit8u *jump(Bit8u cond) {
+    if (cond) { byte(0x0f); byte(cond); }
+    else byte(0xe9);
+    dword(0);
+    return p - 4;
+  }
+  // same with a rel8 displacement
+  Bit8u *jump8(Bit8u cond) {
+    byte(cond ? (0x70 | (cond & 0xf)) : 0xeb);
+    byte(0);
+    return p - 1;
+  }
+};
+
+#define JIT_JMP 0
+#define JIT_JAE 0x83
+#define JIT_JZ  0x84
+#define JIT_JNZ 0x85
+#define JIT_JBE 0x86
+#define JIT_JA  0x87
+
+static void jitPatch(Bit8u *loc, const Bit8u *target)
+{
+  Bit32u rel = (Bit32u)(target - (loc + 4));
+  memcpy(loc, &rel, 4);
+}
+
+static void jitPatch8(Bit8u *loc, const Bit8u *target)
+{
+  Bit32s rel = (Bit32s)(target - (loc + 1));
+  BX_ASSERT(rel >= -128 && rel <= 127);
+  *loc = (Bit8u) rel;
+}
+
+// Forward jumps to a location which is not emitted yet
+struct bxJitLabel {
+  Bit8u *loc[8];
+  unsigned count;
+
+  bxJitLabel(): count(0) {}
+
+  void add(Bit8u *patch) {
+    BX_ASSERT(count < 8);
+    loc[count++] = patch;
+  }
+  void bind(const Bit8u *target) {
+    for (unsigned n=0; n < count; n++) jitPatch(loc[n], target);
+  }
+};
+
+// Offsets of the CPU state fields accessed by the translated code from
+// the CPU object pointer kept in rbx
+struct bxJitOffsets {
+  Bit32u gen_reg[BX_GENERAL_REGISTERS];
+  Bit32u rip;
+  Bit32u prev_rip;
+  Bit32u icount;
+  Bit32u async_event;
+  Bit32u result;
+  Bit32u auxbits;
+  Bit32u seg_valid[6];
+  Bit32u seg_base[6];
+  Bit32u seg_limit[6];
+  Bit32u tlb_entry;
+  Bit32u tlb_set_mask;
+  Bit32u user_pl;
+  Bit32u alignment_check_mask;
+};
+
+#define JIT_OFFSET(field) \
+  ((Bit32u)((const Bit8u *) &(field) - (const Bit8u *) BX_CPU_THIS))
+
+// Lazy flags after an arithmetic or logic operation with op1 in rax, op2 in
+// rcx and the result in rdx, same as the SET_FLAGS_OSZAPC_* and
+// SET_FLAGS_OSZAP_* macros from lazy_flags.h
+static void jitEmitFlags(const bxJitOffsets &o, bxJitEmitter &e, unsigned op, unsigned size)
+{
+  unsigned w = (size == 64);
+
+  if (op == BX_JIT_AND || op == BX_JIT_OR || op == BX_JIT_XOR || op == BX_JIT_TEST) {
+    e.store_imm(o.auxbits, 0);
+  }
+  else {
+    if (op == BX_JIT_ADD || op == BX_JIT_INC) {
+      // ADD_COUT_VEC: (op1 & op2) | ((op1 | op2) & ~result)
+      e.rr(JIT_ALU_MOV, w, JIT_R8, JIT_RAX);
+      e.rr(JIT_ALU_AND, w, JIT_R8, JIT_RCX);
+      e.rr(JIT_ALU_MOV, w, JIT_R9, JIT_RAX);
+      e.rr(JIT_ALU_OR,  w, JIT_R9, JIT_RCX);
+      e.rr(JIT_ALU_MOV, w, JIT_R10, JIT_RDX);
+      e.not_r(w, JIT_R10);
+      e.rr(JIT_ALU_AND, w, JIT_R9, JIT_R10);
+      e.rr(JIT_ALU_OR,  w, JIT_R8, JIT_R9);
+    }
+    else {
+      // SUB_COUT_VEC: (~op1 & op2) | ((~op1 ^ op2) & result)
+      e.rr(JIT_ALU_MOV, w, JIT_R8, JIT_RAX);
+      e.not_r(w, JIT_R8);
+      e.rr(JIT_ALU_MOV, w, JIT_R9, JIT_R8);
+      e.rr(JIT_ALU_AND, w, JIT_R8, JIT_RCX);
+      e.rr(JIT_ALU_XOR, w, JIT_R9, JIT_RCX);
+      e.rr(JIT_ALU_AND, w, JIT_R9, JIT_RDX);
+      e.rr(JIT_ALU_OR,  w, JIT_R8, JIT_R9);
+    }
+
+    if (size == 32) {
+      e.ri(JIT_IMM_AND, 0, JIT_R8, ~(Bit32u)(LF_MASK_PDB | LF_MASK_SD));
+    }
+    else {
+      e.rr(JIT_ALU_MOV, 1, JIT_R9, JIT_R8);
+      e.ri(JIT_IMM_AND, 0, JIT_R9, LF_MASK_AF);
+      e.shift(5 /* shr */, 1, JIT_R8, 62);
+      e.shift(4 /* shl */, 0, JIT_R8, LF_BIT_PO);
+      e.rr(JIT_ALU_OR, 0, JIT_R8, JIT_R9);
+    }
+
+    if (op == BX_JIT_INC || op == BX_JIT_DEC) {
+      // OSZAP: keep the carry flag, fix up the partial overflow
+      e.rm(JIT_ALU_LOAD, 1, JIT_R9, o.auxbits);
+      e.rr(JIT_ALU_XOR, 0, JIT_R9, JIT_R8);
+      e.ri(JIT_IMM_AND, 0, JIT_R9, LF_MASK_CF);
+      e.rr(JIT_ALU_MOV, 0, JIT_R10, JIT_R9);
+      e.shift(5 /* shr */, 0, JIT_R10, 1);
+      e.rr(JIT_ALU_XOR, 0, JIT_R9, JIT_R10);
+      e.rr(JIT_ALU_XOR, 0, JIT_R8, JIT_R9);
+    }
+
+    e.rm(JIT_ALU_MOV, 1, JIT_R8, o.auxbits);
+  }
+
+  if (size == 32) {
+    e.movsxd(JIT_R9, JIT_RDX);
+    e.rm(JIT_ALU_MOV, 1, JIT_R9, o.result);
+  }
+  else {
+    e.rm(JIT_ALU_MOV, 1, JIT_RDX, o.result);
+  }
+}
+
+static void jitEmitInline(const bxJitOffsets &o, bxJitEmitter &e, const bxJitInlineOp *op, bxInstruction_c *i)
+{
+  unsigned w = (op->size == 64);
+
+  if (op->op == BX_JIT_NOP) return;
+
+  if (op->op == BX_JIT_MOV) {
+    switch(op->src) {
+    case BX_JIT_SRC_REG:
+      e.rm(JIT_ALU_LOAD, w, JIT_RAX, o.gen_reg[i->src()]);
+      break;
+    case BX_JIT_SRC_ID:
+      if (w) e.mov_simm32(JIT_RAX, i->Id());
+      else   e.mov_imm32(JIT_RAX, i->Id());
+      break;
+    case BX_JIT_SRC_IQ:
+      e.mov_imm64(JIT_RAX, i->Iq());
+      break;
+    }
+    // 32-bit writes clear the upper half of the register
+    e.rm(JIT_ALU_MOV, 1, JIT_RAX, o.gen_reg[i->dst()]);
+    return;
+  }
+
+  e.rm(JIT_ALU_LOAD, w, JIT_RAX, o.gen_reg[i->dst()]);
+  switch(op->src) {
+  case BX_JIT_SRC_REG:
+    e.rm(JIT_ALU_LOAD, w, JIT_RCX, o.gen_reg[i->src()]);
+    break;
+  case BX_JIT_SRC_ID:
+    if (w) e.mov_simm32(JIT_RCX, i->Id());
+    else   e.mov_imm32(JIT_RCX, i->Id());
+    break;
+  default: // INC/DEC are flagged as ADD/SUB with zero op2
+    e.rr(JIT_ALU_XOR, 0, JIT_RCX, JIT_RCX);
+    break;
+  }
+
+  e.rr(JIT_ALU_MOV, w, JIT_RDX, JIT_RAX);
+  switch(op->op) {
+  case BX_JIT_ADD:
+    e.rr(JIT_ALU_ADD, w, JIT_RDX, JIT_RCX);
+    break;
+  case BX_JIT_SUB:
+  case BX_JIT_CMP:
+    e.rr(JIT_ALU_SUB, w, JIT_RDX, JIT_RCX);
+    break;
+  case BX_JIT_AND:
+  case BX_JIT_TEST:
+    e.rr(JIT_ALU_AND, w, JIT_RDX, JIT_RCX);
+    break;
+  case BX_JIT_OR:
+    e.rr(JIT_ALU_OR, w, JIT_RDX, JIT_RCX);
+    break;
+  case BX_JIT_XOR:
+    e.rr(JIT_ALU_XOR, w, JIT_RDX, JIT_RCX);
+    break;
+  case BX_JIT_INC:
+    e.ri(JIT_IMM_ADD, w, JIT_RDX, 1);
+    break;
+  case BX_JIT_DEC:
+    e.ri(JIT_IMM_SUB, w, JIT_RDX, 1);
+    break;
+  }
+
+  if (op->op != BX_JIT_CMP && op->op != BX_JIT_TEST)
+    e.rm(JIT_ALU_MOV, 1, JIT_RDX, o.gen_reg[i->dst()]);
+
+  jitEmitFlags(o, e, op->op, op->size);
+}
+
+// Commit the RIP advance, prev_rip, icount and timer ticks of the inline
+// instructions emitted since the last commit
+static void jitEmitCommit(const bxJitOffsets &o, bxJitEmitter &e, unsigned count, unsigned len, bx_bool tick)
+{
+  if (count == 0) return;
+
+  e.mem_imm(JIT_IMM_ADD, o.rip, len);
+  e.rm(JIT_ALU_LOAD, 1, JIT_RAX, o.rip);
+  e.rm(JIT_ALU_MOV, 1, JIT_RAX, o.prev_rip);
+  e.mem_imm(JIT_IMM_ADD, o.icount, count);
+  if (tick) {
+    e.byte(0x41); e.byte(0x81); e.byte(0x2c); e.byte(0x24);  // sub dword [r12], imm32
+    e.dword(count);
+  }
+}
+
+enum { JIT_FLAG_CF, JIT_FLAG_ZF, JIT_FLAG_SF, JIT_FLAG_OF, JIT_FLAG_PF };
+
+// eax = one arithmetic flag from the lazy flags (getB_CF() etc), clobbers rcx
+static void jitEmitGetFlag(const bxJitOffsets &o, bxJitEmitter &e, unsigned flag)
+{
+  switch(flag) {
+  case JIT_FLAG_CF:
+    e.rm(JIT_ALU_LOAD, 0, JIT_RAX, o.auxbits);
+    e.shift(5 /* shr */, 0, JIT_RAX, LF_BIT_CF);
+    break;
+  case JIT_FLAG_ZF:
+    e.rm(JIT_ALU_LOAD, 1, JIT_RAX, o.result);
+    e.rr(JIT_ALU_TEST, 1, JIT_RAX, JIT_RAX);
+    e.set_flag(0x4 /* z */);
+    break;
+  case JIT_FLAG_SF:
+    e.rm(JIT_ALU_LOAD, 1, JIT_RAX, o.result);
+    e.shift(5 /* shr */, 1, JIT_RAX, BX_LF_SIGN_BIT);
+    e.rm(JIT_ALU_LOAD, 0, JIT_RCX, o.auxbits);
+    e.rr(JIT_ALU_XOR, 0, JIT_RAX, JIT_RCX);
+    e.ri(JIT_IMM_AND, 0, JIT_RAX, 1 << LF_BIT_SD);
+    break;
+  case JIT_FLAG_OF:
+    // CF ^ partial overflow
+    e.rm(JIT_ALU_LOAD, 0, JIT_RAX, o.auxbits);
+    e.rr(JIT_ALU_MOV, 0, JIT_RCX, JIT_RAX);
+    e.shift(5 /* shr */, 0, JIT_RCX, 1);
+    e.rr(JIT_ALU_XOR, 0, JIT_RAX, JIT_RCX);
+    e.shift(5 /* shr */, 0, JIT_RAX, LF_BIT_PO);
+    e.ri(JIT_IMM_AND, 0, JIT_RAX, 1);
+    break;
+  case JIT_FLAG_PF:
+    // the host parity flag of the low result byte xor'ed with the delta byte
+    e.rm(JIT_ALU_LOAD, 0, JIT_RAX, o.result);
+    e.rm(JIT_ALU_LOAD, 0, JIT_RCX, o.auxbits);
+    e.shift(5 /* shr */, 0, JIT_RCX, LF_BIT_PDB);
+    e.rr(JIT_ALU_XOR, 0, JIT_RAX, JIT_RCX);
+    e.byte(0x84); e.byte(0xc0);                           // test al, al
+    e.set_flag(0xA /* p */);
+    break;
+  }
+}
+
+// Evaluates the condition of a Jcc the same way as its handler does and
+// returns the jump to patch for a non-taken branch
+static Bit8u *jitEmitCondition(const bxJitOffsets &o, bxJitEmitter &e, unsigned cond)
+{
+  switch(cond >> 1) {
+  case 0: // O
+    jitEmitGetFlag(o, e, JIT_FLAG_OF);
+    break;
+  case 1: // B
+    jitEmitGetFlag(o, e, JIT_FLAG_CF);
+    break;
+  case 2: // Z
+    jitEmitGetFlag(o, e, JIT_FLAG_ZF);
+    break;
+  case 3: // BE: CF || ZF
+    jitEmitGetFlag(o, e, JIT_FLAG_CF);
+    e.rr(JIT_ALU_MOV, 0, JIT_RDX, JIT_RAX);
+    jitEmitGetFlag(o, e, JIT_FLAG_ZF);
+    e.rr(JIT_ALU_OR, 0, JIT_RAX, JIT_RDX);
+    break;
+  case 4: // S
+    jitEmitGetFlag(o, e, JIT_FLAG_SF);
+    break;
+  case 5: // P
+    jitEmitGetFlag(o, e, JIT_FLAG_PF);
+    break;
+  case 6: // L: SF != OF
+    jitEmitGetFlag(o, e, JIT_FLAG_SF);
+    e.rr(JIT_ALU_MOV, 0, JIT_RDX, JIT_RAX);
+    jitEmitGetFlag(o, e, JIT_FLAG_OF);
+    e.rr(JIT_ALU_XOR, 0, JIT_RAX, JIT_RDX);
+    break;
+  case 7: // LE: ZF || SF != OF
+    jitEmitGetFlag(o, e, JIT_FLAG_SF);
+    e.rr(JIT_ALU_MOV, 0, JIT_RDX, JIT_RAX);
+    jitEmitGetFlag(o, e, JIT_FLAG_OF);
+    e.rr(JIT_ALU_XOR, 0, JIT_RDX, JIT_RAX);
+    jitEmitGetFlag(o, e, JIT_FLAG_ZF);
+    e.rr(JIT_ALU_OR, 0, JIT_RAX, JIT_RDX);
+    break;
+  }
+
+  e.rr(JIT_ALU_TEST, 0, JIT_RAX, JIT_RAX);
+  // odd condition codes are the negated ones
+  return e.jump((cond & 1) ? JIT_JNZ : JIT_JZ);
+}
+
+// Taken branch, as branch_near32()/branch_near64() with RIP already
+// advanced.  A target outside of the CS limit or a non canonical one is
+// left to the handler, it raises the #GP.
+static void jitEmitBranch(const bxJitOffsets &o, bxJitEmitter &e, const bxJitFastOp *op,
+      bxInstruction_c *i, bxJitLabel &done, bxJitLabel &slow)
+{
+  if (op->size == 32) {
+    e.rm(JIT_ALU_LOAD, 0, JIT_RAX, o.rip);
+    e.ri(JIT_IMM_ADD, 0, JIT_RAX, i->Id());
+    e.rm(JIT_ALU_CMP_RM, 0, JIT_RAX, o.seg_limit[BX_SEG_REG_CS]);
+    slow.add(e.jump(JIT_JA));
+  }
+  else {
+    e.rm(JIT_ALU_LOAD, 1, JIT_RAX, o.rip);
+    e.mov_simm32(JIT_RCX, i->Id());
+    e.rr(JIT_ALU_ADD, 1, JIT_RAX, JIT_RCX);
+    // IsCanonical(): (new_RIP >> 47) + 1 < 2
+    e.rr(JIT_ALU_MOV, 1, JIT_RCX, JIT_RAX);
+    e.shift(7 /* sar */, 1, JIT_RCX, BX_LIN_ADDRESS_WIDTH-1);
+    e.ri(JIT_IMM_ADD, 1, JIT_RCX, 1);
+    e.ri(JIT_IMM_CMP, 1, JIT_RCX, 1);
+    slow.add(e.jump(JIT_JA));
+  }
+
+  e.rm(JIT_ALU_MOV, 1, JIT_RAX, o.rip);
+  // stop the trace, same as the handler does
+  e.mem_imm(JIT_IMM_OR, o.async_event, BX_ASYNC_EVENT_STOP_TRACE, 0);
+  done.add(e.jump(JIT_JMP));
+}
+
+// 32-bit MOV from or to [base+disp32], the fast path of
+// read_virtual_dword_32()/write_virtual_dword_32(): segment limit check,
+// L1 TLB lookup and access through the host page address.  Everything
+// else (TLB miss, #AC, MMIO, pages with translated code) is left to the
+// handler.
+static void jitEmitMemAccess(const bxJitOffsets &o, bxJitEmitter &e, const bxJitFastOp *op,
+      bxInstruction_c *i, bxJitLabel &done, bxJitLabel &slow)
+{
+  unsigned s = i->seg();
+
+  // eax = offset
+  if (i->sibBase() == BX_NIL_REGISTER) {
+    e.mov_imm32(JIT_RAX, i->displ32s());
+  }
+  else {
+    e.rm(JIT_ALU_LOAD, 0, JIT_RAX, o.gen_reg[i->sibBase()]);
+    e.ri(JIT_IMM_ADD, 0, JIT_RAX, i->displ32s());
+  }
+
+  e.rm(JIT_ALU_LOAD, 0, JIT_RCX, o.seg_valid[s]);
+  e.ri(JIT_IMM_AND, 0, JIT_RCX, (op->op == BX_JIT_LOAD) ? SegAccessROK : SegAccessWOK);
+  slow.add(e.jump(JIT_JZ));
+  e.rm(JIT_ALU_LOAD, 0, JIT_RCX, o.seg_limit[s]);
+  e.ri(JIT_IMM_SUB, 0, JIT_RCX, 2);
+  e.rr(JIT_ALU_CMP, 0, JIT_RAX, JIT_RCX);
+  slow.add(e.jump(JIT_JAE));
+
+  // eax = laddr
+  e.rm(JIT_ALU_ADD_RM, 0, JIT_RAX, o.seg_base[s]);
+
+  // rdx = first entry of the TLB set, as TLB_index_of()
+  e.rr(JIT_ALU_MOV, 0, JIT_RDX, JIT_RAX);
+  e.ri(JIT_IMM_ADD, 0, JIT_RDX, 3);
+  e.shift(5 /* shr */, 0, JIT_RDX, 12);
+  e.rm(JIT_ALU_AND_RM, 0, JIT_RDX, o.tlb_set_mask);
+  e.imul(JIT_RDX, JIT_RDX, BX_TLB_WAYS * sizeof(bx_TLB_entry));
+  e.rm(JIT_ALU_ADD_RM, 1, JIT_RDX, o.tlb_entry);
+
+  // rcx = lpf
+  e.rr(JIT_ALU_MOV, 0, JIT_RCX, JIT_RAX);
+#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
+  e.rm(JIT_ALU_LOAD, 0, JIT_R8, o.alignment_check_mask);
+  e.ri(JIT_IMM_AND, 0, JIT_R8, 3);
+  e.ri(JIT_IMM_OR, 0, JIT_R8, (Bit32u) LPF_MASK);
+  e.rr(JIT_ALU_AND, 0, JIT_RCX, JIT_R8);
+#else
+  e.ri(JIT_IMM_AND, 0, JIT_RCX, (Bit32u) LPF_MASK);
+#endif
+
+  // search the ways of the set for an exact match, a TLB_NoHostPtr entry
+  // or a misaligned access with alignment check enabled never matches
+  e.mov_imm32(JIT_R9, BX_TLB_WAYS);
+  Bit8u *loop = e.p;
+  e.rmb(JIT_ALU_CMP, 1, JIT_RCX, JIT_RDX, offsetof(bx_TLB_entry, lpf));
+  Bit8u *hit = e.jump8(JIT_JZ);
+  e.ri(JIT_IMM_ADD, 1, JIT_RDX, sizeof(bx_TLB_entry));
+  e.ri(JIT_IMM_SUB, 0, JIT_R9, 1);
+  jitPatch8(e.jump8(JIT_JNZ), loop);
+  slow.add(e.jump(JIT_JMP));
+  jitPatch8(hit, e.p);
+
+  // accessBits & (0x01 << USER_PL) for read, (0x04 << USER_PL) for write
+  e.rm(JIT_ALU_LOAD, 0, JIT_RCX, o.user_pl);
+  e.rmb(JIT_ALU_LOAD, 0, JIT_R8, JIT_RDX, offsetof(bx_TLB_entry, accessBits));
+  e.shift_cl(5 /* shr */, 0, JIT_R8);
+  e.ri(JIT_IMM_AND, 0, JIT_R8, (op->op == BX_JIT_LOAD) ? 0x01 : 0x04);
+  slow.add(e.jump(JIT_JZ));
+
+  // r8 = host address
+  e.rmb(JIT_ALU_LOAD, 1, JIT_R8, JIT_RDX, offsetof(bx_TLB_entry, hostPageAddr));
+  e.rr(JIT_ALU_MOV, 0, JIT_RCX, JIT_RAX);
+  e.ri(JIT_IMM_AND, 0, JIT_RCX, 0xfff);
+  e.rr(JIT_ALU_OR, 1, JIT_R8, JIT_RCX);
+
+  if (op->op == BX_JIT_LOAD) {
+    e.rmb(JIT_ALU_LOAD, 0, JIT_RAX, JIT_R8, 0);
+    e.rm(JIT_ALU_MOV, 1, JIT_RAX, o.gen_reg[i->dst()]);
+  }
+  else {
+    // any write stamp on the physical page means it may hold translated
+    // code, the handler does the SMC check then
+    e.rmb(JIT_ALU_LOAD, 0, JIT_R9, JIT_RDX, offsetof(bx_TLB_entry, ppf));
+    e.shift(5 /* shr */, 0, JIT_R9, 12);
+    e.shift(4 /* shl */, 0, JIT_R9, 2);
+    e.mov_imm64(JIT_R10, (Bit64u) pageWriteStampTable.getFineGranularityMappingTable());
+    e.rr(JIT_ALU_ADD, 1, JIT_R9, JIT_R10);
+    e.rmb(JIT_ALU_LOAD, 0, JIT_R9, JIT_R9, 0);
+    e.rr(JIT_ALU_TEST, 0, JIT_R9, JIT_R9);
+    slow.add(e.jump(JIT_JNZ));
+    e.rm(JIT_ALU_LOAD, 0, JIT_RCX, o.gen_reg[i->src()]);
+    e.rmb(JIT_ALU_MOV, 0, JIT_RCX, JIT_R8, 0);
+  }
+
+  done.add(e.jump(JIT_JMP));
+}
+
+// The translated trace follows the cpu_loop protocol instruction by
+// instruction: RIP is advanced before the instruction is executed, then
+// prev_rip and icount are committed and the system timer is ticked.  For
+// inline instructions this bookkeeping is deferred until the next handler
+// call or the end of the trace, they can neither fault nor see it.
+//
+// The trace is only entered when no timer can fire inside of it.  After
+// every handler call the code returns to cpu_loop if an async event is
+// pending (interrupt, SMC, stop trace request) or the handler moved the
+// next timer event into the rest of the trace.  Instructions with a fast
+// path share this bookkeeping with their handler call, a taken branch
+// requests a stop trace just as the handler does.
+void BX_CPU_C::jitTranslate(bxICacheEntry_c *entry)
+{
+  bxJitCache_c *jit = &BX_CPU_THIS_PTR jitCache;
+  bxJitOffsets o;
+
+  for (unsigned n=0; n < BX_GENERAL_REGISTERS; n++)
+    o.gen_reg[n] = JIT_OFFSET(BX_CPU_THIS_PTR gen_reg[n].rrx);
+  o.rip = JIT_OFFSET(RIP);
+  o.prev_rip = JIT_OFFSET(BX_CPU_THIS_PTR prev_rip);
+  o.icount = JIT_OFFSET(BX_CPU_THIS_PTR icount);
+  o.async_event = JIT_OFFSET(BX_CPU_THIS_PTR async_event);
+  o.result = JIT_OFFSET(BX_CPU_THIS_PTR oszapc.result);
+  o.auxbits = JIT_OFFSET(BX_CPU_THIS_PTR oszapc.auxbits);
+  for (unsigned n=0; n < 6; n++) {
+    o.seg_valid[n] = JIT_OFFSET(BX_CPU_THIS_PTR sregs[n].cache.valid);
+    o.seg_base[n] = JIT_OFFSET(BX_CPU_THIS_PTR sregs[n].cache.u.segment.base);
+    o.seg_limit[n] = JIT_OFFSET(BX_CPU_THIS_PTR sregs[n].cache.u.segment.limit_scaled);
+  }
+  o.tlb_entry = JIT_OFFSET(BX_CPU_THIS_PTR TLB.entry);
+  o.tlb_set_mask = JIT_OFFSET(BX_CPU_THIS_PTR TLB.set_mask);
+  o.user_pl = JIT_OFFSET(BX_CPU_THIS_PTR user_pl);
+  o.alignment_check_mask = JIT_OFFSET(BX_CPU_THIS_PTR alignment_check_mask);
+
+  unsigned maxlen = entry->tlen * BX_JIT_MAX_INSTR_CODE + BX_JIT_MAX_TRACE_CODE;
+  Bit8u *start = jit->alloc(maxlen);
+  bxJitEmitter e(start);
+
+  Bit8u *exits[BX_MAX_TRACE_LENGTH * 3];
+  unsigned nexits = 0;
+
+  // the system timer is ticked by the SMP scheduler in main.cc otherwise
+  const bx_bool tick = (BX_SMP_PROCESSORS == 1);
+
+  // prologue: rbx = cpu, r12 = countdown of the system timer
+  e.byte(0x53);                          // push rbx
+  e.byte(0x55);                          // push rbp (keeps the stack aligned)
+  e.byte(0x41); e.byte(0x54);            // push r12
+  e.rr(JIT_ALU_MOV, 1, JIT_RBX, JIT_RDI);
+  e.mov_imm64(JIT_R12, (Bit64u) bx_pc_system.getCountdownPtr());
+
+  unsigned pending = 0, pendingLen = 0;
+
+  for (unsigned n=0; n < entry->tlen; n++) {
+    bxInstruction_c *i = entry->i + n;
+
+    const bxJitInlineOp *op = jitFindInlineOp(i);
+    if (op) {
+      jitEmitInline(o, e, op, i);
+      pending++;
+      pendingLen += i->ilen();
+      jit->stats.inlined++;
+      continue;
+    }
+
+    jitEmitCommit(o, e, pending, pendingLen, tick);
+    pending = pendingLen = 0;
+
+    e.mem_imm(JIT_IMM_ADD, o.rip, i->ilen());
+
+    bxJitLabel done, slow;
+    const bxJitFastOp *fast = jitFindFastOp(i);
+    if (fast) {
+      if (fast->op == BX_JIT_JCC) {
+        done.add(jitEmitCondition(o, e, fast->cond));
+        jitEmitBranch(o, e, fast, i, done, slow);
+      }
+      else {
+        jitEmitMemAccess(o, e, fast, i, done, slow);
+      }
+      slow.bind(e.p);
+      jit->stats.fast++;
+    }
+    else {
+      jit->stats.called++;
+    }
+
+#if BX_USE_CPU_SMF
+    e.mov_imm64(JIT_RDI, (Bit64u) i);
+    e.call((const void *) i->execute1);
+#else
+    struct {
+      Bit64u ptr;
+      Bit64s adj;
+    } handler;
+    BX_ASSERT(sizeof(handler) == sizeof(i->execute1));
+    memcpy(&handler, &i->execute1, sizeof(handler));
+    e.rr(JIT_ALU_MOV, 1, JIT_RDI, JIT_RBX);
+    e.mov_imm64(JIT_RSI, (Bit64u) i);
+    if ((handler.ptr & 1) == 0 && handler.adj == 0) {
+      // Itanium C++ ABI: non-virtual member function, call it directly
+      e.call((const void *) handler.ptr);
+    }
+    else {
+      e.call((const void *) &jitCallHandler);
+    }
+#endif
+    done.bind(e.p);
+
+    e.rm(JIT_ALU_LOAD, 1, JIT_RAX, o.rip);
+    e.rm(JIT_ALU_MOV, 1, JIT_RAX, o.prev_rip);
+    e.rex(1, 0, JIT_RBX); e.byte(0xff); e.byte(0x83); e.dword(o.icount); // inc qword [rbx+icount]
+
+    if (tick) {
+      e.byte(0x41); e.byte(0xff); e.byte(0x0c); e.byte(0x24);  // dec dword [r12]
+      e.byte(0x75); e.byte(17);                                // jnz over the next 17 bytes
+      e.call((const void *) &bx_pc_system_c::countdownExpired);
+      exits[nexits++] = e.jump(JIT_JMP);
+    }
+
+    e.byte(0x83); e.byte(0xbb); e.dword(o.async_event); e.byte(0); // cmp dword [rbx+async_event], 0
+    exits[nexits++] = e.jump(JIT_JNZ);
+
+    unsigned remaining = entry->tlen - n - 1;
+    if (tick && remaining) {
+      e.byte(0x41); e.byte(0x81); e.byte(0x3c); e.byte(0x24);  // cmp dword [r12], imm32
+      e.dword(remaining);
+      exits[nexits++] = e.jump(JIT_JBE);
+    }
+  }
+
+  jitEmitCommit(o, e, pending, pendingLen, tick);
+
+  // epilogue, all early exits land here
+  for (unsigned n=0; n < nexits; n++)
+    jitPatch(exits[n], e.p);
+  e.byte(0x41); e.byte(0x5c);            // pop r12
+  e.byte(0x5d);                          // pop rbp
+  e.byte(0x5b);                          // pop rbx
+  e.byte(0xc3);                          // ret
+
+  BX_ASSERT((unsigned)(e.p - start) <= maxlen);
+
+  jit->commit(e.p);
+  jit->stats.translations++;
+
+  entry->jitCode = (bxJitCode_t) start;
+  entry->jitGeneration = jit->generation;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//   Copyright (c) 2013 The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_JIT_H
+#define BX_JIT_H
+
+#if BX_SUPPORT_JIT
+
+// Second execution tier: a trace executed "jit_threshold" times is
+// translated into host x86-64 code.  Integer register-only instructions
+// (MOV, ALU, INC/DEC) are emitted inline and access the guest registers
+// and lazy flags directly.  Conditional branches and 32-bit MOV loads and
+// stores with a [base+disp] address get an inline fast path which falls
+// back to the handler when it does not apply (branch target outside of
+// the segment, TLB miss and so on).  All other instructions are called
+// through their handlers from the translated code.
+
+// Translated code of all traces of one CPU lives in a single buffer which
+// is recycled as a whole when it is full.
+#define BX_JIT_CODE_BUFFER_SIZE (4*1024*1024)
+
+// Upper bounds for the amount of code emitted for a trace
+#define BX_JIT_MAX_INSTR_CODE   512
+#define BX_JIT_MAX_TRACE_CODE   128
+
+typedef void (*bxJitCode_t)(class BX_CPU_C *cpu);
+
+class bxJitCache_c {
+public:
+  Bit8u *buffer;
+  unsigned used;
+  // Bumped every time the buffer is recycled, traces translated with an
+  // older generation number have to be translated again
+  Bit32u generation;
+  Bit32u threshold;
+
+  struct {
+    Bit64u translations;
+    Bit64u flushes;     // code buffer recycled
+    Bit64u executions;  // traces run from translated code
+    Bit64u inlined;     // instructions emitted as host code
+    Bit64u fast;        // instructions with an inline fast path
+    Bit64u called;      // instructions called through their handlers
+  } stats;
+
+public:
+  bxJitCache_c(): buffer(NULL), used(0), generation(1), threshold(0) {
+    memset(&stats, 0, sizeof(stats));
+  }
+ ~bxJitCache_c() { cleanup(); }
+
+  bx_bool init(Bit32u threshold);
+  void cleanup(void);
+
+  BX_CPP_INLINE bx_bool enabled(void) const { return buffer != NULL; }
+
+  BX_CPP_INLINE Bit8u *alloc(unsigned maxlen)
+  {
+    if ((used + maxlen) > BX_JIT_CODE_BUFFER_SIZE) {
+      used = 0;
+      generation++;
+      stats.flushes++;
+    }
+    return buffer + used;
+  }
+
+  BX_CPP_INLINE void commit(const Bit8u *end)
+  {
+    // keep every trace entry point 16 byte aligned
+    used = ((unsigned)(end - buffer) + 15) & ~15;
+  }
+};
+
+#endif
+
+#endif
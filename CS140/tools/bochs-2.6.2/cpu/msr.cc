@@ -34,8 +34,12 @@ bx_bool BX_CPP_AttrRegparmN(2) BX_CPU_C::rdmsr(Bit32u index, Bit64u *msr)
 #if BX_CPU_LEVEL >= 6
   if (bx_cpuid_support_x2apic()) {
     if (index >= 0x800 && index <= 0xBFF) {
-      if (BX_CPU_THIS_PTR msr.apicbase & 0x400)  // X2APIC mode
-        return BX_CPU_THIS_PTR lapic.read_x2apic(index, msr);
+      if (BX_CPU_THIS_PTR msr.apicbase & 0x400) { // X2APIC mode
+        BX_LOCK_IO();
+        bx_bool ok = BX_CPU_THIS_PTR lapic.read_x2apic(index, msr);
+        BX_UNLOCK_IO();
+        return ok;
+      }
       else
         return 0;
     }
@@ -483,8 +487,12 @@ bx_bool BX_CPP_AttrRegparmN(2) BX_CPU_C::wrmsr(Bit32u index, Bit64u val_64)
 #if BX_CPU_LEVEL >= 6
   if (bx_cpuid_support_x2apic()) {
     if (index >= 0x800 && index <= 0xBFF) {
-      if (BX_CPU_THIS_PTR msr.apicbase & 0x400)  // X2APIC mode
-        return BX_CPU_THIS_PTR lapic.write_x2apic(index, val32_hi, val32_lo);
+      if (BX_CPU_THIS_PTR msr.apicbase & 0x400) { // X2APIC mode
+        BX_LOCK_IO();
+        bx_bool ok = BX_CPU_THIS_PTR lapic.write_x2apic(index, val32_hi, val32_lo);
+        BX_UNLOCK_IO();
+        return ok;
+      }
       else
         return 0;
     }
@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "param_names.h"
+
 // X86 Registers Which Affect Paging:
 // ==================================
 //
@@ -375,49 +377,276 @@ static unsigned tlbNonGlobalFlushes=0;
 
 // ==============================================================
 
-void BX_CPU_C::TLB_flush(void)
+void BX_CPU_C::TLB_init(void)
 {
-#if InstrumentTLB
-  InstrTLB_Increment(tlbGlobalFlushes);
-#endif
+  unsigned n, size;
+
+  // L1 and L2 sizes must be powers of 2
+  size = SIM->get_param_num(BXPN_TLB_SIZE)->get();
+  while (size & (size-1)) size &= size-1;
+  BX_CPU_THIS_PTR TLB.size = size;
+  BX_CPU_THIS_PTR TLB.set_mask = size / BX_TLB_WAYS - 1;
+  BX_CPU_THIS_PTR TLB.entry = new bx_TLB_entry[size];
+  BX_CPU_THIS_PTR TLB.next_way = new Bit8u[size / BX_TLB_WAYS];
+  for (n=0; n < size / BX_TLB_WAYS; n++)
+    BX_CPU_THIS_PTR TLB.next_way[n] = 0;
+
+  size = SIM->get_param_num(BXPN_TLB_L2_SIZE)->get();
+  while (size & (size-1)) size &= size-1;
+  BX_CPU_THIS_PTR TLB.l2_mask = size - 1;
+  BX_CPU_THIS_PTR TLB.l2 = new bx_TLB_L2_entry[size];
+  for (n=0; n < size; n++) {
+    BX_CPU_THIS_PTR TLB.l2[n].lpf = BX_INVALID_TLB_ENTRY;
+    BX_CPU_THIS_PTR TLB.l2[n].gen = 0;
+  }
+  for (n=0; n < BX_TLB_LARGE_ENTRIES; n++) {
+    BX_CPU_THIS_PTR TLB.large[n].lpf = BX_INVALID_TLB_ENTRY;
+    BX_CPU_THIS_PTR TLB.large[n].gen = 0;
+  }
+  BX_CPU_THIS_PTR TLB.next_large = 0;
+  BX_CPU_THIS_PTR TLB.l2_split_large = 0;
+
+  // generation 0 marks invalid L2 entries
+  for (n=0; n < BX_TLB_CONTEXTS; n++)
+    BX_CPU_THIS_PTR TLB.context[n].pcid = BX_TLB_NO_CONTEXT;
+  BX_CPU_THIS_PTR TLB.cur_context = 0;
+  BX_CPU_THIS_PTR TLB.next_gen = 1;
+
+  TLB_flush();
+}
 
-  invalidate_prefetch_q();
+// L2 entries of address spaces other than the first context slot are
+// spread over the L2 so that processes using the same linear addresses
+// don't evict each other
+#define BX_TLB_L2_HASH(n) ((n) * 0x9e5)
 
-  invalidate_stack_cache();
+// new generations are handed out until this limit, then the L2 is cleared
+#define BX_TLB_MAX_GEN 0xfffffff0
+
+#define BX_TLB_SAME_DOMAIN(a, b) ((a)->vpid == (b)->vpid && (a)->root == (b)->root)
 
-  for (unsigned n=0; n<BX_TLB_SIZE; n++) {
-    BX_CPU_THIS_PTR TLB.entry[n].lpf = BX_INVALID_TLB_ENTRY;
-    BX_CPU_THIS_PTR TLB.entry[n].accessBits = 0;
+// The L2 TLB is flushed by advancing the generations of the current context,
+// the entries are only cleared when the generation counter wraps around.
+// Global flush also forgets all the other contexts.
+void BX_CPU_C::TLB_L2_flush(bx_bool global)
+{
+  bx_TLB_context *ctx = &BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context];
+
+  if (BX_CPU_THIS_PTR TLB.next_gen > BX_TLB_MAX_GEN) {
+    for (unsigned n=0; n <= BX_CPU_THIS_PTR TLB.l2_mask; n++)
+      BX_CPU_THIS_PTR TLB.l2[n].gen = 0;
+    for (unsigned n=0; n < BX_TLB_LARGE_ENTRIES; n++)
+      BX_CPU_THIS_PTR TLB.large[n].gen = 0;
+    BX_CPU_THIS_PTR TLB.next_gen = 1;
+    global = 1;
+  }
+
+  if (global) {
+    for (unsigned n=1; n < BX_TLB_CONTEXTS; n++)
+      BX_CPU_THIS_PTR TLB.context[n].pcid = BX_TLB_NO_CONTEXT;
+    ctx = &BX_CPU_THIS_PTR TLB.context[0];
+    TLB_get_context(ctx);
+    ctx->gen = BX_CPU_THIS_PTR TLB.next_gen++;
+    BX_CPU_THIS_PTR TLB.cur_context = 0;
+    BX_CPU_THIS_PTR TLB.next_context = 1;
+    BX_CPU_THIS_PTR TLB.l2_hash = 0;
+    BX_CPU_THIS_PTR TLB.l2_split_large = 0;
+  }
+
+  ctx->gen_nonglobal = BX_CPU_THIS_PTR TLB.next_gen++;
+  BX_CPU_THIS_PTR TLB.gen = ctx->gen;
+  BX_CPU_THIS_PTR TLB.gen_nonglobal = ctx->gen_nonglobal;
+}
+
+// Build the tag of the current address space
+void BX_CPU_C::TLB_get_context(bx_TLB_context *ctx)
+{
+  ctx->root = 0;
+  ctx->vpid = 0;
+  ctx->pcid = 0;
+
+#if BX_SUPPORT_VMX
+  if (BX_CPU_THIS_PTR in_vmx_guest && SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_VPID_ENABLE)) {
+    ctx->vpid = BX_CPU_THIS_PTR vmcs.vpid;
+#if BX_SUPPORT_VMX >= 2
+    if (SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE))
+      ctx->root = BX_CPU_THIS_PTR vmcs.eptptr;
+#endif
   }
+#endif
 
-#if BX_CPU_LEVEL >= 5
-  BX_CPU_THIS_PTR TLB.split_large = 0;  // flush whole TLB
+#if BX_SUPPORT_SVM
+  if (BX_CPU_THIS_PTR in_svm_guest) {
+    ctx->vpid = BX_CPU_THIS_PTR vmcb.ctrls.guest_asid;
+    if (SVM_NESTED_PAGING_ENABLED)
+      ctx->root = BX_CPU_THIS_PTR vmcb.ctrls.ncr3;
+  }
 #endif
 
-#if BX_SUPPORT_MONITOR_MWAIT
-  // invalidating of the TLB might change translation for monitored page
-  // and cause subsequent MWAIT instruction to wait forever
-  BX_CPU_THIS_PTR monitor.reset_monitor();
+#if BX_SUPPORT_X86_64
+  if (BX_CPU_THIS_PTR cr4.get_PCIDE())
+    ctx->pcid = (Bit32u) BX_CPU_THIS_PTR cr3 & 0xfff;
 #endif
 }
 
-#if BX_CPU_LEVEL >= 6
-void BX_CPU_C::TLB_flushNonGlobal(void)
+// Make the address space selected by CR3 (with CR4.PCIDE set) and by the
+// VPID/ASID current.  The L2 entries of the recently used address spaces
+// are kept, the L1 TLB is not tagged and is flushed.  VM entry and VM exit
+// flush the whole TLB when neither side uses VPID/ASID.
+void BX_CPU_C::TLB_switch_context(bx_bool vm_switch)
 {
-#if InstrumentTLB
-  InstrTLB_Increment(tlbNonGlobalFlushes);
+  bx_TLB_context new_ctx, *ctx = &BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context];
+  unsigned n;
+
+  TLB_get_context(&new_ctx);
+
+  if (vm_switch && new_ctx.vpid == 0 && ctx->vpid == 0) {
+    TLB_flush();
+    return;
+  }
+
+  bx_bool same_domain = BX_TLB_SAME_DOMAIN(ctx, &new_ctx);
+  if (same_domain && ctx->pcid == new_ctx.pcid)
+    return;
+
+  TLB_L1_flush(! same_domain);
+
+  for (n=0; n < BX_TLB_CONTEXTS; n++) {
+    ctx = &BX_CPU_THIS_PTR TLB.context[n];
+    if (ctx->pcid == new_ctx.pcid && BX_TLB_SAME_DOMAIN(ctx, &new_ctx)) break;
+  }
+
+  if (n == BX_TLB_CONTEXTS) {
+    n = BX_CPU_THIS_PTR TLB.next_context;
+    if (n == BX_CPU_THIS_PTR TLB.cur_context)
+      n = (n + 1) % BX_TLB_CONTEXTS;
+    BX_CPU_THIS_PTR TLB.next_context = (n + 1) % BX_TLB_CONTEXTS;
+
+    // global pages are shared by all the PCIDs of the VPID/ASID
+    new_ctx.gen = 0;
+    for (unsigned k=0; k < BX_TLB_CONTEXTS; k++) {
+      ctx = &BX_CPU_THIS_PTR TLB.context[k];
+      if (k != n && ctx->pcid != BX_TLB_NO_CONTEXT && BX_TLB_SAME_DOMAIN(ctx, &new_ctx)) {
+        new_ctx.gen = ctx->gen;
+        break;
+      }
+    }
+    if (! new_ctx.gen)
+      new_ctx.gen = BX_CPU_THIS_PTR TLB.next_gen++;
+    new_ctx.gen_nonglobal = BX_CPU_THIS_PTR TLB.next_gen++;
+
+    ctx = &BX_CPU_THIS_PTR TLB.context[n];
+    *ctx = new_ctx;
+  }
+
+  BX_CPU_THIS_PTR TLB.cur_context = n;
+  BX_CPU_THIS_PTR TLB.l2_hash = BX_TLB_L2_HASH(n);
+  BX_CPU_THIS_PTR TLB.gen = ctx->gen;
+  BX_CPU_THIS_PTR TLB.gen_nonglobal = ctx->gen_nonglobal;
+
+  if (BX_CPU_THIS_PTR TLB.next_gen > BX_TLB_MAX_GEN)
+    TLB_L2_flush(1);
+}
+
+#define TLB_L2_ENTRY_OF(laddr, hash) \
+   (&BX_CPU_THIS_PTR TLB.l2[(((laddr) >> 12) + (hash)) & BX_CPU_THIS_PTR TLB.l2_mask])
+
+#define TLB_L2_VALID(e) ((e)->gen == BX_CPU_THIS_PTR TLB.gen && \
+   ((e)->gen_nonglobal == BX_CPU_THIS_PTR TLB.gen_nonglobal || ((e)->accessBits & TLB_GlobalPage)))
+
+bx_TLB_L2_entry *BX_CPU_C::TLB_L2_lookup(bx_address laddr, bx_phy_address *paddress)
+{
+  bx_TLB_L2_entry *e = TLB_L2_ENTRY_OF(laddr, BX_CPU_THIS_PTR TLB.l2_hash);
+  if (e->lpf == LPFOf(laddr) && TLB_L2_VALID(e)) {
+    *paddress = e->ppf | PAGE_OFFSET(laddr);
+    return e;
+  }
+
+  // global pages are kept in the slot of the first context
+  if (BX_CPU_THIS_PTR TLB.l2_hash) {
+    e = TLB_L2_ENTRY_OF(laddr, 0);
+    if (e->lpf == LPFOf(laddr) && TLB_L2_VALID(e)) {
+      *paddress = e->ppf | PAGE_OFFSET(laddr);
+      return e;
+    }
+  }
+
+  e = BX_CPU_THIS_PTR TLB.large;
+  for (unsigned n=0; n < BX_TLB_LARGE_ENTRIES; n++, e++) {
+    if ((laddr & ~(bx_address) e->lpf_mask) == e->lpf && TLB_L2_VALID(e)) {
+      *paddress = e->ppf | (laddr & e->lpf_mask);
+      return e;
+    }
+  }
+
+  return NULL;
+}
+
+void BX_CPU_C::TLB_L2_update(bx_address laddr, bx_phy_address paddress, Bit32u lpf_mask, Bit32u accessBits)
+{
+  bx_TLB_L2_entry *e;
+
+  // large page translation can be kept as a single entry if it maps a
+  // physically contiguous region
+  bx_bool large = (lpf_mask > 0xfff) && (~bx_pc_system.a20_mask & lpf_mask) == 0
+#if BX_SUPPORT_VMX >= 2
+    && ! (BX_CPU_THIS_PTR in_vmx_guest && SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE))
+#endif
+#if BX_SUPPORT_SVM
+    && ! (BX_CPU_THIS_PTR in_svm_guest && SVM_NESTED_PAGING_ENABLED)
 #endif
+    ;
+
+  if (large) {
+    bx_address lpf = laddr & ~(bx_address) lpf_mask;
+    bx_phy_address ppf = paddress & ~(bx_phy_address) lpf_mask;
+
+    e = BX_CPU_THIS_PTR TLB.large;
+    for (unsigned n=0; n < BX_TLB_LARGE_ENTRIES; n++, e++) {
+      if (e->lpf == lpf && TLB_L2_VALID(e)) break;
+    }
+    if (e == BX_CPU_THIS_PTR TLB.large + BX_TLB_LARGE_ENTRIES) {
+      e = &BX_CPU_THIS_PTR TLB.large[BX_CPU_THIS_PTR TLB.next_large];
+      BX_CPU_THIS_PTR TLB.next_large = (BX_CPU_THIS_PTR TLB.next_large + 1) % BX_TLB_LARGE_ENTRIES;
+      e->gen = 0;
+    }
+    // merge the rights granted by different page walks of the same mapping
+    if (e->gen == 0 || e->ppf != ppf || e->lpf_mask != lpf_mask)
+      e->accessBits = 0;
+    e->lpf = lpf;
+    e->ppf = ppf;
+    e->lpf_mask = lpf_mask;
+  }
+  else {
+    bx_address lpf = LPFOf(laddr);
+    bx_phy_address ppf = PPFOf(paddress);
+
+    e = TLB_L2_ENTRY_OF(laddr, (accessBits & TLB_GlobalPage) ? 0 : BX_CPU_THIS_PTR TLB.l2_hash);
+    if (e->lpf != lpf || e->ppf != ppf || ! TLB_L2_VALID(e))
+      e->accessBits = 0;
+    e->lpf = lpf;
+    e->ppf = ppf;
+    e->lpf_mask = lpf_mask;
+    if (lpf_mask > 0xfff)
+      BX_CPU_THIS_PTR TLB.l2_split_large = 1;
+  }
 
+  e->accessBits |= accessBits;
+  e->gen = BX_CPU_THIS_PTR TLB.gen;
+  e->gen_nonglobal = BX_CPU_THIS_PTR TLB.gen_nonglobal;
+}
+
+void BX_CPU_C::TLB_L1_flush(bx_bool global)
+{
   invalidate_prefetch_q();
 
   invalidate_stack_cache();
 
-  BX_CPU_THIS_PTR TLB.split_large = 0;
   Bit32u lpf_mask = 0;
 
-  for (unsigned n=0; n<BX_TLB_SIZE; n++) {
+  for (unsigned n=0; n<BX_CPU_THIS_PTR TLB.size; n++) {
     bx_TLB_entry *tlbEntry = &BX_CPU_THIS_PTR TLB.entry[n];
-    if (!(tlbEntry->accessBits & TLB_GlobalPage)) {
+    if (global || !(tlbEntry->accessBits & TLB_GlobalPage)) {
       tlbEntry->lpf = BX_INVALID_TLB_ENTRY;
       tlbEntry->accessBits = 0;
     }
@@ -426,8 +655,9 @@ void BX_CPU_C::TLB_flushNonGlobal(void)
     }
   }
 
-  if (lpf_mask > 0xfff)
-    BX_CPU_THIS_PTR TLB.split_large = 1;
+#if BX_CPU_LEVEL >= 5
+  BX_CPU_THIS_PTR TLB.split_large = (lpf_mask > 0xfff);
+#endif
 
 #if BX_SUPPORT_MONITOR_MWAIT
   // invalidating of the TLB might change translation for monitored page
@@ -435,6 +665,43 @@ void BX_CPU_C::TLB_flushNonGlobal(void)
   BX_CPU_THIS_PTR monitor.reset_monitor();
 #endif
 }
+
+void BX_CPU_C::TLB_flush(void)
+{
+#if InstrumentTLB
+  InstrTLB_Increment(tlbGlobalFlushes);
+#endif
+
+  TLB_L1_flush(1);
+  TLB_L2_flush(1);
+}
+
+#if BX_CPU_LEVEL >= 6
+void BX_CPU_C::TLB_flushNonGlobal(void)
+{
+#if InstrumentTLB
+  InstrTLB_Increment(tlbNonGlobalFlushes);
+#endif
+
+  TLB_L1_flush(0);
+  TLB_L2_flush(0);
+}
+
+// Flush the non-global translations tagged with the PCID in the current
+// VPID/ASID, BX_TLB_NO_CONTEXT selects all the PCIDs
+void BX_CPU_C::TLB_flushPCID(Bit32u pcid)
+{
+  if (pcid == BX_TLB_NO_CONTEXT || pcid == BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context].pcid)
+    TLB_flushNonGlobal();
+
+  bx_TLB_context *cur = &BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context];
+  for (unsigned n=0; n < BX_TLB_CONTEXTS; n++) {
+    bx_TLB_context *ctx = &BX_CPU_THIS_PTR TLB.context[n];
+    if (ctx == cur || ! BX_TLB_SAME_DOMAIN(ctx, cur)) continue;
+    if (pcid == BX_TLB_NO_CONTEXT || ctx->pcid == pcid)
+      ctx->pcid = BX_TLB_NO_CONTEXT;
+  }
+}
 #endif
 
 void BX_CPU_C::TLB_invlpg(bx_address laddr)
@@ -452,7 +719,7 @@ void BX_CPU_C::TLB_invlpg(bx_address laddr)
     BX_CPU_THIS_PTR TLB.split_large = 0;
 
     // make sure INVLPG handles correctly large pages
-    for (unsigned n=0; n<BX_TLB_SIZE; n++) {
+    for (unsigned n=0; n<BX_CPU_THIS_PTR TLB.size; n++) {
       bx_TLB_entry *tlbEntry = &BX_CPU_THIS_PTR TLB.entry[n];
       bx_address entry_lpf_mask = tlbEntry->lpf_mask;
       if ((laddr & ~entry_lpf_mask) == (tlbEntry->lpf & ~entry_lpf_mask)) {
@@ -470,15 +737,32 @@ void BX_CPU_C::TLB_invlpg(bx_address laddr)
   else
 #endif
   {
-    unsigned TLB_index = BX_TLB_INDEX_OF(laddr, 0);
     bx_address lpf = LPFOf(laddr);
-    bx_TLB_entry *tlbEntry = &BX_CPU_THIS_PTR TLB.entry[TLB_index];
+    bx_TLB_entry *tlbEntry = BX_TLB_ENTRY_OF(laddr);
     if (TLB_LPFOf(tlbEntry->lpf) == lpf) {
       tlbEntry->lpf = BX_INVALID_TLB_ENTRY;
       tlbEntry->accessBits = 0;
     }
   }
 
+  if (BX_CPU_THIS_PTR TLB.l2_split_large) {
+    TLB_L2_flush(1);
+  }
+  else {
+    bx_TLB_L2_entry *e = TLB_L2_ENTRY_OF(laddr, BX_CPU_THIS_PTR TLB.l2_hash);
+    if (e->lpf == LPFOf(laddr))
+      e->gen = 0;
+    e = TLB_L2_ENTRY_OF(laddr, 0);
+    if (e->lpf == LPFOf(laddr))
+      e->gen = 0;
+
+    e = BX_CPU_THIS_PTR TLB.large;
+    for (unsigned n=0; n < BX_TLB_LARGE_ENTRIES; n++, e++) {
+      if ((laddr & ~(bx_address) e->lpf_mask) == e->lpf)
+        e->gen = 0;
+    }
+  }
+
 #if BX_SUPPORT_MONITOR_MWAIT
   // invalidating of the TLB entry might change translation for monitored
   // page and cause subsequent MWAIT instruction to wait forever
@@ -1150,99 +1434,138 @@ bx_phy_address BX_CPU_C::translate_linear(bx_TLB_entry *tlbEntry, bx_address lad
 
   InstrTLB_Increment(tlbMisses);
 
-  if(BX_CPU_THIS_PTR cr0.get_PG())
+  Bit32u accessBits = 0;
+  bx_TLB_L2_entry *l2entry = NULL;
+
+  if (BX_CPU_THIS_PTR cr0.get_PG())
+    l2entry = TLB_L2_lookup(laddr, &paddress);
+
+  if (l2entry && (l2entry->accessBits & (1 << ((isExecute<<2) | (isWrite<<1) | user))))
   {
-    BX_DEBUG(("page walk for address 0x" FMT_LIN_ADDRX, laddr));
+    // L2 TLB hit, the translation was already checked by a page walk.
+    lpf_mask = l2entry->lpf_mask;
+
+#if BX_CPU_LEVEL >= 5
+    if (lpf_mask > 0xfff)
+      BX_CPU_THIS_PTR TLB.split_large = 1;
+#endif
+
+    // grant only the rights a page walk for this access would grant,
+    // the host pointer below is requested for this kind of access
+    accessBits = l2entry->accessBits & (TLB_GlobalPage | TLB_SysReadOK | TLB_UserReadOK);
+    if (isWrite)
+      accessBits |= l2entry->accessBits & (TLB_SysWriteOK | TLB_UserWriteOK);
+    if (isExecute)
+      accessBits |= l2entry->accessBits & (TLB_SysExecuteOK | TLB_UserExecuteOK);
+  }
+  else {
+    if(BX_CPU_THIS_PTR cr0.get_PG())
+    {
+      BX_DEBUG(("page walk for address 0x" FMT_LIN_ADDRX, laddr));
 
 #if BX_CPU_LEVEL >= 6
 #if BX_SUPPORT_X86_64
-    if (long_mode())
-      paddress = translate_linear_long_mode(laddr, lpf_mask, combined_access, user, rw);
-    else
-#endif
-      if (BX_CPU_THIS_PTR cr4.get_PAE())
-        paddress = translate_linear_PAE(laddr, lpf_mask, combined_access, user, rw);
+      if (long_mode())
+        paddress = translate_linear_long_mode(laddr, lpf_mask, combined_access, user, rw);
       else
+#endif
+        if (BX_CPU_THIS_PTR cr4.get_PAE())
+          paddress = translate_linear_PAE(laddr, lpf_mask, combined_access, user, rw);
+        else
 #endif 
-        paddress = translate_linear_legacy(laddr, lpf_mask, combined_access, user, rw);
+          paddress = translate_linear_legacy(laddr, lpf_mask, combined_access, user, rw);
 
 #if BX_CPU_LEVEL >= 5
-    if (lpf_mask > 0xfff)
-      BX_CPU_THIS_PTR TLB.split_large = 1;
+      if (lpf_mask > 0xfff)
+        BX_CPU_THIS_PTR TLB.split_large = 1;
 #endif
-  }
-  else {
-    // no paging
-    paddress = (bx_phy_address) laddr;
-  }
+    }
+    else {
+      // no paging
+      paddress = (bx_phy_address) laddr;
+    }
 
-  // Calculate physical memory address and fill in TLB cache entry
+    // Calculate physical memory address and fill in TLB cache entry
 #if BX_SUPPORT_VMX >= 2
-  if (BX_CPU_THIS_PTR in_vmx_guest) {
-    if (SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE)) {
-      paddress = translate_guest_physical(paddress, laddr, 1, 0, rw);
+    if (BX_CPU_THIS_PTR in_vmx_guest) {
+      if (SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE)) {
+        paddress = translate_guest_physical(paddress, laddr, 1, 0, rw);
+      }
     }
-  }
 #endif
 #if BX_SUPPORT_SVM
-  if (BX_CPU_THIS_PTR in_svm_guest && SVM_NESTED_PAGING_ENABLED) {
-    paddress = nested_walk(paddress, rw, 0);
-  }
+    if (BX_CPU_THIS_PTR in_svm_guest && SVM_NESTED_PAGING_ENABLED) {
+      paddress = nested_walk(paddress, rw, 0);
+    }
 #endif
-  paddress = A20ADDR(paddress);
-  ppf = PPFOf(paddress);
+    paddress = A20ADDR(paddress);
 
-  // direct memory access is NOT allowed by default
-  tlbEntry->lpf = lpf | TLB_NoHostPtr;
-  tlbEntry->lpf_mask = lpf_mask;
-  tlbEntry->ppf = ppf;
-  tlbEntry->accessBits = 0;
+    accessBits |= TLB_SysReadOK;
+    if (isWrite)
+      accessBits |= TLB_SysWriteOK;
+    if (isExecute)
+      accessBits |= TLB_SysExecuteOK;
 
-  tlbEntry->accessBits |= TLB_SysReadOK;
-  if (isWrite)
-    tlbEntry->accessBits |= TLB_SysWriteOK;
-  if (isExecute)
-    tlbEntry->accessBits |= TLB_SysExecuteOK;
-
-  if (! BX_CPU_THIS_PTR cr0.get_PG()
+    if (! BX_CPU_THIS_PTR cr0.get_PG()
 #if BX_SUPPORT_VMX >= 2
-        && ! (BX_CPU_THIS_PTR in_vmx_guest && SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE))
+          && ! (BX_CPU_THIS_PTR in_vmx_guest && SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE))
 #endif
 #if BX_SUPPORT_SVM
-        && ! (BX_CPU_THIS_PTR in_svm_guest && SVM_NESTED_PAGING_ENABLED)
-#endif
-    ) {
-    tlbEntry->accessBits |= TLB_UserReadOK |
-                            TLB_UserWriteOK |
-                            TLB_UserExecuteOK;
-  }
-  else {
-    if ((combined_access & 4) != 0) { // User Page
-
-      if (user) {
-        tlbEntry->accessBits |= TLB_UserReadOK;
-        if (isWrite)
-          tlbEntry->accessBits |= TLB_UserWriteOK;
-        if (isExecute)
-          tlbEntry->accessBits |= TLB_UserExecuteOK;
-      }
+          && ! (BX_CPU_THIS_PTR in_svm_guest && SVM_NESTED_PAGING_ENABLED)
+#endif
+      ) {
+      accessBits |= TLB_UserReadOK |
+                    TLB_UserExecuteOK;
+      // direct writes only after a write access, the memory object tracks
+      // the written pages when the host pointer is handed out for writing
+      if (isWrite)
+        accessBits |= TLB_UserWriteOK;
+    }
+    else {
+      if ((combined_access & 4) != 0) { // User Page
+
+        if (user) {
+          accessBits |= TLB_UserReadOK;
+          if (isWrite)
+            accessBits |= TLB_UserWriteOK;
+          if (isExecute)
+            accessBits |= TLB_UserExecuteOK;
+        }
 
 #if BX_CPU_LEVEL >= 6
-      if (BX_CPU_THIS_PTR cr4.get_SMEP())
-        tlbEntry->accessBits &= ~TLB_SysExecuteOK;
+        if (BX_CPU_THIS_PTR cr4.get_SMEP())
+          accessBits &= ~TLB_SysExecuteOK;
 
-      if (BX_CPU_THIS_PTR cr4.get_SMAP())
-        tlbEntry->accessBits &= ~(TLB_SysReadOK | TLB_SysWriteOK);
+        if (BX_CPU_THIS_PTR cr4.get_SMAP())
+          accessBits &= ~(TLB_SysReadOK | TLB_SysWriteOK);
 #endif
 
+      }
     }
-  }
 
 #if BX_CPU_LEVEL >= 6
-  if (combined_access & 0x100) // Global bit
-    tlbEntry->accessBits |= TLB_GlobalPage;
+    if (combined_access & 0x100) // Global bit
+      accessBits |= TLB_GlobalPage;
 #endif
 
+    if (BX_CPU_THIS_PTR cr0.get_PG())
+      TLB_L2_update(laddr, paddress, lpf_mask, accessBits);
+  }
+
+  ppf = PPFOf(paddress);
+
+  // direct memory access is NOT allowed by default
+  tlbEntry->lpf = lpf | TLB_NoHostPtr;
+  tlbEntry->lpf_mask = lpf_mask;
+  tlbEntry->ppf = ppf;
+  tlbEntry->accessBits = accessBits;
+
+  // advance the replacement pointer of the set if its victim was used
+  unsigned tlbIndex = (unsigned)(tlbEntry - BX_CPU_THIS_PTR TLB.entry);
+  unsigned set = tlbIndex / BX_TLB_WAYS;
+  if ((tlbIndex & (BX_TLB_WAYS-1)) == BX_CPU_THIS_PTR TLB.next_way[set])
+    BX_CPU_THIS_PTR TLB.next_way[set] = (BX_CPU_THIS_PTR TLB.next_way[set] + 1) & (BX_TLB_WAYS-1);
+
   // Attempt to get a host pointer to this physical page. Put that
   // pointer in the TLB cache. Note if the request is vetoed, NULL
   // will be returned, and it's OK to OR zero in anyways.
@@ -2043,7 +2366,9 @@ void BX_CPU_C::access_write_physical(bx_phy_address paddr, unsigned len, void *d
 
 #if BX_SUPPORT_APIC
   if (BX_CPU_THIS_PTR lapic.is_selected(paddr)) {
+    BX_LOCK_IO();
     BX_CPU_THIS_PTR lapic.write(paddr, data, len);
+    BX_UNLOCK_IO();
     return;
   }
 #endif
@@ -2061,7 +2386,9 @@ void BX_CPU_C::access_read_physical(bx_phy_address paddr, unsigned len, void *da
 
 #if BX_SUPPORT_APIC
   if (BX_CPU_THIS_PTR lapic.is_selected(paddr)) {
+    BX_LOCK_IO();
     BX_CPU_THIS_PTR lapic.read(paddr, data, len);
+    BX_UNLOCK_IO();
     return;
   }
 #endif
@@ -2087,7 +2414,7 @@ bx_hostpageaddr_t BX_CPU_C::getHostMemAddr(bx_phy_address paddr, unsigned rw)
 #if BX_LARGE_RAMFILE
 bx_bool BX_CPU_C::check_addr_in_tlb_buffers(const Bit8u *addr, const Bit8u *end)
 {
-  for (unsigned tlb_entry_num=0; tlb_entry_num < BX_TLB_SIZE; tlb_entry_num++) {
+  for (unsigned tlb_entry_num=0; tlb_entry_num < BX_CPU_THIS_PTR TLB.size; tlb_entry_num++) {
     if (((BX_CPU_THIS_PTR TLB.entry[tlb_entry_num].hostPageAddr)>=(const bx_hostpageaddr_t)addr) &&
         ((BX_CPU_THIS_PTR TLB.entry[tlb_entry_num].hostPageAddr)<(const bx_hostpageaddr_t)end))
       return true;
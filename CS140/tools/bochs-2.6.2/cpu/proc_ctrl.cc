@@ -449,9 +449,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::BxNoAVX(bxInstruction_c *i)
 
 #endif
 
-void BX_CPU_C::handleCpuContextChange(void)
+void BX_CPU_C::handleCpuContextChange(bx_bool vm_switch)
 {
-  TLB_flush();
+  // VM entry and VM exit switch the TLB context once the new VPID (ASID)
+  // is active
+  if (! vm_switch)
+    TLB_flush();
 
   invalidate_prefetch_q();
   invalidate_stack_cache();
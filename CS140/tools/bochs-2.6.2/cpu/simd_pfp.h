@@ -242,4 +242,120 @@ BX_CPP_INLINE void fnmsubpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister
   op1->xmm64u(1) = float64_muladd(op1->xmm64u(1), op2->xmm64u(1), op3->xmm64u(1), float_muladd_negate_result, status);
 }
 
+// host SSE fast path for the packed arithmetic add/sub/mul/div
+//
+// With the default MXCSR controls (round to nearest, no DAZ and no FTZ)
+// and #U masked the host SSE unit produces exactly the softfloat results
+// as long as no exception but #P is signalled and no lane produces a NaN.
+// An unmasked #U is also signalled for exact tiny results, which the
+// host running with all exceptions masked does not report.
+//
+// The host_* functions return the exception flags in that case,
+// otherwise they return -1 and leave the destination untouched, and the
+// operation has to be repeated with softfloat to get the exact exception
+// semantics.
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define BX_HOST_SIMD_PFP 1
+#else
+#define BX_HOST_SIMD_PFP 0
+#endif
+
+typedef int (*host_pfp_method_t)(BxPackedXmmRegister *r,
+      const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, bx_mxcsr_t mxcsr);
+
+#if BX_HOST_SIMD_PFP
+
+#include <emmintrin.h>
+
+BX_CPP_INLINE bx_bool host_pfp_allowed(bx_mxcsr_t mxcsr)
+{
+  return (mxcsr.mxcsr & (MXCSR_DAZ | MXCSR_ROUNDING_CONTROL | MXCSR_FLUSH_MASKED_UNDERFLOW | MXCSR_UM)) == MXCSR_UM;
+}
+
+// Bring the host MXCSR to its reset value with the flags cleared.  Reading
+// the flags right after writing MXCSR is slow, so a #P left over from the
+// previous operation is kept when the guest has #P set and masked already
+// and it does not matter whether the operation signals it again.
+BX_CPP_INLINE void host_pfp_prepare(bx_mxcsr_t mxcsr)
+{
+  Bit32u keep = ((mxcsr.mxcsr & (MXCSR_PE | MXCSR_PM)) == (MXCSR_PE | MXCSR_PM)) ? MXCSR_PE : 0;
+  if ((_mm_getcsr() & ~keep) != MXCSR_RESET)
+    _mm_setcsr(MXCSR_RESET);
+}
+
+// The empty asm statements keep the compiler from moving the operation
+// across the host MXCSR accesses.
+#define BX_HOST_PFP_METHOD(name, type, load, store, op, cmpunord, movemask)  \
+BX_CPP_INLINE int host_##name(BxPackedXmmRegister *r,                     \
+      const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2,     \
+      bx_mxcsr_t mxcsr)                                                   \
+{                                                                         \
+  if (! host_pfp_allowed(mxcsr)) return -1;                               \
+  type a = load((const void *) op1), b = load((const void *) op2);        \
+  host_pfp_prepare(mxcsr);                                                \
+  __asm__ __volatile__("" : "+x" (a), "+x" (b));                          \
+  type result = op(a, b);                                                 \
+  __asm__ __volatile__("" : "+x" (result));                               \
+  int flags = _mm_getcsr() & MXCSR_EXCEPTIONS;                            \
+  if ((flags & ~MXCSR_PE) != 0 || movemask(cmpunord(result, result)))     \
+    return -1;                                                            \
+  store((void *) r, result);                                              \
+  return flags;                                                           \
+}
+
+#define BX_HOST_PFP_LOAD_PS(ptr) _mm_loadu_ps((const float *)(ptr))
+#define BX_HOST_PFP_LOAD_PD(ptr) _mm_loadu_pd((const double *)(ptr))
+#define BX_HOST_PFP_STORE_PS(ptr, val) _mm_storeu_ps((float *)(ptr), (val))
+#define BX_HOST_PFP_STORE_PD(ptr, val) _mm_storeu_pd((double *)(ptr), (val))
+
+#define BX_HOST_PFP_METHOD_PS(name, op) \
+  BX_HOST_PFP_METHOD(name, __m128, BX_HOST_PFP_LOAD_PS, BX_HOST_PFP_STORE_PS, op, _mm_cmpunord_ps, _mm_movemask_ps)
+#define BX_HOST_PFP_METHOD_PD(name, op) \
+  BX_HOST_PFP_METHOD(name, __m128d, BX_HOST_PFP_LOAD_PD, BX_HOST_PFP_STORE_PD, op, _mm_cmpunord_pd, _mm_movemask_pd)
+
+#else
+
+#define BX_HOST_PFP_METHOD_STUB(name)                                     \
+BX_CPP_INLINE int host_##name(BxPackedXmmRegister *r,                     \
+      const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2,     \
+      bx_mxcsr_t mxcsr)                                                   \
+{                                                                         \
+  return -1;                                                              \
+}
+
+#define BX_HOST_PFP_METHOD_PS(name, op) BX_HOST_PFP_METHOD_STUB(name)
+#define BX_HOST_PFP_METHOD_PD(name, op) BX_HOST_PFP_METHOD_STUB(name)
+
+#endif
+
+BX_HOST_PFP_METHOD_PS(addps, _mm_add_ps)
+BX_HOST_PFP_METHOD_PD(addpd, _mm_add_pd)
+BX_HOST_PFP_METHOD_PS(subps, _mm_sub_ps)
+BX_HOST_PFP_METHOD_PD(subpd, _mm_sub_pd)
+BX_HOST_PFP_METHOD_PS(mulps, _mm_mul_ps)
+BX_HOST_PFP_METHOD_PD(mulpd, _mm_mul_pd)
+BX_HOST_PFP_METHOD_PS(divps, _mm_div_ps)
+BX_HOST_PFP_METHOD_PD(divpd, _mm_div_pd)
+
+#if BX_SUPPORT_AVX
+// all the 128-bit lanes are computed before op1 is modified
+BX_CPP_INLINE int host_pfp_avx(host_pfp_method_t method, BxPackedAvxRegister *op1, const BxPackedAvxRegister *op2, unsigned len, bx_mxcsr_t mxcsr)
+{
+  BxPackedAvxRegister result;
+  int flags = 0;
+
+  for (unsigned n=0; n < len; n++) {
+    int lane_flags = method(&result.avx128(n), &op1->avx128(n), &op2->avx128(n), mxcsr);
+    if (lane_flags < 0) return -1;
+    flags |= lane_flags;
+  }
+
+  for (unsigned n=0; n < len; n++)
+    op1->avx128(n) = result.avx128(n);
+
+  return flags;
+}
+#endif
+
 #endif
@@ -1002,10 +1002,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::ADDPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_addps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_addps(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_addps(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1023,10 +1027,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::ADDPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_addpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_addpd(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_addpd(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1084,10 +1092,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MULPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_mulps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_mulps(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_mulps(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1105,10 +1117,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MULPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_mulpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_mulpd(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_mulpd(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1166,10 +1182,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::SUBPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_subps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_subps(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_subps(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1187,10 +1207,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::SUBPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_subpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_subpd(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_subpd(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1330,10 +1354,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::DIVPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_divps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_divps(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_divps(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1351,10 +1379,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::DIVPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_divpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  int flags = host_divpd(&op1, &op1, &op2, MXCSR);
+  if (flags < 0) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_divpd(&op1, &op2, status);
+    flags = status.float_exception_flags;
+  }
+  check_exceptionsSSE(flags);
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -29,33 +29,95 @@
 //
 
 #if BX_SUPPORT_REPEAT_SPEEDUPS
+
+// Compute the linear address of seg:offset for a fast repeat string access
+// to the rest of the page. Returns 0 if the elements have to be accessed
+// one by one because of the segment checks.
+bx_bool BX_CPU_C::FastRepLinearAddr(unsigned seg, bx_address offset, unsigned rw, bx_address *laddr)
+{
+#if BX_SUPPORT_X86_64
+  if (BX_CPU_THIS_PTR cpu_mode == BX_MODE_LONG_64) {
+    *laddr = get_laddr64(seg, offset);
+    if (! IsCanonical(*laddr)) return 0;
+    // A 32-bit offset wraps at the end of its own page, which is the end
+    // of the linear page only if the segment base is page aligned
+    return PAGE_OFFSET(*laddr) == PAGE_OFFSET(offset);
+  }
+#endif
+
+  bx_segment_reg_t *segPtr = &BX_CPU_THIS_PTR sregs[seg];
+  if (!(segPtr->cache.valid & ((rw == BX_READ) ? SegAccessROK : SegAccessWOK)))
+    return 0;
+  if ((offset | 0xfff) > segPtr->cache.u.segment.limit_scaled)
+    return 0;
+
+  *laddr = get_laddr32(seg, (Bit32u) offset);
+  return 1;
+}
+
+// Copy count elements of the given size which start at the host addresses
+// of the current source and destination elements. The element by element
+// copy of REP MOVS gives the same result as memmove() unless the destination
+// overlaps source data which has not been read yet.
+static void FastRepCopy(Bit8u *hostAddrDst, Bit8u *hostAddrSrc, Bit32u count, unsigned size, bx_bool df)
+{
+  Bit32u bytes = count * size, n;
+
+  if (df) {
+    if (hostAddrDst < hostAddrSrc && (hostAddrDst + bytes) > hostAddrSrc) {
+      for (n = 0; n < bytes; n += size)
+        memmove(hostAddrDst - n, hostAddrSrc - n, size);
+      return;
+    }
+    // counting downward: move to the lowest element of the block
+    hostAddrDst -= bytes - size;
+    hostAddrSrc -= bytes - size;
+  }
+  else {
+    if (hostAddrDst > hostAddrSrc && (hostAddrSrc + bytes) > hostAddrDst) {
+      for (n = 0; n < bytes; n += size)
+        memmove(hostAddrDst + n, hostAddrSrc + n, size);
+      return;
+    }
+  }
+
+  memmove(hostAddrDst, hostAddrSrc, bytes);
+}
+
+// Fill count elements of the given size. The current element at
+// hostAddrDst already holds the value to store.
+static void FastRepFill(Bit8u *hostAddrDst, Bit32u count, unsigned size, bx_bool df)
+{
+  Bit32u bytes = count * size, done = size;
+
+  if (df) {
+    // counting downward: copy the value to the lowest element of the block
+    memcpy(hostAddrDst - (bytes - size), hostAddrDst, size);
+    hostAddrDst -= bytes - size;
+  }
+
+  // double the filled part of the block until it is complete
+  while (done < bytes) {
+    Bit32u len = (done < (bytes - done)) ? done : (bytes - done);
+    memcpy(hostAddrDst + done, hostAddrDst, len);
+    done += len;
+  }
+}
+
 Bit32u BX_CPU_C::FastRepMOVSB(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, unsigned dstSeg, bx_address dstOff, Bit32u count)
 {
   Bit32u bytesFitSrc, bytesFitDst;
-  signed int pointerDelta;
   bx_address laddrDst, laddrSrc;
   Bit8u *hostAddrSrc, *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
+  if (! FastRepLinearAddr(srcSeg, srcOff, BX_READ, &laddrSrc))
     return 0;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrSrc = get_laddr32(srcSeg, srcOff);
-
   hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
   if (! hostAddrSrc) return 0;
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
+    return 0;
 
   hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
   // Check that native host access was not vetoed for that page
@@ -66,13 +128,11 @@ Bit32u BX_CPU_C::FastRepMOVSB(bxInstruction_c *i, unsigned srcSeg, bx_address sr
     // Counting downward.
     bytesFitSrc = 1 + PAGE_OFFSET(laddrSrc);
     bytesFitDst = 1 + PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int) -1;
   }
   else {
     // Counting upward.
     bytesFitSrc = 0x1000 - PAGE_OFFSET(laddrSrc);
     bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int)  1;
   }
 
   // Restrict word count to the number that will fit in either
@@ -87,12 +147,7 @@ Bit32u BX_CPU_C::FastRepMOVSB(bxInstruction_c *i, unsigned srcSeg, bx_address sr
   // If after all the restrictions, there is anything left to do...
   if (count) {
     // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      * (Bit8u *) hostAddrDst = * (Bit8u *) hostAddrSrc;
-      hostAddrDst += pointerDelta;
-      hostAddrSrc += pointerDelta;
-    }
-
+    FastRepCopy(hostAddrDst, hostAddrSrc, count, 1, BX_CPU_THIS_PTR get_DF());
     return count;
   }
 
@@ -102,30 +157,17 @@ Bit32u BX_CPU_C::FastRepMOVSB(bxInstruction_c *i, unsigned srcSeg, bx_address sr
 Bit32u BX_CPU_C::FastRepMOVSW(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, unsigned dstSeg, bx_address dstOff, Bit32u count)
 {
   Bit32u wordsFitSrc, wordsFitDst;
-  signed int pointerDelta;
   bx_address laddrDst, laddrSrc;
   Bit8u *hostAddrSrc, *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
+  if (! FastRepLinearAddr(srcSeg, srcOff, BX_READ, &laddrSrc))
     return 0;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrSrc = get_laddr32(srcSeg, srcOff);
-
   hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
   if (! hostAddrSrc) return 0;
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
+    return 0;
 
   hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
   // Check that native host access was not vetoed for that page
@@ -139,13 +181,11 @@ Bit32u BX_CPU_C::FastRepMOVSW(bxInstruction_c *i, unsigned srcSeg, bx_address sr
        return 0;
     wordsFitSrc = (2 + PAGE_OFFSET(laddrSrc)) >> 1;
     wordsFitDst = (2 + PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int) -2;
   }
   else {
     // Counting upward.
     wordsFitSrc = (0x1000 - PAGE_OFFSET(laddrSrc)) >> 1;
     wordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int)  2;
   }
 
   // Restrict word count to the number that will fit in either
@@ -160,12 +200,7 @@ Bit32u BX_CPU_C::FastRepMOVSW(bxInstruction_c *i, unsigned srcSeg, bx_address sr
   // If after all the restrictions, there is anything left to do...
   if (count) {
     // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      CopyHostWordLittleEndian(hostAddrDst, hostAddrSrc);
-      hostAddrDst += pointerDelta;
-      hostAddrSrc += pointerDelta;
-    }
-
+    FastRepCopy(hostAddrDst, hostAddrSrc, count, 2, BX_CPU_THIS_PTR get_DF());
     return count;
   }
 
@@ -175,30 +210,17 @@ Bit32u BX_CPU_C::FastRepMOVSW(bxInstruction_c *i, unsigned srcSeg, bx_address sr
 Bit32u BX_CPU_C::FastRepMOVSD(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, unsigned dstSeg, bx_address dstOff, Bit32u count)
 {
   Bit32u dwordsFitSrc, dwordsFitDst;
-  signed int pointerDelta;
   bx_address laddrDst, laddrSrc;
   Bit8u *hostAddrSrc, *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
+  if (! FastRepLinearAddr(srcSeg, srcOff, BX_READ, &laddrSrc))
     return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrSrc = get_laddr32(srcSeg, srcOff);
 
   hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
   if (! hostAddrSrc) return 0;
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
+    return 0;
 
   hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
   // Check that native host access was not vetoed for that page
@@ -212,13 +234,11 @@ Bit32u BX_CPU_C::FastRepMOVSD(bxInstruction_c *i, unsigned srcSeg, bx_address sr
       return 0;
     dwordsFitSrc = (4 + PAGE_OFFSET(laddrSrc)) >> 2;
     dwordsFitDst = (4 + PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int) -4;
   }
   else {
     // Counting upward.
     dwordsFitSrc = (0x1000 - PAGE_OFFSET(laddrSrc)) >> 2;
     dwordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int)  4;
   }
 
   // Restrict dword count to the number that will fit in either
@@ -233,34 +253,76 @@ Bit32u BX_CPU_C::FastRepMOVSD(bxInstruction_c *i, unsigned srcSeg, bx_address sr
   // If after all the restrictions, there is anything left to do...
   if (count) {
     // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      CopyHostDWordLittleEndian(hostAddrDst, hostAddrSrc);
-      hostAddrDst += pointerDelta;
-      hostAddrSrc += pointerDelta;
-    }
+    FastRepCopy(hostAddrDst, hostAddrSrc, count, 4, BX_CPU_THIS_PTR get_DF());
+    return count;
+  }
+
+  return 0;
+}
+
+#if BX_SUPPORT_X86_64
+Bit32u BX_CPU_C::FastRepMOVSQ(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, unsigned dstSeg, bx_address dstOff, Bit32u count)
+{
+  Bit32u qwordsFitSrc, qwordsFitDst;
+  bx_address laddrDst, laddrSrc;
+  Bit8u *hostAddrSrc, *hostAddrDst;
+
+  if (! FastRepLinearAddr(srcSeg, srcOff, BX_READ, &laddrSrc))
+    return 0;
+
+  hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
+  if (! hostAddrSrc) return 0;
 
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
+    return 0;
+
+  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
+  // Check that native host access was not vetoed for that page
+  if (!hostAddrDst) return 0;
+
+  // See how many qwords can fit in the rest of this page.
+  if (BX_CPU_THIS_PTR get_DF()) {
+    // Counting downward.
+    // Note: 1st qword must not cross page boundary.
+    if (((laddrSrc & 0xfff) > 0xff8) || ((laddrDst & 0xfff) > 0xff8))
+      return 0;
+    qwordsFitSrc = (8 + PAGE_OFFSET(laddrSrc)) >> 3;
+    qwordsFitDst = (8 + PAGE_OFFSET(laddrDst)) >> 3;
+  }
+  else {
+    // Counting upward.
+    qwordsFitSrc = (0x1000 - PAGE_OFFSET(laddrSrc)) >> 3;
+    qwordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 3;
+  }
+
+  // Restrict qword count to the number that will fit in either
+  // source or dest pages.
+  if (count > qwordsFitSrc)
+    count = qwordsFitSrc;
+  if (count > qwordsFitDst)
+    count = qwordsFitDst;
+  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
+    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
+
+  // If after all the restrictions, there is anything left to do...
+  if (count) {
+    // Transfer data directly using host addresses
+    FastRepCopy(hostAddrDst, hostAddrSrc, count, 8, BX_CPU_THIS_PTR get_DF());
     return count;
   }
 
   return 0;
 }
+#endif
 
 Bit32u BX_CPU_C::FastRepSTOSB(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff, Bit8u val, Bit32u count)
 {
   Bit32u bytesFitDst;
-  signed int pointerDelta;
   bx_address laddrDst;
   Bit8u *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
     return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrDst = get_laddr32(dstSeg, dstOff);
 
   hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
   // Check that native host access was not vetoed for that page
@@ -270,12 +332,10 @@ Bit32u BX_CPU_C::FastRepSTOSB(bxInstruction_c *i, unsigned dstSeg, bx_address ds
   if (BX_CPU_THIS_PTR get_DF()) {
     // Counting downward.
     bytesFitDst = 1 + PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int) -1;
   }
   else {
     // Counting upward.
     bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int)  1;
   }
 
   // Restrict word count to the number that will fit in either
@@ -288,11 +348,9 @@ Bit32u BX_CPU_C::FastRepSTOSB(bxInstruction_c *i, unsigned dstSeg, bx_address ds
   // If after all the restrictions, there is anything left to do...
   if (count) {
     // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      * (Bit8u *) hostAddrDst = val;
-      hostAddrDst += pointerDelta;
-    }
-
+    if (BX_CPU_THIS_PTR get_DF())
+      hostAddrDst -= count - 1;
+    memset(hostAddrDst, val, count);
     return count;
   }
 
@@ -302,20 +360,12 @@ Bit32u BX_CPU_C::FastRepSTOSB(bxInstruction_c *i, unsigned dstSeg, bx_address ds
 Bit32u BX_CPU_C::FastRepSTOSW(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff, Bit16u val, Bit32u count)
 {
   Bit32u wordsFitDst;
-  signed int pointerDelta;
   bx_address laddrDst;
   Bit8u *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
     return 0;
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
-
   hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
   // Check that native host access was not vetoed for that page
   if (!hostAddrDst) return 0;
@@ -326,12 +376,10 @@ Bit32u BX_CPU_C::FastRepSTOSW(bxInstruction_c *i, unsigned dstSeg, bx_address ds
     // Note: 1st word must not cross page boundary.
     if ((laddrDst & 0xfff) > 0xffe) return 0;
     wordsFitDst = (2 + PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int) -2;
   }
   else {
     // Counting upward.
     wordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int)  2;
   }
 
   // Restrict word count to the number that will fit in either
@@ -344,11 +392,8 @@ Bit32u BX_CPU_C::FastRepSTOSW(bxInstruction_c *i, unsigned dstSeg, bx_address ds
   // If after all the restrictions, there is anything left to do...
   if (count) {
     // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      WriteHostWordToLittleEndian(hostAddrDst, val);
-      hostAddrDst += pointerDelta;
-    }
-
+    WriteHostWordToLittleEndian(hostAddrDst, val);
+    FastRepFill(hostAddrDst, count, 2, BX_CPU_THIS_PTR get_DF());
     return count;
   }
 
@@ -358,19 +403,11 @@ Bit32u BX_CPU_C::FastRepSTOSW(bxInstruction_c *i, unsigned dstSeg, bx_address ds
 Bit32u BX_CPU_C::FastRepSTOSD(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff, Bit32u val, Bit32u count)
 {
   Bit32u dwordsFitDst;
-  signed int pointerDelta;
   bx_address laddrDst;
   Bit8u *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
     return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrDst = get_laddr32(dstSeg, dstOff);
 
   hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
   // Check that native host access was not vetoed for that page
@@ -382,12 +419,10 @@ Bit32u BX_CPU_C::FastRepSTOSD(bxInstruction_c *i, unsigned dstSeg, bx_address ds
     // Note: 1st dword must not cross page boundary.
     if ((laddrDst & 0xfff) > 0xffc) return 0;
     dwordsFitDst = (4 + PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int) -4;
   }
   else {
     // Counting upward.
     dwordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int)  4;
   }
 
   // Restrict dword count to the number that will fit in either
@@ -400,11 +435,52 @@ Bit32u BX_CPU_C::FastRepSTOSD(bxInstruction_c *i, unsigned dstSeg, bx_address ds
   // If after all the restrictions, there is anything left to do...
   if (count) {
     // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      WriteHostDWordToLittleEndian(hostAddrDst, val);
-      hostAddrDst += pointerDelta;
-    }
+    WriteHostDWordToLittleEndian(hostAddrDst, val);
+    FastRepFill(hostAddrDst, count, 4, BX_CPU_THIS_PTR get_DF());
+    return count;
+  }
 
+  return 0;
+}
+
+#if BX_SUPPORT_X86_64
+Bit32u BX_CPU_C::FastRepSTOSQ(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff, Bit64u val, Bit32u count)
+{
+  Bit32u qwordsFitDst;
+  bx_address laddrDst;
+  Bit8u *hostAddrDst;
+
+  if (! FastRepLinearAddr(dstSeg, dstOff, BX_WRITE, &laddrDst))
+    return 0;
+
+  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
+  // Check that native host access was not vetoed for that page
+  if (!hostAddrDst) return 0;
+
+  // See how many qwords can fit in the rest of this page.
+  if (BX_CPU_THIS_PTR get_DF()) {
+    // Counting downward.
+    // Note: 1st qword must not cross page boundary.
+    if ((laddrDst & 0xfff) > 0xff8) return 0;
+    qwordsFitDst = (8 + PAGE_OFFSET(laddrDst)) >> 3;
+  }
+  else {
+    // Counting upward.
+    qwordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 3;
+  }
+
+  // Restrict qword count to the number that will fit in either
+  // source or dest pages.
+  if (count > qwordsFitDst)
+    count = qwordsFitDst;
+  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
+    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
+
+  // If after all the restrictions, there is anything left to do...
+  if (count) {
+    // Transfer data directly using host addresses
+    WriteHostQWordToLittleEndian(hostAddrDst, val);
+    FastRepFill(hostAddrDst, count, 8, BX_CPU_THIS_PTR get_DF());
     return count;
   }
 
@@ -412,6 +488,8 @@ Bit32u BX_CPU_C::FastRepSTOSD(bxInstruction_c *i, unsigned dstSeg, bx_address ds
 }
 #endif
 
+#endif
+
 //
 // REP MOVS methods
 //
@@ -565,21 +643,50 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB64_XbYb(bxInstruction_c *i)
 {
   Bit8u temp8;
 
+  Bit64u incr = 1;
+
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
 
-  temp8 = read_virtual_byte_64(i->seg(), rsi);
-  write_virtual_byte_64(BX_SEG_REG_ES, rdi, temp8);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u byteCount = FastRepMOVSB(i, i->seg(), rsi, BX_SEG_REG_ES, rdi, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (byteCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(byteCount-1);
+
+      // Decrement RCX. Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (byteCount-1);
+
+      incr = byteCount;
+    }
+    else {
+      temp8 = read_virtual_byte_64(i->seg(), rsi);
+      write_virtual_byte_64(BX_SEG_REG_ES, rdi, temp8);
+    }
+  }
+  else
+#endif
+  {
+    temp8 = read_virtual_byte_64(i->seg(), rsi);
+    write_virtual_byte_64(BX_SEG_REG_ES, rdi, temp8);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    /* decrement RSI, RDI */
-    rsi--;
-    rdi--;
+    rsi -= incr;
+    rdi -= incr;
   }
   else {
-    /* increment RSI, RDI */
-    rsi++;
-    rdi++;
+    rsi += incr;
+    rdi += incr;
   }
 
   RSI = rsi;
@@ -616,19 +723,50 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW32_XwYw(bxInstruction_c *i)
 {
   Bit16u temp16;
 
+  Bit32u incr = 2;
+
   Bit32u esi = ESI;
   Bit32u edi = EDI;
 
-  temp16 = read_virtual_word(i->seg(), esi);
-  write_virtual_word(BX_SEG_REG_ES, edi, temp16);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u wordCount = FastRepMOVSW(i, i->seg(), esi, BX_SEG_REG_ES, edi, ECX);
+    if (wordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(wordCount-1);
+
+      // Decrement ECX. Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX = ECX - (wordCount-1);
+
+      incr = wordCount << 1; // count * 2
+    }
+    else {
+      temp16 = read_virtual_word(i->seg(), esi);
+      write_virtual_word(BX_SEG_REG_ES, edi, temp16);
+    }
+  }
+  else
+#endif
+  {
+    temp16 = read_virtual_word(i->seg(), esi);
+    write_virtual_word(BX_SEG_REG_ES, edi, temp16);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    esi -= 2;
-    edi -= 2;
+    esi -= incr;
+    edi -= incr;
   }
   else {
-    esi += 2;
-    edi += 2;
+    esi += incr;
+    edi += incr;
   }
 
   // zero extension of RSI/RDI
@@ -642,19 +780,50 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW64_XwYw(bxInstruction_c *i)
 {
   Bit16u temp16;
 
+  Bit64u incr = 2;
+
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
 
-  temp16 = read_virtual_word_64(i->seg(), rsi);
-  write_virtual_word_64(BX_SEG_REG_ES, rdi, temp16);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u wordCount = FastRepMOVSW(i, i->seg(), rsi, BX_SEG_REG_ES, rdi, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (wordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(wordCount-1);
+
+      // Decrement RCX. Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (wordCount-1);
+
+      incr = wordCount << 1; // count * 2
+    }
+    else {
+      temp16 = read_virtual_word_64(i->seg(), rsi);
+      write_virtual_word_64(BX_SEG_REG_ES, rdi, temp16);
+    }
+  }
+  else
+#endif
+  {
+    temp16 = read_virtual_word_64(i->seg(), rsi);
+    write_virtual_word_64(BX_SEG_REG_ES, rdi, temp16);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    rsi -= 2;
-    rdi -= 2;
+    rsi -= incr;
+    rdi -= incr;
   }
   else {
-    rsi += 2;
-    rdi += 2;
+    rsi += incr;
+    rdi += incr;
   }
 
   RSI = rsi;
@@ -749,19 +918,50 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD64_XdYd(bxInstruction_c *i)
 {
   Bit32u temp32;
 
+  Bit64u incr = 4;
+
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
 
-  temp32 = read_virtual_dword_64(i->seg(), rsi);
-  write_virtual_dword_64(BX_SEG_REG_ES, rdi, temp32);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u dwordCount = FastRepMOVSD(i, i->seg(), rsi, BX_SEG_REG_ES, rdi, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (dwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(dwordCount-1);
+
+      // Decrement RCX. Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (dwordCount-1);
+
+      incr = dwordCount << 2; // count * 4
+    }
+    else {
+      temp32 = read_virtual_dword_64(i->seg(), rsi);
+      write_virtual_dword_64(BX_SEG_REG_ES, rdi, temp32);
+    }
+  }
+  else
+#endif
+  {
+    temp32 = read_virtual_dword_64(i->seg(), rsi);
+    write_virtual_dword_64(BX_SEG_REG_ES, rdi, temp32);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    rsi -= 4;
-    rdi -= 4;
+    rsi -= incr;
+    rdi -= incr;
   }
   else {
-    rsi += 4;
-    rdi += 4;
+    rsi += incr;
+    rdi += incr;
   }
 
   RSI = rsi;
@@ -773,19 +973,50 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ32_XqYq(bxInstruction_c *i)
 {
   Bit64u temp64;
 
+  Bit32u incr = 8;
+
   Bit32u esi = ESI;
   Bit32u edi = EDI;
 
-  temp64 = read_virtual_qword_64(i->seg(), esi);
-  write_virtual_qword_64(BX_SEG_REG_ES, edi, temp64);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u qwordCount = FastRepMOVSQ(i, i->seg(), esi, BX_SEG_REG_ES, edi, ECX);
+    if (qwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(qwordCount-1);
+
+      // Decrement ECX. Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX = ECX - (qwordCount-1);
+
+      incr = qwordCount << 3; // count * 8
+    }
+    else {
+      temp64 = read_virtual_qword_64(i->seg(), esi);
+      write_virtual_qword_64(BX_SEG_REG_ES, edi, temp64);
+    }
+  }
+  else
+#endif
+  {
+    temp64 = read_virtual_qword_64(i->seg(), esi);
+    write_virtual_qword_64(BX_SEG_REG_ES, edi, temp64);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    esi -= 8;
-    edi -= 8;
+    esi -= incr;
+    edi -= incr;
   }
   else {
-    esi += 8;
-    edi += 8;
+    esi += incr;
+    edi += incr;
   }
 
   // zero extension of RSI/RDI
@@ -798,19 +1029,50 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ64_XqYq(bxInstruction_c *i)
 {
   Bit64u temp64;
 
+  Bit64u incr = 8;
+
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
 
-  temp64 = read_virtual_qword_64(i->seg(), rsi);
-  write_virtual_qword_64(BX_SEG_REG_ES, rdi, temp64);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u qwordCount = FastRepMOVSQ(i, i->seg(), rsi, BX_SEG_REG_ES, rdi, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (qwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(qwordCount-1);
+
+      // Decrement RCX. Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (qwordCount-1);
+
+      incr = qwordCount << 3; // count * 8
+    }
+    else {
+      temp64 = read_virtual_qword_64(i->seg(), rsi);
+      write_virtual_qword_64(BX_SEG_REG_ES, rdi, temp64);
+    }
+  }
+  else
+#endif
+  {
+    temp64 = read_virtual_qword_64(i->seg(), rsi);
+    write_virtual_qword_64(BX_SEG_REG_ES, rdi, temp64);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    rsi -= 8;
-    rdi -= 8;
+    rsi -= incr;
+    rdi -= incr;
   }
   else {
-    rsi += 8;
-    rdi += 8;
+    rsi += incr;
+    rdi += incr;
   }
 
   RSI = rsi;
@@ -1708,15 +1970,44 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB32_YbAL(bxInstruction_c *i)
 // 64 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB64_YbAL(bxInstruction_c *i)
 {
+  Bit64u incr = 1;
   Bit64u rdi = RDI;
 
-  write_virtual_byte_64(BX_SEG_REG_ES, rdi, AL);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u byteCount = FastRepSTOSB(i, BX_SEG_REG_ES, rdi, AL, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (byteCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(byteCount-1);
+
+      // Decrement RCX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (byteCount-1);
+
+      incr = byteCount;
+    }
+    else {
+      write_virtual_byte_64(BX_SEG_REG_ES, rdi, AL);
+    }
+  }
+  else
+#endif
+  {
+    write_virtual_byte_64(BX_SEG_REG_ES, rdi, AL);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    rdi--;
+    rdi -= incr;
   }
   else {
-    rdi++;
+    rdi += incr;
   }
 
   RDI = rdi;
@@ -1743,15 +2034,44 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW16_YwAX(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW32_YwAX(bxInstruction_c *i)
 {
+  Bit32u incr = 2;
   Bit32u edi = EDI;
 
-  write_virtual_word(BX_SEG_REG_ES, edi, AX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u wordCount = FastRepSTOSW(i, BX_SEG_REG_ES, edi, AX, ECX);
+    if (wordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(wordCount-1);
+
+      // Decrement ECX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX = ECX - (wordCount-1);
+
+      incr = wordCount << 1; // count * 2
+    }
+    else {
+      write_virtual_word(BX_SEG_REG_ES, edi, AX);
+    }
+  }
+  else
+#endif
+  {
+    write_virtual_word(BX_SEG_REG_ES, edi, AX);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    edi -= 2;
+    edi -= incr;
   }
   else {
-    edi += 2;
+    edi += incr;
   }
 
   // zero extension of RDI
@@ -1762,15 +2082,44 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW32_YwAX(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW64_YwAX(bxInstruction_c *i)
 {
+  Bit64u incr = 2;
   Bit64u rdi = RDI;
 
-  write_virtual_word_64(BX_SEG_REG_ES, rdi, AX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u wordCount = FastRepSTOSW(i, BX_SEG_REG_ES, rdi, AX, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (wordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(wordCount-1);
+
+      // Decrement RCX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (wordCount-1);
+
+      incr = wordCount << 1; // count * 2
+    }
+    else {
+      write_virtual_word_64(BX_SEG_REG_ES, rdi, AX);
+    }
+  }
+  else
+#endif
+  {
+    write_virtual_word_64(BX_SEG_REG_ES, rdi, AX);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    rdi -= 2;
+    rdi -= incr;
   }
   else {
-    rdi += 2;
+    rdi += incr;
   }
 
   RDI = rdi;
@@ -1797,15 +2146,44 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD16_YdEAX(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD32_YdEAX(bxInstruction_c *i)
 {
+  Bit32u incr = 4;
   Bit32u edi = EDI;
 
-  write_virtual_dword(BX_SEG_REG_ES, edi, EAX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u dwordCount = FastRepSTOSD(i, BX_SEG_REG_ES, edi, EAX, ECX);
+    if (dwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(dwordCount-1);
+
+      // Decrement ECX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX = ECX - (dwordCount-1);
+
+      incr = dwordCount << 2; // count * 4
+    }
+    else {
+      write_virtual_dword(BX_SEG_REG_ES, edi, EAX);
+    }
+  }
+  else
+#endif
+  {
+    write_virtual_dword(BX_SEG_REG_ES, edi, EAX);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    edi -= 4;
+    edi -= incr;
   }
   else {
-    edi += 4;
+    edi += incr;
   }
 
   // zero extension of RDI
@@ -1817,15 +2195,44 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD32_YdEAX(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD64_YdEAX(bxInstruction_c *i)
 {
+  Bit64u incr = 4;
   Bit64u rdi = RDI;
 
-  write_virtual_dword_64(BX_SEG_REG_ES, rdi, EAX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u dwordCount = FastRepSTOSD(i, BX_SEG_REG_ES, rdi, EAX, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (dwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(dwordCount-1);
+
+      // Decrement RCX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (dwordCount-1);
+
+      incr = dwordCount << 2; // count * 4
+    }
+    else {
+      write_virtual_dword_64(BX_SEG_REG_ES, rdi, EAX);
+    }
+  }
+  else
+#endif
+  {
+    write_virtual_dword_64(BX_SEG_REG_ES, rdi, EAX);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    rdi -= 4;
+    rdi -= incr;
   }
   else {
-    rdi += 4;
+    rdi += incr;
   }
 
   RDI = rdi;
@@ -1834,15 +2241,44 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD64_YdEAX(bxInstruction_c *i)
 /* 64 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ32_YqRAX(bxInstruction_c *i)
 {
+  Bit32u incr = 8;
   Bit32u edi = EDI;
 
-  write_virtual_qword_64(BX_SEG_REG_ES, edi, RAX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u qwordCount = FastRepSTOSQ(i, BX_SEG_REG_ES, edi, RAX, ECX);
+    if (qwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(qwordCount-1);
+
+      // Decrement ECX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX = ECX - (qwordCount-1);
+
+      incr = qwordCount << 3; // count * 8
+    }
+    else {
+      write_virtual_qword_64(BX_SEG_REG_ES, edi, RAX);
+    }
+  }
+  else
+#endif
+  {
+    write_virtual_qword_64(BX_SEG_REG_ES, edi, RAX);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    edi -= 8;
+    edi -= incr;
   }
   else {
-    edi += 8;
+    edi += incr;
   }
 
   // zero extension of RDI
@@ -1852,15 +2288,44 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ32_YqRAX(bxInstruction_c *i)
 /* 64 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ64_YqRAX(bxInstruction_c *i)
 {
+  Bit64u incr = 8;
   Bit64u rdi = RDI;
 
-  write_virtual_qword_64(BX_SEG_REG_ES, rdi, RAX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u qwordCount = FastRepSTOSQ(i, BX_SEG_REG_ES, rdi, RAX, (RCX > 0x1000) ? 0x1000 : (Bit32u) RCX);
+    if (qwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.  Also,
+      // the count is predecremented before examined, so defintely
+      // don't roll it under zero.
+      BX_TICKN(qwordCount-1);
+
+      // Decrement RCX.  Note, the main loop will decrement 1 also, so
+      // decrement by one less than expected, like the case above.
+      RCX -= (qwordCount-1);
+
+      incr = qwordCount << 3; // count * 8
+    }
+    else {
+      write_virtual_qword_64(BX_SEG_REG_ES, rdi, RAX);
+    }
+  }
+  else
+#endif
+  {
+    write_virtual_qword_64(BX_SEG_REG_ES, rdi, RAX);
+  }
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    rdi -= 8;
+    rdi -= incr;
   }
   else {
-    rdi += 8;
+    rdi += incr;
   }
 
   RDI = rdi;
@@ -255,7 +255,9 @@ void BX_CPU_C::SvmExitLoadHostState(SVM_HOST_STATE *host)
 
   CPL = 0;
 
-  handleCpuContextChange();
+  handleCpuContextChange(1);
+
+  TLB_switch_context(1);
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_CPU_THIS_PTR monitor.reset_monitor();
@@ -335,12 +337,14 @@ bx_bool BX_CPU_C::SvmEnterLoadCheckControls(SVM_CONTROLS *ctrls)
     return 0;
   }
 
-  Bit32u guest_asid = vmcb_read32(SVM_CONTROL32_GUEST_ASID);
-  if (guest_asid == 0) {
+  ctrls->guest_asid = vmcb_read32(SVM_CONTROL32_GUEST_ASID);
+  if (ctrls->guest_asid == 0) {
     BX_ERROR(("VMRUN: attempt to run guest with host ASID !"));
     return 0;
   }
 
+  ctrls->tlb_control = vmcb_read8(SVM_CONTROL32_TLB_CONTROL);
+
   ctrls->v_tpr = vmcb_read8(SVM_CONTROL_VTPR);
   ctrls->v_intr_masking = vmcb_read8(SVM_CONTROL_VINTR_MASKING) & 0x1;
   ctrls->v_intr_vector = vmcb_read8(SVM_CONTROL_VINTR_VECTOR);
@@ -564,7 +568,7 @@ bx_bool BX_CPU_C::SvmEnterLoadCheckGuestState(void)
   if (v_irq)
     signal_event(BX_EVENT_SVM_VIRQ_PENDING);
 
-  handleCpuContextChange();
+  handleCpuContextChange(1);
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_CPU_THIS_PTR monitor.reset_monitor();
@@ -995,6 +999,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMRUN(bxInstruction_c *i)
   BX_CPU_THIS_PTR svm_gif = 1;
   BX_CPU_THIS_PTR async_event = 1;
 
+  TLB_switch_context(1);
+  if (BX_CPU_THIS_PTR vmcb.ctrls.tlb_control)
+    TLB_flush();
+
   //
   // Step 4: Inject events to the guest
   //
@@ -1237,6 +1245,8 @@ void BX_CPU_C::register_svm_state(bx_param_c *parent)
   BXRS_HEX_PARAM_FIELD(vmcb_ctrls, v_intr_vector, BX_CPU_THIS_PTR vmcb.ctrls.v_intr_vector);
   BXRS_PARAM_BOOL(vmcb_ctrls, nested_paging, BX_CPU_THIS_PTR vmcb.ctrls.nested_paging);
   BXRS_HEX_PARAM_FIELD(vmcb_ctrls, ncr3, BX_CPU_THIS_PTR vmcb.ctrls.ncr3);
+  BXRS_HEX_PARAM_FIELD(vmcb_ctrls, guest_asid, BX_CPU_THIS_PTR vmcb.ctrls.guest_asid);
+  BXRS_HEX_PARAM_FIELD(vmcb_ctrls, tlb_control, BX_CPU_THIS_PTR vmcb.ctrls.tlb_control);
 
   //
   // VMCB Host State
@@ -309,6 +309,9 @@ typedef struct bx_SVM_CONTROLS
   bx_bool nested_paging;
   Bit64u ncr3;
 
+  Bit32u guest_asid;
+  Bit8u tlb_control;
+
   Bit16u pause_filter_count;
 //Bit16u pause_filter_threshold;
 
@@ -0,0 +1,300 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//   Copyright (c) 2013 The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#define NEED_CPU_REG_SHORTCUTS 1
+#include "bochs.h"
+#include "cpu.h"
+#include "tracecache.h"
+
+bxTraceCacheStore_c traceCacheStore;
+
+#define BX_TRACE_CACHE_MAGIC "BXTRACE1"
+
+struct bxTraceCacheHeader_t {
+  char   magic[8];
+  Bit32u instrSize;     // sizeof(bxInstruction_c)
+  Bit32u signature;
+  Bit32u size;          // size of the records following the header
+  Bit32u reserved;
+};
+
+// Handler pointers are saved as offsets from this function, which is
+// never used as a handler itself, so NULL pointers stay distinguishable.
+static void bx_trace_cache_anchor(void) {}
+
+BX_CPP_INLINE static Bit32u record_size(Bit32u tlen, Bit32u nbytes)
+{
+  return (sizeof(bxTraceRecord_t) + tlen * sizeof(bxInstruction_c) + nbytes + 7) & ~7;
+}
+
+BX_CPP_INLINE static void relocate_handler(void *handler, bx_ptr_equiv_t delta)
+{
+  bx_ptr_equiv_t addr = bx_handler_address(handler);
+  if (addr) {
+    addr += delta;
+    memcpy(handler, &addr, sizeof(addr));
+  }
+}
+
+void bxTraceCacheStore_c::relocate(bxInstruction_c *i, unsigned tlen, bx_bool to_file)
+{
+  bx_ptr_equiv_t anchor = (bx_ptr_equiv_t) &bx_trace_cache_anchor;
+  bx_ptr_equiv_t delta = to_file ? (0 - anchor) : anchor;
+
+  for (unsigned n=0; n < tlen; n++, i++) {
+    relocate_handler(&i->execute1, delta);
+    relocate_handler(&i->handlers, delta);
+    relocate_handler(&i->ResolveModrm, delta);
+  }
+}
+
+Bit32u bxTraceCacheStore_c::compute_signature(Bit64u features)
+{
+  // the decoded instructions also depend on a few handlers assigned
+  // outside of the opcode table
+  BxExecutePtr_tR handlers[2] = { &BX_CPU_C::MOV32S_GdEdM, &BX_CPU_C::MOV32S_EdGdM };
+  BxResolvePtr_tR resolve = &BX_CPU_C::BxResolve32Base;
+  bx_ptr_equiv_t anchor = (bx_ptr_equiv_t) &bx_trace_cache_anchor;
+
+  Bit32u sig = get_bx_opcode_table_hash();
+  sig = sig * 31 + (Bit32u)(bx_handler_address(&handlers[0]) - anchor);
+  sig = sig * 31 + (Bit32u)(bx_handler_address(&handlers[1]) - anchor);
+  sig = sig * 31 + (Bit32u)(bx_handler_address(&resolve) - anchor);
+  sig = sig * 31 + BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS;
+  sig = sig * 31 + (Bit32u) features;
+  sig = sig * 31 + (Bit32u)(features >> 32);
+  return sig;
+}
+
+bxTraceRecord_t *bxTraceCacheStore_c::alloc_record(Bit32u tlen, Bit32u nbytes)
+{
+  Bit32u len = record_size(tlen, nbytes);
+
+  if ((used + len) > size) {
+    if ((used + len) > BX_TRACE_CACHE_MAX_SIZE) return NULL;
+    Bit32u new_size = size ? size * 2 : (1024*1024);
+    while (new_size < used + len) new_size *= 2;
+    if (new_size > BX_TRACE_CACHE_MAX_SIZE) new_size = BX_TRACE_CACHE_MAX_SIZE;
+    Bit8u *new_data = (Bit8u *) realloc(data, new_size);
+    if (! new_data) return NULL;
+    data = new_data;
+    size = new_size;
+  }
+
+  bxTraceRecord_t *rec = (bxTraceRecord_t *)(data + used);
+  used += len;
+  return rec;
+}
+
+void bxTraceCacheStore_c::link_record(bxTraceRecord_t *rec)
+{
+  Bit32u index = rec->keyHash & (BX_TRACE_CACHE_BUCKETS-1);
+  rec->next = bucket[index];
+  bucket[index] = (Bit32u)((Bit8u *) rec - data) + 1;
+}
+
+int bxTraceCacheStore_c::load(const char *filename, Bit64u features)
+{
+  cleanup();
+
+  if (filename == NULL || *filename == 0) return 0;
+
+  path = strdup(filename);
+  bucket = new Bit32u[BX_TRACE_CACHE_BUCKETS];
+  memset(bucket, 0, sizeof(Bit32u) * BX_TRACE_CACHE_BUCKETS);
+  signature = compute_signature(features);
+
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) return 0; // will be created at exit
+
+  bxTraceCacheHeader_t header;
+  int ret = -1;
+  if (fread(&header, sizeof(header), 1, fp) == 1 &&
+      memcmp(header.magic, BX_TRACE_CACHE_MAGIC, 8) == 0 &&
+      header.instrSize == sizeof(bxInstruction_c) &&
+      header.signature == signature &&
+      header.size <= BX_TRACE_CACHE_MAX_SIZE)
+  {
+    data = (Bit8u *) malloc(header.size ? header.size : 1);
+    if (data && fread(data, 1, header.size, fp) == header.size) {
+      size = header.size;
+      ret = 0;
+      // validate the records before linking them in
+      while (used + sizeof(bxTraceRecord_t) <= size) {
+        bxTraceRecord_t *rec = (bxTraceRecord_t *)(data + used);
+        Bit32u len = record_size(rec->tlen, rec->nbytes);
+        if (rec->tlen == 0 || rec->tlen > BX_MAX_TRACE_LENGTH || rec->nbytes < BX_TRACE_CACHE_KEY_LEN ||
+            (used + len) > size)
+        {
+          ret = -1;
+          break;
+        }
+        relocate(rec->instr(), rec->tlen, 0);
+        link_record(rec);
+        used += len;
+        stats.loaded++;
+      }
+    }
+  }
+  fclose(fp);
+
+  if (ret < 0) {
+    // stale or damaged file, start over and overwrite it at exit
+    free(data);
+    data = NULL;
+    used = size = 0;
+    memset(bucket, 0, sizeof(Bit32u) * BX_TRACE_CACHE_BUCKETS);
+    stats.loaded = 0;
+    dirty = 1;
+  }
+
+  return ret;
+}
+
+bx_bool bxTraceCacheStore_c::save(void)
+{
+  if (! enabled() || ! dirty) return 1;
+
+  // write a temporary file first, concurrent runs sharing the file always
+  // see a complete one
+  size_t plen = strlen(path);
+  char *tmpname = new char[plen + 8];
+  sprintf(tmpname, "%s.XXXXXX", path);
+  int fd = mkstemp(tmpname);
+  if (fd < 0) {
+    delete [] tmpname;
+    return 0;
+  }
+  FILE *fp = fdopen(fd, "wb");
+
+  bxTraceCacheHeader_t header;
+  memcpy(header.magic, BX_TRACE_CACHE_MAGIC, 8);
+  header.instrSize = sizeof(bxInstruction_c);
+  header.signature = signature;
+  header.size = used;
+  header.reserved = 0;
+
+  bx_bool ok = (fp != NULL) && fwrite(&header, sizeof(header), 1, fp) == 1;
+
+  // the handler pointers are converted in place and back again
+  for (Bit32u offset = 0; offset < used; ) {
+    bxTraceRecord_t *rec = (bxTraceRecord_t *)(data + offset);
+    Bit32u len = record_size(rec->tlen, rec->nbytes);
+    relocate(rec->instr(), rec->tlen, 1);
+    if (ok && fwrite(rec, len, 1, fp) != 1) ok = 0;
+    relocate(rec->instr(), rec->tlen, 0);
+    offset += len;
+  }
+
+  if (fp != NULL) {
+    if (fclose(fp) != 0) ok = 0;
+  }
+  else {
+    close(fd);
+  }
+
+  if (ok && rename(tmpname, path) != 0) {
+    // rename() does not replace an existing file on some hosts
+    remove(path);
+    ok = (rename(tmpname, path) == 0);
+  }
+  if (! ok) remove(tmpname);
+  delete [] tmpname;
+
+  if (ok) dirty = 0;
+  return ok;
+}
+
+void bxTraceCacheStore_c::cleanup(void)
+{
+  if (path) {
+    free(path);
+    path = NULL;
+  }
+  if (data) {
+    free(data);
+    data = NULL;
+  }
+  if (bucket) {
+    delete [] bucket;
+    bucket = NULL;
+  }
+  used = size = 0;
+  dirty = 0;
+}
+
+bxTraceRecord_t *bxTraceCacheStore_c::lookup(Bit32u fetchModeMask, const Bit8u *fetchPtr, unsigned remainingInPage)
+{
+  if (remainingInPage < BX_TRACE_CACHE_KEY_LEN) return NULL;
+
+  Bit32u hash = key_hash(fetchModeMask, fetchPtr);
+
+  for (Bit32u next = bucket[hash & (BX_TRACE_CACHE_BUCKETS-1)]; next != 0; ) {
+    bxTraceRecord_t *rec = (bxTraceRecord_t *)(data + next - 1);
+    if (rec->keyHash == hash && rec->fetchModeMask == fetchModeMask &&
+        rec->nbytes <= remainingInPage && ! memcmp(rec->bytes(), fetchPtr, rec->nbytes))
+    {
+      stats.hits++;
+      return rec;
+    }
+    next = rec->next;
+  }
+
+  return NULL;
+}
+
+void bxTraceCacheStore_c::insert(Bit32u fetchModeMask, const Bit8u *fetchPtr, const bxInstruction_c *i, unsigned tlen, const bxICache_c *iCache)
+{
+  unsigned nbytes = 0;
+  for (unsigned n=0; n < tlen; n++)
+    nbytes += i[n].ilen();
+
+  // short traces are not worth the lookup
+  if (nbytes < BX_TRACE_CACHE_KEY_LEN) return;
+
+  bxTraceRecord_t *rec = alloc_record(tlen, nbytes);
+  if (rec == NULL) return; // the store is full
+
+  rec->keyHash = key_hash(fetchModeMask, fetchPtr);
+  rec->fetchModeMask = fetchModeMask;
+  rec->nbytes = nbytes;
+  rec->tlen = tlen;
+  rec->reserved = 0;
+
+  bxInstruction_c *dst = rec->instr();
+  memcpy(dst, i, sizeof(bxInstruction_c) * tlen);
+  memcpy((Bit8u *) rec->bytes(), fetchPtr, nbytes);
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  // links to other traces are only valid in this trace cache
+  for (unsigned n=0; n < tlen; n++) {
+    if (iCache->in_pool(dst[n].getNextTrace()))
+      dst[n].setNextTrace(NULL);
+  }
+#else
+  UNUSED(iCache);
+#endif
+
+  link_record(rec);
+  stats.stored++;
+  dirty = 1;
+}
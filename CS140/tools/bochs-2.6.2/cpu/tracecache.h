@@ -0,0 +1,121 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//   Copyright (c) 2013 The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_TRACE_CACHE_H
+#define BX_TRACE_CACHE_H
+
+// Persistent store of decoded traces ("cpu: trace_cache=<file>").
+//
+// The traces decoded during a run are saved to a file at exit and loaded
+// again by the next run.  A trace is keyed by the fetch mode and by the
+// instruction bytes it was decoded from, on a trace cache miss the stored
+// trace is used instead of decoding when the bytes at the fetch address
+// are the same.  Handler pointers are saved relative to the executable,
+// the file is rejected if it was written by a different Bochs binary or
+// CPU model.
+
+// Upper limit for the size of the store (and of the file)
+#define BX_TRACE_CACHE_MAX_SIZE (64*1024*1024)
+
+// Number of hash buckets, must be a power of 2
+#define BX_TRACE_CACHE_BUCKETS  (64*1024)
+
+// Number of instruction bytes hashed to find the stored traces
+#define BX_TRACE_CACHE_KEY_LEN  8
+
+// Code address of a handler, the first word of the handler pointer
+BX_CPP_INLINE bx_ptr_equiv_t bx_handler_address(const void *handler)
+{
+  bx_ptr_equiv_t addr;
+  memcpy(&addr, handler, sizeof(addr));
+  return addr;
+}
+
+// Hash of the handlers assigned to the opcodes (see fetchdecode.cc)
+extern Bit32u get_bx_opcode_table_hash(void);
+
+struct bxTraceRecord_t {
+  Bit32u next;          // offset+1 of the next record in the bucket
+  Bit32u keyHash;
+  Bit32u fetchModeMask;
+  Bit16u nbytes;        // length of the instruction bytes
+  Bit8u  tlen;          // number of instructions
+  Bit8u  reserved;
+  // followed by tlen decoded instructions and the instruction bytes
+
+  BX_CPP_INLINE bxInstruction_c *instr(void) { return (bxInstruction_c *)(this + 1); }
+  BX_CPP_INLINE const Bit8u *bytes(void) { return (const Bit8u *)(instr() + tlen); }
+};
+
+class bxTraceCacheStore_c {
+  char  *path;
+  Bit8u *data;          // records, one after the other
+  Bit32u used, size;
+  Bit32u *bucket;
+  Bit32u signature;
+  bx_bool dirty;
+
+  static Bit32u compute_signature(Bit64u features);
+  static void relocate(bxInstruction_c *i, unsigned tlen, bx_bool to_file);
+
+  BX_CPP_INLINE static Bit32u key_hash(Bit32u fetchModeMask, const Bit8u *fetchPtr)
+  {
+    Bit64u key;
+    memcpy(&key, fetchPtr, BX_TRACE_CACHE_KEY_LEN);
+    key = (key ^ fetchModeMask) * BX_CONST64(0x9E3779B97F4A7C15);
+    return (Bit32u)(key >> 32);
+  }
+
+  bxTraceRecord_t *alloc_record(Bit32u tlen, Bit32u nbytes);
+  void link_record(bxTraceRecord_t *rec);
+
+public:
+  struct {
+    Bit64u loaded;      // traces read from the file
+    Bit64u hits;        // misses served from the store
+    Bit64u stored;      // new traces added during this run
+  } stats;
+
+  bxTraceCacheStore_c(): path(NULL), data(NULL), used(0), size(0),
+    bucket(NULL), signature(0), dirty(0)
+  {
+    memset(&stats, 0, sizeof(stats));
+  }
+ ~bxTraceCacheStore_c() { cleanup(); }
+
+  BX_CPP_INLINE bx_bool enabled(void) const { return path != NULL; }
+
+  // returns a negative value if the file exists but cannot be used,
+  // features identify the CPU model (the decoding depends on it)
+  int load(const char *filename, Bit64u features);
+  bx_bool save(void);
+  void cleanup(void);
+
+  BX_CPP_INLINE const char *get_path(void) const { return path; }
+
+  bxTraceRecord_t *lookup(Bit32u fetchModeMask, const Bit8u *fetchPtr, unsigned remainingInPage);
+  void insert(Bit32u fetchModeMask, const Bit8u *fetchPtr, const bxInstruction_c *i, unsigned tlen, const bxICache_c *iCache);
+};
+
+extern bxTraceCacheStore_c traceCacheStore;
+
+#endif
@@ -1919,7 +1919,7 @@ Bit32u BX_CPU_C::VMenterLoadCheckGuestState(Bit64u *qualification)
   if (vm->vmexec_ctrls2 & VMX_VM_EXEC_CTRL2_INTERRUPT_WINDOW_VMEXIT)
     signal_event(BX_EVENT_VMX_INTERRUPT_WINDOW_EXITING);
 
-  handleCpuContextChange();
+  handleCpuContextChange(1);
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_CPU_THIS_PTR monitor.reset_monitor();
@@ -2390,7 +2390,9 @@ void BX_CPU_C::VMexitLoadHostState(void)
 
   BX_CPU_THIS_PTR activity_state = BX_ACTIVITY_STATE_ACTIVE;
 
-  handleCpuContextChange();
+  handleCpuContextChange(1);
+
+  TLB_switch_context(1);
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_CPU_THIS_PTR monitor.reset_monitor();
@@ -2837,6 +2839,8 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMLAUNCH(bxInstruction_c *i)
 
   BX_CPU_THIS_PTR in_vmx_guest = 1;
 
+  TLB_switch_context(1);
+
   unmask_event(BX_EVENT_INIT);
 
   if (VMEXIT(VMX_VM_EXEC_CTRL2_TSC_OFFSET))
@@ -3508,7 +3512,7 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::INVVPID(bxInstruction_c *i)
     break;
    
   case BX_INVEPT_INVVPID_SINGLE_CONTEXT_NON_GLOBAL_INVALIDATION:
-    TLB_flushNonGlobal(); // invalidate all mappings tagged with VPID except globals
+    TLB_flush(); // invalidate all mappings tagged with VPID except globals
     break;
 
   default:
@@ -3591,7 +3595,11 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::INVPCID(bxInstruction_c *i)
       BX_ERROR(("INVPCID: invalid PCID"));
       exception(BX_GP_EXCEPTION, 0);
     }
-    TLB_flushNonGlobal(); // Invalidate all mappings for LADDR tagged with PCID except globals
+    // Invalidate all mappings for LADDR tagged with PCID except globals
+    if (pcid == BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context].pcid)
+      TLB_invlpg(invpcid_desc.xmm64u(1));
+    else
+      TLB_flushPCID(pcid);
     break;
 
   case BX_INVPCID_SINGLE_CONTEXT_NON_GLOBAL_INVALIDATION:
@@ -3599,7 +3607,7 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::INVPCID(bxInstruction_c *i)
       BX_ERROR(("INVPCID: invalid PCID"));
       exception(BX_GP_EXCEPTION, 0);
     }
-    TLB_flushNonGlobal(); // Invalidate all mappings tagged with PCID except globals
+    TLB_flushPCID(pcid); // Invalidate all mappings tagged with PCID except globals
     break;
 
   case BX_INVPCID_ALL_CONTEXT_INVALIDATION:
@@ -3607,7 +3615,7 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::INVPCID(bxInstruction_c *i)
     break;
 
   case BX_INVPCID_ALL_CONTEXT_NON_GLOBAL_INVALIDATION:
-    TLB_flushNonGlobal(); // Invalidate all mappings tagged with any PCID except globals
+    TLB_flushPCID(BX_TLB_NO_CONTEXT); // Invalidate all mappings tagged with any PCID except globals
     break;
 
   default:
@@ -26,40 +26,123 @@
 //  of several of the popular FDDI "MAC" chips.
 //  **************************************************************************
 
-#include "config.h"
+#include "bochs.h"
 
-/* Initialized first time "crc32()" is called. If you prefer, you can
- * statically initialize it at compile time. [Another exercise.]
+/* Slicing-by-8 tables, built at startup: table[0] is the classic
+ * byte-at-a-time table, table[k] advances the CRC over k more zero bytes
+ * so that 8 input bytes are folded in with 8 independent lookups.
  */
-static Bit32u crc32_table[256];
+static Bit32u crc32_table[8][256];   /* CRC-32, most significant bit first */
+static Bit32u crc32c_table[8][256];  /* CRC-32C, bit reflected */
 
-/*
- * Build auxiliary table for parallel byte-at-a-time CRC-32.
- */
 #define CRC32_POLY 0x04c11db7     /* AUTODIN II, Ethernet, & FDDI */
+#define CRC32C_POLY 0x82f63b78    /* Castagnoli, bit reflected */
+
+#if BX_HOST_X86_INSN
+static int host_has_crc32 = 0;
+#endif
 
 static void init_crc32(void)
 {
-  int i, j;
+  int i, j, k;
   Bit32u c;
 
   for (i = 0; i < 256; ++i) {
     for (c = i << 24, j = 8; j > 0; --j)
       c = c & 0x80000000 ? (c << 1) ^ CRC32_POLY : (c << 1);
-    crc32_table[i] = c;
+    crc32_table[0][i] = c;
+
+    for (c = i, j = 8; j > 0; --j)
+      c = c & 1 ? (c >> 1) ^ CRC32C_POLY : (c >> 1);
+    crc32c_table[0][i] = c;
   }
+
+  for (k = 1; k < 8; ++k) {
+    for (i = 0; i < 256; ++i) {
+      c = crc32_table[k-1][i];
+      crc32_table[k][i] = (c << 8) ^ crc32_table[0][c >> 24];
+      c = crc32c_table[k-1][i];
+      crc32c_table[k][i] = (c >> 8) ^ crc32c_table[0][c & 0xff];
+    }
+  }
+
+#if BX_HOST_X86_INSN
+  host_has_crc32 = (bx_get_host_cpu_features() & BX_HOST_CPU_SSE4_2) != 0;
+#endif
 }
 
+/* build the tables before any CPU thread can use them */
+static struct bx_crc_init_t {
+  bx_crc_init_t() { init_crc32(); }
+} bx_crc_init;
+
 Bit32u crc32(const Bit8u *buf, int len)
 {
-  const Bit8u *p;
-  Bit32u crc;
-
-  if (!crc32_table[1])    /* if not already done, */
-    init_crc32();   /* build table */
+  const Bit8u *p = buf;
+  Bit32u crc = 0xffffffff; /* preload shift register, per CRC-32 spec */
 
-  crc = 0xffffffff;       /* preload shift register, per CRC-32 spec */
-  for (p = buf; len > 0; ++p, --len)
-    crc = (crc << 8) ^ crc32_table[(crc >> 24) ^ *p];
+  for (; len >= 8; p += 8, len -= 8) {
+    Bit32u hi = crc ^ (((Bit32u) p[0] << 24) | ((Bit32u) p[1] << 16) | ((Bit32u) p[2] << 8) | p[3]);
+    Bit32u lo =       (((Bit32u) p[4] << 24) | ((Bit32u) p[5] << 16) | ((Bit32u) p[6] << 8) | p[7]);
+    crc = crc32_table[7][hi >> 24] ^ crc32_table[6][(hi >> 16) & 0xff] ^
+          crc32_table[5][(hi >> 8) & 0xff] ^ crc32_table[4][hi & 0xff] ^
+          crc32_table[3][lo >> 24] ^ crc32_table[2][(lo >> 16) & 0xff] ^
+          crc32_table[1][(lo >> 8) & 0xff] ^ crc32_table[0][lo & 0xff];
+  }
+  for (; len > 0; ++p, --len)
+    crc = (crc << 8) ^ crc32_table[0][(crc >> 24) ^ *p];
   return ~crc;            /* transmit complement, per CRC-32 spec */
 }
+
+#if BX_HOST_X86_INSN
+
+__attribute__((target("sse4.2")))
+static Bit32u host_crc32c(Bit32u crc, Bit64u data, unsigned len)
+{
+  switch(len) {
+  case 1:
+    return __builtin_ia32_crc32qi(crc, (Bit8u) data);
+  case 2:
+    return __builtin_ia32_crc32hi(crc, (Bit16u) data);
+  case 4:
+    return __builtin_ia32_crc32si(crc, (Bit32u) data);
+  default:
+#if defined(__x86_64__)
+    return (Bit32u) __builtin_ia32_crc32di(crc, data);
+#else
+    crc = __builtin_ia32_crc32si(crc, (Bit32u) data);
+    return __builtin_ia32_crc32si(crc, (Bit32u)(data >> 32));
+#endif
+  }
+}
+
+#endif
+
+/* CRC-32C update as done by the SSE4.2 CRC32 instruction: the 1, 2, 4 or
+ * 8 bytes of 'data' are processed least significant byte first, without
+ * initial or final inversion.
+ */
+Bit32u crc32c(Bit32u crc, Bit64u data, unsigned len)
+{
+#if BX_HOST_X86_INSN
+  if (host_has_crc32)
+    return host_crc32c(crc, data, len);
+#endif
+
+  if (len == 8) {
+    Bit32u lo = crc ^ (Bit32u) data;
+    Bit32u hi = (Bit32u)(data >> 32);
+    return crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+           crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+           crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+           crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+  }
+  if (len == 4) {
+    crc ^= (Bit32u) data;
+    return crc32c_table[3][crc & 0xff] ^ crc32c_table[2][(crc >> 8) & 0xff] ^
+           crc32c_table[1][(crc >> 16) & 0xff] ^ crc32c_table[0][crc >> 24];
+  }
+  for (; len > 0; --len, data >>= 8)
+    crc = (crc >> 8) ^ crc32c_table[0][(crc ^ (Bit32u) data) & 0xff];
+  return crc;
+}
@@ -31,6 +31,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <sys/select.h>
 #include <signal.h>
 #include <netdb.h>
 #endif
@@ -40,6 +41,7 @@
 #include "bochs.h"
 #include "param_names.h"
 #include "cpu/cpu.h"
+#include "bxthread.h"
 
 #define LOG_THIS gdbstublog->
 #define IFDBG(x) x
@@ -242,29 +244,123 @@ static Bit32u registers[NUMREGS];
 
 #define MAX_BREAKPOINTS (255)
 static unsigned breakpoints[MAX_BREAKPOINTS] = {0,};
+
+// Hash set of the breakpoint addresses checked on every instruction,
+// rebuilt from breakpoints[] when a breakpoint is inserted or removed.
+#define BREAKPOINT_HASH_BITS (9)
+#define BREAKPOINT_HASH_SIZE (1 << BREAKPOINT_HASH_BITS)
+static unsigned breakpoint_hash[BREAKPOINT_HASH_SIZE] = {0,};
 static unsigned nr_breakpoints = 0;
 
 static int stub_trace_flag = 0;
-static int instr_count = 0;
 static int saved_eip = 0;
 static int bx_enter_gdbstub = 0;
 
+// While the guest runs, the socket is watched by a separate thread which
+// sets input_pending when gdb sends something (normally a Ctrl-C).  The
+// thread only reports input for the run it was started for, the packets
+// exchanged while the guest is stopped are read by debug_loop().
+static BX_THREAD_VAR(watch_thread);
+static BX_MUTEX(watch_mutex);
+static bx_thread_event_t watch_event;
+static unsigned watch_generation = 0;
+static bx_bool guest_running = 0;
+static volatile int input_pending = 0;
+
 void bx_gdbstub_break(void)
 {
   bx_enter_gdbstub = 1;
 }
 
-int bx_gdbstub_check(unsigned int eip)
+static BX_THREAD_FUNC(watch_socket_thread, arg)
 {
-  unsigned int i;
-  unsigned char ch;
-  long arg;
-  int r;
-#if defined(__CYGWIN__) || defined(__MINGW32__) || defined(_MSC_VER)
-  fd_set fds;
-  struct timeval tv = {0, 0};
-#endif
+  while (1)
+  {
+    bx_wait_for_event(&watch_event);
+
+    BX_LOCK(watch_mutex);
+    unsigned generation = watch_generation;
+    BX_UNLOCK(watch_mutex);
+
+    fd_set fds;
+    int r;
+    do {
+      FD_ZERO(&fds);
+      FD_SET(socket_fd, &fds);
+      r = select(socket_fd + 1, &fds, NULL, NULL, NULL);
+    } while (r < 0 && errno == EINTR);
+
+    BX_LOCK(watch_mutex);
+    if (guest_running && generation == watch_generation)
+      input_pending = 1;
+    BX_UNLOCK(watch_mutex);
+  }
+
+  BX_THREAD_EXIT;
+}
+
+static void start_watch_thread(void)
+{
+  BX_INIT_MUTEX(watch_mutex);
+  bx_create_event(&watch_event);
+  BX_THREAD_CREATE(watch_socket_thread, NULL, watch_thread);
+}
+
+static void resume_guest(void)
+{
+  BX_LOCK(watch_mutex);
+  watch_generation++;
+  guest_running = 1;
+  BX_UNLOCK(watch_mutex);
+  bx_set_event(&watch_event);
+}
+
+static void stop_guest(void)
+{
+  BX_LOCK(watch_mutex);
+  guest_running = 0;
+  input_pending = 0;
+  BX_UNLOCK(watch_mutex);
+}
+
+BX_CPP_INLINE unsigned hash_breakpoint(unsigned addr)
+{
+  return ((Bit32u)(addr * 0x9E3779B1)) >> (32 - BREAKPOINT_HASH_BITS);
+}
+
+static void rebuild_breakpoint_hash(void)
+{
+  memset(breakpoint_hash, 0, sizeof(breakpoint_hash));
+  nr_breakpoints = 0;
+
+  for (unsigned i = 0; i < MAX_BREAKPOINTS; i++)
+  {
+    unsigned addr = breakpoints[i];
+    if (addr == 0) continue;
+
+    unsigned h = hash_breakpoint(addr);
+    while (breakpoint_hash[h] != 0 && breakpoint_hash[h] != addr)
+      h = (h + 1) & (BREAKPOINT_HASH_SIZE - 1);
+    if (breakpoint_hash[h] == 0)
+    {
+      breakpoint_hash[h] = addr;
+      nr_breakpoints++;
+    }
+  }
+}
+
+BX_CPP_INLINE int is_breakpoint(unsigned addr)
+{
+  for (unsigned h = hash_breakpoint(addr); breakpoint_hash[h] != 0;
+       h = (h + 1) & (BREAKPOINT_HASH_SIZE - 1))
+  {
+    if (breakpoint_hash[h] == addr) return(1);
+  }
+  return(0);
+}
 
+int bx_gdbstub_check(unsigned int eip)
+{
   if (bx_enter_gdbstub)
   {
     bx_enter_gdbstub = 0;
@@ -272,40 +368,24 @@ int bx_gdbstub_check(unsigned int eip)
     return GDBSTUB_EXECUTION_BREAKPOINT;
   }
 
-  instr_count++;
-
-  if ((instr_count % 500) == 0)
+  if (input_pending)
   {
-#if !defined(__CYGWIN__) && !defined(__MINGW32__) && !defined(_MSC_VER)
-    arg = fcntl(socket_fd, F_GETFL);
-    fcntl(socket_fd, F_SETFL, arg | O_NONBLOCK);
-    r = recv(socket_fd, &ch, 1, 0);
-    fcntl(socket_fd, F_SETFL, arg);
-#else
-    FD_ZERO(&fds);
-    FD_SET(socket_fd, &fds);
-    r = select(socket_fd + 1, &fds, NULL, NULL, &tv);
-    if (r == 1)
-    {
-      r = recv(socket_fd, (char *)&ch, 1, 0);
-    }
-#endif
-    if (r == 1)
+    char ch;
+    input_pending = 0;
+    // the socket is readable, this does not block
+    if (recv(socket_fd, &ch, 1, 0) == 1)
     {
-      BX_INFO(("Got byte %x", (unsigned int)ch));
+      BX_INFO(("Got byte %x", (unsigned int)(unsigned char)ch));
       last_stop_reason = GDBSTUB_USER_BREAK;
       return GDBSTUB_USER_BREAK;
     }
   }
 
-  for (i = 0; i < nr_breakpoints; i++)
+  if (nr_breakpoints != 0 && is_breakpoint(eip))
   {
-    if (eip == breakpoints[i])
-    {
-      BX_INFO(("found breakpoint at %x", eip));
-      last_stop_reason = GDBSTUB_EXECUTION_BREAKPOINT;
-      return GDBSTUB_EXECUTION_BREAKPOINT;
-    }
+    BX_INFO(("found breakpoint at %x", eip));
+    last_stop_reason = GDBSTUB_EXECUTION_BREAKPOINT;
+    return GDBSTUB_EXECUTION_BREAKPOINT;
   }
 
   if (stub_trace_flag == 1)
@@ -330,6 +410,7 @@ static int remove_breakpoint(unsigned addr, int len)
     {
       BX_INFO(("Removing breakpoint at %x", addr));
       breakpoints[i] = 0;
+      rebuild_breakpoint_hash();
       return(1);
     }
   }
@@ -347,10 +428,7 @@ static void insert_breakpoint(unsigned addr)
     if (breakpoints[i] == 0)
     {
       breakpoints[i] = addr;
-      if (i >= nr_breakpoints)
-      {
-        nr_breakpoints = i + 1;
-      }
+      rebuild_breakpoint_hash();
       return;
     }
   }
@@ -470,7 +548,9 @@ static void debug_loop(void)
         }
 
         stub_trace_flag = 0;
+        resume_guest();
         bx_cpu.cpu_loop();
+        stop_guest();
 
         SIM->refresh_vga();
 
@@ -805,6 +885,7 @@ static void debug_loop(void)
       case 'D':
         BX_INFO(("Debugger detached"));
         put_reply("OK");
+        resume_guest();
         return;
         break;
 
@@ -911,6 +992,7 @@ void bx_gdbstub_init(void)
   /* Wait for connect */
   printf("Waiting for gdb connection on port %d\n", portn);
   wait_for_connect(portn);
+  start_watch_thread();
 
   /* Do debugger command loop */
   debug_loop();
@@ -26,7 +26,7 @@
 // RFB still to do :
 // - properly handle SetPixelFormat, including big/little-endian flag
 // - depth > 8bpp support
-// - optional compression support
+// - Tight encoding
 
 
 // Define BX_PLUGGABLE in files that can be compiled into plugins.  For
@@ -98,6 +98,10 @@ typedef int SOCKET;
 
 #endif
 
+#if BX_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 static bx_bool keep_alive;
 static bx_bool client_connected;
 static bx_bool desktop_resizable;
@@ -139,20 +143,55 @@ static struct _rfbKeyboardEvent {
 static unsigned long rfbKeyboardEvents = 0;
 static bool          bKeyboardInUse = false;
 
-// Misc Stuff
-static struct _rfbUpdateRegion {
-    unsigned int x;
-    unsigned int y;
-    unsigned int width;
-    unsigned int height;
-    bool updated;
-} rfbUpdateRegion;
-
 #define BX_RFB_MAX_XDIM 1024
 #define BX_RFB_MAX_YDIM 768
 #define BX_RFB_DEF_XDIM 720
 #define BX_RFB_DEF_YDIM 480
 
+// Changed screen areas are recorded in a map of cells with a size of
+// BX_RFB_CELL_SIZE x BX_RFB_CELL_SIZE pixels. Before sending an update
+// the dirty cells are merged into rectangles.
+#define BX_RFB_CELL_SIZE 16
+
+static Bit8u   *rfbDirtyCells = NULL;
+static unsigned rfbCellsX, rfbCellsY;
+static bx_bool  rfbDirty = 0;
+static volatile bx_bool rfbFullUpdateRequest = 0;
+static bx_bool  rfbResizePending = 0;
+
+typedef struct {
+    unsigned x;
+    unsigned y;
+    unsigned width;
+    unsigned height;
+} rfbRect;
+
+// The framebuffer updates are encoded and sent by a separate thread. The
+// simulation thread copies the contents of the dirty rectangles into the
+// update job and hands it over if the encoder thread is idle. Otherwise
+// the cells stay dirty and are sent with the next update.
+static struct {
+    BX_THREAD_VAR(thread);
+    BX_MUTEX(mutex);
+    bx_thread_event_t event;
+    bx_bool  busy;
+    bx_bool  exit;
+    bx_bool  resize;
+    unsigned width, height;
+    unsigned nrects;
+    rfbRect *rects;
+    Bit8u   *pixels;
+} rfbEncoder;
+
+static volatile Bit32u rfbUpdateEncoding = rfbEncodingRaw;
+static volatile bx_bool rfbEncoderReset = 0;
+
+typedef struct {
+    Bit8u   *data;
+    unsigned len;
+    unsigned size;
+} rfbBuffer;
+
 static char  *rfbScreen;
 static char  rfbPalette[256];
 
@@ -187,10 +226,12 @@ void CDECL ServerThreadInit(void *indata);
 void HandleRfbClient(SOCKET sClient);
 int  ReadExact(int sock, char *buf, int len);
 int  WriteExact(int sock, char *buf, int len);
-void DrawBitmap(int x, int y, int width, int height, char *bmap, char color, bool update_client);
+void DrawBitmap(int x, int y, int width, int height, char *bmap, char color);
 void DrawChar(int x, int y, int width, int height, int fonty, char *bmap, char color, bx_bool gfxchar);
-void UpdateScreen(unsigned char *newBits, int x, int y, int width, int height, bool update_client);
-void SendUpdate(int x, int y, int width, int height, Bit32u encoding);
+void UpdateScreen(unsigned char *newBits, int x, int y, int width, int height);
+void rfbAddDirtyRegion(unsigned x, unsigned y, unsigned width, unsigned height);
+void rfbSendUpdate();
+BX_THREAD_FUNC(rfbEncoderThread, indata);
 void StartThread();
 void rfbKeyPressed(Bit32u key, int press_release);
 void rfbMouseMove(int x, int y, int bmask);
@@ -254,11 +295,20 @@ void bx_rfb_gui_c::specific_init(int argc, char **argv, unsigned headerbar_y)
   rfbPalette[7] = (char)0xAD;
   rfbPalette[63] = (char)0xFF;
 
-  rfbUpdateRegion.x = rfbWindowX;
-  rfbUpdateRegion.y = rfbWindowY;
-  rfbUpdateRegion.width  = 0;
-  rfbUpdateRegion.height = 0;
-  rfbUpdateRegion.updated = false;
+  // the dirty cell map and the encoder buffers are sized for the maximum
+  // resolution, so they don't have to follow the dimension changes
+  rfbCellsX = (rfbWindowX + BX_RFB_CELL_SIZE - 1) / BX_RFB_CELL_SIZE;
+  rfbCellsY = (rfbWindowY + BX_RFB_CELL_SIZE - 1) / BX_RFB_CELL_SIZE;
+  i = ((BX_RFB_MAX_XDIM + BX_RFB_CELL_SIZE - 1) / BX_RFB_CELL_SIZE) *
+      ((BX_RFB_MAX_YDIM + rfbHeaderbarY + rfbStatusbarY + BX_RFB_CELL_SIZE - 1) / BX_RFB_CELL_SIZE);
+  rfbDirtyCells = (Bit8u *)malloc(i);
+  memset(rfbDirtyCells, 0, i);
+  rfbEncoder.rects = (rfbRect *)malloc(i * sizeof(rfbRect));
+  rfbEncoder.pixels = (Bit8u *)malloc(BX_RFB_MAX_XDIM * (BX_RFB_MAX_YDIM + rfbHeaderbarY + rfbStatusbarY));
+  rfbEncoder.busy = 0;
+  rfbEncoder.exit = 0;
+  BX_INIT_MUTEX(rfbEncoder.mutex);
+  bx_create_event(&rfbEncoder.event);
 
   clientEncodingsCount=0;
   clientEncodings=NULL;
@@ -267,6 +317,7 @@ void bx_rfb_gui_c::specific_init(int argc, char **argv, unsigned headerbar_y)
   client_connected = 0;
   desktop_resizable = 0;
   StartThread();
+  BX_THREAD_CREATE(rfbEncoderThread, NULL, rfbEncoder.thread);
 
 #ifdef WIN32
   Sleep(1000);
@@ -343,18 +394,13 @@ void rfbSetStatusText(int element, const char *text, bx_bool active, bx_bool w)
   } else {
     color = 0xf0;
   }
-  DrawBitmap(xleft, rfbWindowY - rfbStatusbarY + 1, xsize, rfbStatusbarY - 2, newBits, color, false);
+  DrawBitmap(xleft, rfbWindowY - rfbStatusbarY + 1, xsize, rfbStatusbarY - 2, newBits, color);
   free(newBits);
   len = ((element > 0) && (strlen(text) > 4)) ? 4 : strlen(text);
   for (i = 0; i < len; i++) {
     DrawChar(xleft + i * 8 + 2, rfbWindowY - rfbStatusbarY + 5, 8, 8, 0,
       (char *)&sdl_font8x8[(unsigned)text[i]][0], color, 0);
   }
-  if (xleft < rfbUpdateRegion.x) rfbUpdateRegion.x = xleft;
-  if ((rfbWindowY - rfbStatusbarY + 1) < rfbUpdateRegion.y) rfbUpdateRegion.y = rfbWindowY - rfbStatusbarY + 1;
-  if (((xleft + xsize) - rfbUpdateRegion.x) > rfbUpdateRegion.width) rfbUpdateRegion.width = ((xleft + xsize) - rfbUpdateRegion.x);
-  if (((rfbWindowY - 2) - rfbUpdateRegion.y) > rfbUpdateRegion.height) rfbUpdateRegion.height = ((rfbWindowY - 2) - rfbUpdateRegion.y);
-  rfbUpdateRegion.updated = true;
 }
 
 void bx_rfb_gui_c::statusbar_setitem_specific(int element, bx_bool active, bx_bool w)
@@ -507,6 +553,9 @@ void HandleRfbClient(SOCKET sClient)
     return;
   }
 
+  // a new client starts with raw encoding and a new zlib stream
+  rfbUpdateEncoding = rfbEncodingRaw;
+  rfbEncoderReset = 1;
   client_connected = 1;
   sGlobal = sClient;
   while (keep_alive) {
@@ -603,6 +652,17 @@ void HandleRfbClient(SOCKET sClient)
             }
             if (!found) BX_INFO(("%08x Unknown", clientEncodings[i]));
           }
+          // use the first supported encoding in the order of client preference
+          for (i = 0; i < clientEncodingsCount; i++) {
+            if ((clientEncodings[i] == rfbEncodingRaw) ||
+#if BX_HAVE_ZLIB
+                (clientEncodings[i] == rfbEncodingZRLE) ||
+#endif
+                (clientEncodings[i] == rfbEncodingHextile)) {
+              rfbUpdateEncoding = clientEncodings[i];
+              break;
+            }
+          }
           break;
         }
       case rfbFramebufferUpdateRequest:
@@ -611,18 +671,9 @@ void HandleRfbClient(SOCKET sClient)
 
           ReadExact(sClient, (char *)&fur, sizeof(rfbFramebufferUpdateRequestMessage));
           if(!fur.incremental) {
-            rfbUpdateRegion.x = 0;
-            rfbUpdateRegion.y = 0;
-            rfbUpdateRegion.width  = rfbWindowX;
-            rfbUpdateRegion.height = rfbWindowY;
-            rfbUpdateRegion.updated = true;
-          } //else {
-          //    if(fur.x < rfbUpdateRegion.x) rfbUpdateRegion.x = fur.x;
-          //    if(fur.y < rfbUpdateRegion.x) rfbUpdateRegion.y = fur.y;
-          //    if(((fur.x + fur.w) - rfbUpdateRegion.x) > rfbUpdateRegion.width) rfbUpdateRegion.width = ((fur.x + fur.w) - rfbUpdateRegion.x);
-          //    if(((fur.y + fur.h) - rfbUpdateRegion.y) > rfbUpdateRegion.height) rfbUpdateRegion.height = ((fur.y + fur.h) - rfbUpdateRegion.y);
-          //}
-          //rfbUpdateRegion.updated = true;
+            // the whole screen is marked dirty by the simulation thread
+            rfbFullUpdateRequest = 1;
+          }
           break;
         }
       case rfbKeyEvent:
@@ -707,15 +758,13 @@ void bx_rfb_gui_c::handle_events(void)
     }
     bKeyboardInUse = false;
 
-    if(rfbUpdateRegion.updated) {
-        SendUpdate(rfbUpdateRegion.x, rfbUpdateRegion.y, rfbUpdateRegion.width,
-                   rfbUpdateRegion.height, rfbEncodingRaw);
-        rfbUpdateRegion.x = rfbWindowX;
-        rfbUpdateRegion.y = rfbWindowY;
-        rfbUpdateRegion.width  = 0;
-        rfbUpdateRegion.height = 0;
+    if(rfbFullUpdateRequest) {
+        rfbFullUpdateRequest = 0;
+        rfbAddDirtyRegion(0, 0, rfbWindowX, rfbWindowY);
+    }
+    if(rfbDirty || rfbResizePending) {
+        rfbSendUpdate();
     }
-    rfbUpdateRegion.updated = false;
 #if BX_SHOW_IPS
   if (rfbIPSupdate) {
     rfbIPSupdate = 0;
@@ -815,11 +864,6 @@ void bx_rfb_gui_c::text_update(Bit8u *old_text, Bit8u *new_text, unsigned long c
         gfxchar = tm_info->line_graphics && ((cChar & 0xE0) == 0xC0);
         xc = x * font_width;
         DrawChar(xc, yc, font_width, font_height, 0, (char *)&vga_charmap[cChar<<5], cAttr, gfxchar);
-        if(yc < rfbUpdateRegion.y) rfbUpdateRegion.y = yc;
-        if((yc + font_height - rfbUpdateRegion.y) > rfbUpdateRegion.height) rfbUpdateRegion.height = (yc + font_height - rfbUpdateRegion.y);
-        if(xc < rfbUpdateRegion.x) rfbUpdateRegion.x = xc;
-        if((xc + font_width - rfbUpdateRegion.x) > rfbUpdateRegion.width) rfbUpdateRegion.width = (xc + font_width - rfbUpdateRegion.x);
-        rfbUpdateRegion.updated = true;
         if (offset == curs) {
           cAttr = ((cAttr >> 4) & 0xF) + ((cAttr & 0xF) << 4);
           DrawChar(xc, yc + tm_info->cs_start, font_width, tm_info->cs_end - tm_info->cs_start + 1,
@@ -879,15 +923,7 @@ bx_bool bx_rfb_gui_c::palette_change(Bit8u index, Bit8u red, Bit8u green, Bit8u
 //       left of the window.
 void bx_rfb_gui_c::graphics_tile_update(Bit8u *tile, unsigned x0, unsigned y0)
 {
-  UpdateScreen(tile, x0, y0 + rfbHeaderbarY, rfbTileX, rfbTileY, false);
-  if(x0 < rfbUpdateRegion.x) rfbUpdateRegion.x = x0;
-  if((y0 + rfbHeaderbarY) < rfbUpdateRegion.y) rfbUpdateRegion.y = y0 + rfbHeaderbarY;
-  if(((y0 + rfbHeaderbarY + rfbTileY) - rfbUpdateRegion.y) > rfbUpdateRegion.height) rfbUpdateRegion.height =  ((y0 + rfbHeaderbarY + rfbTileY) - rfbUpdateRegion.y);
-  if(((x0 + rfbTileX) - rfbUpdateRegion.x) > rfbUpdateRegion.width) rfbUpdateRegion.width = ((x0 + rfbTileX) - rfbUpdateRegion.x);
-  if ((rfbUpdateRegion.x + rfbUpdateRegion.width) > rfbWindowX) {
-    rfbUpdateRegion.width = rfbWindowX - rfbUpdateRegion.x;
-  }
-  rfbUpdateRegion.updated = true;
+  UpdateScreen(tile, x0, y0 + rfbHeaderbarY, rfbTileX, rfbTileY);
 }
 
 bx_svga_tileinfo_t *bx_rfb_gui_c::graphics_tile_info(bx_svga_tileinfo_t *info)
@@ -933,14 +969,7 @@ Bit8u *bx_rfb_gui_c::graphics_tile_get(unsigned x0, unsigned y0,
 void bx_rfb_gui_c::graphics_tile_update_in_place(unsigned x0, unsigned y0,
                                         unsigned w, unsigned h)
 {
-  if(x0 < rfbUpdateRegion.x) rfbUpdateRegion.x = x0;
-  if((y0 + rfbHeaderbarY) < rfbUpdateRegion.y) rfbUpdateRegion.y = y0 + rfbHeaderbarY;
-  if(((y0 + rfbHeaderbarY + h) - rfbUpdateRegion.y) > rfbUpdateRegion.height) rfbUpdateRegion.height =  ((y0 + rfbHeaderbarY + h) - rfbUpdateRegion.y);
-  if(((x0 + w) - rfbUpdateRegion.x) > rfbUpdateRegion.width) rfbUpdateRegion.width = ((x0 + h) - rfbUpdateRegion.x);
-  if ((rfbUpdateRegion.x + rfbUpdateRegion.width) > rfbWindowX) {
-    rfbUpdateRegion.width = rfbWindowX - rfbUpdateRegion.x;
-  }
-  rfbUpdateRegion.updated = true;
+  rfbAddDirtyRegion(x0, y0 + rfbHeaderbarY, w, h);
 }
 
 
@@ -980,11 +1009,14 @@ void bx_rfb_gui_c::dimension_update(unsigned x, unsigned y, unsigned fheight, un
       rfbWindowX = rfbDimensionX;
       rfbWindowY = rfbDimensionY + rfbHeaderbarY + rfbStatusbarY;
       rfbScreen = (char *)realloc(rfbScreen, rfbWindowX * rfbWindowY);
-      SendUpdate(0, 0, rfbWindowX, rfbWindowY, rfbEncodingDesktopSize);
+      rfbCellsX = (rfbWindowX + BX_RFB_CELL_SIZE - 1) / BX_RFB_CELL_SIZE;
+      rfbCellsY = (rfbWindowY + BX_RFB_CELL_SIZE - 1) / BX_RFB_CELL_SIZE;
+      rfbResizePending = 1;
       bx_gui->show_headerbar();
+      rfbAddDirtyRegion(0, 0, rfbWindowX, rfbWindowY);
     } else {
       clear_screen();
-      SendUpdate(0, rfbHeaderbarY, rfbDimensionX, rfbDimensionY, rfbEncodingRaw);
+      rfbAddDirtyRegion(0, rfbHeaderbarY, rfbDimensionX, rfbDimensionY);
       rfbDimensionX = x;
       rfbDimensionY = y;
     }
@@ -1071,14 +1103,14 @@ void bx_rfb_gui_c::show_headerbar(void)
 
   newBits = (char *)malloc(rfbWindowX * rfbHeaderbarY);
   memset(newBits, 0, (rfbWindowX * rfbHeaderbarY));
-  DrawBitmap(0, 0, rfbWindowX, rfbHeaderbarY, newBits, (char)0xf0, false);
+  DrawBitmap(0, 0, rfbWindowX, rfbHeaderbarY, newBits, (char)0xf0);
   for(i = 0; i < rfbHeaderbarBitmapCount; i++) {
     if(rfbHeaderbarBitmaps[i].alignment == BX_GRAVITY_LEFT) {
       xorigin = rfbHeaderbarBitmaps[i].xorigin;
     } else {
       xorigin = rfbWindowX - rfbHeaderbarBitmaps[i].xorigin;
     }
-    DrawBitmap(xorigin, 0, rfbBitmaps[rfbHeaderbarBitmaps[i].index].xdim, rfbBitmaps[rfbHeaderbarBitmaps[i].index].ydim, rfbBitmaps[rfbHeaderbarBitmaps[i].index].bmap, (char)0xf0, false);
+    DrawBitmap(xorigin, 0, rfbBitmaps[rfbHeaderbarBitmaps[i].index].xdim, rfbBitmaps[rfbHeaderbarBitmaps[i].index].ydim, rfbBitmaps[rfbHeaderbarBitmaps[i].index].bmap, (char)0xf0);
   }
   free(newBits);
   newBits = (char *)malloc(rfbWindowX * rfbStatusbarY / 8);
@@ -1090,7 +1122,7 @@ void bx_rfb_gui_c::show_headerbar(void)
       newBits[(rfbWindowX * j / 8) + addr] = value;
     }
   }
-  DrawBitmap(0, rfbWindowY - rfbStatusbarY, rfbWindowX, rfbStatusbarY, newBits, (char)0xf0, false);
+  DrawBitmap(0, rfbWindowY - rfbStatusbarY, rfbWindowX, rfbStatusbarY, newBits, (char)0xf0);
   free(newBits);
   for (i = 1; i <= statusitem_count; i++) {
     rfbSetStatusText(i, statusitem[i-1].text, rfbStatusitemActive[i]);
@@ -1124,7 +1156,7 @@ void bx_rfb_gui_c::replace_bitmap(unsigned hbar_id, unsigned bmap_id)
     }
     DrawBitmap(xorigin, 0, rfbBitmaps[rfbHeaderbarBitmaps[hbar_id].index].xdim,
                rfbBitmaps[rfbHeaderbarBitmaps[hbar_id].index].ydim,
-               rfbBitmaps[rfbHeaderbarBitmaps[hbar_id].index].bmap, (char)0xf0, true);
+               rfbBitmaps[rfbHeaderbarBitmaps[hbar_id].index].bmap, (char)0xf0);
 }
 
 
@@ -1136,6 +1168,18 @@ void bx_rfb_gui_c::exit(void)
 {
     unsigned int i;
     keep_alive = 0;
+    // stop the encoder thread before its buffers are freed
+    BX_LOCK(rfbEncoder.mutex);
+    rfbEncoder.exit = 1;
+    BX_UNLOCK(rfbEncoder.mutex);
+    bx_set_event(&rfbEncoder.event);
+    BX_THREAD_JOIN(rfbEncoder.thread);
+    bx_destroy_event(&rfbEncoder.event);
+    BX_FINI_MUTEX(rfbEncoder.mutex);
+    free(rfbEncoder.rects);
+    free(rfbEncoder.pixels);
+    free(rfbDirtyCells);
+    rfbDirtyCells = NULL;
 #ifdef WIN32
     StopWinsock();
 #endif
@@ -1195,7 +1239,7 @@ int WriteExact(int sock, char *buf, int len)
     return 1;
 }
 
-void DrawBitmap(int x, int y, int width, int height, char *bmap, char color, bool update_client)
+void DrawBitmap(int x, int y, int width, int height, char *bmap, char color)
 {
     unsigned char *newBits;
     char fgcolor, bgcolor;
@@ -1232,7 +1276,7 @@ void DrawBitmap(int x, int y, int width, int height, char *bmap, char color, boo
         newBits[i * 8 + 6] = (bmap[i] & 0x40) ? fgcolor : bgcolor;
         newBits[i * 8 + 7] = (bmap[i] & 0x80) ? fgcolor : bgcolor;
     }
-    UpdateScreen(newBits, x, y, width, height, update_client);
+    UpdateScreen(newBits, x, y, width, height);
     //DrawColorPalette();
     free(newBits);
 }
@@ -1281,7 +1325,7 @@ void DrawChar(int x, int y, int width, int height, int fonty, char *bmap, char c
     }
     fonty++;
   }
-  UpdateScreen(newBits, x, y, width, height, false);
+  UpdateScreen(newBits, x, y, width, height);
   //DrawColorPalette();
 }
 
@@ -1291,7 +1335,7 @@ void DrawColorPalette()
     int x = 0, y = 0, c;
     for(c = 0; c < 256; c++) {
         memset(&bits, rfbPalette[c], 100);
-        UpdateScreen(bits, x, y, 10, 10, false);
+        UpdateScreen(bits, x, y, 10, 10);
         x += 10;
         if(x > 70) {
             y += 10;
@@ -1300,66 +1344,466 @@ void DrawColorPalette()
     }
 }
 
-void UpdateScreen(unsigned char *newBits, int x, int y, int width, int height, bool update_client)
+void UpdateScreen(unsigned char *newBits, int x, int y, int width, int height)
 {
     int i, c;
     for(i = 0; i < height; i++) {
         for(c = 0; c < width; c++) {
             newBits[(i * width) + c] = rfbPalette[newBits[(i * width) + c]];
         }
-        memcpy(&rfbScreen[y * rfbWindowX + x], &newBits[i * width], width);
-        y++;
+        memcpy(&rfbScreen[(y + i) * rfbWindowX + x], &newBits[i * width], width);
     }
-    if(update_client) {
-        if(sGlobal == INVALID_SOCKET) return;
-        rfbFramebufferUpdateMessage fum;
-        rfbFramebufferUpdateRectHeader furh;
-        fum.messageType = rfbFramebufferUpdate;
-        fum.numberOfRectangles = htons(1);
-        WriteExact(sGlobal, (char *)&fum, rfbFramebufferUpdateMessageSize);
-        furh.r.xPosition = htons(x);
-        furh.r.yPosition = htons((y - i));
-        furh.r.width = htons((short)width);
-        furh.r.height = htons((short)height);
-        furh.r.encodingType = htonl(rfbEncodingRaw);
-        WriteExact(sGlobal, (char *)&furh, rfbFramebufferUpdateRectHeaderSize);
-        WriteExact(sGlobal, (char *)newBits, width * height);
+    rfbAddDirtyRegion(x, y, width, height);
+}
+
+void rfbAddDirtyRegion(unsigned x, unsigned y, unsigned width, unsigned height)
+{
+    unsigned cx0, cy0, cx1, cy1, cy;
+
+    if ((x >= rfbWindowX) || (y >= rfbWindowY) || !width || !height) return;
+    if ((x + width) > rfbWindowX) width = rfbWindowX - x;
+    if ((y + height) > rfbWindowY) height = rfbWindowY - y;
+    cx0 = x / BX_RFB_CELL_SIZE;
+    cy0 = y / BX_RFB_CELL_SIZE;
+    cx1 = (x + width - 1) / BX_RFB_CELL_SIZE;
+    cy1 = (y + height - 1) / BX_RFB_CELL_SIZE;
+    for (cy = cy0; cy <= cy1; cy++) {
+        memset(&rfbDirtyCells[cy * rfbCellsX + cx0], 1, cx1 - cx0 + 1);
     }
+    rfbDirty = 1;
 }
 
-void SendUpdate(int x, int y, int width, int height, Bit32u encoding)
+// Merge the dirty cells into rectangles: horizontal runs of dirty cells
+// are extended downwards as long as the rows below have the same run dirty.
+static unsigned rfbCollectDirtyRects(rfbRect *rects)
 {
-    char *newBits;
+    unsigned nrects = 0, cx, cy, cx1, cy1, i;
+
+    for (cy = 0; cy < rfbCellsY; cy++) {
+        Bit8u *row = &rfbDirtyCells[cy * rfbCellsX];
+        for (cx = 0; cx < rfbCellsX; cx++) {
+            if (!row[cx]) continue;
+            cx1 = cx;
+            while ((cx1 < rfbCellsX) && row[cx1]) cx1++;
+            for (cy1 = cy + 1; cy1 < rfbCellsY; cy1++) {
+                Bit8u *next = &rfbDirtyCells[cy1 * rfbCellsX];
+                for (i = cx; i < cx1; i++) {
+                    if (!next[i]) break;
+                }
+                if (i < cx1) break;
+                memset(&next[cx], 0, cx1 - cx);
+            }
+            memset(&row[cx], 0, cx1 - cx);
+            rects[nrects].x = cx * BX_RFB_CELL_SIZE;
+            rects[nrects].y = cy * BX_RFB_CELL_SIZE;
+            rects[nrects].width = (cx1 - cx) * BX_RFB_CELL_SIZE;
+            rects[nrects].height = (cy1 - cy) * BX_RFB_CELL_SIZE;
+            if ((rects[nrects].x + rects[nrects].width) > rfbWindowX)
+                rects[nrects].width = rfbWindowX - rects[nrects].x;
+            if ((rects[nrects].y + rects[nrects].height) > rfbWindowY)
+                rects[nrects].height = rfbWindowY - rects[nrects].y;
+            nrects++;
+            cx = cx1;
+        }
+    }
+    return nrects;
+}
 
-    if(x < 0 || y < 0 || (x + width) > (int)rfbWindowX || (y + height) > (int)rfbWindowY) {
-        BX_ERROR(("Dimensions out of bounds.  x=%i y=%i w=%i h=%i", x, y, width, height));
+// Called from the simulation thread: copy the dirty screen areas into the
+// update job and start the encoder thread.
+void rfbSendUpdate()
+{
+    unsigned i, y;
+    Bit8u *pixels;
+
+    if (sGlobal == INVALID_SOCKET) {
+        // the client requests a full update after connecting
+        memset(rfbDirtyCells, 0, rfbCellsX * rfbCellsY);
+        rfbDirty = 0;
+        rfbResizePending = 0;
+        return;
     }
-    if(sGlobal != INVALID_SOCKET) {
-        rfbFramebufferUpdateMessage fum;
-        rfbFramebufferUpdateRectHeader furh;
-
-        fum.messageType = rfbFramebufferUpdate;
-        fum.numberOfRectangles = htons(1);
-
-        furh.r.xPosition = htons(x);
-        furh.r.yPosition = htons(y);
-        furh.r.width = htons((short)width);
-        furh.r.height = htons((short)height);
-        furh.r.encodingType = htonl(encoding);
-
-        WriteExact(sGlobal, (char *)&fum, rfbFramebufferUpdateMessageSize);
-        WriteExact(sGlobal, (char *)&furh, rfbFramebufferUpdateRectHeaderSize);
-
-        if (encoding == rfbEncodingRaw) {
-          newBits = (char *)malloc(width * height);
-          for(int i = 0; i < height; i++) {
-            memcpy(&newBits[i * width], &rfbScreen[y * rfbWindowX + x], width);
-            y++;
-          }
-          WriteExact(sGlobal, (char *)newBits, width * height);
-          free(newBits);
+    BX_LOCK(rfbEncoder.mutex);
+    if (rfbEncoder.busy) {
+        BX_UNLOCK(rfbEncoder.mutex);
+        return;
+    }
+    rfbEncoder.resize = rfbResizePending;
+    rfbEncoder.width = rfbWindowX;
+    rfbEncoder.height = rfbWindowY;
+    rfbEncoder.nrects = rfbCollectDirtyRects(rfbEncoder.rects);
+    pixels = rfbEncoder.pixels;
+    for (i = 0; i < rfbEncoder.nrects; i++) {
+        rfbRect *r = &rfbEncoder.rects[i];
+        for (y = 0; y < r->height; y++) {
+            memcpy(pixels, &rfbScreen[(r->y + y) * rfbWindowX + r->x], r->width);
+            pixels += r->width;
+        }
+    }
+    rfbDirty = 0;
+    rfbResizePending = 0;
+    rfbEncoder.busy = 1;
+    BX_UNLOCK(rfbEncoder.mutex);
+    bx_set_event(&rfbEncoder.event);
+}
+
+static void rfbBufferReserve(rfbBuffer *buf, unsigned n)
+{
+    if ((buf->len + n) > buf->size) {
+        buf->size = (buf->len + n) * 2;
+        buf->data = (Bit8u *)realloc(buf->data, buf->size);
+    }
+}
+
+BX_CPP_INLINE void rfbPut8(rfbBuffer *buf, Bit8u val)
+{
+    buf->data[buf->len++] = val;
+}
+
+BX_CPP_INLINE void rfbPut16(rfbBuffer *buf, Bit16u val)
+{
+    buf->data[buf->len++] = (Bit8u)(val >> 8);
+    buf->data[buf->len++] = (Bit8u)val;
+}
+
+BX_CPP_INLINE void rfbPut32(rfbBuffer *buf, Bit32u val)
+{
+    rfbPut16(buf, (Bit16u)(val >> 16));
+    rfbPut16(buf, (Bit16u)val);
+}
+
+static void rfbPutRectHeader(rfbBuffer *buf, unsigned x, unsigned y, unsigned w, unsigned h, Bit32u encoding)
+{
+    rfbBufferReserve(buf, rfbFramebufferUpdateRectHeaderSize);
+    rfbPut16(buf, x);
+    rfbPut16(buf, y);
+    rfbPut16(buf, w);
+    rfbPut16(buf, h);
+    rfbPut32(buf, encoding);
+}
+
+// Hextile: 16x16 tiles, each either raw or a background color with
+// solid subrectangles.
+static void rfbEncodeHextile(rfbBuffer *buf, const Bit8u *pixels, unsigned w, unsigned h)
+{
+    Bit8u tile[256], done[256];
+    unsigned count[256];
+    int bg = -1; // background of the previous tile, -1 if undefined
+
+    for (unsigned ty = 0; ty < h; ty += 16) {
+        unsigned th = ((h - ty) < 16) ? (h - ty) : 16;
+        for (unsigned tx = 0; tx < w; tx += 16) {
+            unsigned tw = ((w - tx) < 16) ? (w - tx) : 16;
+            unsigned n = tw * th, ncolors = 0, i, x, y;
+            Bit8u tbg, tfg = 0;
+
+            for (y = 0; y < th; y++) {
+                memcpy(&tile[y * tw], &pixels[(ty + y) * w + tx], tw);
+            }
+            memset(count, 0, sizeof(count));
+            tbg = tile[0];
+            for (i = 0; i < n; i++) {
+                if (count[tile[i]]++ == 0) ncolors++;
+                if (count[tile[i]] > count[tbg]) tbg = tile[i];
+            }
+            rfbBufferReserve(buf, 4 + 3 * n);
+            if (ncolors == 1) {
+                if (bg == tbg) {
+                    rfbPut8(buf, 0);
+                } else {
+                    rfbPut8(buf, rfbHextileBackgroundSpecified);
+                    rfbPut8(buf, tbg);
+                    bg = tbg;
+                }
+                continue;
+            }
+            unsigned start = buf->len;
+            Bit8u flags = rfbHextileAnySubrects;
+            buf->len++;
+            if (bg != tbg) {
+                flags |= rfbHextileBackgroundSpecified;
+                rfbPut8(buf, tbg);
+            }
+            if (ncolors == 2) {
+                for (i = 0; i < n; i++) {
+                    if (tile[i] != tbg) break;
+                }
+                tfg = tile[i];
+                flags |= rfbHextileForegroundSpecified;
+                rfbPut8(buf, tfg);
+            } else {
+                flags |= rfbHextileSubrectsColoured;
+            }
+            unsigned nsub_pos = buf->len++, nsub = 0;
+            memset(done, 0, n);
+            for (y = 0; (y < th) && ((buf->len - start) <= n); y++) {
+                for (x = 0; x < tw; x++) {
+                    i = y * tw + x;
+                    if (done[i] || (tile[i] == tbg)) continue;
+                    Bit8u c = tile[i];
+                    unsigned x1 = x + 1, y1 = y + 1, j;
+                    while ((x1 < tw) && !done[y * tw + x1] && (tile[y * tw + x1] == c)) x1++;
+                    for (; y1 < th; y1++) {
+                        for (j = x; j < x1; j++) {
+                            if (done[y1 * tw + j] || (tile[y1 * tw + j] != c)) break;
+                        }
+                        if (j < x1) break;
+                    }
+                    for (j = y; j < y1; j++) {
+                        memset(&done[j * tw + x], 1, x1 - x);
+                    }
+                    if (ncolors > 2) rfbPut8(buf, c);
+                    rfbPut8(buf, rfbHextilePackXY(x, y));
+                    rfbPut8(buf, rfbHextilePackWH(x1 - x, y1 - y));
+                    nsub++;
+                }
+            }
+            if ((buf->len - start) > n) {
+                // subrectangles don't pay off, send the tile raw
+                buf->len = start;
+                rfbPut8(buf, rfbHextileRaw);
+                memcpy(&buf->data[buf->len], tile, n);
+                buf->len += n;
+                bg = -1;
+            } else {
+                buf->data[start] = flags;
+                buf->data[nsub_pos] = nsub;
+                bg = tbg;
+            }
+        }
+    }
+}
+
+#if BX_HAVE_ZLIB
+
+static z_stream rfbZStream;
+static bx_bool rfbZStreamInit = 0;
+
+// ZRLE run lengths are stored as length-1 in a sequence of bytes, all but
+// the last of them 255
+static void rfbPutRunLength(rfbBuffer *buf, unsigned len)
+{
+    len--;
+    while (len >= 255) {
+        rfbPut8(buf, 255);
+        len -= 255;
+    }
+    rfbPut8(buf, len);
+}
+
+// Append one ZRLE tile to the uncompressed data, using the smallest of
+// the solid, raw, packed palette, plain RLE and palette RLE subencodings.
+static void rfbEncodeZRLETile(rfbBuffer *buf, const Bit8u *pixels, unsigned stride, unsigned w, unsigned h)
+{
+    Bit8u palette[128];
+    int index[256];
+    unsigned npal = 0, rle_size = 0, prle_size = 0, run = 0;
+    unsigned raw_size, packed_size = ~0U, bits = 0, x, y, i;
+    Bit8u prev = 0;
+
+    memset(index, -1, sizeof(index));
+    for (y = 0; y < h; y++) {
+        const Bit8u *p = &pixels[y * stride];
+        for (x = 0; x < w; x++) {
+            if (index[p[x]] < 0) {
+                if (npal < 128) palette[npal] = p[x];
+                index[p[x]] = npal++;
+            }
+            if (run && (p[x] == prev)) {
+                run++;
+            } else {
+                if (run) {
+                    rle_size += 1 + (run - 1) / 255 + 1;
+                    prle_size += (run == 1) ? 1 : (1 + (run - 1) / 255 + 1);
+                }
+                prev = p[x];
+                run = 1;
+            }
+        }
+    }
+    rle_size += 1 + (run - 1) / 255 + 1;
+    prle_size += (run == 1) ? 1 : (1 + (run - 1) / 255 + 1);
+
+    // none of the subencodings used is larger than raw
+    rfbBufferReserve(buf, 1 + 128 + w * h);
+    if (npal == 1) {
+        rfbPut8(buf, 1);
+        rfbPut8(buf, palette[0]);
+        return;
+    }
+    raw_size = w * h;
+    if (npal <= 16) {
+        bits = (npal <= 2) ? 1 : ((npal <= 4) ? 2 : 4);
+        packed_size = npal + h * ((w * bits + 7) / 8);
+    }
+    prle_size = (npal <= 127) ? (npal + prle_size) : ~0U;
+
+    if ((packed_size <= raw_size) && (packed_size <= rle_size) && (packed_size <= prle_size)) {
+        rfbPut8(buf, npal);
+        for (i = 0; i < npal; i++) rfbPut8(buf, palette[i]);
+        for (y = 0; y < h; y++) {
+            const Bit8u *p = &pixels[y * stride];
+            unsigned byte = 0, nbits = 0;
+            for (x = 0; x < w; x++) {
+                byte = (byte << bits) | index[p[x]];
+                nbits += bits;
+                if (nbits == 8) {
+                    rfbPut8(buf, byte);
+                    byte = nbits = 0;
+                }
+            }
+            if (nbits) rfbPut8(buf, byte << (8 - nbits));
+        }
+    } else if ((prle_size <= raw_size) && (prle_size <= rle_size)) {
+        rfbPut8(buf, 128 + npal);
+        for (i = 0; i < npal; i++) rfbPut8(buf, palette[i]);
+        run = 0;
+        for (y = 0; y < h; y++) {
+            const Bit8u *p = &pixels[y * stride];
+            for (x = 0; x < w; x++) {
+                if (run && (p[x] == prev)) {
+                    run++;
+                    continue;
+                }
+                if (run == 1) {
+                    rfbPut8(buf, index[prev]);
+                } else if (run) {
+                    rfbPut8(buf, index[prev] | 128);
+                    rfbPutRunLength(buf, run);
+                }
+                prev = p[x];
+                run = 1;
+            }
+        }
+        if (run == 1) {
+            rfbPut8(buf, index[prev]);
+        } else {
+            rfbPut8(buf, index[prev] | 128);
+            rfbPutRunLength(buf, run);
+        }
+    } else if (rle_size < raw_size) {
+        rfbPut8(buf, 128);
+        run = 0;
+        for (y = 0; y < h; y++) {
+            const Bit8u *p = &pixels[y * stride];
+            for (x = 0; x < w; x++) {
+                if (run && (p[x] == prev)) {
+                    run++;
+                    continue;
+                }
+                if (run) {
+                    rfbPut8(buf, prev);
+                    rfbPutRunLength(buf, run);
+                }
+                prev = p[x];
+                run = 1;
+            }
+        }
+        rfbPut8(buf, prev);
+        rfbPutRunLength(buf, run);
+    } else {
+        rfbPut8(buf, 0);
+        for (y = 0; y < h; y++) {
+            memcpy(&buf->data[buf->len], &pixels[y * stride], w);
+            buf->len += w;
+        }
+    }
+}
+
+// ZRLE: 64x64 tiles compressed with a zlib stream that lasts for the
+// whole connection.
+static void rfbEncodeZRLE(rfbBuffer *buf, rfbBuffer *tmp, const Bit8u *pixels, unsigned w, unsigned h)
+{
+    unsigned start, end;
+
+    tmp->len = 0;
+    for (unsigned ty = 0; ty < h; ty += 64) {
+        unsigned th = ((h - ty) < 64) ? (h - ty) : 64;
+        for (unsigned tx = 0; tx < w; tx += 64) {
+            unsigned tw = ((w - tx) < 64) ? (w - tx) : 64;
+            rfbEncodeZRLETile(tmp, &pixels[ty * w + tx], w, tw, th);
+        }
+    }
+    rfbBufferReserve(buf, 4);
+    start = buf->len;
+    buf->len += 4;
+    rfbZStream.next_in = tmp->data;
+    rfbZStream.avail_in = tmp->len;
+    do {
+        rfbBufferReserve(buf, tmp->len / 4 + 1024);
+        rfbZStream.next_out = &buf->data[buf->len];
+        rfbZStream.avail_out = buf->size - buf->len;
+        deflate(&rfbZStream, Z_SYNC_FLUSH);
+        buf->len = buf->size - rfbZStream.avail_out;
+    } while (rfbZStream.avail_out == 0);
+    end = buf->len;
+    buf->len = start;
+    rfbPut32(buf, end - start - 4);
+    buf->len = end;
+}
+
+#endif
+
+BX_THREAD_FUNC(rfbEncoderThread, indata)
+{
+    rfbBuffer buf = {NULL, 0, 0}, tmp = {NULL, 0, 0};
+    Bit32u encoding;
+    unsigned i;
+
+    while (1) {
+        bx_wait_for_event(&rfbEncoder.event);
+        BX_LOCK(rfbEncoder.mutex);
+        bx_bool exit = rfbEncoder.exit;
+        BX_UNLOCK(rfbEncoder.mutex);
+        if (exit) break;
+        encoding = rfbUpdateEncoding;
+#if BX_HAVE_ZLIB
+        if (rfbEncoderReset) {
+            rfbEncoderReset = 0;
+            if (rfbZStreamInit) deflateEnd(&rfbZStream);
+            rfbZStreamInit = 0;
+        }
+        if ((encoding == rfbEncodingZRLE) && !rfbZStreamInit) {
+            memset(&rfbZStream, 0, sizeof(rfbZStream));
+            deflateInit(&rfbZStream, Z_DEFAULT_COMPRESSION);
+            rfbZStreamInit = 1;
+        }
+#endif
+        buf.len = 0;
+        rfbBufferReserve(&buf, rfbFramebufferUpdateMessageSize);
+        rfbPut8(&buf, rfbFramebufferUpdate);
+        rfbPut8(&buf, 0);
+        rfbPut16(&buf, rfbEncoder.nrects + (rfbEncoder.resize ? 1 : 0));
+        if (rfbEncoder.resize) {
+            rfbPutRectHeader(&buf, 0, 0, rfbEncoder.width, rfbEncoder.height, rfbEncodingDesktopSize);
+        }
+        const Bit8u *pixels = rfbEncoder.pixels;
+        for (i = 0; i < rfbEncoder.nrects; i++) {
+            rfbRect *r = &rfbEncoder.rects[i];
+            rfbPutRectHeader(&buf, r->x, r->y, r->width, r->height, encoding);
+            if (encoding == rfbEncodingHextile) {
+                rfbEncodeHextile(&buf, pixels, r->width, r->height);
+#if BX_HAVE_ZLIB
+            } else if (encoding == rfbEncodingZRLE) {
+                rfbEncodeZRLE(&buf, &tmp, pixels, r->width, r->height);
+#endif
+            } else {
+                rfbBufferReserve(&buf, r->width * r->height);
+                memcpy(&buf.data[buf.len], pixels, r->width * r->height);
+                buf.len += r->width * r->height;
+            }
+            pixels += r->width * r->height;
+        }
+        if (sGlobal != INVALID_SOCKET) {
+            WriteExact(sGlobal, (char *)buf.data, buf.len);
         }
+        BX_LOCK(rfbEncoder.mutex);
+        rfbEncoder.busy = 0;
+        BX_UNLOCK(rfbEncoder.mutex);
     }
+    free(buf.data);
+    free(tmp.data);
+    BX_THREAD_EXIT;
 }
 
 void StartThread()
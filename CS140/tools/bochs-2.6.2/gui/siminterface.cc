@@ -1020,6 +1020,8 @@ bx_bool bx_real_sim_c::save_state(const char *checkpoint_path)
   int i, dev, ndev = SIM->get_n_log_modules();
   int type, ntype = SIM->get_max_log_level();
 
+  // let the devices complete pending operations first
+  DEV_before_save_state();
   get_param_string(BXPN_RESTORE_PATH)->set(checkpoint_path);
   sprintf(sr_file, "%s/config", checkpoint_path);
   if (write_rc(sr_file, 1) < 0)
@@ -1233,10 +1235,10 @@ bx_bool bx_real_sim_c::restore_bochs_param(bx_list_c *root, const char *sr_path,
                   fp2 = fopen(devdata, "rb");
                   if (fp2 != NULL) {
                     FILE **fpp = ((bx_shadow_filedata_c*)param)->get_fpp();
-                    // If the temporary backing store file wasn't created, do it now.
-                    if (*fpp == NULL)
+                    // Without a backing store the restore handler reads the data.
+                    if ((fpp != NULL) && (*fpp == NULL))
                       *fpp = tmpfile();
-                    if (*fpp != NULL) {
+                    if ((fpp != NULL) && (*fpp != NULL)) {
                       while (!feof(fp2)) {
                         char buffer[64];
                         size_t chars = fread(buffer, 1, sizeof(buffer), fp2);
@@ -1353,11 +1355,17 @@ bx_bool bx_real_sim_c::save_sr_param(FILE *fp, bx_param_c *node, const char *sr_
         sprintf(tmpstr, "%s/%s.%s", sr_path, node->get_parent()->get_name(), node->get_name());
       else
         sprintf(tmpstr, "%s.%s", node->get_parent()->get_name(), node->get_name());
+      // Without a backing store the save handler writes the file itself
+      // (it may still read the previous contents).
+      if (((bx_shadow_filedata_c*)node)->get_fpp() == NULL) {
+        ((bx_shadow_filedata_c*)node)->save(NULL);
+        break;
+      }
       fp2 = fopen(tmpstr, "wb");
       if (fp2 != NULL) {
         FILE **fpp = ((bx_shadow_filedata_c*)node)->get_fpp();
         // If the backing store hasn't been created, just save an empty 0 byte placeholder file.
-        if (*fpp != NULL) {
+        if ((fpp != NULL) && (*fpp != NULL)) {
           while (!feof(*fpp)) {
             char buffer[64];
             size_t chars = fread (buffer, 1, sizeof(buffer), *fpp);
@@ -557,6 +557,11 @@ enum {
 };
 #define BX_CLOCK_SYNC_LAST       BX_CLOCK_SYNC_BOTH
 
+enum {
+  BX_LOG_FORMAT_TEXT,
+  BX_LOG_FORMAT_BINARY
+};
+
 enum {
   BX_PCI_CHIPSET_I430FX,
   BX_PCI_CHIPSET_I440FX
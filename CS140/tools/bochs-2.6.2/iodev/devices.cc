@@ -345,6 +345,11 @@ void bx_devices_c::register_state()
   bx_plugins_register_state();
 }
 
+void bx_devices_c::before_save_state()
+{
+  bx_plugins_before_save_state();
+}
+
 void bx_devices_c::after_restore_state()
 {
   bx_slowdown_timer.after_restore_state();
@@ -964,6 +969,8 @@ bx_devices_c::inp(Bit16u addr, unsigned io_len)
 
   BX_INSTR_INP(addr, io_len);
 
+  BX_LOCK_IO();
+
   io_read_handler = read_port_to_handler[addr];
   if (io_read_handler->mask & io_len) {
     ret = ((bx_read_handler_t)io_read_handler->funct)(io_read_handler->this_ptr, (Bit32u)addr, io_len);
@@ -978,6 +985,8 @@ bx_devices_c::inp(Bit16u addr, unsigned io_len)
     }
   }
 
+  BX_UNLOCK_IO();
+
   BX_INSTR_INP2(addr, io_len, ret);
   BX_DBG_IO_REPORT(addr, io_len, BX_READ, ret);
 
@@ -997,12 +1006,16 @@ bx_devices_c::outp(Bit16u addr, Bit32u value, unsigned io_len)
   BX_INSTR_OUTP(addr, io_len, value);
   BX_DBG_IO_REPORT(addr, io_len, BX_WRITE, value);
 
+  BX_LOCK_IO();
+
   io_write_handler = write_port_to_handler[addr];
   if (io_write_handler->mask & io_len) {
     ((bx_write_handler_t)io_write_handler->funct)(io_write_handler->this_ptr, (Bit32u)addr, value, io_len);
   } else if (addr != 0x0cf8) { // don't flood the logfile when probing PCI
     BX_ERROR(("write to port 0x%04x with len %d ignored", addr, io_len));
   }
+
+  BX_UNLOCK_IO();
 }
 
 bx_bool bx_devices_c::is_harddrv_enabled(void)
@@ -1262,6 +1275,7 @@ bx_bool bx_devices_c::register_pci_handlers(bx_pci_device_stub_c *dev,
 }
 
 bx_bool bx_devices_c::pci_set_base_mem(void *this_ptr, memory_handler_t f1, memory_handler_t f2,
+                                       memory_direct_access_handler_t da,
                                        Bit32u *addr, Bit8u *pci_conf, unsigned size)
 {
   Bit32u newbase;
@@ -1284,7 +1298,7 @@ bx_bool bx_devices_c::pci_set_base_mem(void *this_ptr, memory_handler_t f1, memo
       DEV_unregister_memory_handlers(this_ptr, oldbase, oldbase + size - 1);
     }
     if (newbase > 0) {
-      DEV_register_memory_handlers(this_ptr, f1, f2, newbase, newbase + size - 1);
+      DEV_register_memory_handlers(this_ptr, f1, f2, da, newbase, newbase + size - 1);
     }
     *addr = newbase;
     return 1;
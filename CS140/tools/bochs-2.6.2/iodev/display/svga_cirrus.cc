@@ -72,6 +72,33 @@
 #define SVGA_WRITE(addr,val,len) svga_write(addr,val,len)
 #endif // BX_USE_CIRRUS_SMF
 
+// The BitBLT raster operations and the color expansion use the host SSE2
+// or AVX2 instructions when the host CPU has them, the portable code is
+// the fallback.
+#define BX_HOST_SIMD_BLT BX_HOST_X86_INSN
+
+#if BX_HOST_SIMD_BLT
+
+#include <emmintrin.h>
+
+#define BX_HOST_BLT_SSE2 1
+#define BX_HOST_BLT_AVX2 2
+
+static unsigned host_simd_blt = 0;
+
+// decided once at startup
+static struct bx_host_blt_init_t {
+  bx_host_blt_init_t() {
+    Bit32u features = bx_get_host_cpu_features();
+    if (features & BX_HOST_CPU_AVX2)
+      host_simd_blt = BX_HOST_BLT_AVX2;
+    else if (features & BX_HOST_CPU_SSE2)
+      host_simd_blt = BX_HOST_BLT_SSE2;
+  }
+} bx_host_blt_init;
+
+#endif // BX_HOST_SIMD_BLT
+
 #define ID_CLGD5428  (0x26<<2)
 #define ID_CLGD5430  (0x28<<2)
 #define ID_CLGD5434  (0x2A<<2)
@@ -125,6 +152,9 @@
 #define CIRRUS_BLTMODE_PIXELWIDTH24     0x20
 #define CIRRUS_BLTMODE_PIXELWIDTH32     0x30
 
+// largest BLT row (width register 0x20-0x21) rounded up to whole pixels
+#define CIRRUS_BLT_ROW_BYTES            (0x2000 + 4)
+
 // control 0x31
 #define CIRRUS_BLT_BUSY                 0x01
 #define CIRRUS_BLT_START                0x02
@@ -442,21 +472,21 @@ void bx_svga_cirrus_c::after_restore_state(void)
     if (BX_CIRRUS_THIS pci_enabled) {
       if (DEV_pci_set_base_mem(BX_CIRRUS_THIS_PTR, cirrus_mem_read_handler,
                                cirrus_mem_write_handler,
-                               &BX_CIRRUS_THIS pci_base_address[0],
+                               cirrus_mem_da_handler, &BX_CIRRUS_THIS pci_base_address[0],
                                &BX_CIRRUS_THIS pci_conf[0x10],
                                0x2000000)) {
         BX_INFO(("new pci_memaddr: 0x%04x", BX_CIRRUS_THIS pci_base_address[0]));
       }
       if (DEV_pci_set_base_mem(BX_CIRRUS_THIS_PTR, cirrus_mem_read_handler,
                                cirrus_mem_write_handler,
-                               &BX_CIRRUS_THIS pci_base_address[1],
+                               NULL, &BX_CIRRUS_THIS pci_base_address[1],
                                &BX_CIRRUS_THIS pci_conf[0x14],
                                CIRRUS_PNPMMIO_SIZE)) {
         BX_INFO(("new pci_mmioaddr = 0x%08x", BX_CIRRUS_THIS pci_base_address[1]));
       }
       if (DEV_pci_set_base_mem(BX_CIRRUS_THIS_PTR, cirrus_mem_read_handler,
                                cirrus_mem_write_handler,
-                               &BX_CIRRUS_THIS pci_rom_address,
+                               NULL, &BX_CIRRUS_THIS pci_rom_address,
                                &BX_CIRRUS_THIS pci_conf[0x30],
                                BX_CIRRUS_THIS pci_rom_size)) {
         BX_INFO(("new ROM address: 0x%08x", BX_CIRRUS_THIS pci_rom_address));
@@ -692,6 +722,30 @@ Bit8u bx_svga_cirrus_c::mem_read(bx_phy_address addr)
 }
 
 #if BX_SUPPORT_PCI
+// The CPUs may access the linear framebuffer directly as long as mem_write()
+// would store the bytes unchanged: not in VGA mode, with address shifting
+// or extended write modes (GR0B), during a CPU-to-video BLT or in the page
+// holding the memory-mapped BLT registers.
+Bit8u *bx_svga_cirrus_c::cirrus_mem_da_handler(bx_phy_address addr, unsigned rw, void *param)
+{
+  if (((BX_CIRRUS_THIS sequencer.reg[0x07] & 0x01) == CIRRUS_SR7_BPP_VGA) ||
+      (BX_CIRRUS_THIS control.reg[0x0b] & 0x06) ||
+      (BX_CIRRUS_THIS bitblt.memsrc_needed > 0) ||
+      (BX_CIRRUS_THIS bitblt.memdst_needed != 0)) {
+    return NULL;
+  }
+  if ((addr < BX_CIRRUS_THIS pci_base_address[0]) ||
+      (addr >= (BX_CIRRUS_THIS pci_base_address[0] + CIRRUS_PNPMEM_SIZE))) {
+    return NULL;
+  }
+  Bit32u offset = addr & (BX_CIRRUS_THIS s.memsize - 1);
+  if (((offset | 0xfff) >= (BX_CIRRUS_THIS s.memsize - 256)) &&
+      ((BX_CIRRUS_THIS sequencer.reg[0x17] & 0x44) == 0x44)) {
+    return NULL;
+  }
+  return BX_CIRRUS_THIS lfb_host_ptr(offset, rw);
+}
+
 bx_bool bx_svga_cirrus_c::cirrus_mem_write_handler(bx_phy_address addr, unsigned len,
                                          void *data, void *param)
 {
@@ -1282,6 +1336,11 @@ void bx_svga_cirrus_c::svga_update(void)
     BX_CIRRUS_THIS svga_needs_update_dispentire = 0;
   }
 
+  if (BX_CIRRUS_THIS lfb_update_tiles((Bit32u)(BX_CIRRUS_THIS disp_ptr - BX_CIRRUS_THIS s.memory),
+                                      pitch, BX_CIRRUS_THIS svga_bpp >> 3, width, height)) {
+    BX_CIRRUS_THIS svga_needs_update_tile = 1;
+  }
+
   if (!BX_CIRRUS_THIS svga_needs_update_tile) {
     return;
   }
@@ -1771,6 +1830,7 @@ void bx_svga_cirrus_c::svga_write_sequencer(Bit32u address, unsigned index, Bit8
   BX_DEBUG(("sequencer: index 0x%02x write 0x%02x", index, (unsigned)value));
 
   bx_bool update_cursor = 0;
+  bx_bool lfb_changed = 0;
   Bit16u x, y, size;
 
   x = BX_CIRRUS_THIS hw_cursor.x;
@@ -1805,6 +1865,9 @@ void bx_svga_cirrus_c::svga_write_sequencer(Bit32u address, unsigned index, Bit8
     case 0x7: // cirrus extended sequencer mode
       if (value != BX_CIRRUS_THIS sequencer.reg[0x7]) {
         BX_CIRRUS_THIS svga_needs_update_mode = 1;
+        if ((value ^ BX_CIRRUS_THIS sequencer.reg[0x7]) & 0x01) {
+          lfb_changed = 1;
+        }
       }
       break;
     case 0x08:
@@ -1867,6 +1930,9 @@ void bx_svga_cirrus_c::svga_write_sequencer(Bit32u address, unsigned index, Bit8
       break;
     case 0x17:
       value = (BX_CIRRUS_THIS sequencer.reg[0x17] & 0x38) | (value & 0xc7);
+      if ((value ^ BX_CIRRUS_THIS sequencer.reg[0x17]) & 0x44) {
+        lfb_changed = 1;
+      }
       break;
     default:
       BX_DEBUG(("sequencer index 0x%02x is unknown(write 0x%02x)", index, (unsigned)value));
@@ -1881,6 +1947,10 @@ void bx_svga_cirrus_c::svga_write_sequencer(Bit32u address, unsigned index, Bit8
   if (index <= CIRRUS_SEQENCER_MAX) {
     BX_CIRRUS_THIS sequencer.reg[index] = value;
   }
+  if (lfb_changed) {
+    // direct access to the framebuffer aperture changed
+    BX_CIRRUS_THIS lfb_unmap(1);
+  }
   if (index <= VGA_SEQENCER_MAX) {
     VGA_WRITE(address,value,1);
   }
@@ -1983,6 +2053,9 @@ void bx_svga_cirrus_c::svga_write_control(Bit32u address, unsigned index, Bit8u
     case 0x0A: // bank offset #1
     case 0x0B:
       BX_CIRRUS_THIS control.reg[index] = value;
+      if ((value ^ old_value) & 0x06) {
+        BX_CIRRUS_THIS lfb_unmap();
+      }
       update_bank_ptr(0);
       update_bank_ptr(1);
       break;
@@ -2483,7 +2556,7 @@ void bx_svga_cirrus_c::pci_write_handler(Bit8u address, Bit32u value, unsigned i
   if (baseaddr0_change) {
     if (DEV_pci_set_base_mem(BX_CIRRUS_THIS_PTR, cirrus_mem_read_handler,
                              cirrus_mem_write_handler,
-                             &BX_CIRRUS_THIS pci_base_address[0],
+                             cirrus_mem_da_handler, &BX_CIRRUS_THIS pci_base_address[0],
                              &BX_CIRRUS_THIS pci_conf[0x10],
                              0x2000000)) {
       BX_INFO(("new pci_memaddr: 0x%04x", BX_CIRRUS_THIS pci_base_address[0]));
@@ -2492,7 +2565,7 @@ void bx_svga_cirrus_c::pci_write_handler(Bit8u address, Bit32u value, unsigned i
   if (baseaddr1_change) {
     if (DEV_pci_set_base_mem(BX_CIRRUS_THIS_PTR, cirrus_mem_read_handler,
                              cirrus_mem_write_handler,
-                             &BX_CIRRUS_THIS pci_base_address[1],
+                             NULL, &BX_CIRRUS_THIS pci_base_address[1],
                              &BX_CIRRUS_THIS pci_conf[0x14],
                              CIRRUS_PNPMMIO_SIZE)) {
       BX_INFO(("new pci_mmioaddr = 0x%08x", BX_CIRRUS_THIS pci_base_address[1]));
@@ -2501,7 +2574,7 @@ void bx_svga_cirrus_c::pci_write_handler(Bit8u address, Bit32u value, unsigned i
   if (romaddr_change) {
     if (DEV_pci_set_base_mem(BX_CIRRUS_THIS_PTR, cirrus_mem_read_handler,
                              cirrus_mem_write_handler,
-                             &BX_CIRRUS_THIS pci_rom_address,
+                             NULL, &BX_CIRRUS_THIS pci_rom_address,
                              &BX_CIRRUS_THIS pci_conf[0x30],
                              BX_CIRRUS_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_CIRRUS_THIS pci_rom_address));
@@ -2680,6 +2753,8 @@ void bx_svga_cirrus_c::svga_setup_bitblt_cputovideo(Bit32u dstaddr,Bit32u srcadd
         BX_CIRRUS_THIS bitblt.srcpitch * BX_CIRRUS_THIS bitblt.bltheight;
   }
   BX_CIRRUS_THIS bitblt.memsrc_endptr += BX_CIRRUS_THIS bitblt.srcpitch;
+  // the source data is written to the framebuffer aperture
+  BX_CIRRUS_THIS lfb_unmap();
 }
 
 void bx_svga_cirrus_c::svga_setup_bitblt_videotocpu(Bit32u dstaddr,Bit32u srcaddr)
@@ -2772,6 +2847,78 @@ void bx_svga_cirrus_c::svga_colorexpand_32_static(void *this_ptr,Bit8u *dst,cons
 
 #endif // BX_USE_CIRRUS_SMF
 
+#if BX_HOST_SIMD_BLT
+// Expands whole source bytes (8 pixels each) of 1, 2 or 4 bytes per pixel
+// and returns the number of pixels done, the caller expands the rest.
+__attribute__((target("sse2")))
+static int host_colorexpand_sse2(Bit8u *dst, const Bit8u *src, int count,
+                                 int pixelwidth, const Bit8u *bg, const Bit8u *fg)
+{
+  __m128i vbg, vfg, sel_lo, sel_hi, bits, mask;
+  int done;
+
+  switch (pixelwidth) {
+    case 1:
+      vbg = _mm_set1_epi8((char) bg[0]);
+      vfg = _mm_set1_epi8((char) fg[0]);
+      sel_lo = _mm_setr_epi8((char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                             0, 0, 0, 0, 0, 0, 0, 0);
+      sel_hi = sel_lo;
+      break;
+    case 2:
+      vbg = _mm_set1_epi16((short) (bg[0] | (bg[1] << 8)));
+      vfg = _mm_set1_epi16((short) (fg[0] | (fg[1] << 8)));
+      sel_lo = _mm_setr_epi8((char) 0x80, (char) 0x80, 0x40, 0x40, 0x20, 0x20, 0x10, 0x10,
+                             0x08, 0x08, 0x04, 0x04, 0x02, 0x02, 0x01, 0x01);
+      sel_hi = sel_lo;
+      break;
+    case 4:
+      vbg = _mm_set1_epi32((int) (bg[0] | (bg[1] << 8) | (bg[2] << 16) | ((Bit32u) bg[3] << 24)));
+      vfg = _mm_set1_epi32((int) (fg[0] | (fg[1] << 8) | (fg[2] << 16) | ((Bit32u) fg[3] << 24)));
+      sel_lo = _mm_setr_epi8((char) 0x80, (char) 0x80, (char) 0x80, (char) 0x80,
+                             0x40, 0x40, 0x40, 0x40, 0x20, 0x20, 0x20, 0x20, 0x10, 0x10, 0x10, 0x10);
+      sel_hi = _mm_setr_epi8(0x08, 0x08, 0x08, 0x08, 0x04, 0x04, 0x04, 0x04,
+                             0x02, 0x02, 0x02, 0x02, 0x01, 0x01, 0x01, 0x01);
+      break;
+    default:
+      return 0;
+  }
+
+  for (done = 0; (done + 8) <= count; done += 8) {
+    bits = _mm_set1_epi8((char) *src++);
+    // pixels whose bit is set take the foreground color
+    mask = _mm_cmpeq_epi8(_mm_and_si128(bits, sel_lo), sel_lo);
+    mask = _mm_or_si128(_mm_and_si128(mask, vfg), _mm_andnot_si128(mask, vbg));
+    if (pixelwidth == 1) {
+      _mm_storel_epi64((__m128i *) dst, mask);
+      dst += 8;
+      continue;
+    }
+    _mm_storeu_si128((__m128i *) dst, mask);
+    dst += 16;
+    if (pixelwidth == 4) {
+      mask = _mm_cmpeq_epi8(_mm_and_si128(bits, sel_hi), sel_hi);
+      mask = _mm_or_si128(_mm_and_si128(mask, vfg), _mm_andnot_si128(mask, vbg));
+      _mm_storeu_si128((__m128i *) dst, mask);
+      dst += 16;
+    }
+  }
+  return done;
+}
+
+// Lets the SSE2 code expand the leading whole source bytes.
+#define BX_HOST_COLOREXPAND(pixelwidth, bg, fg) \
+  if (host_simd_blt) { \
+    int done = host_colorexpand_sse2(dst, src, count, pixelwidth, bg, fg); \
+    dst += done * (pixelwidth); \
+    src += done >> 3; \
+    count -= done; \
+    if (count == 0) return; \
+  }
+#else
+#define BX_HOST_COLOREXPAND(pixelwidth, bg, fg)
+#endif
+
 void bx_svga_cirrus_c::svga_colorexpand_8(Bit8u *dst,const Bit8u *src,int count)
 {
   Bit8u colors[2];
@@ -2780,6 +2927,7 @@ void bx_svga_cirrus_c::svga_colorexpand_8(Bit8u *dst,const Bit8u *src,int count)
 
   colors[0] = BX_CIRRUS_THIS control.shadow_reg0;
   colors[1] = BX_CIRRUS_THIS control.shadow_reg1;
+  BX_HOST_COLOREXPAND(1, &colors[0], &colors[1])
 
   bitmask = 0x80;
   bits = *src++;
@@ -2804,6 +2952,7 @@ void bx_svga_cirrus_c::svga_colorexpand_16(Bit8u *dst,const Bit8u *src,int count
   colors[0][1] = BX_CIRRUS_THIS control.reg[0x10];
   colors[1][0] = BX_CIRRUS_THIS control.shadow_reg1;
   colors[1][1] = BX_CIRRUS_THIS control.reg[0x11];
+  BX_HOST_COLOREXPAND(2, colors[0], colors[1])
 
   bitmask = 0x80;
   bits = *src++;
@@ -2863,6 +3012,7 @@ void bx_svga_cirrus_c::svga_colorexpand_32(Bit8u *dst,const Bit8u *src,int count
   colors[1][1] = BX_CIRRUS_THIS control.reg[0x11];
   colors[1][2] = BX_CIRRUS_THIS control.reg[0x13];
   colors[1][3] = BX_CIRRUS_THIS control.reg[0x15];
+  BX_HOST_COLOREXPAND(4, colors[0], colors[1])
 
   bitmask = 0x80;
   bits = *src++;
@@ -2913,13 +3063,24 @@ void bx_svga_cirrus_c::svga_colorexpand_transp_memsrc_static(void *this_ptr)
 
 #endif // !BX_USE_CIRRUS_SMF
 
+// Repeats the first 'len' bytes of 'row' until it is 'rowbytes' long.
+static void svga_replicate_row(Bit8u *row, int len, int rowbytes)
+{
+  while ((len > 0) && (len < rowbytes)) {
+    int n = (len < (rowbytes - len)) ? len : (rowbytes - len);
+    memcpy(row + len, row, n);
+    len += n;
+  }
+}
+
 void bx_svga_cirrus_c::svga_patterncopy()
 {
   Bit8u color[4];
   Bit8u work_colorexp[256];
+  Bit8u work_row[CIRRUS_BLT_ROW_BYTES];
   Bit8u *src, *dst;
-  Bit8u *dstc, *srcc, *src2;
-  int x, y, pattern_x, pattern_y, srcskipleft;
+  Bit8u *srcc, *src2;
+  int x, y, i, rowbytes, pattern_x, pattern_y, srcskipleft;
   int patternbytes = 8 * BX_CIRRUS_THIS bitblt.pixelwidth;
   int pattern_pitch = patternbytes;
   int bltbytes = BX_CIRRUS_THIS bitblt.bltwidth;
@@ -2984,15 +3145,23 @@ void bx_svga_cirrus_c::svga_patterncopy()
   dst = BX_CIRRUS_THIS bitblt.dst;
   pattern_y = BX_CIRRUS_THIS bitblt.srcaddr & 0x07;
   src = (Bit8u *)BX_CIRRUS_THIS bitblt.src;
+  // the pattern pixels of a row are laid out once and passed to the raster
+  // operation in a single call, the row repeats every 8 pixels
+  rowbytes = 0;
+  if (pattern_x < bltbytes) {
+    rowbytes = (bltbytes - pattern_x + BX_CIRRUS_THIS bitblt.pixelwidth - 1) /
+               BX_CIRRUS_THIS bitblt.pixelwidth * BX_CIRRUS_THIS bitblt.pixelwidth;
+  }
   for (y = 0; y < BX_CIRRUS_THIS bitblt.bltheight; y++) {
     srcc = src + pattern_y * pattern_pitch;
-    dstc = dst + pattern_x;
-    for (x = pattern_x; x < bltbytes; x += BX_CIRRUS_THIS bitblt.pixelwidth) {
+    for (x = pattern_x, i = 0; (i < rowbytes) && (i < patternbytes); x += BX_CIRRUS_THIS bitblt.pixelwidth) {
       src2 = srcc + (x % patternbytes);
-      (*BX_CIRRUS_THIS bitblt.rop_handler)(
-        dstc, src2, 0, 0, BX_CIRRUS_THIS bitblt.pixelwidth, 1);
-      dstc += BX_CIRRUS_THIS bitblt.pixelwidth;
+      memcpy(&work_row[i], src2, BX_CIRRUS_THIS bitblt.pixelwidth);
+      i += BX_CIRRUS_THIS bitblt.pixelwidth;
     }
+    svga_replicate_row(work_row, i, rowbytes);
+    (*BX_CIRRUS_THIS bitblt.rop_handler)(
+      dst + pattern_x, work_row, 0, 0, rowbytes, 1);
     pattern_y = (pattern_y + 1) & 7;
     dst += BX_CIRRUS_THIS bitblt.dstpitch;
   }
@@ -3075,8 +3244,8 @@ void bx_svga_cirrus_c::svga_simplebitblt()
 void bx_svga_cirrus_c::svga_solidfill()
 {
   Bit8u color[4];
-  int x, y;
-  Bit8u *dst;
+  Bit8u work_row[CIRRUS_BLT_ROW_BYTES];
+  int y, rowbytes;
 
   BX_DEBUG(("BLT: SOLIDFILL"));
 
@@ -3085,13 +3254,14 @@ void bx_svga_cirrus_c::svga_solidfill()
   color[2] = BX_CIRRUS_THIS control.reg[0x13];
   color[3] = BX_CIRRUS_THIS control.reg[0x15];
 
+  // the fill is done a row at a time from a row of the color
+  rowbytes = (BX_CIRRUS_THIS bitblt.bltwidth + BX_CIRRUS_THIS bitblt.pixelwidth - 1) /
+             BX_CIRRUS_THIS bitblt.pixelwidth * BX_CIRRUS_THIS bitblt.pixelwidth;
+  memcpy(work_row, color, BX_CIRRUS_THIS bitblt.pixelwidth);
+  svga_replicate_row(work_row, BX_CIRRUS_THIS bitblt.pixelwidth, rowbytes);
   for (y = 0; y < BX_CIRRUS_THIS bitblt.bltheight; y++) {
-    dst = BX_CIRRUS_THIS bitblt.dst;
-    for (x = 0; x < BX_CIRRUS_THIS bitblt.bltwidth; x+=BX_CIRRUS_THIS bitblt.pixelwidth) {
-      (*BX_CIRRUS_THIS bitblt.rop_handler)(
-        dst, &color[0], 0, 0, BX_CIRRUS_THIS bitblt.pixelwidth, 1);
-        dst += BX_CIRRUS_THIS bitblt.pixelwidth;
-    }
+    (*BX_CIRRUS_THIS bitblt.rop_handler)(
+      BX_CIRRUS_THIS bitblt.dst, work_row, 0, 0, rowbytes, 1);
     BX_CIRRUS_THIS bitblt.dst += BX_CIRRUS_THIS bitblt.dstpitch;
   }
   BX_CIRRUS_THIS redraw_area(BX_CIRRUS_THIS redraw.x, BX_CIRRUS_THIS redraw.y,
@@ -3243,6 +3413,11 @@ cleanup:
 //
 /////////////////////////////////////////////////////////////////////////
 
+// Each raster operation is written once as an expression on the source
+// byte(s) 's' and destination byte(s) 'd'. The same expression serves the
+// scalar kernels and, on x86 hosts, the SSE2 and AVX2 kernels built with
+// GCC vector types.
+
 #define IMPLEMENT_FORWARD_BITBLT(name,opline) \
   static void bitblt_rop_fwd_##name( \
     Bit8u *dst,const Bit8u *src, \
@@ -3254,7 +3429,10 @@ cleanup:
     srcpitch -= bltwidth; \
     for (y = 0; y < bltheight; y++) { \
       for (x = 0; x < bltwidth; x++) { \
+        Bit8u s = *src, d = *dst; \
+        UNUSED(s); \
         opline; \
+        *dst = d; \
         dst++; \
         src++; \
       } \
@@ -3274,7 +3452,10 @@ cleanup:
     srcpitch += bltwidth; \
     for (y = 0; y < bltheight; y++) { \
       for (x = 0; x < bltwidth; x++) { \
+        Bit8u s = *src, d = *dst; \
+        UNUSED(s); \
         opline; \
+        *dst = d; \
         dst--; \
         src--; \
       } \
@@ -3283,39 +3464,118 @@ cleanup:
     } \
   }
 
-IMPLEMENT_FORWARD_BITBLT(0, *dst = 0)
-IMPLEMENT_FORWARD_BITBLT(src_and_dst, *dst = (*src) & (*dst))
+#if BX_HOST_SIMD_BLT
+
+typedef Bit8u bx_blt_sse2_t __attribute__((vector_size(16)));
+typedef Bit8u bx_blt_avx2_t __attribute__((vector_size(32)));
+
+// A vector may only be used for a row if the destination does not run
+// less than one vector ahead of the source, otherwise the bytes written
+// would no longer feed the following reads as in the scalar loop.
+static BX_CPP_INLINE bx_bool bitblt_vector_ok(const Bit8u *ahead, const Bit8u *behind, int vsize)
+{
+  return (ahead <= behind) || (ahead >= (behind + vsize));
+}
+
+#define IMPLEMENT_SIMD_BITBLT(isa,name,opline) \
+  __attribute__((target(#isa))) \
+  static void bitblt_rop_fwd_##isa##_##name( \
+    Bit8u *dst,const Bit8u *src, \
+    int dstpitch,int srcpitch, \
+    int bltwidth,int bltheight) \
+  { \
+    const int vsize = sizeof(bx_blt_##isa##_t); \
+    for (int y = 0; y < bltheight; y++) { \
+      int x = 0; \
+      if (bitblt_vector_ok(dst, src, vsize)) { \
+        for (; (x + vsize) <= bltwidth; x += vsize) { \
+          bx_blt_##isa##_t s, d; \
+          memcpy(&s, src + x, vsize); \
+          memcpy(&d, dst + x, vsize); \
+          UNUSED(s); \
+          opline; \
+          memcpy(dst + x, &d, vsize); \
+        } \
+      } \
+      for (; x < bltwidth; x++) { \
+        Bit8u s = src[x], d = dst[x]; \
+        UNUSED(s); \
+        opline; \
+        dst[x] = d; \
+      } \
+      dst += dstpitch; \
+      src += srcpitch; \
+    } \
+  } \
+  __attribute__((target(#isa))) \
+  static void bitblt_rop_bkwd_##isa##_##name( \
+    Bit8u *dst,const Bit8u *src, \
+    int dstpitch,int srcpitch, \
+    int bltwidth,int bltheight) \
+  { \
+    const int vsize = sizeof(bx_blt_##isa##_t); \
+    for (int y = 0; y < bltheight; y++) { \
+      int x = 0; \
+      if (bitblt_vector_ok(src, dst, vsize)) { \
+        for (; (x + vsize) <= bltwidth; x += vsize) { \
+          bx_blt_##isa##_t s, d; \
+          memcpy(&s, src - x - (vsize - 1), vsize); \
+          memcpy(&d, dst - x - (vsize - 1), vsize); \
+          UNUSED(s); \
+          opline; \
+          memcpy(dst - x - (vsize - 1), &d, vsize); \
+        } \
+      } \
+      for (; x < bltwidth; x++) { \
+        Bit8u s = src[-x], d = dst[-x]; \
+        UNUSED(s); \
+        opline; \
+        dst[-x] = d; \
+      } \
+      dst += dstpitch; \
+      src += srcpitch; \
+    } \
+  }
+
+#define IMPLEMENT_BITBLT(name,opline) \
+  IMPLEMENT_FORWARD_BITBLT(name,opline) \
+  IMPLEMENT_BACKWARD_BITBLT(name,opline) \
+  IMPLEMENT_SIMD_BITBLT(sse2,name,opline) \
+  IMPLEMENT_SIMD_BITBLT(avx2,name,opline)
+
+#define BX_CIRRUS_ROP(dir,name) \
+  ((host_simd_blt == BX_HOST_BLT_AVX2) ? bitblt_rop_##dir##_avx2_##name : \
+   (host_simd_blt == BX_HOST_BLT_SSE2) ? bitblt_rop_##dir##_sse2_##name : \
+                                         bitblt_rop_##dir##_##name)
+
+#else
+
+#define IMPLEMENT_BITBLT(name,opline) \
+  IMPLEMENT_FORWARD_BITBLT(name,opline) \
+  IMPLEMENT_BACKWARD_BITBLT(name,opline)
+
+#define BX_CIRRUS_ROP(dir,name) bitblt_rop_##dir##_##name
+
+#endif // BX_HOST_SIMD_BLT
+
 IMPLEMENT_FORWARD_BITBLT(nop, (void)0)
-IMPLEMENT_FORWARD_BITBLT(src_and_notdst, *dst = (*src) & (~(*dst)))
-IMPLEMENT_FORWARD_BITBLT(notdst, *dst = ~(*dst))
-IMPLEMENT_FORWARD_BITBLT(src, *dst = *src)
-IMPLEMENT_FORWARD_BITBLT(1, *dst = 0xff)
-IMPLEMENT_FORWARD_BITBLT(notsrc_and_dst, *dst = (~(*src)) & (*dst))
-IMPLEMENT_FORWARD_BITBLT(src_xor_dst, *dst = (*src) ^ (*dst))
-IMPLEMENT_FORWARD_BITBLT(src_or_dst, *dst = (*src) | (*dst))
-IMPLEMENT_FORWARD_BITBLT(notsrc_or_notdst, *dst = (~(*src)) | (~(*dst)))
-IMPLEMENT_FORWARD_BITBLT(src_notxor_dst, *dst = ~((*src) ^ (*dst)))
-IMPLEMENT_FORWARD_BITBLT(src_or_notdst, *dst = (*src) | (~(*dst)))
-IMPLEMENT_FORWARD_BITBLT(notsrc, *dst = (~(*src)))
-IMPLEMENT_FORWARD_BITBLT(notsrc_or_dst, *dst = (~(*src)) | (*dst))
-IMPLEMENT_FORWARD_BITBLT(notsrc_and_notdst, *dst = (~(*src)) & (~(*dst)))
-
-IMPLEMENT_BACKWARD_BITBLT(0, *dst = 0)
-IMPLEMENT_BACKWARD_BITBLT(src_and_dst, *dst = (*src) & (*dst))
 IMPLEMENT_BACKWARD_BITBLT(nop, (void)0)
-IMPLEMENT_BACKWARD_BITBLT(src_and_notdst, *dst = (*src) & (~(*dst)))
-IMPLEMENT_BACKWARD_BITBLT(notdst, *dst = ~(*dst))
-IMPLEMENT_BACKWARD_BITBLT(src, *dst = *src)
-IMPLEMENT_BACKWARD_BITBLT(1, *dst = 0xff)
-IMPLEMENT_BACKWARD_BITBLT(notsrc_and_dst, *dst = (~(*src)) & (*dst))
-IMPLEMENT_BACKWARD_BITBLT(src_xor_dst, *dst = (*src) ^ (*dst))
-IMPLEMENT_BACKWARD_BITBLT(src_or_dst, *dst = (*src) | (*dst))
-IMPLEMENT_BACKWARD_BITBLT(notsrc_or_notdst, *dst = (~(*src)) | (~(*dst)))
-IMPLEMENT_BACKWARD_BITBLT(src_notxor_dst, *dst = ~((*src) ^ (*dst)))
-IMPLEMENT_BACKWARD_BITBLT(src_or_notdst, *dst = (*src) | (~(*dst)))
-IMPLEMENT_BACKWARD_BITBLT(notsrc, *dst = (~(*src)))
-IMPLEMENT_BACKWARD_BITBLT(notsrc_or_dst, *dst = (~(*src)) | (*dst))
-IMPLEMENT_BACKWARD_BITBLT(notsrc_and_notdst, *dst = (~(*src)) & (~(*dst)))
+
+IMPLEMENT_BITBLT(0, d ^= d)
+IMPLEMENT_BITBLT(src_and_dst, d = s & d)
+IMPLEMENT_BITBLT(src_and_notdst, d = s & ~d)
+IMPLEMENT_BITBLT(notdst, d = ~d)
+IMPLEMENT_BITBLT(src, d = s)
+IMPLEMENT_BITBLT(1, d |= ~d)
+IMPLEMENT_BITBLT(notsrc_and_dst, d = ~s & d)
+IMPLEMENT_BITBLT(src_xor_dst, d = s ^ d)
+IMPLEMENT_BITBLT(src_or_dst, d = s | d)
+IMPLEMENT_BITBLT(notsrc_or_notdst, d = ~s | ~d)
+IMPLEMENT_BITBLT(src_notxor_dst, d = ~(s ^ d))
+IMPLEMENT_BITBLT(src_or_notdst, d = s | ~d)
+IMPLEMENT_BITBLT(notsrc, d = ~s)
+IMPLEMENT_BITBLT(notsrc_or_dst, d = ~s | d)
+IMPLEMENT_BITBLT(notsrc_and_notdst, d = ~s & ~d)
 
 bx_cirrus_bitblt_rop_t bx_svga_cirrus_c::svga_get_fwd_rop_handler(Bit8u rop)
 {
@@ -3324,52 +3584,52 @@ bx_cirrus_bitblt_rop_t bx_svga_cirrus_c::svga_get_fwd_rop_handler(Bit8u rop)
   switch (rop)
   {
     case CIRRUS_ROP_0:
-      rop_handler = bitblt_rop_fwd_0;
+      rop_handler = BX_CIRRUS_ROP(fwd, 0);
       break;
     case CIRRUS_ROP_SRC_AND_DST:
-      rop_handler = bitblt_rop_fwd_src_and_dst;
+      rop_handler = BX_CIRRUS_ROP(fwd, src_and_dst);
       break;
     case CIRRUS_ROP_NOP:
       rop_handler = bitblt_rop_fwd_nop;
       break;
     case CIRRUS_ROP_SRC_AND_NOTDST:
-      rop_handler = bitblt_rop_fwd_src_and_notdst;
+      rop_handler = BX_CIRRUS_ROP(fwd, src_and_notdst);
       break;
     case CIRRUS_ROP_NOTDST:
-      rop_handler = bitblt_rop_fwd_notdst;
+      rop_handler = BX_CIRRUS_ROP(fwd, notdst);
       break;
     case CIRRUS_ROP_SRC:
-      rop_handler = bitblt_rop_fwd_src;
+      rop_handler = BX_CIRRUS_ROP(fwd, src);
       break;
     case CIRRUS_ROP_1:
-      rop_handler = bitblt_rop_fwd_1;
+      rop_handler = BX_CIRRUS_ROP(fwd, 1);
       break;
     case CIRRUS_ROP_NOTSRC_AND_DST:
-      rop_handler = bitblt_rop_fwd_notsrc_and_dst;
+      rop_handler = BX_CIRRUS_ROP(fwd, notsrc_and_dst);
       break;
     case CIRRUS_ROP_SRC_XOR_DST:
-      rop_handler = bitblt_rop_fwd_src_xor_dst;
+      rop_handler = BX_CIRRUS_ROP(fwd, src_xor_dst);
       break;
     case CIRRUS_ROP_SRC_OR_DST:
-      rop_handler = bitblt_rop_fwd_src_or_dst;
+      rop_handler = BX_CIRRUS_ROP(fwd, src_or_dst);
       break;
     case CIRRUS_ROP_NOTSRC_OR_NOTDST:
-      rop_handler = bitblt_rop_fwd_notsrc_or_notdst;
+      rop_handler = BX_CIRRUS_ROP(fwd, notsrc_or_notdst);
       break;
     case CIRRUS_ROP_SRC_NOTXOR_DST:
-      rop_handler = bitblt_rop_fwd_src_notxor_dst;
+      rop_handler = BX_CIRRUS_ROP(fwd, src_notxor_dst);
       break;
     case CIRRUS_ROP_SRC_OR_NOTDST:
-      rop_handler = bitblt_rop_fwd_src_or_notdst;
+      rop_handler = BX_CIRRUS_ROP(fwd, src_or_notdst);
       break;
     case CIRRUS_ROP_NOTSRC:
-      rop_handler = bitblt_rop_fwd_notsrc;
+      rop_handler = BX_CIRRUS_ROP(fwd, notsrc);
       break;
     case CIRRUS_ROP_NOTSRC_OR_DST:
-      rop_handler = bitblt_rop_fwd_notsrc_or_dst;
+      rop_handler = BX_CIRRUS_ROP(fwd, notsrc_or_dst);
       break;
     case CIRRUS_ROP_NOTSRC_AND_NOTDST:
-      rop_handler = bitblt_rop_fwd_notsrc_and_notdst;
+      rop_handler = BX_CIRRUS_ROP(fwd, notsrc_and_notdst);
       break;
     default:
       BX_ERROR(("unknown ROP %02x",rop));
@@ -3386,52 +3646,52 @@ bx_cirrus_bitblt_rop_t bx_svga_cirrus_c::svga_get_bkwd_rop_handler(Bit8u rop)
   switch (rop)
   {
     case CIRRUS_ROP_0:
-      rop_handler = bitblt_rop_bkwd_0;
+      rop_handler = BX_CIRRUS_ROP(bkwd, 0);
       break;
     case CIRRUS_ROP_SRC_AND_DST:
-      rop_handler = bitblt_rop_bkwd_src_and_dst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, src_and_dst);
       break;
     case CIRRUS_ROP_NOP:
       rop_handler = bitblt_rop_bkwd_nop;
       break;
     case CIRRUS_ROP_SRC_AND_NOTDST:
-      rop_handler = bitblt_rop_bkwd_src_and_notdst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, src_and_notdst);
       break;
     case CIRRUS_ROP_NOTDST:
-      rop_handler = bitblt_rop_bkwd_notdst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, notdst);
       break;
     case CIRRUS_ROP_SRC:
-      rop_handler = bitblt_rop_bkwd_src;
+      rop_handler = BX_CIRRUS_ROP(bkwd, src);
       break;
     case CIRRUS_ROP_1:
-      rop_handler = bitblt_rop_bkwd_1;
+      rop_handler = BX_CIRRUS_ROP(bkwd, 1);
       break;
     case CIRRUS_ROP_NOTSRC_AND_DST:
-      rop_handler = bitblt_rop_bkwd_notsrc_and_dst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, notsrc_and_dst);
       break;
     case CIRRUS_ROP_SRC_XOR_DST:
-      rop_handler = bitblt_rop_bkwd_src_xor_dst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, src_xor_dst);
       break;
     case CIRRUS_ROP_SRC_OR_DST:
-      rop_handler = bitblt_rop_bkwd_src_or_dst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, src_or_dst);
       break;
     case CIRRUS_ROP_NOTSRC_OR_NOTDST:
-      rop_handler = bitblt_rop_bkwd_notsrc_or_notdst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, notsrc_or_notdst);
       break;
     case CIRRUS_ROP_SRC_NOTXOR_DST:
-      rop_handler = bitblt_rop_bkwd_src_notxor_dst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, src_notxor_dst);
       break;
     case CIRRUS_ROP_SRC_OR_NOTDST:
-      rop_handler = bitblt_rop_bkwd_src_or_notdst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, src_or_notdst);
       break;
     case CIRRUS_ROP_NOTSRC:
-      rop_handler = bitblt_rop_bkwd_notsrc;
+      rop_handler = BX_CIRRUS_ROP(bkwd, notsrc);
       break;
     case CIRRUS_ROP_NOTSRC_OR_DST:
-      rop_handler = bitblt_rop_bkwd_notsrc_or_dst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, notsrc_or_dst);
       break;
     case CIRRUS_ROP_NOTSRC_AND_NOTDST:
-      rop_handler = bitblt_rop_bkwd_notsrc_and_notdst;
+      rop_handler = BX_CIRRUS_ROP(bkwd, notsrc_and_notdst);
       break;
     default:
       BX_ERROR(("unknown ROP %02x",rop));
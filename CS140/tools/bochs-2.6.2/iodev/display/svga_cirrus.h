@@ -259,6 +259,7 @@ private:
 
   BX_CIRRUS_SMF bx_bool cirrus_mem_read_handler(bx_phy_address addr, unsigned len, void *data, void *param);
   BX_CIRRUS_SMF bx_bool cirrus_mem_write_handler(bx_phy_address addr, unsigned len, void *data, void *param);
+  static Bit8u *cirrus_mem_da_handler(bx_phy_address addr, unsigned rw, void *param);
 #endif
 };
 
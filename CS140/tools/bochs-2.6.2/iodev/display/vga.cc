@@ -109,7 +109,7 @@ void bx_vga_c::init_vga_extension(void)
     if (!BX_VGA_THIS pci_enabled) {
       BX_VGA_THIS vbe.base_address = VBE_DISPI_LFB_PHYSICAL_ADDRESS;
       DEV_register_memory_handlers(theVga, mem_read_handler, mem_write_handler,
-                                   BX_VGA_THIS vbe.base_address,
+                                   mem_da_handler, BX_VGA_THIS vbe.base_address,
                                    BX_VGA_THIS vbe.base_address + VBE_DISPI_TOTAL_VIDEO_MEMORY_BYTES - 1);
     }
     if (BX_VGA_THIS s.memory == NULL)
@@ -255,7 +255,7 @@ void bx_vga_c::after_restore_state(void)
       }
     }
     if (DEV_pci_set_base_mem(this, mem_read_handler, mem_write_handler,
-                             &BX_VGA_THIS pci_rom_address,
+                             NULL, &BX_VGA_THIS pci_rom_address,
                              &BX_VGA_THIS pci_conf[0x30],
                              BX_VGA_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_VGA_THIS pci_rom_address));
@@ -392,6 +392,13 @@ void bx_vga_c::update(void)
   unsigned iHeight, iWidth;
 
   if (BX_VGA_THIS vbe.enabled) {
+    /* collect the pages written through the direct LFB mapping */
+    if (BX_VGA_THIS lfb_update_tiles(BX_VGA_THIS vbe.virtual_start, BX_VGA_THIS s.line_offset,
+                                     BX_VGA_THIS vbe.bpp_multiplier, BX_VGA_THIS vbe.xres,
+                                     BX_VGA_THIS vbe.yres)) {
+      BX_VGA_THIS s.vga_mem_updated = 1;
+    }
+
     /* no screen update necessary */
     if ((BX_VGA_THIS s.vga_mem_updated==0) && BX_VGA_THIS s.graphics_ctrl.graphics_alpha)
       return;
@@ -787,6 +794,20 @@ void bx_vga_c::mem_write(bx_phy_address addr, Bit8u value)
   bx_vgacore_c::mem_write(addr, value);
 }
 
+// The LFB of the packed pixel modes is plain memory, so the CPUs may access
+// it directly. The display update finds the written pages in the dirty map.
+Bit8u *bx_vga_c::mem_da_handler(bx_phy_address addr, unsigned rw, void *param)
+{
+  if (theVga->vbe.enabled && theVga->vbe.lfb_enabled &&
+      (theVga->vbe.bpp != VBE_DISPI_BPP_4) &&
+      (addr >= theVga->vbe.base_address)) {
+    Bit32u offset = (Bit32u)(addr - theVga->vbe.base_address);
+    if (offset < VBE_DISPI_TOTAL_VIDEO_MEMORY_BYTES)
+      return theVga->lfb_host_ptr(offset, rw);
+  }
+  return NULL;
+}
+
 void bx_vga_c::redraw_area(unsigned x0, unsigned y0, unsigned width,
                       unsigned height)
 {
@@ -832,7 +853,7 @@ bx_bool bx_vga_c::vbe_set_base_addr(Bit32u *addr, Bit8u *pci_conf)
 {
   if (DEV_pci_set_base_mem(BX_VGA_THIS_PTR, mem_read_handler,
                            mem_write_handler,
-                           addr, pci_conf, VBE_DISPI_TOTAL_VIDEO_MEMORY_BYTES)) {
+                           mem_da_handler, addr, pci_conf, VBE_DISPI_TOTAL_VIDEO_MEMORY_BYTES)) {
     BX_VGA_THIS vbe.base_address = *addr;
     return 1;
   }
@@ -1160,6 +1181,7 @@ Bit32u bx_vga_c::vbe_write(Bit32u address, Bit32u value, unsigned io_len)
 
         case VBE_DISPI_INDEX_ENABLE: // enable video
         {
+          bx_bool lfb_direct = BX_VGA_THIS vbe.enabled && BX_VGA_THIS vbe.lfb_enabled;
           if ((value & VBE_DISPI_ENABLED) && !BX_VGA_THIS vbe.enabled)
           {
             unsigned depth=0;
@@ -1234,6 +1256,10 @@ Bit32u bx_vga_c::vbe_write(Bit32u address, Bit32u value, unsigned io_len)
             BX_VGA_THIS s.plane_offset = 0;
           }
           BX_VGA_THIS vbe.enabled = (bx_bool)((value & VBE_DISPI_ENABLED) != 0);
+          if ((BX_VGA_THIS vbe.enabled && BX_VGA_THIS vbe.lfb_enabled) != lfb_direct) {
+            // the LFB pages switch between direct and handler access
+            BX_VGA_THIS lfb_unmap(1);
+          }
           BX_VGA_THIS vbe.get_capabilities = (bx_bool)((value & VBE_DISPI_GETCAPS) != 0);
           new_vbe_8bit_dac = (bx_bool)((value & VBE_DISPI_8BIT_DAC) != 0);
           if (new_vbe_8bit_dac != BX_VGA_THIS vbe.dac_8bit) {
@@ -1440,7 +1466,7 @@ void bx_vga_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_len)
   }
   if (romaddr_change) {
     if (DEV_pci_set_base_mem(this, mem_read_handler, mem_write_handler,
-                             &BX_VGA_THIS pci_rom_address,
+                             NULL, &BX_VGA_THIS pci_rom_address,
                              &BX_VGA_THIS pci_conf[0x30],
                              BX_VGA_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_VGA_THIS pci_rom_address));
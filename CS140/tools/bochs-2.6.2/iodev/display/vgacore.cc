@@ -93,6 +93,11 @@ bx_vgacore_c::~bx_vgacore_c()
     delete [] s.vga_tile_updated;
     s.vga_tile_updated = NULL;
   }
+  if (s.lfb.dirty_map != NULL) {
+    delete [] s.lfb.dirty_map;
+    delete [] s.lfb.last_map;
+    s.lfb.dirty_map = NULL;
+  }
   SIM->get_param_num(BXPN_VGA_UPDATE_FREQUENCY)->set_handler(NULL);
 }
 
@@ -116,6 +121,12 @@ void bx_vgacore_c::init(void)
     for (x = 0; x < BX_VGA_THIS s.num_x_tiles; x++)
       SET_TILE_UPDATED(x, y, 0);
 
+  BX_VGA_THIS s.lfb.map_words = ((BX_VGA_THIS s.memsize >> 12) + 31) >> 5;
+  BX_VGA_THIS s.lfb.dirty_map = new Bit32u[BX_VGA_THIS s.lfb.map_words];
+  BX_VGA_THIS s.lfb.last_map = new Bit32u[BX_VGA_THIS s.lfb.map_words];
+  memset(BX_VGA_THIS s.lfb.dirty_map, 0, BX_VGA_THIS s.lfb.map_words * sizeof(Bit32u));
+  memset(BX_VGA_THIS s.lfb.last_map, 0, BX_VGA_THIS s.lfb.map_words * sizeof(Bit32u));
+
   char *strptr = SIM->get_param_string(BXPN_VGA_EXTENSION)->getptr();
   if (!BX_VGA_THIS extension_init &&
       (strlen(strptr) > 0) && strcmp(strptr, "none")) {
@@ -173,7 +184,7 @@ void bx_vgacore_c::init_standard_vga(void)
     memset(BX_VGA_THIS s.memory, 0, BX_VGA_THIS s.memsize);
   }
   DEV_register_memory_handlers(BX_VGA_THIS_PTR, mem_read_handler, mem_write_handler,
-                               0xa0000, 0xbffff);
+                               NULL, 0xa0000, 0xbffff);
 
   // video card with BIOS ROM
   DEV_cmos_set_reg(0x14, (DEV_cmos_get_reg(0x14) & 0xcf) | 0x00);
@@ -1405,6 +1416,87 @@ bx_bool bx_vgacore_c::skip_update(void)
   return 0;
 }
 
+// Direct access to the linear framebuffer: the memory handler of an
+// extension may return host pointers into the video memory, which the CPUs
+// keep in their TLBs. Guest stores then bypass mem_write(), but the TLB
+// asks again for every page it maps for writing, so that is where the page
+// is marked dirty.
+Bit8u *bx_vgacore_c::lfb_host_ptr(Bit32u offset, unsigned rw)
+{
+  BX_VGA_THIS s.lfb.mapped = 1;
+  if ((rw == BX_WRITE) || (rw == BX_RW)) {
+    Bit32u page = offset >> 12;
+    bx_atomic_or32(&BX_VGA_THIS s.lfb.dirty_map[page >> 5], 1 << (page & 31));
+    BX_VGA_THIS s.vga_mem_updated = 1;
+  }
+  return BX_VGA_THIS s.memory + offset;
+}
+
+// Drop all host pointers handed out so far. Must be called whenever the
+// memory handler would no longer grant a page it has granted before. With
+// 'all' set the TLBs are flushed in any case, so pages refused before are
+// asked for again.
+void bx_vgacore_c::lfb_unmap(bx_bool all)
+{
+  if (BX_VGA_THIS s.lfb.mapped || all) {
+    BX_VGA_THIS s.lfb.mapped = 0;
+    bx_pc_system.MemoryMappingChanged();
+  }
+}
+
+// Turn the pages written since the last call into updated tiles of the
+// screen at 'start' and remove the write mappings, so the next store to
+// one of the pages is seen again. The pages are also redrawn on the next
+// call, since a CPU thread may still store through a pointer until the
+// TLB flush has reached it.
+bx_bool bx_vgacore_c::lfb_update_tiles(Bit32u start, unsigned pitch, unsigned bytespp,
+                                       unsigned xres, unsigned yres)
+{
+  Bit32u end = start + pitch * yres;
+  bx_bool written = 0, dirty = 0;
+
+  for (Bit32u w = 0; w < BX_VGA_THIS s.lfb.map_words; w++) {
+    Bit32u bits = BX_VGA_THIS s.lfb.last_map[w];
+    if (BX_VGA_THIS s.lfb.dirty_map[w] != 0) {
+      BX_VGA_THIS s.lfb.last_map[w] = bx_atomic_xchg32(&BX_VGA_THIS s.lfb.dirty_map[w], 0);
+      bits |= BX_VGA_THIS s.lfb.last_map[w];
+      written = 1;
+    } else {
+      BX_VGA_THIS s.lfb.last_map[w] = 0;
+    }
+    if (bits == 0 || pitch == 0 || bytespp == 0)
+      continue;
+    dirty = 1;
+    for (unsigned b = 0; b < 32; b++) {
+      if (!(bits & (1 << b)))
+        continue;
+      Bit32u pstart = ((w << 5) + b) << 12, pend = pstart + 0x1000;
+      if ((pend <= start) || (pstart >= end))
+        continue;
+      Bit32u first = ((pstart > start) ? pstart : start) - start;
+      Bit32u last = ((pend < end) ? pend : end) - start - 1;
+      unsigned y0 = first / pitch, y1 = last / pitch;
+      unsigned x0 = 0, x1 = xres - 1;
+      if (y0 == y1) {
+        // the page covers part of a single scanline
+        x0 = (first % pitch) / bytespp;
+        if ((last % pitch) / bytespp < x1)
+          x1 = (last % pitch) / bytespp;
+        if (x0 > x1)
+          continue;
+      }
+      for (unsigned yti = y0 / Y_TILESIZE; yti <= y1 / Y_TILESIZE; yti++) {
+        for (unsigned xti = x0 / X_TILESIZE; xti <= x1 / X_TILESIZE; xti++) {
+          SET_TILE_UPDATED(xti, yti, 1);
+        }
+      }
+    }
+  }
+  if (written)
+    BX_VGA_THIS lfb_unmap();
+  return dirty;
+}
+
 void bx_vgacore_c::update(void)
 {
   unsigned iHeight, iWidth;
@@ -102,6 +102,11 @@ protected:
   void calculate_retrace_timing(void);
   bx_bool skip_update(void);
 
+  Bit8u  *lfb_host_ptr(Bit32u offset, unsigned rw);
+  void    lfb_unmap(bx_bool all = 0);
+  bx_bool lfb_update_tiles(Bit32u start, unsigned pitch, unsigned bytespp,
+                           unsigned xres, unsigned yres);
+
   struct {
     struct {
       bx_bool color_emulation;  // 1=color emulation, base address = 3Dx
@@ -235,6 +240,13 @@ protected:
     // vga override mode
     bx_bool vga_override;
     bx_nonvga_device_c *nvgadev;
+    // linear framebuffer pages handed out to the CPU TLBs
+    struct {
+      bx_bool mapped;           // host pointers handed out since the last flush
+      Bit32u  map_words;        // size of the dirty maps in 32 bit words
+      Bit32u *dirty_map;        // pages handed out for writing (one bit per 4K)
+      Bit32u *last_map;         // pages collected by the previous display update
+    } lfb;
   } s;  // state information
 
   int timer_id;
@@ -106,6 +106,7 @@ bx_voodoo_c::bx_voodoo_c()
 
 bx_voodoo_c::~bx_voodoo_c()
 {
+  poly_free(v->poly);
   free(v->fbi.ram);
   free(v->tmu[0].ram);
   free(v->tmu[1].ram);
@@ -321,10 +322,16 @@ void bx_voodoo_c::register_state(void)
   register_pci_state(list);
 }
 
+void bx_voodoo_c::before_save_state(void)
+{
+  // the saved frame buffer must contain every queued triangle
+  poly_wait(v->poly, "save state");
+}
+
 void bx_voodoo_c::after_restore_state(void)
 {
   if (DEV_pci_set_base_mem(BX_VOODOO_THIS_PTR, mem_read_handler, mem_write_handler,
-                           &BX_VOODOO_THIS pci_base_address[0],
+                           NULL, &BX_VOODOO_THIS pci_base_address[0],
                            &BX_VOODOO_THIS pci_conf[0x10],
                            0x1000000)) {
     BX_INFO(("new mem base address: 0x%08x", BX_VOODOO_THIS pci_base_address[0]));
@@ -597,7 +604,7 @@ void bx_voodoo_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_len
   }
   if (baseaddr_change) {
     if (DEV_pci_set_base_mem(BX_VOODOO_THIS_PTR, mem_read_handler, mem_write_handler,
-                             &BX_VOODOO_THIS pci_base_address[0],
+                             NULL, &BX_VOODOO_THIS pci_base_address[0],
                              &BX_VOODOO_THIS pci_conf[0x10],
                              0x1000000)) {
       BX_INFO(("new mem base address: 0x%08x", BX_VOODOO_THIS pci_base_address[0]));
@@ -49,6 +49,7 @@ public:
   virtual void init(void);
   virtual void reset(unsigned type);
   virtual void register_state(void);
+  virtual void before_save_state(void);
   virtual void after_restore_state(void);
 
   virtual void refresh_display(void *this_ptr, bx_bool redraw);
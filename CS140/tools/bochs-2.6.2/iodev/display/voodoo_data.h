@@ -1692,6 +1692,52 @@ struct _poly_extra_data
 };
 
 
+#define POLY_WORK_ITEMS       1024  /* size of the work item ring */
+#define POLY_MAX_EXTENTS      64    /* extents per custom work item */
+#define POLY_BAND_SHIFT       3     /* 8 scanlines per band */
+
+/* a queued triangle or block of extents, rendered by the worker threads */
+typedef struct _poly_work_item poly_work_item;
+struct _poly_work_item
+{
+  poly_draw_scanline_func callback; /* scanline rasterizer */
+  void *        dest;         /* destination buffer */
+  Bit32s        starty;       /* first scanline (clipped) */
+  Bit32s        stopy;        /* last scanline + 1 (clipped) */
+  bx_bool       custom;       /* use the extents below instead of the edges */
+  poly_vertex   v1, v2;       /* sorted top and middle vertices */
+  float         dxdy_v1v2, dxdy_v1v3, dxdy_v2v3; /* edge slopes */
+  tri_extent    extent[POLY_MAX_EXTENTS]; /* extents for custom items */
+  poly_extra_data extra;      /* copy of the triangle parameters */
+};
+
+typedef struct _poly_manager poly_manager;
+
+/* a rasterizer thread; it owns every band with (y >> POLY_BAND_SHIFT) % count == index */
+typedef struct _poly_worker poly_worker;
+struct _poly_worker
+{
+  poly_manager *poly;         /* pointer back to the manager */
+  int           index;        /* band index */
+  int           threadid;     /* slot in the thread statistics */
+  volatile Bit32u tail;       /* next work item to render */
+  volatile Bit32u sleeping;   /* waiting for the wake event */
+  BX_THREAD_VAR(thread);
+  bx_thread_event_t wake;     /* new work or exit request */
+  bx_thread_event_t idle;     /* caught up with the queue */
+};
+
+struct _poly_manager
+{
+  int           count;        /* number of worker threads, 0 = render inline */
+  volatile Bit32u head;       /* next free work item */
+  volatile Bit32u waiting;    /* poly_wait() is blocked */
+  volatile Bit32u exit;       /* worker threads must terminate */
+  poly_work_item *item;       /* work item ring */
+  poly_worker   worker[WORK_MAX_THREADS - 1];
+};
+
+
 typedef struct _banshee_info banshee_info;
 struct _banshee_info
 {
@@ -1736,7 +1782,7 @@ struct _voodoo_state
   Bit32u      send_config;
   Bit32u      tmu_config;
 
-//  poly_manager*   poly;         /* polygon manager */
+  poly_manager*   poly;         /* polygon manager */
   stats_block *   thread_stats; /* per-thread statistics */
 
   voodoo_stats    stats;        /* internal statistics */
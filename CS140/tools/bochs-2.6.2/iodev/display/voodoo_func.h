@@ -41,7 +41,6 @@
 Bit32u voodoo_last_msg = 255;
 
 
-#define poly_wait(x,y)
 #define cpu_eat_cycles(x,y)
 
 #define DEBUG_DEPTH     (0)
@@ -470,16 +469,274 @@ BX_CPP_INLINE Bit32s round_coordinate(float value)
   return result + (value - (float)result > 0.5f);
 }
 
-Bit32u poly_render_triangle(void *dest, const rectangle *cliprect, poly_draw_scanline_func callback, int paramcount, const poly_vertex *v1, const poly_vertex *v2, const poly_vertex *v3, poly_extra_data *extra)
+/*************************************
+ *
+ *  Rasterizer worker threads
+ *
+ *************************************/
+
+BX_CPP_INLINE void poly_triangle_extent(const poly_vertex *v1, const poly_vertex *v2, float dxdy_v1v2, float dxdy_v1v3, float dxdy_v2v3, Bit32s y, const rectangle *cliprect, poly_extent *extent)
+{
+  float fully = (float)y + 0.5f;
+  float startx = v1->x + (fully - v1->y) * dxdy_v1v3;
+  float stopx;
+  Bit32s istartx, istopx;
+
+  /* compute the ending X based on which part of the triangle we're in */
+  if (fully < v2->y)
+    stopx = v1->x + (fully - v1->y) * dxdy_v1v2;
+  else
+    stopx = v2->x + (fully - v2->y) * dxdy_v2v3;
+
+  /* clamp to full pixels */
+  istartx = round_coordinate(startx);
+  istopx = round_coordinate(stopx);
+
+  /* force start < stop */
+  if (istartx > istopx)
+  {
+    Bit32s temp = istartx;
+    istartx = istopx;
+    istopx = temp;
+  }
+
+  /* apply left/right clipping */
+  if (cliprect != NULL)
+  {
+    if (istartx < cliprect->min_x)
+      istartx = cliprect->min_x;
+    if (istopx > cliprect->max_x)
+      istopx = cliprect->max_x + 1;
+  }
+
+  /* set the extent */
+  if (istartx >= istopx)
+    istartx = istopx = 0;
+  extent->startx = istartx;
+  extent->stopx = istopx;
+}
+
+/* pixels drawn for a custom extent: start and stop in either order, clipped */
+BX_CPP_INLINE Bit32u poly_custom_pixels(const poly_extent *extent, const rectangle *cliprect)
+{
+  Bit32s istartx = extent->startx, istopx = extent->stopx;
+
+  /* force start < stop */
+  if (istartx > istopx)
+  {
+    Bit32s temp = istartx;
+    istartx = istopx;
+    istopx = temp;
+  }
+
+  /* apply left/right clipping */
+  if (cliprect != NULL)
+  {
+    if (istartx < cliprect->min_x)
+      istartx = cliprect->min_x;
+    if (istopx > cliprect->max_x)
+      istopx = cliprect->max_x + 1;
+  }
+
+  return (istartx < istopx) ? (istopx - istartx) : 0;
+}
+
+static void poly_render_item(const poly_work_item *item, int index, int count, int threadid)
+{
+  poly_extent extent;
+  Bit32s y = item->starty;
+
+  /* walk the bands of the item and render the ones this worker owns */
+  while (y < item->stopy)
+  {
+    Bit32s band = y >> POLY_BAND_SHIFT;
+    Bit32s bandend = MIN((band + 1) * (1 << POLY_BAND_SHIFT), item->stopy);
+
+    if (((Bit32u)band % count) == (Bit32u)index)
+    {
+      for ( ; y < bandend; y++)
+      {
+        if (item->custom)
+        {
+          extent.startx = item->extent[y - item->starty].startx;
+          extent.stopx = item->extent[y - item->starty].stopx;
+        }
+        else
+          poly_triangle_extent(&item->v1, &item->v2, item->dxdy_v1v2, item->dxdy_v1v3, item->dxdy_v2v3, y, NULL, &extent);
+        (item->callback)(item->dest, y, &extent, &item->extra, threadid);
+      }
+    }
+    y = bandend;
+  }
+}
+
+BX_THREAD_FUNC(poly_worker_thread, indata)
+{
+  poly_worker *w = (poly_worker *)indata;
+  poly_manager *poly = w->poly;
+
+  for (;;)
+  {
+    Bit32u head = poly->head;
+    bx_memory_barrier();
+    if (w->tail == head)
+    {
+      if (poly->exit)
+        break;
+      /* nothing queued; sleep until the producer publishes more work */
+      w->sleeping = 1;
+      bx_memory_barrier();
+      if ((w->tail == poly->head) && !poly->exit)
+        bx_wait_for_event(&w->wake);
+      w->sleeping = 0;
+      continue;
+    }
+
+    poly_render_item(&poly->item[w->tail % POLY_WORK_ITEMS], w->index, poly->count, w->threadid);
+
+    bx_memory_barrier();
+    w->tail++;
+    bx_memory_barrier();
+    if ((w->tail == poly->head) && poly->waiting)
+      bx_set_event(&w->idle);
+  }
+  BX_THREAD_EXIT;
+}
+
+static int poly_host_cpus(void)
+{
+#ifdef WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  return 1;
+#endif
+}
+
+poly_manager *poly_alloc(void)
+{
+  poly_manager *poly = new poly_manager;
+  int i;
+
+  /* use all but one host CPU; the other one keeps running the guest */
+  poly->count = poly_host_cpus() - 1;
+  if (poly->count < 0)
+    poly->count = 0;
+  if (poly->count > WORK_MAX_THREADS - 1)
+    poly->count = WORK_MAX_THREADS - 1;
+  poly->head = 0;
+  poly->waiting = 0;
+  poly->exit = 0;
+  poly->item = (poly->count > 0) ? new poly_work_item[POLY_WORK_ITEMS] : NULL;
+
+  for (i = 0; i < poly->count; i++)
+  {
+    poly_worker *w = &poly->worker[i];
+    w->poly = poly;
+    w->index = i;
+    /* thread statistics slot 0 belongs to the inline renderer */
+    w->threadid = i + 1;
+    w->tail = 0;
+    w->sleeping = 0;
+    bx_create_event(&w->wake);
+    bx_create_event(&w->idle);
+    BX_THREAD_CREATE(poly_worker_thread, w, w->thread);
+  }
+  if (poly->count > 0)
+    BX_INFO(("Voodoo rasterizer uses %d worker thread(s)", poly->count));
+  return poly;
+}
+
+void poly_free(poly_manager *poly)
+{
+  int i;
+
+  poly->exit = 1;
+  bx_memory_barrier();
+  for (i = 0; i < poly->count; i++)
+    bx_set_event(&poly->worker[i].wake);
+  for (i = 0; i < poly->count; i++)
+  {
+    BX_THREAD_JOIN(poly->worker[i].thread);
+    bx_destroy_event(&poly->worker[i].wake);
+    bx_destroy_event(&poly->worker[i].idle);
+  }
+  delete [] poly->item;
+  delete poly;
+}
+
+bx_bool poly_busy(poly_manager *poly)
+{
+  int i;
+
+  bx_memory_barrier();
+  for (i = 0; i < poly->count; i++)
+    if (poly->worker[i].tail != poly->head)
+      return 1;
+  return 0;
+}
+
+void poly_wait(poly_manager *poly, const char *debug_reason)
+{
+  int i;
+
+  if (poly->count == 0)
+    return;
+
+  if (LOG_WAITS && poly_busy(poly)) BX_DEBUG(("poly_wait: %s", debug_reason));
+
+  poly->waiting = 1;
+  bx_memory_barrier();
+  for (i = 0; i < poly->count; i++)
+  {
+    poly_worker *w = &poly->worker[i];
+    while (w->tail != poly->head)
+      bx_wait_for_event(&w->idle);
+  }
+  poly->waiting = 0;
+}
+
+static poly_work_item *poly_alloc_item(poly_manager *poly)
+{
+  int i;
+
+  /* if the slowest worker is a full ring behind, drain the queue */
+  for (i = 0; i < poly->count; i++)
+  {
+    if ((poly->head - poly->worker[i].tail) >= POLY_WORK_ITEMS)
+    {
+      poly_wait(poly, "queue full");
+      break;
+    }
+  }
+  return &poly->item[poly->head % POLY_WORK_ITEMS];
+}
+
+static void poly_submit_item(poly_manager *poly)
+{
+  int i;
+
+  /* publish the item before the new head, then wake the idle workers */
+  bx_memory_barrier();
+  poly->head++;
+  bx_memory_barrier();
+  for (i = 0; i < poly->count; i++)
+    if (poly->worker[i].sleeping)
+      bx_set_event(&poly->worker[i].wake);
+}
+
+Bit32u poly_render_triangle(poly_manager *poly, void *dest, const rectangle *cliprect, poly_draw_scanline_func callback, int paramcount, const poly_vertex *v1, const poly_vertex *v2, const poly_vertex *v3, poly_extra_data *extra)
 {
   float dxdy_v1v2, dxdy_v1v3, dxdy_v2v3;
   const poly_vertex *tv;
-  Bit32s curscan, scaninc=1;
+  Bit32s curscan;
 
   Bit32s v1yclip, v3yclip;
-  Bit32s v1y, v3y /*, v1x */;
+  Bit32s v1y, v3y;
   Bit32s pixels = 0;
-//  Bit32u startunit;
 
   /* first sort by Y */
   if (v2->y < v1->y)
@@ -502,13 +759,12 @@ Bit32u poly_render_triangle(void *dest, const rectangle *cliprect, poly_draw_sca
   }
 
   /* compute some integral X/Y vertex values */
-//  v1x = round_coordinate(v1->x);
   v1y = round_coordinate(v1->y);
   v3y = round_coordinate(v3->y);
 
   /* clip coordinates */
   v1yclip = v1y;
-  v3yclip = v3y;// + ((poly->flags & POLYFLAG_INCLUDE_BOTTOM_EDGE) ? 1 : 0);
+  v3yclip = v3y;
   if (cliprect != NULL)
   {
     v1yclip = MAX(v1yclip, cliprect->min_y);
@@ -517,106 +773,44 @@ Bit32u poly_render_triangle(void *dest, const rectangle *cliprect, poly_draw_sca
   if (v3yclip - v1yclip <= 0)
     return 0;
 
-  /* allocate a new polygon */
-//  polygon = allocate_polygon(poly, v1yclip, v3yclip);
-
-  /* fill in the polygon information */
-  //polygon->poly = poly;
-  //polygon->dest = dest;
-  //polygon->callback = callback;
-  //polygon->extra = poly->extra[poly->extra_next - 1];
-  //polygon->numparams = paramcount;
-  //polygon->numverts = 3;
-
-  /* set the start X/Y coordinates */
-  //polygon->xorigin = v1x;
-  //polygon->yorigin = v1y;
-
   /* compute the slopes for each portion of the triangle */
   dxdy_v1v2 = (v2->y == v1->y) ? 0.0f : (v2->x - v1->x) / (v2->y - v1->y);
   dxdy_v1v3 = (v3->y == v1->y) ? 0.0f : (v3->x - v1->x) / (v3->y - v1->y);
   dxdy_v2v3 = (v3->y == v2->y) ? 0.0f : (v3->x - v2->x) / (v3->y - v2->y);
 
-  /* compute the X extents for each scanline */
-//  startunit = poly->unit_next;
-
-//  tri_work_unit *unit = new tri_work_unit;
-  poly_extent extent;
-  int extnum=0;
-  for (curscan = v1yclip; curscan < v3yclip; curscan += scaninc)
+  /* farm the scanlines out to the worker threads */
+  if (poly != NULL && poly->count > 0 && cliprect == NULL)
   {
-//    Bit32u bucketnum = ((Bit32u)curscan / SCANLINES_PER_BUCKET) % TOTAL_BUCKETS;
-//    Bit32u unit_index = poly->unit_next++;
-//    tri_work_unit *unit = &poly->unit[unit_index]->tri;
-
-
-    /* determine how much to advance to hit the next bucket */
-//    scaninc = SCANLINES_PER_BUCKET - (Bit32u)curscan % SCANLINES_PER_BUCKET;
-
-    /* fill in the work unit basics */
-//    unit->shared.polygon = polygon;
-//    unit->shared.count_next = MIN(v3yclip - curscan, scaninc);
-//    unit->shared.scanline = curscan;
-//    unit->shared.previtem = poly->unit_bucket[bucketnum];
-//    poly->unit_bucket[bucketnum] = unit_index;
-
-    /* iterate over extents */
-//    for (extnum = 0; extnum < unit->shared.count_next; extnum++)
-    {
-      float fully = (float)(curscan + extnum) + 0.5f;
-      float startx = v1->x + (fully - v1->y) * dxdy_v1v3;
-      float stopx;
-      Bit32s istartx, istopx;
-
-      /* compute the ending X based on which part of the triangle we're in */
-      if (fully < v2->y)
-        stopx = v1->x + (fully - v1->y) * dxdy_v1v2;
-      else
-        stopx = v2->x + (fully - v2->y) * dxdy_v2v3;
-
-      /* clamp to full pixels */
-      istartx = round_coordinate(startx);
-      istopx = round_coordinate(stopx);
-
-      /* force start < stop */
-      if (istartx > istopx)
-      {
-        Bit32s temp = istartx;
-        istartx = istopx;
-        istopx = temp;
-      }
-
-      /* include the right edge if requested */
-//      if (poly->flags & POLYFLAG_INCLUDE_RIGHT_EDGE)
-//        istopx++;
-
-      /* apply left/right clipping */
-      if (cliprect != NULL)
-      {
-        if (istartx < cliprect->min_x)
-          istartx = cliprect->min_x;
-        if (istopx > cliprect->max_x)
-          istopx = cliprect->max_x + 1;
-      }
+    poly_work_item *item = poly_alloc_item(poly);
+
+    item->callback = callback;
+    item->dest = dest;
+    item->starty = v1yclip;
+    item->stopy = v3yclip;
+    item->custom = 0;
+    item->v1 = *v1;
+    item->v2 = *v2;
+    item->dxdy_v1v2 = dxdy_v1v2;
+    item->dxdy_v1v3 = dxdy_v1v3;
+    item->dxdy_v2v3 = dxdy_v2v3;
+    item->extra = *extra;
+    poly_submit_item(poly);
+
+    /* the extents are computed by the workers; estimate the pixel count from the area */
+    return (Bit32u)(fabs((v2->x - v1->x) * (v3->y - v1->y) - (v3->x - v1->x) * (v2->y - v1->y)) * 0.5f);
+  }
+
+  /* compute the X extents for each scanline and render it */
+  for (curscan = v1yclip; curscan < v3yclip; curscan++)
+  {
+    poly_extent extent;
 
-      /* set the extent and update the total pixel count */
-      if (istartx >= istopx)
-        istartx = istopx = 0;
-//      unit->extent[extnum].startx = istartx;
-//      unit->extent[extnum].stopx = istopx;
-      extent.startx = istartx;
-      extent.stopx = istopx;
-      (callback)(dest,curscan,&extent,extra,0);
-
-      pixels += istopx - istartx;
-    }
+    poly_triangle_extent(v1, v2, dxdy_v1v2, dxdy_v1v3, dxdy_v2v3, curscan, cliprect, &extent);
+    (callback)(dest, curscan, &extent, extra, 0);
+    pixels += extent.stopx - extent.startx;
   }
 
-//  delete unit;
-
   /* return the total number of pixels in the triangle */
-//  poly->triangles++;
-//  poly->pixels += pixels;
   return pixels;
 }
 
@@ -697,7 +891,14 @@ Bit32s triangle_create_work_item(/*voodoo_state *v,*/ Bit16u *drawbuf, int texco
 
   /* farm the rasterization out to other threads */
   info->polys++;
-  retval = poly_render_triangle(drawbuf, NULL, info->callback, 0, &vert[0], &vert[1], &vert[2], &extra);
+  if (FBZMODE_ENABLE_STIPPLE(v->reg[fbzMode].u) && FBZMODE_STIPPLE_PATTERN(v->reg[fbzMode].u) == 0)
+  {
+    /* the rotating stipple register advances in pixel order; render it here */
+    poly_wait(v->poly, "rotating stipple");
+    retval = poly_render_triangle(NULL, drawbuf, NULL, info->callback, 0, &vert[0], &vert[1], &vert[2], &extra);
+  }
+  else
+    retval = poly_render_triangle(v->poly, drawbuf, NULL, info->callback, 0, &vert[0], &vert[1], &vert[2], &extra);
 
 //  delete info;
 
@@ -914,7 +1115,7 @@ static void raster_fastfill(void *destbase, Bit32s y, const poly_extent *extent,
 }
 
 
-Bit32u poly_render_triangle_custom(/*poly_manager *poly, */void *dest, const rectangle *cliprect, poly_draw_scanline_func callback, int startscanline, int numscanlines, const poly_extent *extents, poly_extra_data *extra)
+Bit32u poly_render_triangle_custom(poly_manager *poly, void *dest, const rectangle *cliprect, poly_draw_scanline_func callback, int startscanline, int numscanlines, const poly_extent *extents, poly_extra_data *extra)
 {
   Bit32s curscan, scaninc;
 //  polygon_info *polygon;
@@ -936,6 +1137,30 @@ Bit32u poly_render_triangle_custom(/*poly_manager *poly, */void *dest, const rec
   if (v3yclip - v1yclip <= 0)
     return 0;
 
+  /* farm the scanlines out to the worker threads */
+  if (poly != NULL && poly->count > 0 && numscanlines <= POLY_MAX_EXTENTS)
+  {
+    poly_work_item *item = poly_alloc_item(poly);
+
+    item->callback = callback;
+    item->dest = dest;
+    item->starty = v1yclip;
+    item->stopy = v3yclip;
+    item->custom = 1;
+    for (curscan = v1yclip; curscan < v3yclip; curscan++)
+    {
+      const poly_extent *extent = &extents[curscan - startscanline];
+
+      /* the callback gets the extent as passed in, as on the serial path */
+      item->extent[curscan - v1yclip].startx = extent->startx;
+      item->extent[curscan - v1yclip].stopx = extent->stopx;
+      pixels += poly_custom_pixels(extent, cliprect);
+    }
+    item->extra = *extra;
+    poly_submit_item(poly);
+    return pixels;
+  }
+
   /* allocate a new polygon */
 //  polygon = allocate_polygon(poly, v1yclip, v3yclip);
 
@@ -973,31 +1198,12 @@ Bit32u poly_render_triangle_custom(/*poly_manager *poly, */void *dest, const rec
 //    for (extnum = 0; extnum < unit->shared.count_next; extnum++)
     {
       const poly_extent *extent = &extents[(curscan + extnum) - startscanline];
-      Bit32s istartx = extent->startx, istopx = extent->stopx;
-
-      /* force start < stop */
-      if (istartx > istopx)
-      {
-        Bit32s temp = istartx;
-        istartx = istopx;
-        istopx = temp;
-      }
-
-      /* apply left/right clipping */
-      if (cliprect != NULL)
-      {
-        if (istartx < cliprect->min_x)
-          istartx = cliprect->min_x;
-        if (istopx > cliprect->max_x)
-          istopx = cliprect->max_x + 1;
-      }
 
       /* set the extent and update the total pixel count */
 //      unit.extent[extnum].startx = istartx;
 //      unit.extent[extnum].stopx = istopx;
       (callback)(dest,curscan,extent,extra,0);
-      if (istartx < istopx)
-        pixels += istopx - istartx;
+      pixels += poly_custom_pixels(extent, cliprect);
     }
   }
 #if KEEP_STATISTICS
@@ -1083,7 +1289,7 @@ Bit32s fastfill(voodoo_state *v)
     extra.state = v;
     memcpy(extra.dither, dithermatrix, sizeof(extra.dither));
 
-    pixels += poly_render_triangle_custom(drawbuf, NULL, raster_fastfill, y, count, extents, &extra);
+    pixels += poly_render_triangle_custom(v->poly, drawbuf, NULL, raster_fastfill, y, count, extents, &extra);
   }
 
   /* 2 pixels per clock */
@@ -1093,6 +1299,9 @@ Bit32s fastfill(voodoo_state *v)
 void swap_buffers(voodoo_state *v)
 {
   int count;
+
+  /* the buffers may not change under the rasterizer threads */
+  poly_wait(v->poly, "swap_buffers");
 //  if (LOG_VBLANK_SWAP) BX_DEBUG(("--- swap_buffers @ %d", video_screen_get_vpos(v->screen)));
 
   /* force a partial update */
@@ -1273,6 +1482,9 @@ static void update_statistics(voodoo_state *v, int accumulate)
 {
   int threadnum;
 
+  /* the worker threads update their own statistics block */
+  poly_wait(v->poly, "update_statistics");
+
   /* accumulate/reset statistics from all units */
   for (threadnum = 0; threadnum < WORK_MAX_THREADS; threadnum++)
   {
@@ -2024,6 +2236,7 @@ void register_w(Bit32u offset, Bit32u data) {
 
     case trexInit1:
       /* send tmu config data to the frame buffer */
+      poly_wait(v->poly, v->regnames[regnum]);
       v->send_config = TREXINIT_SEND_TMU_CONFIG(data);
       goto default_case;
       break;
@@ -2550,6 +2763,10 @@ Bit32u register_r(Bit32u offset)
 
   Bit32u result;
 
+  /* the status register reports pending work; everything else must see it completed */
+  if (regnum != status)
+    poly_wait(v->poly, v->regnames[regnum]);
+
   /* default result is the FBI register value */
   result = v->reg[regnum].u;
 
@@ -2576,17 +2793,9 @@ Bit32u register_r(Bit32u offset)
       //result |= v->fbi.vblank << 6;
       result |= Voodoo_get_retrace() << 6;
 
-      /* bit 7 is FBI graphics engine busy */
-      if (v->pci.op_pending)
-        result |= 1 << 7;
-
-      /* bit 8 is TREX busy */
-      if (v->pci.op_pending)
-        result |= 1 << 8;
-
-      /* bit 9 is overall busy */
-      if (v->pci.op_pending)
-        result |= 1 << 9;
+      /* bits 7-9 are FBI, TREX and overall busy */
+      if (v->pci.op_pending || poly_busy(v->poly))
+        result |= (1 << 7) | (1 << 8) | (1 << 9);
 
       /* Banshee is different starting here */
       if (v->type < VOODOO_BANSHEE)
@@ -2921,7 +3130,8 @@ void voodoo_init()
 
   v->tmu_config = 64;
 
-  v->thread_stats = new stats_block[16];
+  v->thread_stats = new stats_block[WORK_MAX_THREADS];
+  v->poly = poly_alloc();
 
   soft_reset(v);
 }
@@ -2929,12 +3139,16 @@ void voodoo_init()
 bx_bool voodoo_update(/*running_device *device, bitmap_t *bitmap, */const rectangle *cliprect)
 {
 //  voodoo_state *v = get_safe_token(device);
-  bx_bool changed = v->fbi.video_changed;
+  bx_bool changed;
 //  int drawbuf = v->fbi.frontbuf;
 //  int statskey;
   int x, y;
 
+  /* finish the queued triangles before the frame is displayed */
+  poly_wait(v->poly, "voodoo_update");
+
   /* reset the video changed flag */
+  changed = v->fbi.video_changed;
   v->fbi.video_changed = 0;
 
   /* if we are blank, just fill with black */
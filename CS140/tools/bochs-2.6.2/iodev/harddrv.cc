@@ -37,6 +37,9 @@
 
 #define INDEX_PULSE_CYCLE 10
 
+// polling interval (usec) for the asynchronous disk I/O completions
+#define BX_HD_AIO_POLL_INTERVAL 10
+
 #define PACKET_SIZE 12
 
 // some packet handling macros
@@ -128,9 +131,13 @@ bx_hard_drive_c::bx_hard_drive_c()
 #ifdef LOWLEVEL_CDROM
       channels[channel].drives[device].cdrom.cd =  NULL;
 #endif
+      channels[channel].drives[device].async_io = 0;
+      memset(&channels[channel].drives[device].aio, 0, sizeof(hd_aio_t));
     }
   }
   seek_timer_index = BX_NULL_TIMER_HANDLE;
+  aio_timer_index = BX_NULL_TIMER_HANDLE;
+  aio_timer_active = 0;
 }
 
 bx_hard_drive_c::~bx_hard_drive_c()
@@ -141,6 +148,10 @@ bx_hard_drive_c::~bx_hard_drive_c()
   for (Bit8u channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
     for (Bit8u device=0; device<2; device ++) {
       if (channels[channel].drives[device].hdimage != NULL) {
+        if (channels[channel].drives[device].async_io) {
+          channels[channel].drives[device].hdimage->aio_exit();
+          delete [] channels[channel].drives[device].aio.dma_buffer;
+        }
         channels[channel].drives[device].hdimage->close();
         delete channels[channel].drives[device].hdimage;
         channels[channel].drives[device].hdimage = NULL;
@@ -308,6 +319,8 @@ void bx_hard_drive_c::init(void)
         BX_HD_THIS channels[channel].drives[device].hdimage->cylinders = cyl;
         BX_HD_THIS channels[channel].drives[device].hdimage->heads = heads;
         BX_HD_THIS channels[channel].drives[device].hdimage->spt = spt;
+        BX_HD_THIS channels[channel].drives[device].hdimage->cache_size =
+          SIM->get_param_num("cache", base)->get();
 
         /* open hard drive image file */
         if ((BX_HD_THIS channels[channel].drives[device].hdimage->open(SIM->get_param_string("path", base)->getptr())) < 0) {
@@ -345,6 +358,15 @@ void bx_hard_drive_c::init(void)
             BX_INFO(("ata%d-%d: extra data outside of CHS address range", channel, device));
           }
         }
+
+        if (SIM->get_param_bool("async", base)->get() &&
+            BX_HD_THIS channels[channel].drives[device].hdimage->aio_init()) {
+          BX_INFO(("ata%d-%d: using asynchronous I/O", channel, device));
+          BX_HD_THIS channels[channel].drives[device].async_io = 1;
+          BX_HD_THIS channels[channel].drives[device].aio.channel = channel;
+          BX_HD_THIS channels[channel].drives[device].aio.device = device;
+          BX_HD_THIS channels[channel].drives[device].aio.dma_buffer = new Bit8u[BX_HD_AIO_DMA_SECTORS * 512];
+        }
       } else if (SIM->get_param_enum("type", base)->get() == BX_ATA_DEVICE_CDROM) {
         bx_list_c *cdrom_rt = (bx_list_c*)SIM->get_param(BXPN_MENU_RUNTIME_CDROM);
         cdrom_rt->add(base);
@@ -558,6 +580,11 @@ void bx_hard_drive_c::init(void)
       DEV_register_timer(this, seek_timer_handler, 100000, 0,0, "HD/CD seek");
     // TODO !!!
   }
+  // register timer polling the asynchronous I/O completions
+  if (BX_HD_THIS aio_timer_index == BX_NULL_TIMER_HANDLE) {
+    BX_HD_THIS aio_timer_index =
+      DEV_register_timer(this, aio_timer_handler, BX_HD_AIO_POLL_INTERVAL, 1, 0, "HD async I/O");
+  }
 
   BX_HD_THIS pci_enabled = SIM->get_param_bool(BXPN_PCI_ENABLED)->get();
 
@@ -626,6 +653,11 @@ void bx_hard_drive_c::register_state(void)
         new bx_shadow_num_c(drive, "hob_hcyl", &BX_CONTROLLER(i, j).hob.hcyl, BASE_HEX);
         new bx_shadow_num_c(drive, "num_sectors", &BX_CONTROLLER(i, j).num_sectors, BASE_HEX);
         new bx_shadow_bool_c(drive, "cdrom_locked", &BX_HD_THIS channels[i].drives[j].cdrom.locked);
+        if (channels[i].drives[j].async_io) {
+          new bx_shadow_data_c(drive, "aio_dma_buffer", channels[i].drives[j].aio.dma_buffer, BX_HD_AIO_DMA_SECTORS * 512);
+          new bx_shadow_num_c(drive, "aio_dma_size", &channels[i].drives[j].aio.dma_size, BASE_HEX);
+          new bx_shadow_num_c(drive, "aio_dma_index", &channels[i].drives[j].aio.dma_index, BASE_HEX);
+        }
       }
     }
     new bx_shadow_num_c(chan, "drive_select", &BX_HD_THIS channels[i].drive_select);
@@ -647,6 +679,36 @@ void bx_hard_drive_c::seek_timer()
   }
 }
 
+void bx_hard_drive_c::before_save_state(void)
+{
+  // complete the commands waiting for the image I/O
+  for (Bit8u channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
+    ide_aio_flush(channel, 0);
+  }
+}
+
+void bx_hard_drive_c::aio_timer_handler(void *this_ptr)
+{
+  bx_hard_drive_c *class_ptr = (bx_hard_drive_c *) this_ptr;
+  class_ptr->aio_timer();
+}
+
+void bx_hard_drive_c::aio_timer()
+{
+  unsigned outstanding = 0;
+
+  for (unsigned channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
+    for (unsigned device=0; device<2; device++) {
+      if (BX_DRIVE(channel,device).async_io)
+        outstanding += BX_DRIVE(channel,device).hdimage->aio_poll();
+    }
+  }
+  if (outstanding == 0) {
+    bx_pc_system.deactivate_timer(BX_HD_THIS aio_timer_index);
+    BX_HD_THIS aio_timer_active = 0;
+  }
+}
+
 void bx_hard_drive_c::runtime_config_handler(void *this_ptr)
 {
   bx_hard_drive_c *class_ptr = (bx_hard_drive_c *) this_ptr;
@@ -809,7 +871,9 @@ Bit32u bx_hard_drive_c::read(Bit32u address, unsigned io_len)
               controller->status.drq = 1;
               controller->status.seek_complete = 1;
 
-              if (ide_read_sector(channel, controller->buffer, controller->buffer_size)) {
+              if (BX_SELECTED_DRIVE(channel).async_io) {
+                ide_aio_start(channel, controller->buffer, controller->buffer_size, 0);
+              } else if (ide_read_sector(channel, controller->buffer, controller->buffer_size)) {
                 controller->buffer_index = 0;
                 raise_interrupt(channel);
               }
@@ -1157,8 +1221,10 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
 
           /* if buffer completely writtten */
           if (controller->buffer_index >= controller->buffer_size) {
-            if (ide_write_sector(channel, controller->buffer,
-                                 controller->buffer_size)) {
+            if (BX_SELECTED_DRIVE(channel).async_io) {
+              ide_aio_start(channel, controller->buffer, controller->buffer_size, 1);
+            } else if (ide_write_sector(channel, controller->buffer,
+                                        controller->buffer_size)) {
               if ((controller->current_command == 0xC5) ||
                   (controller->current_command == 0x39)) {
                 if (controller->num_sectors > controller->multiple_sectors) {
@@ -1891,6 +1957,8 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
         BX_ERROR(("ata%d: command 0x%02x sent, controller BSY bit set", channel, value));
         break;
       }
+      // drop the read-ahead data of a previous DMA command
+      ide_aio_flush(channel, 1);
       if ((value & 0xf0) == 0x10)
         value = 0x10;
       controller->status.err = 0;
@@ -1973,8 +2041,10 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
           }
           controller->current_command = value;
 
-          if (ide_read_sector(channel, controller->buffer,
-                                  controller->buffer_size)) {
+          if (BX_SELECTED_DRIVE(channel).async_io) {
+            ide_aio_start(channel, controller->buffer, controller->buffer_size, 0);
+          } else if (ide_read_sector(channel, controller->buffer,
+                                         controller->buffer_size)) {
             controller->error_register = 0;
             controller->status.busy  = 0;
             controller->status.drive_ready = 1;
@@ -2358,6 +2428,13 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
             controller->status.seek_complete = 1;
             controller->status.drq   = 1;
             controller->current_command = value;
+#if BX_SUPPORT_PCI
+            if (BX_SELECTED_DRIVE(channel).async_io) {
+              BX_SELECTED_DRIVE(channel).aio.error = 0;
+              BX_SELECTED_DRIVE(channel).aio.dma_wait = 0;
+              ide_dma_read_ahead(channel);
+            }
+#endif
           } else {
             BX_ERROR(("write cmd 0x%02x (READ DMA) not supported", value));
             command_aborted(channel, value);
@@ -2373,6 +2450,12 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
             controller->status.seek_complete = 1;
             controller->status.drq   = 1;
             controller->current_command = value;
+#if BX_SUPPORT_PCI
+            if (BX_SELECTED_DRIVE(channel).async_io) {
+              BX_SELECTED_DRIVE(channel).aio.error = 0;
+              BX_SELECTED_DRIVE(channel).aio.dma_complete = 0;
+            }
+#endif
           } else {
             BX_ERROR(("write cmd 0x%02x (WRITE DMA) not supported", value));
             command_aborted(channel, value);
@@ -2484,6 +2567,7 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
       if (!prev_control_reset && controller->control.reset) {
         // transition from 0 to 1 causes all drives to reset
         BX_DEBUG(("Enter RESET mode"));
+        ide_aio_flush(channel, 1);
 
         // (mch) Set BSY, drive not ready
         for (int id = 0; id < 2; id++) {
@@ -3220,15 +3304,52 @@ bx_bool bx_hard_drive_c::bmdma_present(void)
 }
 
 #if BX_SUPPORT_PCI
+// Returns the data for a DMA read. With asynchronous I/O, a sector_size of 0
+// means the data is not read yet; the BM-DMA is restarted on completion.
 bx_bool bx_hard_drive_c::bmdma_read_sector(Bit8u channel, Bit8u *buffer, Bit32u *sector_size)
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
 
   if ((controller->current_command == 0xC8) ||
       (controller->current_command == 0x25)) {
-    *sector_size = 512;
-    if (!ide_read_sector(channel, buffer, 512)) {
-      return 0;
+    if (BX_SELECTED_DRIVE(channel).async_io) {
+      hd_aio_t *aio = &BX_SELECTED_DRIVE(channel).aio;
+      if ((aio->dma_index >= aio->dma_size) && (aio->pending == 0)) {
+        ide_dma_read_ahead(channel);
+      }
+      if (aio->pending > 0) {
+        // not ready, the BM-DMA is restarted when the read-ahead completes
+        aio->dma_wait = 1;
+        *sector_size = 0;
+        return 1;
+      }
+      if (aio->dma_index >= aio->dma_size) {
+        return 0;
+      }
+      Bit32u len = (*sector_size + 511) & ~511;
+      if (len > (aio->dma_size - aio->dma_index)) {
+        len = aio->dma_size - aio->dma_index;
+      }
+      memcpy(buffer, aio->dma_buffer + aio->dma_index, len);
+      aio->dma_index += len;
+      *sector_size = len;
+      // start reading the next chunk while the guest processes this one
+      if ((aio->dma_index >= aio->dma_size) && (controller->num_sectors > 0)) {
+        ide_dma_read_ahead(channel);
+      }
+    } else {
+      // transfer as many sectors as the PRD requests in one go
+      Bit32u count = (*sector_size + 511) / 512;
+      if (count > controller->num_sectors) {
+        count = controller->num_sectors;
+      }
+      if (count == 0) {
+        count = 1;
+      }
+      *sector_size = count * 512;
+      if (!ide_read_sector(channel, buffer, *sector_size)) {
+        return 0;
+      }
     }
   } else if (controller->current_command == 0xA0) {
     if (controller->packet_dma) {
@@ -3283,7 +3404,8 @@ bx_bool bx_hard_drive_c::bmdma_write_sector(Bit8u channel, Bit8u *buffer)
     command_aborted (channel, controller->current_command);
     return 0;
   }
-  if (!ide_write_sector(channel, buffer, 512)) {
+  // the data is copied by the image, consecutive sectors are merged there
+  if (!ide_sector_io(channel, buffer, 512, 1, BX_SELECTED_DRIVE(channel).async_io)) {
     return 0;
   }
   return 1;
@@ -3293,6 +3415,11 @@ void bx_hard_drive_c::bmdma_complete(Bit8u channel)
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
 
+  if (BX_SELECTED_DRIVE(channel).async_io && (BX_SELECTED_DRIVE(channel).aio.pending > 0)) {
+    // report the completion when the image writes are done
+    BX_SELECTED_DRIVE(channel).aio.dma_complete = 1;
+    return;
+  }
   controller->status.busy = 0;
   controller->status.drive_ready = 1;
   controller->status.drq = 0;
@@ -3308,6 +3435,24 @@ void bx_hard_drive_c::bmdma_complete(Bit8u channel)
   }
   raise_interrupt(channel);
 }
+
+void bx_hard_drive_c::ide_dma_read_ahead(Bit8u channel)
+{
+  controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
+  hd_aio_t *aio = &BX_SELECTED_DRIVE(channel).aio;
+
+  Bit32u count = controller->num_sectors;
+  if (count > BX_HD_AIO_DMA_SECTORS) {
+    count = BX_HD_AIO_DMA_SECTORS;
+  } else if (count == 0) {
+    count = 1;
+  }
+  aio->dma_index = 0;
+  aio->dma_size = count * 512;
+  if (!ide_sector_io(channel, aio->dma_buffer, aio->dma_size, 0, 1)) {
+    aio->dma_size = 0;
+  }
+}
 #endif
 
 void bx_hard_drive_c::set_signature(Bit8u channel, Bit8u id)
@@ -3326,76 +3471,230 @@ void bx_hard_drive_c::set_signature(Bit8u channel, Bit8u id)
   }
 }
 
+// Synchronous transfers for drives without the "async" option, the others
+// use ide_aio_start() and ide_dma_read_ahead() instead.
 bx_bool bx_hard_drive_c::ide_read_sector(Bit8u channel, Bit8u *buffer, Bit32u buffer_size)
+{
+  return ide_sector_io(channel, buffer, buffer_size, 0, 0);
+}
+
+bx_bool bx_hard_drive_c::ide_write_sector(Bit8u channel, Bit8u *buffer, Bit32u buffer_size)
+{
+  return ide_sector_io(channel, buffer, buffer_size, 1, 0);
+}
+
+// Transfer the sectors starting at the current address and advance the
+// address registers. Runs of consecutive sectors are passed to the image
+// as a single request.
+bx_bool bx_hard_drive_c::ide_sector_io(Bit8u channel, Bit8u *buffer, Bit32u buffer_size,
+                                       bx_bool write, bx_bool async)
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
 
   Bit64s logical_sector = 0;
-  Bit64s ret;
+  Bit64s run_start = 0;
+  Bit32u run_count = 0;
+  bx_bool ok = 1;
 
   int sector_count = (buffer_size / 512);
   Bit8u *bufptr = buffer;
+  /* set status bar conditions for device */
+  bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1, write);
   do {
     if (!calculate_logical_address(channel, &logical_sector)) {
-      BX_ERROR(("ide_read_sector() reached invalid sector %lu, aborting", (unsigned long)logical_sector));
-      command_aborted(channel, controller->current_command);
-      return 0;
+      BX_ERROR(("ide_%s_sector() reached invalid sector %lu, aborting",
+                write ? "write" : "read", (unsigned long)logical_sector));
+      ok = 0;
+      break;
     }
-    ret = BX_SELECTED_DRIVE(channel).hdimage->lseek(logical_sector * 512, SEEK_SET);
-    if (ret < 0) {
-      BX_ERROR(("could not lseek() hard drive image file"));
-      command_aborted(channel, controller->current_command);
-      return 0;
+    if ((run_count > 0) && (logical_sector != (run_start + run_count))) {
+      if (!ide_transfer_run(channel, run_start, bufptr, run_count, write, async)) {
+        return 0;
+      }
+      bufptr += run_count * 512;
+      run_count = 0;
     }
-    /* set status bar conditions for device */
-    bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1);
-    ret = BX_SELECTED_DRIVE(channel).hdimage->read((bx_ptr_t)bufptr, 512);
-    if (ret < 512) {
-      BX_ERROR(("could not read() hard drive image file at byte %lu", (unsigned long)logical_sector*512));
-      command_aborted(channel, controller->current_command);
-      return 0;
+    if (run_count == 0) {
+      run_start = logical_sector;
     }
+    run_count++;
     increment_address(channel, &logical_sector);
-    bufptr += 512;
   } while (--sector_count > 0);
 
+  if ((run_count > 0) && !ide_transfer_run(channel, run_start, bufptr, run_count, write, async)) {
+    return 0;
+  }
+  if (!ok) {
+    if (BX_SELECTED_DRIVE(channel).aio.pending > 0) {
+      // the completion of the requests already submitted must not be reported
+      BX_SELECTED_DRIVE(channel).aio.cancelled = 1;
+    }
+    command_aborted(channel, controller->current_command);
+  }
+  return ok;
+}
+
+bx_bool bx_hard_drive_c::ide_transfer_run(Bit8u channel, Bit64s sector, Bit8u *buffer,
+                                          Bit32u count, bx_bool write, bx_bool async)
+{
+  controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
+  device_image_t *hdimage = BX_SELECTED_DRIVE(channel).hdimage;
+  bx_iovec_t iov;
+  ssize_t ret;
+
+  if (async) {
+    BX_SELECTED_DRIVE(channel).aio.pending++;
+    hdimage->aio_submit(write, sector * 512, buffer, count * 512, aio_callback,
+                        &BX_SELECTED_DRIVE(channel).aio);
+    if (!BX_HD_THIS aio_timer_active) {
+      bx_pc_system.activate_timer(BX_HD_THIS aio_timer_index, BX_HD_AIO_POLL_INTERVAL, 1);
+      BX_HD_THIS aio_timer_active = 1;
+    }
+    return 1;
+  }
+  iov.base = buffer;
+  iov.len = count * 512;
+  if (write) {
+    ret = hdimage->write_vector(sector * 512, &iov, 1);
+  } else {
+    ret = hdimage->read_vector(sector * 512, &iov, 1);
+  }
+  if (ret < (ssize_t)iov.len) {
+    BX_ERROR(("could not %s() hard drive image file at byte %lu",
+              write ? "write" : "read", (unsigned long)sector * 512));
+    command_aborted(channel, controller->current_command);
+    return 0;
+  }
   return 1;
 }
 
-bx_bool bx_hard_drive_c::ide_write_sector(Bit8u channel, Bit8u *buffer, Bit32u buffer_size)
+void bx_hard_drive_c::aio_callback(void *param, ssize_t result)
+{
+  hd_aio_t *aio = (hd_aio_t *) param;
+
+  if (result < 0) {
+    aio->error = 1;
+  }
+  if (--aio->pending == 0) {
+    theHardDrive->ide_aio_complete(aio->channel, aio->device);
+  }
+}
+
+// Start a PIO transfer between the controller buffer and the image. The drive
+// stays busy until ide_aio_complete() updates the status and raises the IRQ.
+void bx_hard_drive_c::ide_aio_start(Bit8u channel, Bit8u *buffer, Bit32u buffer_size, bx_bool write)
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
 
-  Bit64s logical_sector = 0;
-  Bit64s ret;
+  BX_SELECTED_DRIVE(channel).aio.error = 0;
+  controller->status.busy = 1;
+  controller->status.drq = 0;
+  ide_sector_io(channel, buffer, buffer_size, write, 1);
+}
 
-  int sector_count = (buffer_size / 512);
-  Bit8u *bufptr = buffer;
-  do {
-    if (!calculate_logical_address(channel, &logical_sector)) {
-      BX_ERROR(("ide_write_sector() reached invalid sector %lu, aborting", (unsigned long)logical_sector));
-      command_aborted(channel, controller->current_command);
-      return 0;
-    }
-    ret = BX_SELECTED_DRIVE(channel).hdimage->lseek(logical_sector * 512, SEEK_SET);
-    if (ret < 0) {
-      BX_ERROR(("could not lseek() hard drive image file at byte %lu", (unsigned long)logical_sector * 512));
-      command_aborted(channel, controller->current_command);
-      return 0;
-    }
-    /* set status bar conditions for device */
-    bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1, 1 /* write */);
-    ret = BX_SELECTED_DRIVE(channel).hdimage->write((bx_ptr_t)bufptr, 512);
-    if (ret < 512) {
-      BX_ERROR(("could not write() hard drive image file at byte %lu", (unsigned long)logical_sector*512));
-      command_aborted(channel, controller->current_command);
-      return 0;
+void bx_hard_drive_c::ide_aio_complete(Bit8u channel, Bit8u device)
+{
+  controller_t *controller = &BX_CONTROLLER(channel, device);
+  hd_aio_t *aio = &BX_DRIVE(channel, device).aio;
+
+  if (aio->cancelled) {
+    // the error of a cancelled request must not abort the next command
+    aio->cancelled = 0;
+    aio->error = 0;
+    aio->dma_complete = 0;
+    aio->dma_wait = 0;
+    return;
+  }
+  if (aio->error) {
+    BX_ERROR(("ata%d-%d: asynchronous I/O on hard drive image file failed", channel, device));
+    aio->error = 0;
+    aio->dma_complete = 0;
+    aio->dma_size = 0;
+    command_aborted(channel, controller->current_command);
+    if (aio->dma_wait) {
+      // the BM-DMA sees the error when it retries the read
+      aio->dma_wait = 0;
+      DEV_ide_bmdma_start_transfer(channel);
     }
-    increment_address(channel, &logical_sector);
-    bufptr += 512;
-  } while (--sector_count > 0);
+    return;
+  }
+  switch (controller->current_command) {
+    case 0x20: // READ SECTORS, with retries
+    case 0x21: // READ SECTORS, without retries
+    case 0xC4: // READ MULTIPLE SECTORS
+    case 0x24: // READ SECTORS EXT
+    case 0x29: // READ MULTIPLE EXT
+      controller->error_register = 0;
+      controller->status.busy  = 0;
+      controller->status.drive_ready = 1;
+      controller->status.seek_complete = 1;
+      controller->status.drq   = 1;
+      controller->status.corrected_data = 0;
+      controller->status.err = 0;
+      controller->buffer_index = 0;
+      raise_interrupt(channel);
+      break;
 
-  return 1;
+    case 0x30: // WRITE SECTORS, with retries
+    case 0xC5: // WRITE MULTIPLE SECTORS
+    case 0x34: // WRITE SECTORS EXT
+    case 0x39: // WRITE MULTIPLE EXT
+      if ((controller->current_command == 0xC5) ||
+          (controller->current_command == 0x39)) {
+        if (controller->num_sectors > controller->multiple_sectors) {
+          controller->buffer_size = controller->multiple_sectors * 512;
+        } else {
+          controller->buffer_size = controller->num_sectors * 512;
+        }
+      }
+      controller->buffer_index = 0;
+      controller->status.busy = 0;
+      controller->status.drive_ready = 1;
+      controller->status.drq = (controller->num_sectors != 0);
+      controller->status.err = 0;
+      controller->status.corrected_data = 0;
+      raise_interrupt(channel);
+      break;
+
+#if BX_SUPPORT_PCI
+    case 0x35: // WRITE DMA EXT
+    case 0xCA: // WRITE DMA
+      if (aio->dma_complete) {
+        aio->dma_complete = 0;
+        BX_HD_THIS bmdma_complete(channel);
+      }
+      break;
+
+    case 0x25: // READ DMA EXT
+    case 0xC8: // READ DMA
+      // the read-ahead data is picked up by bmdma_read_sector()
+      if (aio->dma_wait) {
+        aio->dma_wait = 0;
+        DEV_ide_bmdma_start_transfer(channel);
+      }
+      break;
+#endif
+
+    default:
+      break;
+  }
+}
+
+// Wait for the outstanding requests of the drives on this channel. If cancel
+// is set, the completion of the current command is not reported.
+void bx_hard_drive_c::ide_aio_flush(Bit8u channel, bx_bool cancel)
+{
+  for (Bit8u device=0; device<2; device++) {
+    if (BX_DRIVE(channel,device).async_io && (BX_DRIVE(channel,device).aio.pending > 0)) {
+      if (cancel) {
+        BX_DRIVE(channel,device).aio.cancelled = 1;
+        BX_DRIVE(channel,device).aio.dma_complete = 0;
+        BX_DRIVE(channel,device).aio.dma_wait = 0;
+      }
+      BX_DRIVE(channel,device).hdimage->aio_flush();
+      BX_DRIVE(channel,device).aio.cancelled = 0;
+    }
+  }
 }
 
 void bx_hard_drive_c::lba48_transform(controller_t *controller, bx_bool lba48)
@@ -150,6 +150,24 @@ struct atapi_t
   int total_bytes_remaining;
 };
 
+// sectors read ahead by an asynchronous READ DMA command
+#define BX_HD_AIO_DMA_SECTORS 256
+
+// state of the asynchronous image I/O of a drive
+struct hd_aio_t
+{
+  Bit8u    channel;
+  Bit8u    device;
+  unsigned pending;      // requests of the current command in flight
+  bx_bool  error;        // one of them failed
+  bx_bool  cancelled;    // the command was aborted, ignore the completion
+  bx_bool  dma_complete; // bmdma_complete() waits for the DMA writes
+  bx_bool  dma_wait;     // the BM-DMA waits for the read-ahead data
+  Bit8u   *dma_buffer;   // READ DMA read-ahead buffer
+  Bit32u   dma_size;
+  Bit32u   dma_index;
+};
+
 #if BX_USE_HD_SMF
 #  define BX_HD_SMF  static
 #  define BX_HD_THIS theHardDrive->
@@ -179,6 +197,7 @@ public:
   virtual void     bmdma_complete(Bit8u channel);
 #endif
   virtual void     register_state(void);
+  virtual void     before_save_state(void);
 
   virtual Bit32u virt_read_handler(Bit32u address, unsigned io_len)
   {
@@ -199,6 +218,9 @@ public:
 
   static void seek_timer_handler(void *);
   BX_HD_SMF void seek_timer(void);
+  static void aio_timer_handler(void *);
+  BX_HD_SMF void aio_timer(void);
+  static void aio_callback(void *param, ssize_t result);
 
   static void runtime_config_handler(void *);
   void runtime_config(void);
@@ -221,6 +243,14 @@ private:
   BX_HD_SMF void set_signature(Bit8u channel, Bit8u id);
   BX_HD_SMF bx_bool ide_read_sector(Bit8u channel, Bit8u *buffer, Bit32u buffer_size);
   BX_HD_SMF bx_bool ide_write_sector(Bit8u channel, Bit8u *buffer, Bit32u buffer_size);
+  BX_HD_SMF bx_bool ide_sector_io(Bit8u channel, Bit8u *buffer, Bit32u buffer_size, bx_bool write, bx_bool async);
+  BX_HD_SMF bx_bool ide_transfer_run(Bit8u channel, Bit64s sector, Bit8u *buffer, Bit32u count, bx_bool write, bx_bool async);
+  BX_HD_SMF void ide_aio_start(Bit8u channel, Bit8u *buffer, Bit32u buffer_size, bx_bool write);
+  BX_HD_SMF void ide_aio_complete(Bit8u channel, Bit8u device);
+  BX_HD_SMF void ide_aio_flush(Bit8u channel, bx_bool cancel);
+#if BX_SUPPORT_PCI
+  BX_HD_SMF void ide_dma_read_ahead(Bit8u channel);
+#endif
   BX_HD_SMF void lba48_transform(controller_t *controller, bx_bool lba48);
 
   static Bit64s cdrom_status_handler(bx_param_c *param, int set, Bit64s val);
@@ -250,6 +280,9 @@ private:
       int statusbar_id;
       Bit8u device_num; // for ATAPI identify & inquiry
       bx_bool status_changed;
+      // image I/O is done by the asynchronous engine of the image
+      bx_bool async_io;
+      hd_aio_t aio;
     } drives[2];
     unsigned drive_select;
 
@@ -260,6 +293,8 @@ private:
   } channels[BX_MAX_ATA_CHANNEL];
 
   int seek_timer_index;
+  int aio_timer_index;
+  bx_bool aio_timer_active;
   Bit8u cdrom_count;
   bx_bool pci_enabled;
 };
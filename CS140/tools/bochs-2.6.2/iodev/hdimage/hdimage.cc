@@ -35,6 +35,9 @@
 #if BX_HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
+#if BX_HAVE_PREADV
+#include <sys/uio.h>
+#endif
 #ifdef linux
 #include <linux/fs.h>
 #include <sys/ioctl.h>
@@ -372,6 +375,8 @@ bx_bool hdimage_copy_file(const char *src, const char *dst)
 device_image_t::device_image_t()
 {
   hd_size = 0;
+  cache_size = 0;
+  aio = NULL;
 }
 
 int device_image_t::open(const char* _pathname)
@@ -395,8 +400,546 @@ void device_image_t::register_state(bx_list_c *parent)
   image->set_sr_handlers(this, hdimage_save_handler, hdimage_restore_handler);
 }
 
+ssize_t device_image_t::read_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt)
+{
+  ssize_t total = 0, ret;
+
+  for (int i = 0; i < iovcnt; i++) {
+    for (size_t done = 0; done < iov[i].len; done += 512) {
+      if (lseek(offset + total, SEEK_SET) < 0) return -1;
+      ret = read((Bit8u*) iov[i].base + done, 512);
+      if (ret < 0) return -1;
+      total += ret;
+      if (ret < 512) return total;
+    }
+  }
+  return total;
+}
+
+ssize_t device_image_t::write_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt)
+{
+  ssize_t total = 0, ret;
+
+  for (int i = 0; i < iovcnt; i++) {
+    for (size_t done = 0; done < iov[i].len; done += 512) {
+      if (lseek(offset + total, SEEK_SET) < 0) return -1;
+      ret = write((Bit8u*) iov[i].base + done, 512);
+      if (ret < 0) return -1;
+      total += ret;
+      if (ret < 512) return total;
+    }
+  }
+  return total;
+}
+
+/*** asynchronous I/O engine ***/
+
+// maximum number of requests merged into one transfer
+#define HDIMAGE_AIO_MAX_IOV 64
+
+struct hdimage_aio_req_t {
+  hdimage_aio_req_t *next;
+  bx_bool write;
+  Bit64s  offset;
+  Bit8u  *buf;
+  size_t  count;
+  ssize_t result;
+  hdimage_aio_callback_t callback;
+  void   *param;
+};
+
+struct hdimage_aio_t {
+  BX_MUTEX(mutex);
+  BX_THREAD_VAR(thread);
+  bx_thread_event_t wakeup;  // requests queued or exit requested
+  bx_thread_event_t done;    // requests completed
+  hdimage_aio_req_t *queue, **queue_tail;
+  hdimage_aio_req_t *completed, **completed_tail;
+  unsigned outstanding;      // requests not reported by aio_poll() yet
+  bx_bool exit;
+};
+
+BX_THREAD_FUNC(hdimage_aio_thread, arg)
+{
+  ((device_image_t *) arg)->aio_worker();
+  BX_THREAD_EXIT;
+}
+
+bx_bool device_image_t::aio_init(void)
+{
+  if (aio != NULL) return 1;
+  aio = new hdimage_aio_t;
+  BX_INIT_MUTEX(aio->mutex);
+  bx_create_event(&aio->wakeup);
+  bx_create_event(&aio->done);
+  aio->queue = NULL;
+  aio->queue_tail = &aio->queue;
+  aio->completed = NULL;
+  aio->completed_tail = &aio->completed;
+  aio->outstanding = 0;
+  aio->exit = 0;
+  BX_THREAD_CREATE(hdimage_aio_thread, this, aio->thread);
+  return 1;
+}
+
+void device_image_t::aio_exit(void)
+{
+  if (aio == NULL) return;
+  aio_flush();
+  BX_LOCK(aio->mutex);
+  aio->exit = 1;
+  BX_UNLOCK(aio->mutex);
+  bx_set_event(&aio->wakeup);
+  BX_THREAD_JOIN(aio->thread);
+  bx_destroy_event(&aio->wakeup);
+  bx_destroy_event(&aio->done);
+  BX_FINI_MUTEX(aio->mutex);
+  delete aio;
+  aio = NULL;
+}
+
+void device_image_t::aio_submit(bx_bool write, Bit64s offset, void *buf, size_t count,
+                                hdimage_aio_callback_t callback, void *param)
+{
+  hdimage_aio_req_t *req = new hdimage_aio_req_t;
+  req->next = NULL;
+  req->write = write;
+  req->offset = offset;
+  req->count = count;
+  req->result = -1;
+  req->callback = callback;
+  req->param = param;
+  if (write) {
+    req->buf = new Bit8u[count];
+    memcpy(req->buf, buf, count);
+  } else {
+    req->buf = (Bit8u *) buf;
+  }
+
+  BX_LOCK(aio->mutex);
+  *aio->queue_tail = req;
+  aio->queue_tail = &req->next;
+  aio->outstanding++;
+  BX_UNLOCK(aio->mutex);
+  bx_set_event(&aio->wakeup);
+}
+
+unsigned device_image_t::aio_poll(void)
+{
+  if (aio == NULL) return 0;
+
+  BX_LOCK(aio->mutex);
+  hdimage_aio_req_t *req = aio->completed;
+  aio->completed = NULL;
+  aio->completed_tail = &aio->completed;
+  BX_UNLOCK(aio->mutex);
+
+  while (req != NULL) {
+    hdimage_aio_req_t *next = req->next;
+    aio->outstanding--;
+    if (req->write) delete [] req->buf;
+    if (req->callback != NULL)
+      req->callback(req->param, req->result);
+    delete req;
+    req = next;
+  }
+  return aio->outstanding;
+}
+
+void device_image_t::aio_flush(void)
+{
+  while (aio_poll() > 0)
+    bx_wait_for_event(&aio->done);
+}
+
+void device_image_t::aio_worker(void)
+{
+  bx_iovec_t iov[HDIMAGE_AIO_MAX_IOV];
+
+  for (;;) {
+    BX_LOCK(aio->mutex);
+    hdimage_aio_req_t *batch = aio->queue;
+    aio->queue = NULL;
+    aio->queue_tail = &aio->queue;
+    bx_bool exit = aio->exit;
+    BX_UNLOCK(aio->mutex);
+    if (batch == NULL) {
+      if (exit) break;
+      bx_wait_for_event(&aio->wakeup);
+      continue;
+    }
+
+    // transfer runs of adjacent requests with one vectored call
+    hdimage_aio_req_t *first = batch, *last = NULL, *req;
+    while (first != NULL) {
+      Bit64s end = first->offset + first->count;
+      int iovcnt = 1;
+      iov[0].base = first->buf;
+      iov[0].len = first->count;
+      last = first;
+      while ((last->next != NULL) && (iovcnt < HDIMAGE_AIO_MAX_IOV) &&
+             (last->next->write == first->write) && (last->next->offset == end)) {
+        last = last->next;
+        iov[iovcnt].base = last->buf;
+        iov[iovcnt].len = last->count;
+        end += last->count;
+        iovcnt++;
+      }
+      ssize_t ret = first->write ? write_vector(first->offset, iov, iovcnt) :
+                                   read_vector(first->offset, iov, iovcnt);
+      for (req = first; ; req = req->next) {
+        if (ret < 0) {
+          req->result = -1;
+        } else {
+          req->result = ((size_t) ret > req->count) ? (ssize_t) req->count : ret;
+          ret -= req->result;
+        }
+        if (req == last) break;
+      }
+      first = last->next;
+    }
+
+    BX_LOCK(aio->mutex);
+    *aio->completed_tail = batch;
+    aio->completed_tail = &last->next;
+    BX_UNLOCK(aio->mutex);
+    bx_set_event(&aio->done);
+  }
+}
+
+/*** vectored file I/O ***/
+
+static ssize_t hdimage_read_vector(int fd, Bit64s offset, const bx_iovec_t *iov, int iovcnt)
+{
+#if BX_HAVE_PREADV
+  struct iovec host_iov[HDIMAGE_AIO_MAX_IOV + 1];
+  if (iovcnt <= (HDIMAGE_AIO_MAX_IOV + 1)) {
+    for (int i = 0; i < iovcnt; i++) {
+      host_iov[i].iov_base = iov[i].base;
+      host_iov[i].iov_len = iov[i].len;
+    }
+    return ::preadv(fd, host_iov, iovcnt, (off_t) offset);
+  }
+#endif
+  ssize_t total = 0, ret;
+  if (::lseek(fd, (off_t) offset, SEEK_SET) < 0) return -1;
+  for (int i = 0; i < iovcnt; i++) {
+    ret = ::read(fd, (char*) iov[i].base, iov[i].len);
+    if (ret < 0) return -1;
+    total += ret;
+    if ((size_t) ret < iov[i].len) break;
+  }
+  return total;
+}
+
+static ssize_t hdimage_write_vector(int fd, Bit64s offset, const bx_iovec_t *iov, int iovcnt)
+{
+#if BX_HAVE_PREADV
+  struct iovec host_iov[HDIMAGE_AIO_MAX_IOV + 1];
+  if (iovcnt <= (HDIMAGE_AIO_MAX_IOV + 1)) {
+    for (int i = 0; i < iovcnt; i++) {
+      host_iov[i].iov_base = iov[i].base;
+      host_iov[i].iov_len = iov[i].len;
+    }
+    return ::pwritev(fd, host_iov, iovcnt, (off_t) offset);
+  }
+#endif
+  ssize_t total = 0, ret;
+  if (::lseek(fd, (off_t) offset, SEEK_SET) < 0) return -1;
+  for (int i = 0; i < iovcnt; i++) {
+    ret = ::write(fd, (char*) iov[i].base, iov[i].len);
+    if (ret < 0) return -1;
+    total += ret;
+    if ((size_t) ret < iov[i].len) break;
+  }
+  return total;
+}
+
+/*** block cache ***/
+
+// number of blocks read ahead when sequential reads are detected
+#define HDIMAGE_CACHE_READAHEAD 64
+
+#define HDIMAGE_CACHE_NONE 0xffffffff
+
+// LRU cache of 512 byte file blocks. Writes go through to the file and
+// update the cache, misses of a sequential read stream also fetch the
+// following blocks in the same system call.
+class hdimage_cache_t
+{
+  public:
+      hdimage_cache_t(Bit32u size_kb);
+      ~hdimage_cache_t();
+
+      ssize_t read(int fd, Bit64s offset, const bx_iovec_t *iov, int iovcnt, Bit64s limit);
+      ssize_t write(int fd, Bit64s offset, const bx_iovec_t *iov, int iovcnt);
+      // forget blocks written to the file without the cache
+      void discard(Bit64s offset, Bit64s len);
+
+  private:
+      Bit32u lookup(Bit64s block);
+      Bit32u insert(Bit64s block);
+      void   remove(Bit32u slot);
+      void   touch(Bit32u slot);
+      Bit32u hash(Bit64s block) {return (Bit32u)(block ^ (block >> 16)) & (nbuckets - 1);}
+
+      Bit32u  nblocks;
+      Bit32u  nbuckets;
+      Bit8u  *data;
+      Bit64s *tag;         // block number, -1 if the slot is unused
+      Bit32u *chain;       // next slot in the hash bucket
+      Bit32u *bucket;
+      Bit32u *lru_prev;
+      Bit32u *lru_next;
+      Bit32u  lru_head;    // most recently used slot
+      Bit32u  lru_tail;    // least recently used slot
+      Bit64s  next_block;  // block following the previous read
+      Bit32u  seq_reads;   // number of sequential reads in a row
+      Bit8u  *ra_buffer;
+      BX_MUTEX(mutex);
+};
+
+hdimage_cache_t::hdimage_cache_t(Bit32u size_kb)
+{
+  nblocks = size_kb * 2;
+  if (nblocks < (HDIMAGE_CACHE_READAHEAD * 2)) {
+    nblocks = HDIMAGE_CACHE_READAHEAD * 2;
+  }
+  nbuckets = 1;
+  while (nbuckets < nblocks) nbuckets <<= 1;
+  data = new Bit8u[nblocks * 512];
+  tag = new Bit64s[nblocks];
+  chain = new Bit32u[nblocks];
+  lru_prev = new Bit32u[nblocks];
+  lru_next = new Bit32u[nblocks];
+  bucket = new Bit32u[nbuckets];
+  for (Bit32u i = 0; i < nbuckets; i++) {
+    bucket[i] = HDIMAGE_CACHE_NONE;
+  }
+  for (Bit32u i = 0; i < nblocks; i++) {
+    tag[i] = -1;
+    chain[i] = HDIMAGE_CACHE_NONE;
+    lru_prev[i] = (i > 0) ? (i - 1) : HDIMAGE_CACHE_NONE;
+    lru_next[i] = ((i + 1) < nblocks) ? (i + 1) : HDIMAGE_CACHE_NONE;
+  }
+  lru_head = 0;
+  lru_tail = nblocks - 1;
+  next_block = -1;
+  seq_reads = 0;
+  ra_buffer = new Bit8u[HDIMAGE_CACHE_READAHEAD * 512];
+  BX_INIT_MUTEX(mutex);
+}
+
+hdimage_cache_t::~hdimage_cache_t()
+{
+  BX_FINI_MUTEX(mutex);
+  delete [] data;
+  delete [] tag;
+  delete [] chain;
+  delete [] lru_prev;
+  delete [] lru_next;
+  delete [] bucket;
+  delete [] ra_buffer;
+}
+
+Bit32u hdimage_cache_t::lookup(Bit64s block)
+{
+  Bit32u slot = bucket[hash(block)];
+
+  while ((slot != HDIMAGE_CACHE_NONE) && (tag[slot] != block)) {
+    slot = chain[slot];
+  }
+  return slot;
+}
+
+void hdimage_cache_t::touch(Bit32u slot)
+{
+  if (slot == lru_head) return;
+  // unlink
+  lru_next[lru_prev[slot]] = lru_next[slot];
+  if (lru_next[slot] != HDIMAGE_CACHE_NONE) {
+    lru_prev[lru_next[slot]] = lru_prev[slot];
+  } else {
+    lru_tail = lru_prev[slot];
+  }
+  // insert at the head
+  lru_prev[slot] = HDIMAGE_CACHE_NONE;
+  lru_next[slot] = lru_head;
+  lru_prev[lru_head] = slot;
+  lru_head = slot;
+}
+
+void hdimage_cache_t::remove(Bit32u slot)
+{
+  Bit32u *link = &bucket[hash(tag[slot])];
+
+  while (*link != slot) {
+    link = &chain[*link];
+  }
+  *link = chain[slot];
+  tag[slot] = -1;
+}
+
+// return the slot holding the block, reusing the least recently used slot
+// if it is not cached yet
+Bit32u hdimage_cache_t::insert(Bit64s block)
+{
+  Bit32u slot = lookup(block);
+
+  if (slot == HDIMAGE_CACHE_NONE) {
+    slot = lru_tail;
+    if (tag[slot] >= 0) {
+      remove(slot);
+    }
+    tag[slot] = block;
+    chain[slot] = bucket[hash(block)];
+    bucket[hash(block)] = slot;
+  }
+  touch(slot);
+  return slot;
+}
+
+void hdimage_cache_t::discard(Bit64s offset, Bit64s len)
+{
+  Bit32u slot;
+
+  BX_LOCK(mutex);
+  for (Bit64s block = offset / 512; block < ((offset + len + 511) / 512); block++) {
+    if ((slot = lookup(block)) != HDIMAGE_CACHE_NONE) {
+      remove(slot);
+    }
+  }
+  BX_UNLOCK(mutex);
+}
+
+ssize_t hdimage_cache_t::read(int fd, Bit64s offset, const bx_iovec_t *iov, int iovcnt, Bit64s limit)
+{
+  bx_iovec_t rd_iov[HDIMAGE_AIO_MAX_IOV + 1];
+  bx_bool hit = 1;
+  size_t total = 0, done;
+  Bit64s block;
+  Bit32u slot, ra = 0;
+  ssize_t ret;
+  int i;
+
+  for (i = 0; i < iovcnt; i++) {
+    if ((iov[i].len % 512) != 0) break;
+    total += iov[i].len;
+  }
+  if (((offset % 512) != 0) || (i < iovcnt)) {
+    return hdimage_read_vector(fd, offset, iov, iovcnt);
+  }
+
+  BX_LOCK(mutex);
+  block = offset / 512;
+  if (block == next_block) {
+    seq_reads++;
+  } else {
+    seq_reads = 0;
+  }
+  next_block = block + total / 512;
+  for (i = 0; (i < iovcnt) && hit; i++) {
+    for (done = 0; done < iov[i].len; done += 512) {
+      if (lookup(block++) == HDIMAGE_CACHE_NONE) {
+        hit = 0;
+        break;
+      }
+    }
+  }
+  block = offset / 512;
+  if (hit) {
+    for (i = 0; i < iovcnt; i++) {
+      for (done = 0; done < iov[i].len; done += 512) {
+        slot = insert(block++);
+        memcpy((Bit8u*) iov[i].base + done, data + slot * 512, 512);
+      }
+    }
+    BX_UNLOCK(mutex);
+    return total;
+  }
+
+  // miss: read the request from the file, plus the following blocks if
+  // the guest reads sequentially
+  if ((seq_reads > 0) && (iovcnt <= HDIMAGE_AIO_MAX_IOV)) {
+    ra = HDIMAGE_CACHE_READAHEAD;
+    if ((limit >= 0) && ((next_block + ra) * 512 > limit)) {
+      ra = (limit > next_block * 512) ? (Bit32u)(limit / 512 - next_block) : 0;
+    }
+  }
+  if (ra > 0) {
+    for (i = 0; i < iovcnt; i++) {
+      rd_iov[i] = iov[i];
+    }
+    rd_iov[iovcnt].base = ra_buffer;
+    rd_iov[iovcnt].len = ra * 512;
+    ret = hdimage_read_vector(fd, offset, rd_iov, iovcnt + 1);
+  } else {
+    ret = hdimage_read_vector(fd, offset, iov, iovcnt);
+  }
+  if (ret > 0) {
+    // keep the complete blocks transferred
+    size_t left = ret;
+    for (i = 0; (i < iovcnt) && (left >= 512); i++) {
+      for (done = 0; (done < iov[i].len) && (left >= 512); done += 512, left -= 512) {
+        slot = insert(block++);
+        memcpy(data + slot * 512, (Bit8u*) iov[i].base + done, 512);
+      }
+    }
+    for (done = 0; (done < ra * 512) && (left >= 512); done += 512, left -= 512) {
+      slot = lookup(block);
+      if (slot == HDIMAGE_CACHE_NONE) {
+        slot = insert(block);
+        memcpy(data + slot * 512, ra_buffer + done, 512);
+      }
+      block++;
+    }
+    if ((size_t) ret > total) ret = total;
+  }
+  BX_UNLOCK(mutex);
+  return ret;
+}
+
+ssize_t hdimage_cache_t::write(int fd, Bit64s offset, const bx_iovec_t *iov, int iovcnt)
+{
+  size_t left, done;
+  Bit64s block = offset / 512;
+  Bit32u slot;
+  ssize_t ret;
+  int i;
+
+  for (i = 0; i < iovcnt; i++) {
+    if ((iov[i].len % 512) != 0) break;
+  }
+  if (((offset % 512) != 0) || (i < iovcnt)) {
+    ret = hdimage_write_vector(fd, offset, iov, iovcnt);
+    if (ret > 0) discard(offset, ret);
+    return ret;
+  }
+
+  BX_LOCK(mutex);
+  ret = hdimage_write_vector(fd, offset, iov, iovcnt);
+  if (ret > 0) {
+    left = ret;
+    for (i = 0; (i < iovcnt) && (left >= 512); i++) {
+      for (done = 0; (done < iov[i].len) && (left >= 512); done += 512, left -= 512) {
+        slot = insert(block++);
+        memcpy(data + slot * 512, (Bit8u*) iov[i].base + done, 512);
+      }
+    }
+  }
+  BX_UNLOCK(mutex);
+  return ret;
+}
+
 /*** default_image_t function definitions ***/
 
+default_image_t::default_image_t()
+{
+  fd = -1;
+  cache = NULL;
+  pos = 0;
+}
+
 int default_image_t::open(const char* _pathname, int flags)
 {
   pathname = _pathname;
@@ -406,6 +949,10 @@ int default_image_t::open(const char* _pathname, int flags)
   BX_INFO(("hd_size: "FMT_LL"u", hd_size));
   if (hd_size <= 0) BX_PANIC(("size of disk image not detected / invalid"));
   if ((hd_size % 512) != 0) BX_PANIC(("size of disk image must be multiple of 512 bytes"));
+  if (cache_size > 0) {
+    cache = new hdimage_cache_t(cache_size);
+    pos = 0;
+  }
   return fd;
 }
 
@@ -414,23 +961,70 @@ void default_image_t::close()
   if (fd > -1) {
     ::close(fd);
   }
+  if (cache != NULL) {
+    delete cache;
+    cache = NULL;
+  }
 }
 
 Bit64s default_image_t::lseek(Bit64s offset, int whence)
 {
+  if (cache != NULL) {
+    // transfers use the offset, no need to move the file pointer
+    if (whence == SEEK_SET) {
+      pos = offset;
+    } else if (whence == SEEK_CUR) {
+      pos += offset;
+    } else {
+      pos = (Bit64s)::lseek(fd, (off_t)offset, whence);
+    }
+    return pos;
+  }
   return (Bit64s)::lseek(fd, (off_t)offset, whence);
 }
 
 ssize_t default_image_t::read(void* buf, size_t count)
 {
+  if (cache != NULL) {
+    bx_iovec_t iov;
+    iov.base = buf;
+    iov.len = count;
+    ssize_t ret = cache->read(fd, pos, &iov, 1, hd_size);
+    if (ret > 0) pos += ret;
+    return ret;
+  }
   return ::read(fd, (char*) buf, count);
 }
 
 ssize_t default_image_t::write(const void* buf, size_t count)
 {
+  if (cache != NULL) {
+    bx_iovec_t iov;
+    iov.base = (void*) buf;
+    iov.len = count;
+    ssize_t ret = cache->write(fd, pos, &iov, 1);
+    if (ret > 0) pos += ret;
+    return ret;
+  }
   return ::write(fd, (char*) buf, count);
 }
 
+ssize_t default_image_t::read_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt)
+{
+  if (cache != NULL) {
+    return cache->read(fd, offset, iov, iovcnt, hd_size);
+  }
+  return hdimage_read_vector(fd, offset, iov, iovcnt);
+}
+
+ssize_t default_image_t::write_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt)
+{
+  if (cache != NULL) {
+    return cache->write(fd, offset, iov, iovcnt);
+  }
+  return hdimage_write_vector(fd, offset, iov, iovcnt);
+}
+
 int default_image_t::check_format(int fd, Bit64u imgsize)
 {
   char buffer[512];
@@ -1308,9 +1902,14 @@ redolog_t::redolog_t()
   fd = -1;
   catalog = NULL;
   bitmap = NULL;
+  bitmap_update = 1;
+  bitmap_dirty = 0;
+  bitmap_extent = 0;
   extent_index = (Bit32u)0;
   extent_offset = (Bit32u)0;
   extent_next = (Bit32u)0;
+  cache = NULL;
+  cache_size = 0;
 }
 
 void redolog_t::print_header()
@@ -1426,9 +2025,75 @@ int redolog_t::create(int filedes, const char* type, Bit64u size)
   // FIXME could mmap
   ::write(fd, catalog, dtoh32(header.specific.catalog) * sizeof (Bit32u));
 
+  bitmap_update = 1;
+  bitmap_dirty = 0;
+  init_cache();
+
   return 0;
 }
 
+void redolog_t::init_cache()
+{
+  if (cache_size > 0) {
+    cache = new hdimage_cache_t(cache_size);
+  }
+}
+
+ssize_t redolog_t::read_block(Bit64s offset, void *buf, size_t count)
+{
+  if (cache != NULL) {
+    bx_iovec_t iov;
+    iov.base = buf;
+    iov.len = count;
+    return cache->read(fd, offset, &iov, 1, -1);
+  }
+  return bx_read_image(fd, offset, buf, (int)count);
+}
+
+ssize_t redolog_t::write_block(Bit64s offset, const void *buf, size_t count)
+{
+  if (cache != NULL) {
+    bx_iovec_t iov;
+    iov.base = (void*)buf;
+    iov.len = count;
+    return cache->write(fd, offset, &iov, 1);
+  }
+  return bx_write_image(fd, offset, (void*)buf, (int)count);
+}
+
+Bit64s redolog_t::bitmap_offset(Bit32u extent)
+{
+  Bit64s offset;
+
+  offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
+  offset += (Bit64s)512 * dtoh32(catalog[extent]) * (extent_blocks + bitmap_blocks);
+  return offset;
+}
+
+// Make the bitmap buffer hold the bitmap of the current extent. Changes of
+// the previous extent's bitmap are written back first.
+bx_bool redolog_t::load_bitmap()
+{
+  if (bitmap_update) {
+    flush_bitmap();
+    if (read_block(bitmap_offset(extent_index), bitmap, dtoh32(header.specific.bitmap)) != (ssize_t)dtoh32(header.specific.bitmap)) {
+      BX_PANIC(("redolog : failed to read bitmap for extent %d", extent_index));
+      return 0;
+    }
+    bitmap_extent = extent_index;
+    bitmap_update = 0;
+  }
+  return 1;
+}
+
+void redolog_t::flush_bitmap()
+{
+  if (bitmap_dirty) {
+    write_block(bitmap_offset(bitmap_extent), bitmap, dtoh32(header.specific.bitmap));
+    bitmap_dirty = 0;
+  }
+}
+
 int redolog_t::open(const char* filename, const char *type)
 {
   return open(filename, type, O_RDWR);
@@ -1519,14 +2184,23 @@ int redolog_t::open(const char* filename, const char *type, int flags)
 
   imagepos = 0;
   bitmap_update = 1;
+  bitmap_dirty = 0;
+  init_cache();
 
   return 0;
 }
 
 void redolog_t::close()
 {
-  if (fd >= 0)
+  if (fd >= 0) {
+    flush_bitmap();
     ::close(fd);
+  }
+
+  if (cache != NULL) {
+    delete cache;
+    cache = NULL;
+  }
 
   if (catalog != NULL)
     free(catalog);
@@ -1586,7 +2260,7 @@ Bit64s redolog_t::lseek(Bit64s offset, int whence)
 
 ssize_t redolog_t::read(void* buf, size_t count)
 {
-  Bit64s block_offset, bitmap_offset;
+  Bit64s block_offset, bitmap_offs;
   ssize_t ret;
 
   if (count != 512) {
@@ -1601,19 +2275,14 @@ ssize_t redolog_t::read(void* buf, size_t count)
     return 0;
   }
 
-  bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
-  bitmap_offset += (Bit64s)512 * dtoh32(catalog[extent_index]) * (extent_blocks + bitmap_blocks);
-  block_offset    = bitmap_offset + ((Bit64s)512 * (bitmap_blocks + extent_offset));
+  bitmap_offs  = bitmap_offset(extent_index);
+  block_offset = bitmap_offs + ((Bit64s)512 * (bitmap_blocks + extent_offset));
 
-  BX_DEBUG(("redolog : bitmap offset is %x", (Bit32u)bitmap_offset));
+  BX_DEBUG(("redolog : bitmap offset is %x", (Bit32u)bitmap_offs));
   BX_DEBUG(("redolog : block offset is %x", (Bit32u)block_offset));
 
-  if (bitmap_update) {
-    if (bx_read_image(fd, (off_t)bitmap_offset, bitmap,  dtoh32(header.specific.bitmap)) != (ssize_t)dtoh32(header.specific.bitmap)) {
-      BX_PANIC(("redolog : failed to read bitmap for extent %d", extent_index));
-      return -1;
-    }
-    bitmap_update = 0;
+  if (!load_bitmap()) {
+    return -1;
   }
 
   if (((bitmap[extent_offset/8] >> (extent_offset%8)) & 0x01) == 0x00) {
@@ -1623,7 +2292,7 @@ ssize_t redolog_t::read(void* buf, size_t count)
     return 0;
   }
 
-  ret = bx_read_image(fd, (off_t)block_offset, buf, count);
+  ret = read_block(block_offset, buf, count);
   if (ret >= 0) lseek(512, SEEK_CUR);
 
   return ret;
@@ -1632,7 +2301,7 @@ ssize_t redolog_t::read(void* buf, size_t count)
 ssize_t redolog_t::write(const void* buf, size_t count)
 {
   Bit32u i;
-  Bit64s block_offset, bitmap_offset, catalog_offset;
+  Bit64s block_offset, bitmap_offs, catalog_offset;
   ssize_t written;
   bx_bool update_catalog = 0;
 
@@ -1660,9 +2329,8 @@ ssize_t redolog_t::write(const void* buf, size_t count)
     memset(zerobuffer, 0, 512);
 
     // Write bitmap
-    bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
-    bitmap_offset += (Bit64s)512 * dtoh32(catalog[extent_index]) * (extent_blocks + bitmap_blocks);
-    ::lseek(fd, (off_t)bitmap_offset, SEEK_SET);
+    bitmap_offs = bitmap_offset(extent_index);
+    ::lseek(fd, (off_t)bitmap_offs, SEEK_SET);
     for (i=0; i<bitmap_blocks; i++) {
       ::write(fd, zerobuffer, 512);
     }
@@ -1670,35 +2338,34 @@ ssize_t redolog_t::write(const void* buf, size_t count)
     for (i=0; i<extent_blocks; i++) {
       ::write(fd, zerobuffer, 512);
     }
+    if (cache != NULL) {
+      cache->discard(bitmap_offs, (Bit64s)512 * (bitmap_blocks + extent_blocks));
+    }
 
     free(zerobuffer);
 
     update_catalog = 1;
   }
 
-  bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
-  bitmap_offset += (Bit64s)512 * dtoh32(catalog[extent_index]) * (extent_blocks + bitmap_blocks);
-  block_offset    = bitmap_offset + ((Bit64s)512 * (bitmap_blocks + extent_offset));
+  bitmap_offs  = bitmap_offset(extent_index);
+  block_offset = bitmap_offs + ((Bit64s)512 * (bitmap_blocks + extent_offset));
 
-  BX_DEBUG(("redolog : bitmap offset is %x", (Bit32u)bitmap_offset));
+  BX_DEBUG(("redolog : bitmap offset is %x", (Bit32u)bitmap_offs));
   BX_DEBUG(("redolog : block offset is %x", (Bit32u)block_offset));
 
   // Write block
-  written = bx_write_image(fd, (off_t)block_offset, (void*)buf, count);
+  written = write_block(block_offset, buf, count);
 
-  // Write bitmap
-  if (bitmap_update) {
-    if (bx_read_image(fd, (off_t)bitmap_offset, bitmap,  dtoh32(header.specific.bitmap)) != (ssize_t)dtoh32(header.specific.bitmap)) {
-      BX_PANIC(("redolog : failed to read bitmap for extent %d", extent_index));
-      return 0;
-    }
-    bitmap_update = 0;
+  // Update bitmap
+  if (!load_bitmap()) {
+    return 0;
   }
 
-  // If bloc does not belong to extent yet
+  // If bloc does not belong to extent yet, the bitmap is written back
+  // when leaving the extent
   if (((bitmap[extent_offset/8] >> (extent_offset%8)) & 0x01) == 0x00) {
     bitmap[extent_offset/8] |= 1 << (extent_offset%8);
-    bx_write_image(fd, (off_t)bitmap_offset, bitmap,  dtoh32(header.specific.bitmap));
+    bitmap_dirty = 1;
   }
 
   // Write catalog
@@ -1745,6 +2412,7 @@ int redolog_t::check_format(int fd, const char *subtype)
 
 bx_bool redolog_t::save_state(const char *backup_fname)
 {
+  flush_bitmap();
   return hdimage_backup_file(fd, backup_fname);
 }
 
@@ -1763,6 +2431,7 @@ growing_image_t::~growing_image_t()
 int growing_image_t::open(const char* _pathname, int flags)
 {
   pathname = _pathname;
+  redolog->set_cache_size(cache_size);
   int filedes = redolog->open(pathname, REDOLOG_SUBTYPE_GROWING, flags);
   hd_size = redolog->get_size();
   BX_INFO(("'growing' disk opened, growing file is '%s'", pathname));
@@ -1896,8 +2565,10 @@ int undoable_image_t::open(const char* pathname, int flags)
   if (ro_disk == NULL) {
     return -1;
   }
+  ro_disk->cache_size = cache_size;
   if (ro_disk->open(pathname, O_RDONLY) < 0)
     return -1;
+  redolog->set_cache_size(cache_size);
 
   hd_size = ro_disk->hd_size;
 
@@ -2029,8 +2700,10 @@ int volatile_image_t::open(const char* pathname, int flags)
   if (ro_disk == NULL) {
     return -1;
   }
+  ro_disk->cache_size = cache_size;
   if (ro_disk->open(pathname, O_RDONLY)<0)
     return -1;
+  redolog->set_cache_size(cache_size);
 
   hd_size = ro_disk->hd_size;
 
@@ -141,6 +141,19 @@ int hdimage_open_file(const char *pathname, int flags, Bit64u *fsize, FILETIME *
 bx_bool hdimage_backup_file(int fd, const char *backup_fname);
 bx_bool hdimage_copy_file(const char *src, const char *dst);
 
+// buffer of a vectored transfer
+typedef struct {
+  void   *base;
+  size_t  len;
+} bx_iovec_t;
+
+// completion callback of an asynchronous request, the result is the number
+// of bytes transferred or -1 on error
+typedef void (*hdimage_aio_callback_t)(void *param, ssize_t result);
+
+struct hdimage_aio_t;
+class hdimage_cache_t;
+
 // base class
 class device_image_t
 {
@@ -170,6 +183,27 @@ class device_image_t
       // written (count).
       virtual ssize_t write(const void* buf, size_t count) = 0;
 
+      // Vectored transfer at the given offset. Return the number of
+      // bytes transferred. The default implementation seeks and transfers
+      // one sector at a time like the ATA emulation did.
+      virtual ssize_t read_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt);
+      virtual ssize_t write_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt);
+
+      // Asynchronous I/O: the requests are executed in order by a worker
+      // thread, adjacent requests queued in the meantime are merged into
+      // one vectored transfer. Write data is copied on submission. The
+      // callbacks are called from aio_poll() in the simulation thread.
+      virtual bx_bool aio_init(void);
+      virtual void aio_exit(void);
+      virtual void aio_submit(bx_bool write, Bit64s offset, void *buf, size_t count,
+                              hdimage_aio_callback_t callback, void *param);
+      // Run the callbacks of the completed requests. Return the number of
+      // requests still outstanding.
+      virtual unsigned aio_poll(void);
+      // Wait for all requests and run their callbacks.
+      virtual void aio_flush(void);
+      void aio_worker(void);
+
       // Get image capabilities
       virtual Bit32u get_capabilities();
 
@@ -188,18 +222,23 @@ class device_image_t
       unsigned heads;
       unsigned spt;
       Bit64u   hd_size;
+      Bit32u   cache_size;  // block cache size in KB (0 = disabled)
   protected:
 #ifndef WIN32
       time_t mtime;
 #else
       FILETIME mtime;
 #endif
+      hdimage_aio_t *aio;
 };
 
 // FLAT MODE
 class default_image_t : public device_image_t
 {
   public:
+      // Contructor
+      default_image_t();
+
       // Open an image with specific flags. Returns non-negative if successful.
       int open(const char* pathname, int flags);
 
@@ -218,6 +257,10 @@ class default_image_t : public device_image_t
       // written (count).
       ssize_t write(const void* buf, size_t count);
 
+      // Vectored transfer at the given offset (one system call)
+      ssize_t read_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt);
+      ssize_t write_vector(Bit64s offset, const bx_iovec_t *iov, int iovcnt);
+
       // Check image format
       static int check_format(int fd, Bit64u imgsize);
 
@@ -228,6 +271,8 @@ class default_image_t : public device_image_t
   private:
       int fd;
       const char *pathname;
+      hdimage_cache_t *cache;
+      Bit64s pos;  // file position if the cache is enabled
 };
 
 // CONCAT MODE
@@ -420,13 +465,26 @@ class redolog_t
 
       bx_bool save_state(const char *backup_fname);
 
+      // Set the block cache size in KB before opening or creating the redolog
+      void set_cache_size(Bit32u size) {cache_size = size;}
+
   private:
       void             print_header();
+      void             init_cache();
+      ssize_t          read_block(Bit64s offset, void *buf, size_t count);
+      ssize_t          write_block(Bit64s offset, const void *buf, size_t count);
+      Bit64s           bitmap_offset(Bit32u extent);
+      bx_bool          load_bitmap();
+      void             flush_bitmap();
       int              fd;
       redolog_header_t header;     // Header is kept in x86 (little) endianness
       Bit32u          *catalog;
       Bit8u           *bitmap;
       bx_bool          bitmap_update;
+      bx_bool          bitmap_dirty;  // bitmap changed, written back when leaving the extent
+      Bit32u           bitmap_extent; // extent the bitmap buffer belongs to
+      hdimage_cache_t *cache;
+      Bit32u           cache_size;
       Bit32u           extent_index;
       Bit32u           extent_offset;
       Bit32u           extent_next;
@@ -240,7 +240,7 @@ void bx_ioapic_c::set_enabled(bx_bool _enabled, Bit16u base_offset)
     if (_enabled) {
       base_addr = BX_IOAPIC_BASE_ADDR | base_offset;
       DEV_register_memory_handlers(theIOAPIC,
-        ioapic_read, ioapic_write, base_addr, base_addr + 0xfff);
+        ioapic_read, ioapic_write, NULL, base_addr, base_addr + 0xfff);
     } else {
       DEV_unregister_memory_handlers(theIOAPIC, base_addr, base_addr + 0xfff);
     }
@@ -249,7 +249,7 @@ void bx_ioapic_c::set_enabled(bx_bool _enabled, Bit16u base_offset)
       DEV_unregister_memory_handlers(theIOAPIC, base_addr, base_addr + 0xfff);
       base_addr = BX_IOAPIC_BASE_ADDR | base_offset;
       DEV_register_memory_handlers(theIOAPIC,
-        ioapic_read, ioapic_write, base_addr, base_addr + 0xfff);
+        ioapic_read, ioapic_write, NULL, base_addr, base_addr + 0xfff);
   }
   BX_INFO(("IOAPIC %sabled (base address = 0x%08x)", enabled?"en":"dis", (Bit32u)base_addr));
 }
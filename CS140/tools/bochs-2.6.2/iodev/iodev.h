@@ -71,6 +71,7 @@ class BOCHSAPI bx_devmodel_c : public logfunctions {
   virtual void init(void) {}
   virtual void reset(unsigned type) {}
   virtual void register_state(void) {}
+  virtual void before_save_state(void) {}
   virtual void after_restore_state(void) {}
 #if BX_DEBUGGER
   virtual void debug_dump(int argc, char **argv) {}
@@ -278,6 +279,7 @@ public:
     return 0;
   }
   virtual void bmdma_set_irq(Bit8u channel) {}
+  virtual void bmdma_start_transfer(Bit8u channel) {}
 };
 
 class BOCHSAPI bx_speaker_stub_c : public bx_devmodel_c {
@@ -387,6 +389,7 @@ public:
   // Cleanup the devices when the simulation quits.
   void exit(void);
   void register_state(void);
+  void before_save_state(void);
   void after_restore_state(void);
   BX_MEM_C *mem;  // address space associated with these devices
   bx_bool register_io_read_handler(void *this_ptr, bx_read_handler_t f,
@@ -428,6 +431,7 @@ public:
   bx_bool register_pci_handlers(bx_pci_device_stub_c *device, Bit8u *devfunc,
                                 const char *name, const char *descr);
   bx_bool pci_set_base_mem(void *this_ptr, memory_handler_t f1, memory_handler_t f2,
+                           memory_direct_access_handler_t da,
                            Bit32u *addr, Bit8u *pci_conf, unsigned size);
   bx_bool pci_set_base_io(void *this_ptr, bx_read_handler_t f1, bx_write_handler_t f2,
                           Bit32u *addr, Bit8u *pci_conf, unsigned size,
@@ -624,7 +624,7 @@ void bx_e1000_c::register_state(void)
 void bx_e1000_c::after_restore_state(void)
 {
   if (DEV_pci_set_base_mem(BX_E1000_THIS_PTR, mem_read_handler, mem_write_handler,
-                           &BX_E1000_THIS pci_base_address[0],
+                           NULL, &BX_E1000_THIS pci_base_address[0],
                            &BX_E1000_THIS pci_conf[0x10],
                            0x20000)) {
     BX_INFO(("new mem base address: 0x%08x", BX_E1000_THIS pci_base_address[0]));
@@ -638,7 +638,7 @@ void bx_e1000_c::after_restore_state(void)
   if (BX_E1000_THIS pci_rom_size > 0) {
     if (DEV_pci_set_base_mem(BX_E1000_THIS_PTR, mem_read_handler,
                              mem_write_handler,
-                             &BX_E1000_THIS pci_rom_address,
+                             NULL, &BX_E1000_THIS pci_rom_address,
                              &BX_E1000_THIS pci_conf[0x30],
                              BX_E1000_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_E1000_THIS pci_rom_address));
@@ -1579,7 +1579,7 @@ void bx_e1000_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_len)
   }
   if (baseaddr0_change) {
     if (DEV_pci_set_base_mem(BX_E1000_THIS_PTR, mem_read_handler, mem_write_handler,
-                             &BX_E1000_THIS pci_base_address[0],
+                             NULL, &BX_E1000_THIS pci_base_address[0],
                              &BX_E1000_THIS pci_conf[0x10],
                              0x20000)) {
       BX_INFO(("new mem base address: 0x%08x", BX_E1000_THIS pci_base_address[0]));
@@ -1596,7 +1596,7 @@ void bx_e1000_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_len)
   if (romaddr_change) {
     if (DEV_pci_set_base_mem(BX_E1000_THIS_PTR, mem_read_handler,
                              mem_write_handler,
-                             &BX_E1000_THIS pci_rom_address,
+                             NULL, &BX_E1000_THIS pci_rom_address,
                              &BX_E1000_THIS pci_conf[0x30],
                              BX_E1000_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_E1000_THIS pci_rom_address));
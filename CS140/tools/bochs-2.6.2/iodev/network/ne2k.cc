@@ -465,7 +465,7 @@ void bx_ne2k_c::after_restore_state(void)
     if (BX_NE2K_THIS pci_rom_size > 0) {
       if (DEV_pci_set_base_mem(BX_NE2K_THIS_PTR, mem_read_handler,
                                mem_write_handler,
-                               &BX_NE2K_THIS pci_rom_address,
+                               NULL, &BX_NE2K_THIS pci_rom_address,
                                &BX_NE2K_THIS pci_conf[0x30],
                                BX_NE2K_THIS pci_rom_size)) {
         BX_INFO(("new ROM address: 0x%08x", BX_NE2K_THIS pci_rom_address));
@@ -1782,7 +1782,7 @@ void bx_ne2k_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_len)
   if (romaddr_change) {
     if (DEV_pci_set_base_mem(BX_NE2K_THIS_PTR, mem_read_handler,
                              mem_write_handler,
-                             &BX_NE2K_THIS pci_rom_address,
+                             NULL, &BX_NE2K_THIS pci_rom_address,
                              &BX_NE2K_THIS pci_conf[0x30],
                              BX_NE2K_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_NE2K_THIS pci_rom_address));
@@ -249,7 +249,7 @@ void bx_pcipnic_c::after_restore_state(void)
   if (BX_PNIC_THIS pci_rom_size > 0) {
     if (DEV_pci_set_base_mem(BX_PNIC_THIS_PTR, mem_read_handler,
                              mem_write_handler,
-                             &BX_PNIC_THIS pci_rom_address,
+                             NULL, &BX_PNIC_THIS pci_rom_address,
                              &BX_PNIC_THIS pci_conf[0x30],
                              BX_PNIC_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_PNIC_THIS pci_rom_address));
@@ -486,7 +486,7 @@ void bx_pcipnic_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_le
   if (romaddr_change) {
     if (DEV_pci_set_base_mem(BX_PNIC_THIS_PTR, mem_read_handler,
                              mem_write_handler,
-                             &BX_PNIC_THIS pci_rom_address,
+                             NULL, &BX_PNIC_THIS pci_rom_address,
                              &BX_PNIC_THIS pci_conf[0x30],
                              BX_PNIC_THIS pci_rom_size)) {
       BX_INFO(("new ROM address: 0x%08x", BX_PNIC_THIS pci_rom_address));
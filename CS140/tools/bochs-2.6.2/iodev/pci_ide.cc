@@ -231,6 +231,14 @@ void bx_pci_ide_c::bmdma_set_irq(Bit8u channel)
   }
 }
 
+// The drive has the data of a pending DMA read available now
+void bx_pci_ide_c::bmdma_start_transfer(Bit8u channel)
+{
+  if (channel < 2) {
+    bx_pc_system.activate_timer(BX_PIDE_THIS s.bmdma[channel].timer_index, 1, 0);
+  }
+}
+
 void bx_pci_ide_c::timer_handler(void *this_ptr)
 {
   bx_pci_ide_c *class_ptr = (bx_pci_ide_c *) this_ptr;
@@ -269,6 +277,10 @@ void bx_pci_ide_c::timer()
     while (count > 0) {
       sector_size = count;
       if (DEV_hd_bmdma_read_sector(channel, BX_PIDE_THIS s.bmdma[channel].buffer_top, &sector_size)) {
+        if (sector_size == 0) {
+          // data not ready yet, the drive calls bmdma_start_transfer()
+          return;
+        }
         BX_PIDE_THIS s.bmdma[channel].buffer_top += sector_size;
         count -= sector_size;
       } else {
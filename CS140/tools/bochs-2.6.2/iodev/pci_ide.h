@@ -39,6 +39,7 @@ public:
   virtual void reset(unsigned type);
   virtual bx_bool bmdma_present(void);
   virtual void bmdma_set_irq(Bit8u channel);
+  virtual void bmdma_start_transfer(Bit8u channel);
   virtual void register_state(void);
   virtual void after_restore_state(void);
   static Bit64s param_save_handler(void *devptr, bx_param_c *param);
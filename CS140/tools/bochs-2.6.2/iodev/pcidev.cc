@@ -426,7 +426,7 @@ void bx_pcidev_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_len
       if (DEV_pci_set_base_mem(&(BX_PCIDEV_THIS regions[io_reg_idx]),
           pcidev_mem_read_handler,
           pcidev_mem_write_handler,
-          &BX_PCIDEV_THIS regions[io_reg_idx].start,
+          NULL, &BX_PCIDEV_THIS regions[io_reg_idx].start,
           (Bit8u*)&BX_PCIDEV_THIS regions[io_reg_idx].config_value,
           BX_PCIDEV_THIS regions[io_reg_idx].size)) {
             BX_INFO(("new base #%d memory address: 0x%08x", io_reg_idx,
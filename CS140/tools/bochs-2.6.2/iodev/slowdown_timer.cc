@@ -92,6 +92,18 @@ void bx_slowdown_timer_c::after_restore_state(void)
   s.start_emulated_time = bx_pc_system.time_usec();
 }
 
+Bit64u bx_slowdown_timer_c::get_idle_usec(Bit64u usec)
+{
+  if (s.timer_handle == BX_NULL_TIMER_HANDLE)
+    return 0;
+
+  Bit64u total_emu_time = (bx_pc_system.time_usec()) - s.start_emulated_time;
+  Bit64u totaltime = sectousec(time(NULL)) - s.start_time;
+
+  // let the idle time pass in real time, as long as we are not behind
+  return (total_emu_time >= totaltime) ? usec : 0;
+}
+
 void bx_slowdown_timer_c::timer_handler(void * this_ptr)
 {
   bx_slowdown_timer_c * class_ptr = (bx_slowdown_timer_c *) this_ptr;
@@ -46,6 +46,10 @@ public:
 
   void handle_timer();
 
+  // Real time in usec an idle simulation should wait for the given
+  // emulated time (0 if not ahead of real time)
+  Bit64u get_idle_usec(Bit64u usec);
+
 };
 
 extern bx_slowdown_timer_c bx_slowdown_timer;
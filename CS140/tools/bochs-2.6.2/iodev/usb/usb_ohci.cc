@@ -489,7 +489,7 @@ void bx_usb_ohci_c::register_state(void)
 void bx_usb_ohci_c::after_restore_state(void)
 {
   if (DEV_pci_set_base_mem(BX_OHCI_THIS_PTR, read_handler, write_handler,
-                         &BX_OHCI_THIS pci_base_address[0],
+                         NULL, &BX_OHCI_THIS pci_base_address[0],
                          &BX_OHCI_THIS pci_conf[0x10],
                          4096))  {
      BX_INFO(("new base address: 0x%04x", BX_OHCI_THIS pci_base_address[0]));
@@ -1467,7 +1467,7 @@ void bx_usb_ohci_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_l
   }
   if (baseaddr_change) {
     if (DEV_pci_set_base_mem(BX_OHCI_THIS_PTR, read_handler, write_handler,
-                             &BX_OHCI_THIS pci_base_address[0],
+                             NULL, &BX_OHCI_THIS pci_base_address[0],
                              &BX_OHCI_THIS pci_conf[0x10],
                              4096)) {
       BX_INFO(("new base address: 0x%04x", BX_OHCI_THIS pci_base_address[0]));
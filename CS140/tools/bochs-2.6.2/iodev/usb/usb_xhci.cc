@@ -623,7 +623,7 @@ void bx_usb_xhci_c::register_state(void)
 void bx_usb_xhci_c::after_restore_state(void)
 {
   if (DEV_pci_set_base_mem(BX_XHCI_THIS_PTR, read_handler, write_handler,
-                         &BX_XHCI_THIS pci_base_address[0],
+                         NULL, &BX_XHCI_THIS pci_base_address[0],
                          &BX_XHCI_THIS pci_conf[0x10],
                          4096))  {
      BX_INFO(("new base address: 0x%04x", BX_XHCI_THIS pci_base_address[0]));
@@ -2585,7 +2585,7 @@ void bx_usb_xhci_c::pci_write_handler(Bit8u address, Bit32u value, unsigned io_l
   }
   if (baseaddr_change) {
     if (DEV_pci_set_base_mem(BX_XHCI_THIS_PTR, read_handler, write_handler,
-                             &BX_XHCI_THIS pci_base_address[0],
+                             NULL, &BX_XHCI_THIS pci_base_address[0],
                              &BX_XHCI_THIS pci_conf[0x10],
                              IO_SPACE_SIZE)) {
       BX_INFO(("new base address: 0x%04x", BX_XHCI_THIS pci_base_address[0]));
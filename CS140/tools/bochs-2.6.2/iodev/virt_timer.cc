@@ -527,6 +527,21 @@ void bx_virt_timer_c::pc_system_timer_handler(void* this_ptr)
   ((bx_virt_timer_c *)this_ptr)->timer_handler();
 }
 
+Bit64u bx_virt_timer_c::get_idle_usec(void)
+{
+#if BX_HAVE_REALTIME_USEC
+  if (virtual_timers_realtime && init_done) {
+    // the virtual time is lined up with the real time in timer_handler()
+    Bit64u real_time_total = GET_VIRT_REALTIME64_USEC() - last_real_time - real_time_delay + total_real_usec;
+    Bit64u next_event_time = total_ticks + virtual_next_event_time;
+    if (next_event_time > real_time_total) {
+      return next_event_time - real_time_total;
+    }
+  }
+#endif
+  return 0;
+}
+
 void bx_virt_timer_c::set_realtime_delay()
 {
   if (virtual_timers_realtime) {
@@ -151,6 +151,10 @@ public:
   //Determine the real time elapsed during runtime config or between save and
   //restore.
   void set_realtime_delay(void);
+
+  //Real time in usec until the next virtual timer is due (0 if the virtual
+  //timers are not synchronized to real time).
+  Bit64u get_idle_usec(void);
 };
 
 BOCHSAPI extern bx_virt_timer_c bx_virt_timer;
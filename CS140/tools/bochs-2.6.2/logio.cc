@@ -32,6 +32,65 @@
 
 static int Allocio=0;
 
+// Asynchronous output ("log: async=1")
+//
+// The threads logging a message format it into a record of a ring buffer
+// and a writer thread writes the records to the log file in batches.  A
+// record is reserved by advancing the head index and handed over to the
+// writer through its sequence number, so no lock is taken on the way in.
+// The writer side is serialized by a mutex; when the ring is full, the
+// logging thread writes out the pending records itself instead of waiting.
+
+#define BX_LOG_RING_SIZE        2048  // records, must be a power of 2
+#define BX_LOG_RECORD_SIZE      1024  // longer messages are truncated
+#define BX_LOG_WRITER_INTERVAL  10    // msec between writer thread batches
+
+struct bx_log_record_t {
+  volatile Bit32u seq;
+  Bit32u len;
+  char data[BX_LOG_RECORD_SIZE];
+};
+
+struct bx_log_ring_t {
+  volatile Bit32u head;         // next record to reserve
+  Bit32u tail;                  // next record to write out
+  BX_MUTEX(writer_mutex);
+  BX_THREAD_VAR(writer_thread);
+  bx_log_record_t rec[BX_LOG_RING_SIZE];
+};
+
+static volatile bx_bool log_writer_stop = 0;
+
+// Binary log format ("log: format=binary"): the file starts with the magic
+// string, each message is a header followed by the device prefix and the
+// message text, without terminating zeroes.
+#define BX_LOG_BINARY_MAGIC "BXLOG01\n"
+
+struct bx_log_binary_header_t {
+  Bit64u ticks;
+  Bit32u eip;                   // CPU0 EIP, 0 in SMP builds
+  Bit8u  level;
+  Bit8u  prefix_len;
+  Bit16u msg_len;
+};
+
+static BX_THREAD_FUNC(log_writer_thread, arg)
+{
+  iofunc_t *iofunc = (iofunc_t *) arg;
+
+  while (! log_writer_stop) {
+    iofunc->drain_log_ring();
+    BX_MSLEEP(BX_LOG_WRITER_INTERVAL);
+  }
+
+  BX_THREAD_EXIT;
+}
+
+static void log_ring_atexit(void)
+{
+  if (io != NULL) io->exit_log();
+}
+
 const char* iofunctions::getlevel(int i) const
 {
   static const char *loglevel[N_LOGLEV] = {
@@ -55,8 +114,60 @@ const char* iofunctions::getaction(int i) const
 void iofunctions::flush(void)
 {
   if(logfd && magic == MAGIC_LOGNUM) {
+    drain_log_ring();
+    fflush(logfd);
+  }
+}
+
+void iofunctions::drain_log_ring(void)
+{
+  bx_log_ring_t *r = ring;
+  if (r == NULL) return;
+
+  BX_LOCK(r->writer_mutex);
+  Bit32u pos = r->tail;
+  unsigned count = 0;
+  for (;;) {
+    bx_log_record_t *rec = &r->rec[pos & (BX_LOG_RING_SIZE-1)];
+    if (rec->seq != pos + 1) break;
+    bx_memory_barrier();
+    fwrite(rec->data, 1, rec->len, logfd);
+    // the record can be reused for the next round of the ring
+    bx_atomic_xchg32(&rec->seq, pos + BX_LOG_RING_SIZE);
+    pos++;
+    count++;
+  }
+  r->tail = pos;
+  if (count) fflush(logfd);
+  BX_UNLOCK(r->writer_mutex);
+}
+
+void iofunctions::set_log_mode(bx_bool async, bx_bool binary_format)
+{
+  assert(magic==MAGIC_LOGNUM);
+
+  binary = binary_format;
+  if (binary) {
+    fwrite(BX_LOG_BINARY_MAGIC, 1, strlen(BX_LOG_BINARY_MAGIC), logfd);
     fflush(logfd);
   }
+
+  if (async && ring == NULL) {
+    static bx_bool atexit_registered = 0;
+    bx_log_ring_t *r = new bx_log_ring_t;
+    r->head = r->tail = 0;
+    for (Bit32u n=0; n < BX_LOG_RING_SIZE; n++)
+      r->rec[n].seq = n;
+    BX_INIT_MUTEX(r->writer_mutex);
+    ring = r;
+    log_writer_stop = 0;
+    BX_THREAD_CREATE(log_writer_thread, this, r->writer_thread);
+    // the pending records are written out when Bochs exits
+    if (! atexit_registered) {
+      atexit(log_ring_atexit);
+      atexit_registered = 1;
+    }
+  }
 }
 
 void iofunctions::init(void)
@@ -68,6 +179,8 @@ void iofunctions::init(void)
   // sets the default logprefix
   strcpy(logprefix,"%t%e%d");
   n_logfn = 0;
+  ring = NULL;
+  binary = 0;
   init_log(stderr);
   log = new logfunc_t(this);
   log->put("logio", "IO");
@@ -151,12 +264,22 @@ void iofunctions::init_log(int fd)
 
 void iofunctions::exit_log()
 {
+  if (ring != NULL) {
+    log_writer_stop = 1;
+    BX_THREAD_JOIN(ring->writer_thread);
+    drain_log_ring();
+    BX_FINI_MUTEX(ring->writer_mutex);
+    delete ring;
+    ring = NULL;
+  }
   flush();
   if (logfd != stderr) {
     fclose(logfd);
     logfd = stderr;
     free((char *)logfn);
     logfn = "/dev/stderr";
+    // messages after this point go to stderr as text
+    binary = 0;
   }
 }
 
@@ -170,16 +293,12 @@ void iofunctions::set_log_prefix(const char* prefix)
   strcpy(logprefix, prefix);
 }
 
-//  iofunctions::out(level, prefix, fmt, ap)
-//  DO NOT nest out() from ::info() and the like.
-//    fmt and ap retained for direct printinf from iofunctions only!
-
-void iofunctions::out(int level, const char *prefix, const char *fmt, va_list ap)
+// Expands the log prefix (set_log_prefix) into buf, followed by a space
+// and the panic marker, returns the length of the string.
+int iofunctions::format_prefix(char *buf, int size, int level, const char *prefix)
 {
-  char c=' ', *s;
-  assert(magic==MAGIC_LOGNUM);
-  assert(this != NULL);
-  assert(logfd != NULL);
+  char c=' ';
+  int len = 0, n;
 
   switch (level) {
     case LOGLEV_INFO: c='i'; break;
@@ -189,47 +308,132 @@ void iofunctions::out(int level, const char *prefix, const char *fmt, va_list ap
     default: break;
   }
 
-  s=logprefix;
-  while(*s) {
-    switch(*s) {
-      case '%':
-        if(*(s+1)) s++;
-        else break;
-        switch(*s) {
-          case 'd':
-            fprintf(logfd, "%s", prefix==NULL?"":prefix);
-            break;
-          case 't':
-            fprintf(logfd, FMT_TICK, bx_pc_system.time_ticks());
-            break;
-          case 'i':
+  for (const char *s = logprefix; *s; s++) {
+    n = 0;
+    if (*s == '%') {
+      if (*(s+1) == 0) break;
+      s++;
+      switch(*s) {
+        case 'd':
+          n = snprintf(buf+len, size-len, "%s", prefix==NULL?"":prefix);
+          break;
+        case 't':
+          n = snprintf(buf+len, size-len, FMT_TICK, bx_pc_system.time_ticks());
+          break;
+        case 'i':
+#if BX_SUPPORT_SMP == 0
+          n = snprintf(buf+len, size-len, "%08x", BX_CPU(0)->get_eip());
+#endif
+          break;
+        case 'e':
+          n = snprintf(buf+len, size-len, "%c", c);
+          break;
+        case '%':
+          n = snprintf(buf+len, size-len, "%%");
+          break;
+        default:
+          n = snprintf(buf+len, size-len, "%%%c", *s);
+      }
+    }
+    else {
+      n = snprintf(buf+len, size-len, "%c", *s);
+    }
+    if (n < 0 || n >= size-len) return size-1; // truncated
+    len += n;
+  }
+
+  n = snprintf(buf+len, size-len, (level==LOGLEV_PANIC) ? " >>PANIC<< " : " ");
+  if (n < 0 || n >= size-len) return size-1;
+  return len + n;
+}
+
+// Formats a message as a log file record (text line or binary record)
+// into buf, returns the length of the record.
+int iofunctions::format_record(char *buf, int size, int level, const char *prefix, const char *fmt, va_list ap)
+{
+  int len, n;
+
+  if (binary) {
+    bx_log_binary_header_t header;
+    int hlen = sizeof(header);
+    int plen = (prefix == NULL) ? 0 : strlen(prefix);
+    if (plen > 255) plen = 255;
+    n = vsnprintf(buf + hlen + plen, size - hlen - plen, fmt, ap);
+    if (n < 0 || n >= size - hlen - plen) n = size - hlen - plen - 1;
+    header.ticks = bx_pc_system.time_ticks();
 #if BX_SUPPORT_SMP == 0
-            fprintf(logfd, "%08x", BX_CPU(0)->get_eip());
+    header.eip = BX_CPU(0)->get_eip();
+#else
+    header.eip = 0;
 #endif
-            break;
-          case 'e':
-            fprintf(logfd, "%c", c);
-            break;
-          case '%':
-            fprintf(logfd,"%%");
-            break;
-          default:
-            fprintf(logfd,"%%%c",*s);
-        }
-        break;
-      default :
-        fprintf(logfd,"%c",*s);
+    header.level = level;
+    header.prefix_len = plen;
+    header.msg_len = n;
+    memcpy(buf, &header, hlen);
+    if (plen) memcpy(buf + hlen, prefix, plen);
+    return hlen + plen + n;
+  }
+
+  // leave room for the newline
+  len = format_prefix(buf, size - 1, level, prefix);
+  n = vsnprintf(buf + len, size - 1 - len, fmt, ap);
+  if (n < 0 || n >= size - 1 - len) n = size - 2 - len;
+  len += n;
+  buf[len++] = '\n';
+  return len;
+}
+
+void iofunctions::async_out(int level, const char *prefix, const char *fmt, va_list ap)
+{
+  bx_log_record_t *rec;
+  Bit32u pos = ring->head;
+
+  for (;;) {
+    rec = &ring->rec[pos & (BX_LOG_RING_SIZE-1)];
+    Bit32s diff = (Bit32s)(rec->seq - pos);
+    if (diff == 0) {
+      if (bx_atomic_cas32(&ring->head, pos, pos + 1)) break;
     }
-    s++;
+    else if (diff < 0) {
+      // the ring is full, write out the pending records instead of waiting
+      drain_log_ring();
+    }
+    pos = ring->head;
   }
 
-  fprintf(logfd," ");
+  rec->len = format_record(rec->data, BX_LOG_RECORD_SIZE, level, prefix, fmt, ap);
+  // hand the record over to the writer
+  bx_atomic_xchg32(&rec->seq, pos + 1);
+
+  if (level == LOGLEV_PANIC)
+    drain_log_ring();
+}
+
+//  iofunctions::out(level, prefix, fmt, ap)
+//  DO NOT nest out() from ::info() and the like.
+//    fmt and ap retained for direct printinf from iofunctions only!
+
+void iofunctions::out(int level, const char *prefix, const char *fmt, va_list ap)
+{
+  char buf[BX_LOG_RECORD_SIZE];
+  assert(magic==MAGIC_LOGNUM);
+  assert(this != NULL);
+  assert(logfd != NULL);
 
-  if(level==LOGLEV_PANIC)
-    fprintf(logfd, ">>PANIC<< ");
+  if (ring != NULL) {
+    async_out(level, prefix, fmt, ap);
+    return;
+  }
 
-  vfprintf(logfd, fmt, ap);
-  fprintf(logfd, "\n");
+  if (binary) {
+    fwrite(buf, 1, format_record(buf, sizeof(buf), level, prefix, fmt, ap), logfd);
+  }
+  else {
+    format_prefix(buf, sizeof(buf), level, prefix);
+    fputs(buf, logfd);
+    vfprintf(logfd, fmt, ap);
+    fprintf(logfd, "\n");
+  }
   fflush(logfd);
 }
 
@@ -282,6 +486,8 @@ logfunctions::logfunctions(void)
   name = NULL;
   prefix = NULL;
   put("?", " ");
+  rate_second = 0;
+  rate_count = rate_dropped = 0;
   if (io == NULL && Allocio == 0) {
     Allocio = 1;
     io = new iofunc_t(stderr);
@@ -298,6 +504,8 @@ logfunctions::logfunctions(iofunc_t *iofunc)
   name = NULL;
   prefix = NULL;
   put("?", " ");
+  rate_second = 0;
+  rate_count = rate_dropped = 0;
   setio(iofunc);
   // BUG: unfortunately this can be called before the bochsrc is read,
   // which means that the bochsrc has no effect on the actions.
@@ -305,6 +513,35 @@ logfunctions::logfunctions(iofunc_t *iofunc)
     onoff[i] = get_default_action(i);
 }
 
+unsigned logfunctions::rate_limit = 0;
+
+static void log_out(iofunc_t *iofunc, int level, const char *prefix, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  iofunc->out(level, prefix, fmt, ap);
+  va_end(ap);
+}
+
+// Returns 1 if a message exceeds the rate limit of this device.  The rate
+// is measured in emulated time, so the log stays the same between runs.
+// The number of suppressed messages is reported with the first message
+// of the next second.
+bx_bool logfunctions::rate_exceeded(int level)
+{
+  Bit64u second = bx_pc_system.time_usec() / 1000000;
+  if (second != rate_second) {
+    if (rate_dropped) {
+      log_out(logio, level, prefix, "%u messages suppressed by the rate limit", rate_dropped);
+    }
+    rate_second = second;
+    rate_count = rate_dropped = 0;
+  }
+  if (++rate_count <= rate_limit) return 0;
+  rate_dropped++;
+  return 1;
+}
+
 logfunctions::~logfunctions()
 {
   logio->remove_logfn(this);
@@ -363,6 +600,7 @@ void logfunctions::info(const char *fmt, ...)
   assert(logio != NULL);
 
   if(!onoff[LOGLEV_INFO]) return;
+  if (rate_limit && onoff[LOGLEV_INFO] == ACT_REPORT && rate_exceeded(LOGLEV_INFO)) return;
 
   va_start(ap, fmt);
   logio->out(LOGLEV_INFO, prefix, fmt, ap);
@@ -380,6 +618,7 @@ void logfunctions::error(const char *fmt, ...)
   assert(logio != NULL);
 
   if(!onoff[LOGLEV_ERROR]) return;
+  if (rate_limit && onoff[LOGLEV_ERROR] == ACT_REPORT && rate_exceeded(LOGLEV_ERROR)) return;
 
   va_start(ap, fmt);
   logio->out(LOGLEV_ERROR, prefix, fmt, ap);
@@ -421,6 +660,7 @@ void logfunctions::ldebug(const char *fmt, ...)
   assert(logio != NULL);
 
   if(!onoff[LOGLEV_DEBUG]) return;
+  if (rate_limit && onoff[LOGLEV_DEBUG] == ACT_REPORT && rate_exceeded(LOGLEV_DEBUG)) return;
 
   va_start(ap, fmt);
   logio->out(LOGLEV_DEBUG, prefix, fmt, ap);
@@ -934,6 +934,133 @@ bx_bool load_and_init_display_lib(void)
   return true;
 }
 
+#if BX_SUPPORT_SMP && BX_DEBUGGER == 0
+
+// Threaded SMP simulation: every processor is simulated by its own host
+// thread.  The processors run time slices in lockstep; between two slices
+// all of them are stopped and the main thread advances the system timers,
+// so devices and timer handlers always see a consistent machine state.
+// Device accesses done by the processors inside a slice are serialized by
+// the I/O lock (see BX_LOCK_IO in bochs.h).
+
+// Upper limit for the length of one slice, in instructions.  Shorter slices
+// keep the processors closer in time (IPI latency) at the cost of more
+// host thread synchronization.
+#define BX_SMP_THREADS_MAX_SLICE 4096
+
+struct bx_cpu_thread_t {
+  BX_THREAD_VAR(thread);
+  bx_thread_event_t run_event;
+  bx_thread_event_t done_event;
+};
+
+static bx_cpu_thread_t *bx_cpu_threads = NULL;
+static volatile Bit32u bx_smp_slice = 0;
+static volatile bx_bool bx_smp_threads_exit = 0;
+
+BX_THREAD_FUNC(bx_cpu_thread, arg)
+{
+  unsigned processor = (unsigned)(bx_ptr_equiv_t) arg;
+  BX_CPU_C *cpu = BX_CPU(processor);
+
+  while (1) {
+    bx_wait_for_event(&bx_cpu_threads[processor].run_event);
+    if (bx_smp_threads_exit) break;
+
+    Bit64u start = cpu->get_icount();
+    while ((cpu->get_icount() - start) < bx_smp_slice) {
+      cpu->icount_last_sync = cpu->get_icount();
+      // linked traces may run until the end of the slice
+      cpu->icount_link_limit = bx_smp_slice - (Bit32u)(cpu->get_icount() - start);
+      cpu->cpu_run_trace();
+      // a halted processor has nothing more to do in this slice unless
+      // another processor has sent it a request (for example SIPI)
+      if (cpu->activity_state != BX_CPU_C::BX_ACTIVITY_STATE_ACTIVE && !cpu->remote_request)
+        break;
+      if (bx_pc_system.kill_bochs_request || bx_pc_system.pending_reset)
+        break;
+    }
+
+    bx_set_event(&bx_cpu_threads[processor].done_event);
+  }
+
+  BX_THREAD_EXIT;
+}
+
+static void bx_smp_threads_loop(void)
+{
+  unsigned processor;
+
+  bx_cpu_threads = new bx_cpu_thread_t[BX_SMP_PROCESSORS];
+  bx_pc_system.smp_threads = 1;
+
+  for (processor=0; processor < BX_SMP_PROCESSORS; processor++) {
+    bx_create_event(&bx_cpu_threads[processor].run_event);
+    bx_create_event(&bx_cpu_threads[processor].done_event);
+    BX_THREAD_CREATE(bx_cpu_thread, (void *)(bx_ptr_equiv_t) processor,
+                     bx_cpu_threads[processor].thread);
+  }
+
+  while (1) {
+    // run until the next timer event is due, but not longer than the
+    // maximum slice length
+    Bit32u slice = bx_pc_system.getNumCpuTicksLeftNextEvent();
+    if (slice > BX_SMP_THREADS_MAX_SLICE) slice = BX_SMP_THREADS_MAX_SLICE;
+    if (slice == 0) slice = 1;
+    bx_smp_slice = slice;
+
+    bx_pc_system.cpus_running = 1;
+    for (processor=0; processor < BX_SMP_PROCESSORS; processor++)
+      bx_set_event(&bx_cpu_threads[processor].run_event);
+    for (processor=0; processor < BX_SMP_PROCESSORS; processor++)
+      bx_wait_for_event(&bx_cpu_threads[processor].done_event);
+    bx_pc_system.cpus_running = 0;
+
+    BX_TICKN(slice);
+
+    // a reset requested by one of the processors was deferred until
+    // all of them are stopped
+    if (bx_pc_system.pending_reset) {
+      unsigned type = bx_pc_system.pending_reset;
+      bx_pc_system.pending_reset = 0;
+      bx_pc_system.Reset(type);
+    }
+
+    // interrupts raised by devices or other processors while a processor
+    // was clearing its async_event must not be lost
+    for (processor=0; processor < BX_SMP_PROCESSORS; processor++) {
+      if (BX_CPU(processor)->unmasked_events_pending() || BX_CPU(processor)->remote_request)
+        BX_CPU(processor)->async_event = 1;
+    }
+
+    // all processors halted: skip to the next timer event
+    for (processor=0; processor < BX_SMP_PROCESSORS; processor++) {
+      if (BX_CPU(processor)->activity_state == BX_CPU_C::BX_ACTIVITY_STATE_ACTIVE ||
+          BX_CPU(processor)->unmasked_events_pending() || BX_CPU(processor)->remote_request)
+        break;
+    }
+    if (processor == BX_SMP_PROCESSORS && !bx_pc_system.pending_reset)
+      bx_pc_system.idle();
+
+    if (bx_pc_system.kill_bochs_request)
+      break;
+  }
+
+  bx_smp_threads_exit = 1;
+  for (processor=0; processor < BX_SMP_PROCESSORS; processor++) {
+    bx_set_event(&bx_cpu_threads[processor].run_event);
+    BX_THREAD_JOIN(bx_cpu_threads[processor].thread);
+    bx_destroy_event(&bx_cpu_threads[processor].run_event);
+    bx_destroy_event(&bx_cpu_threads[processor].done_event);
+  }
+
+  bx_pc_system.smp_threads = 0;
+  delete [] bx_cpu_threads;
+  bx_cpu_threads = NULL;
+}
+
+#endif
+
 int bx_begin_simulation (int argc, char *argv[])
 {
   bx_user_quit = 0;
@@ -1023,31 +1150,46 @@ int bx_begin_simulation (int argc, char *argv[])
       // that kill_bochs_request was set by the GUI interface.
     }
 #if BX_SUPPORT_SMP
+    else if (SIM->get_param_bool(BXPN_SMP_THREADS)->get()) {
+      // SMP simulation with one host thread per processor
+      bx_smp_threads_loop();
+    }
     else {
       // SMP simulation: do a few instructions on each processor, then switch
       // to another.  Increasing quantum speeds up overall performance, but
       // reduces granularity of synchronization between processors.
       // Current implementation uses dynamic quantum, each processor will
-      // execute exactly one trace then quit the cpu_loop and switch to
-      // the next processor.
+      // execute one trace (and the traces linked to it, up to the quantum)
+      // then quit the cpu_loop and switch to the next processor.
 
       static int quantum = SIM->get_param_num(BXPN_SMP_QUANTUM)->get();
-      Bit32u executed = 0, processor = 0;
+      Bit32u executed = 0, processor = 0, halted = 0;
 
       while (1) {
          // do some instructions in each processor
          Bit64u icount = BX_CPU(processor)->icount_last_sync = BX_CPU(processor)->get_icount();
+         BX_CPU(processor)->icount_link_limit = quantum;
          BX_CPU(processor)->cpu_run_trace();
 
          // see how many instruction it was able to run
          Bit32u n = (Bit32u)(BX_CPU(processor)->get_icount() - icount);
-         if (n == 0) n = quantum; // the CPU was halted
+         if (n == 0) { // the CPU was halted
+           n = quantum;
+           halted++;
+         }
          executed += n;
 
          if (++processor == BX_SMP_PROCESSORS) {
            processor = 0;
-           BX_TICKN(executed / BX_SMP_PROCESSORS);
-           executed %= BX_SMP_PROCESSORS;
+           if (halted == BX_SMP_PROCESSORS) {
+             // all processors halted: skip to the next timer event
+             bx_pc_system.idle();
+             executed = 0;
+           } else {
+             BX_TICKN(executed / BX_SMP_PROCESSORS);
+             executed %= BX_SMP_PROCESSORS;
+           }
+           halted = 0;
          }
 
          if (bx_pc_system.kill_bochs_request)
@@ -1081,6 +1223,7 @@ void bx_sr_after_restore_state(void)
     BX_CPU(i)->after_restore_state();
   }
 #endif
+  bx_pc_system.after_restore_state();
   DEV_after_restore_state();
 }
 
@@ -1116,12 +1259,21 @@ void bx_init_hardware()
 
   bx_pc_system.initialize(SIM->get_param_num(BXPN_IPS)->get());
 
+  // look up the log options before the log file is opened, so that a
+  // binary log file starts with its header
+  const char *log_prefix = SIM->get_param_string(BXPN_LOG_PREFIX)->getptr();
+  bx_bool log_async = SIM->get_param_bool(BXPN_LOG_ASYNC)->get();
+  bx_bool log_binary = (SIM->get_param_enum(BXPN_LOG_FORMAT)->get() == BX_LOG_FORMAT_BINARY);
+  unsigned log_rate_limit = SIM->get_param_num(BXPN_LOG_RATE_LIMIT)->get();
+
   if (SIM->get_param_string(BXPN_LOG_FILENAME)->getptr()[0]!='-') {
     BX_INFO (("using log file %s", SIM->get_param_string(BXPN_LOG_FILENAME)->getptr()));
     io->init_log(SIM->get_param_string(BXPN_LOG_FILENAME)->getptr());
   }
 
-  io->set_log_prefix(SIM->get_param_string(BXPN_LOG_PREFIX)->getptr());
+  io->set_log_prefix(log_prefix);
+  io->set_log_mode(log_async, log_binary);
+  logfunctions::set_rate_limit(log_rate_limit);
 
   // Output to the log file the cpu and device settings
   // This will by handy for bug reports
@@ -1146,7 +1298,8 @@ void bx_init_hardware()
   BX_INFO(("IPS is set to %d", (Bit32u) SIM->get_param_num(BXPN_IPS)->get()));
   BX_INFO(("CPU configuration"));
 #if BX_SUPPORT_SMP
-  BX_INFO(("  SMP support: yes, quantum=%d", SIM->get_param_num(BXPN_SMP_QUANTUM)->get()));
+  BX_INFO(("  SMP support: yes, quantum=%d, threads=%s", SIM->get_param_num(BXPN_SMP_QUANTUM)->get(),
+    SIM->get_param_bool(BXPN_SMP_THREADS)->get()?"yes":"no"));
 #else
   BX_INFO(("  SMP support: no"));
 #endif
@@ -69,15 +69,12 @@ void BX_MEM_C::writePhysicalPage(BX_CPU_C *cpu, bx_phy_address addr, unsigned le
     }
   }
 
-  memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-          memory_handler->end >= a20addr &&
-          memory_handler->write_handler(a20addr, len, data, memory_handler->param))
-    {
-      return;
-    }
-    memory_handler = memory_handler->next;
+  memory_handler = BX_MEM_THIS get_memory_handler(a20addr);
+  if (memory_handler) {
+    BX_LOCK_IO();
+    bx_bool handled = memory_handler->write_handler(a20addr, len, data, memory_handler->param);
+    BX_UNLOCK_IO();
+    if (handled) return;
   }
 
 mem_write:
@@ -89,22 +86,22 @@ mem_write:
     {
       if (len == 8) {
         pageWriteStampTable.decWriteStamp(a20addr, 8);
-        WriteHostQWordToLittleEndian(BX_MEM_THIS get_vector(a20addr), *(Bit64u*)data);
+        WriteHostQWordToLittleEndian(BX_MEM_THIS get_vector_write(a20addr), *(Bit64u*)data);
         return;
       }
       if (len == 4) {
         pageWriteStampTable.decWriteStamp(a20addr, 4);
-        WriteHostDWordToLittleEndian(BX_MEM_THIS get_vector(a20addr), *(Bit32u*)data);
+        WriteHostDWordToLittleEndian(BX_MEM_THIS get_vector_write(a20addr), *(Bit32u*)data);
         return;
       }
       if (len == 2) {
         pageWriteStampTable.decWriteStamp(a20addr, 2);
-        WriteHostWordToLittleEndian(BX_MEM_THIS get_vector(a20addr), *(Bit16u*)data);
+        WriteHostWordToLittleEndian(BX_MEM_THIS get_vector_write(a20addr), *(Bit16u*)data);
         return;
       }
       if (len == 1) {
         pageWriteStampTable.decWriteStamp(a20addr, 1);
-        * (BX_MEM_THIS get_vector(a20addr)) = * (Bit8u *) data;
+        * (BX_MEM_THIS get_vector_write(a20addr)) = * (Bit8u *) data;
         return;
       }
       // len == other, just fall thru to special cases handling
@@ -122,7 +119,7 @@ mem_write:
     {
       // addr *not* in range 000A0000 .. 000FFFFF
       while(1) {
-        *(BX_MEM_THIS get_vector(a20addr)) = *data_ptr;
+        *(BX_MEM_THIS get_vector_write(a20addr)) = *data_ptr;
         if (len == 1) return;
         len--;
         a20addr++;
@@ -142,7 +139,7 @@ mem_write:
       if (a20addr < 0x000c0000) {
         // devices are not allowed to access SMMRAM under VGA memory
         if (cpu) {
-          *(BX_MEM_THIS get_vector(a20addr)) = *data_ptr;
+          *(BX_MEM_THIS get_vector_write(a20addr)) = *data_ptr;
         }
         goto inc_one;
       }
@@ -159,7 +156,7 @@ mem_write:
         if (BX_MEM_THIS memory_type[area][1] == 1) {
           // Writes to ShadowRAM
           BX_DEBUG(("Writing to ShadowRAM: address 0x" FMT_PHY_ADDRX ", data %02x", a20addr, *data_ptr));
-          *(BX_MEM_THIS get_vector(a20addr)) = *data_ptr;
+          *(BX_MEM_THIS get_vector_write(a20addr)) = *data_ptr;
         } else {
           // Writes to ROM, Inhibit
           BX_DEBUG(("Write to ROM ignored: address 0x" FMT_PHY_ADDRX ", data %02x", a20addr, *data_ptr));
@@ -227,15 +224,12 @@ void BX_MEM_C::readPhysicalPage(BX_CPU_C *cpu, bx_phy_address addr, unsigned len
     }
   }
 
-  memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-          memory_handler->end >= a20addr &&
-          memory_handler->read_handler(a20addr, len, data, memory_handler->param))
-    {
-      return;
-    }
-    memory_handler = memory_handler->next;
+  memory_handler = BX_MEM_THIS get_memory_handler(a20addr);
+  if (memory_handler) {
+    BX_LOCK_IO();
+    bx_bool handled = memory_handler->read_handler(a20addr, len, data, memory_handler->param);
+    BX_UNLOCK_IO();
+    if (handled) return;
   }
 
 mem_read:
@@ -35,6 +35,7 @@
 #endif
 
 class BX_CPU_C;
+struct bx_mem_snapshot_t;
 
                                        // 512K BIOS ROM @0xfff80000
 #define BIOSROMSZ ((Bit32u)(1 << 21))  //   2M BIOS ROM @0xffe00000, must be a power of 2
@@ -65,12 +66,14 @@ typedef bx_bool (*memory_handler_t)(bx_phy_address addr, unsigned len, void *dat
 // same format as getHostMemAddr method
 typedef Bit8u* (*memory_direct_access_handler_t)(bx_phy_address addr, unsigned rw, void *param);
 
+// The registered ranges never overlap, so a binary tree ordered by address
+// answers both the overlap checks and the "which range holds addr" lookups.
 struct memory_handler_struct {
-  struct memory_handler_struct *next;
+  struct memory_handler_struct *left;
+  struct memory_handler_struct *right;
   void *param;
   bx_phy_address begin;
   bx_phy_address end;
-  Bit16u bitmap;
   memory_handler_t read_handler;
   memory_handler_t write_handler;
   memory_direct_access_handler_t da_handler;
@@ -79,9 +82,16 @@ struct memory_handler_struct {
 #define SMRAM_CODE  1
 #define SMRAM_DATA  2
 
+// The handler map has one entry per 4K page, split in second level tables
+// of 1024 pages (4M) which are only allocated where handlers are registered
+#define BX_MEM_HANDLER_TABLE_SHIFT 22
+#define BX_MEM_HANDLER_TABLE_PAGES (1 << (BX_MEM_HANDLER_TABLE_SHIFT - 12))
+
 class BOCHSAPI BX_MEM_C : public logfunctions {
 private:
-  struct memory_handler_struct **memory_handlers;
+  struct memory_handler_struct *memory_handler_tree;
+  // first handler registered within each page (NULL: plain memory)
+  struct memory_handler_struct ***memory_handler_map;
   bx_bool pci_enabled;
   bx_bool bios_write_enabled;
   bx_bool smram_available;
@@ -98,6 +108,40 @@ private:
   bx_bool memory_type[13][2];
 
   Bit32u used_blocks;
+  // guest RAM is one memory mapped region, all blocks are present
+  bx_bool ram_mapped;
+
+  // Page tracking for the RAM snapshots, one bit per 4K page of the host
+  // memory vector.  The dirty map holds the pages written since the last
+  // checkpoint, the used map all pages written since power-up.
+  Bit32u  num_pages;
+  Bit32u *dirty_map;
+  Bit32u *used_map;
+  // RAM snapshot currently written by the background thread (or NULL)
+  bx_mem_snapshot_t *snapshot;
+  // path of the last checkpoint saved or restored (parent of the next delta)
+  char   *last_checkpoint;
+  // Lazy restore: the pages of a restored checkpoint are read from the
+  // snapshot files on first access.  The lazy map holds the file and the
+  // offset of each page not loaded yet (0 if the page is present).
+  Bit64u *lazy_map;
+  volatile Bit32u lazy_pages;  // number of pages not loaded yet
+  int    *lazy_fds;
+  unsigned lazy_num_fds;
+
+  BX_MEM_SMF void   dirty_page(Bit32u page);
+  BX_MEM_SMF void   finish_snapshot(void);
+  BX_MEM_SMF bx_bool restore_snapshot(const char *path, unsigned depth);
+  BX_MEM_SMF void   page_in(const Bit8u *hostAddr);
+  BX_MEM_SMF void   load_page(Bit32u page);
+  BX_MEM_SMF void   load_all_pages(void);
+  BX_MEM_SMF void   close_lazy_restore(void);
+#if BX_HAVE_SYS_MMAN_H
+  Bit64u  ram_map_len;
+
+  BX_MEM_SMF Bit8u* map_ram(Bit64u size);
+  BX_MEM_SMF void   unmap_ram(void);
+#endif
 #if BX_LARGE_RAMFILE
   static Bit8u * const swapped_out; // NULL; // (NULL - sizeof(Bit8u));
   Bit32u  next_swapout_idx;
@@ -111,6 +155,8 @@ public:
  ~BX_MEM_C();
 
   BX_MEM_SMF Bit8u*  get_vector(bx_phy_address addr);
+  BX_MEM_SMF Bit8u*  get_vector_write(bx_phy_address addr);
+  BX_MEM_SMF void    mark_dirty(const Bit8u *hostAddr);
   BX_MEM_SMF void    init_memory(Bit64u guest, Bit64u host);
   BX_MEM_SMF void    cleanup_memory(void);
 
@@ -153,6 +199,9 @@ public:
      return registerMemoryHandlers(param, read_handler, write_handler, NULL, begin_addr, end_addr);
   }
   BX_MEM_SMF bx_bool unregisterMemoryHandlers(void *param, bx_phy_address begin_addr, bx_phy_address end_addr);
+  BX_MEM_SMF BX_CPP_INLINE struct memory_handler_struct *get_memory_handler(bx_phy_address a20addr);
+  BX_MEM_SMF struct memory_handler_struct *find_memory_handler(bx_phy_address a20addr);
+  BX_MEM_SMF void update_memory_handler_map(bx_phy_address begin_addr, bx_phy_address end_addr);
 
   BX_MEM_SMF Bit64u  get_memory_len(void);
   BX_MEM_SMF void allocate_block(Bit32u index);
@@ -165,7 +214,11 @@ public:
 
   void register_state(void);
 
+  BX_MEM_SMF void    start_snapshot(const char *path);
+  BX_MEM_SMF void    write_snapshot(bx_mem_snapshot_t *snap);
+
   friend void ramfile_save_handler(void *devptr, FILE *fp);
+  friend void ram_snapshot_restore_handler(void *devptr, FILE *fp);
   friend Bit64s memory_param_save_handler(void *devptr, bx_param_c *param);
   friend void memory_param_restore_handler(void *devptr, bx_param_c *param, Bit64s val);
 };
@@ -182,17 +235,74 @@ BX_CPP_INLINE Bit8u* BX_MEM_C::get_vector(bx_phy_address addr)
 }
 */
 
+// the page containing hostAddr (in the RAM vector) is being accessed
+BX_CPP_INLINE void BX_MEM_C::page_in(const Bit8u *hostAddr)
+{
+  Bit32u page = (Bit32u)((hostAddr - BX_MEM_THIS vector) >> 12);
+  if (BX_MEM_THIS lazy_map[page])
+    load_page(page);
+}
+
 BX_CPP_INLINE Bit8u* BX_MEM_C::get_vector(bx_phy_address addr)
 {
-  Bit32u block = (Bit32u)(addr / BX_MEM_BLOCK_LEN);
+  Bit8u *hostAddr;
+
+  if (BX_MEM_THIS ram_mapped) {
+    hostAddr = BX_MEM_THIS vector + addr;
+  }
+  else {
+    Bit32u block = (Bit32u)(addr / BX_MEM_BLOCK_LEN);
 #if (BX_LARGE_RAMFILE)
-  if (!BX_MEM_THIS blocks[block] || (BX_MEM_THIS blocks[block] == BX_MEM_THIS swapped_out))
+    if (!BX_MEM_THIS blocks[block] || (BX_MEM_THIS blocks[block] == BX_MEM_THIS swapped_out))
 #else
-  if (!BX_MEM_THIS blocks[block])
+    if (!BX_MEM_THIS blocks[block])
 #endif
-    allocate_block(block);
+      allocate_block(block);
+
+    hostAddr = BX_MEM_THIS blocks[block] + (Bit32u)(addr & (BX_MEM_BLOCK_LEN-1));
+  }
 
-  return BX_MEM_THIS blocks[block] + (Bit32u)(addr & (BX_MEM_BLOCK_LEN-1));
+  // first access to a page of a lazily restored checkpoint
+  if (BX_MEM_THIS lazy_pages)
+    page_in(hostAddr);
+
+  return hostAddr;
+}
+
+// the page containing hostAddr (in the RAM vector) is being written
+BX_CPP_INLINE void BX_MEM_C::mark_dirty(const Bit8u *hostAddr)
+{
+  Bit32u page = (Bit32u)((hostAddr - BX_MEM_THIS vector) >> 12);
+  if (! (BX_MEM_THIS dirty_map[page >> 5] & (1 << (page & 31))))
+    dirty_page(page);
+}
+
+BX_CPP_INLINE Bit8u* BX_MEM_C::get_vector_write(bx_phy_address addr)
+{
+  Bit8u *hostAddr = get_vector(addr);
+  mark_dirty(hostAddr);
+  return hostAddr;
+}
+
+// return the memory handler registered for a20addr or NULL
+BX_CPP_INLINE struct memory_handler_struct *BX_MEM_C::get_memory_handler(bx_phy_address a20addr)
+{
+  struct memory_handler_struct **table =
+    BX_MEM_THIS memory_handler_map[a20addr >> BX_MEM_HANDLER_TABLE_SHIFT];
+  if (! table) return NULL;
+
+  struct memory_handler_struct *memory_handler =
+    table[(a20addr >> 12) & (BX_MEM_HANDLER_TABLE_PAGES-1)];
+  if (! memory_handler || memory_handler->begin > a20addr)
+    return NULL;
+  if (memory_handler->end >= a20addr)
+    return memory_handler;
+
+  // page shared by more than one range
+  memory_handler = find_memory_handler(a20addr);
+  if (memory_handler && memory_handler->begin <= a20addr)
+    return memory_handler;
+  return NULL;
 }
 
 BX_CPP_INLINE Bit64u BX_MEM_C::get_memory_len(void)
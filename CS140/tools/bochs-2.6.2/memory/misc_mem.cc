@@ -28,14 +28,72 @@
 #include "iodev/iodev.h"
 #define LOG_THIS BX_MEM(0)->
 
+#if BX_HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#endif
+
 // alignment of memory vector, must be a power of 2
 #define BX_MEM_VECTOR_ALIGN 4096
-#define BX_MEM_HANDLERS   ((BX_CONST64(1) << BX_PHY_ADDRESS_WIDTH) >> 20) /* one per megabyte */
+#define BX_MEM_HANDLER_TABLES ((BX_CONST64(1) << BX_PHY_ADDRESS_WIDTH) >> BX_MEM_HANDLER_TABLE_SHIFT)
+
+static void delete_memory_handlers(struct memory_handler_struct *memory_handler)
+{
+  if (memory_handler) {
+    delete_memory_handlers(memory_handler->left);
+    delete_memory_handlers(memory_handler->right);
+    delete memory_handler;
+  }
+}
 
 #if BX_LARGE_RAMFILE
 Bit8u* const BX_MEM_C::swapped_out = ((Bit8u*)NULL - sizeof(Bit8u));
 #endif
 
+// RAM snapshot file: header, parent checkpoint path (empty for a full
+// snapshot), runs of saved 4K pages terminated by a run of length 0
+#define BX_RAM_SNAPSHOT_MAGIC "BXRAMSN1"
+#define BX_RAM_SNAPSHOT_MAX_DEPTH 256
+
+struct bx_ram_snapshot_header_t {
+  char   magic[8];
+  Bit32u num_pages;
+  Bit32u parent_len;
+};
+
+struct bx_ram_snapshot_run_t {
+  Bit32u first_page;
+  Bit32u num_pages;
+};
+
+// RAM snapshot written by the background thread.  The pages of the
+// snapshot are copied aside on the first write after the checkpoint
+// (copy-on-write) if the writer thread did not save them yet.
+struct bx_mem_snapshot_t {
+  Bit32u *pages;    // pages belonging to the snapshot
+  Bit32u *pending;  // pages not yet saved or copied aside
+  Bit8u **aside;    // copies of the pages written after the checkpoint
+  char    path[BX_PATHNAME_LEN];
+  char    parent[BX_PATHNAME_LEN];
+};
+
+static BX_MUTEX(snapshot_mutex);
+static BX_THREAD_VAR(snapshot_thread);
+static bx_bool snapshot_thread_running = 0;
+
+// lazy map entry: index of the snapshot file + 1 in the upper 16 bits,
+// file offset of the page in the lower 48 bits
+#define BX_LAZY_PAGE(file, offset) ((((Bit64u)(file) + 1) << 48) | (offset))
+#define BX_LAZY_ZERO_PAGE   BX_CONST64(0xffff000000000000)
+#define BX_LAZY_OFFSET_MASK BX_CONST64(0x0000ffffffffffff)
+
+static BX_MUTEX(lazy_mutex);
+
 BX_MEM_C::BX_MEM_C()
 {
   put("memory", "MEM0");
@@ -45,8 +103,21 @@ BX_MEM_C::BX_MEM_C()
   blocks = NULL;
   len    = 0;
   used_blocks = 0;
-
-  memory_handlers = NULL;
+  ram_mapped = 0;
+  num_pages = 0;
+  dirty_map = NULL;
+  used_map = NULL;
+  snapshot = NULL;
+  last_checkpoint = NULL;
+  lazy_map = NULL;
+  lazy_pages = 0;
+  lazy_fds = NULL;
+  lazy_num_fds = 0;
+  BX_INIT_MUTEX(snapshot_mutex);
+  BX_INIT_MUTEX(lazy_mutex);
+
+  memory_handler_tree = NULL;
+  memory_handler_map = NULL;
 
 #if BX_LARGE_RAMFILE
   next_swapout_idx = 0;
@@ -73,6 +144,63 @@ Bit8u* BX_MEM_C::alloc_vector_aligned(Bit32u bytes, Bit32u alignment)
   return vector;
 }
 
+#if BX_HAVE_SYS_MMAN_H
+// Map the guest RAM as a single region.  The host kernel allocates the
+// pages on first touch and does the paging, so unused guest memory costs
+// nothing.  With a backing file the RAM contents are kept in the file.
+Bit8u* BX_MEM_C::map_ram(Bit64u size)
+{
+  const char *path = SIM->get_param_string(BXPN_MEM_FILE)->getptr();
+  int flags = MAP_NORESERVE, fd = -1;
+
+  if (*path != '\0') {
+    fd = open(path, O_RDWR | O_CREAT
+#ifdef O_BINARY
+                | O_BINARY
+#endif
+              , S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+      BX_PANIC(("map_ram: couldn't open RAM backing file '%s'", path));
+      return NULL;
+    }
+    // the restored checkpoint replaces the old contents of the file
+    if (SIM->get_param_bool(BXPN_RESTORE_FLAG)->get() && (ftruncate(fd, 0) < 0)) {
+      BX_PANIC(("map_ram: couldn't clear RAM backing file '%s'", path));
+      close(fd);
+      return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) < 0) {
+      BX_PANIC(("map_ram: couldn't resize RAM backing file '%s'", path));
+      close(fd);
+      return NULL;
+    }
+    flags |= MAP_SHARED;
+  }
+  else {
+    flags |= MAP_PRIVATE | MAP_ANONYMOUS;
+  }
+
+  void *ptr = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, flags, fd, 0);
+  // the mapping keeps its own reference to the file
+  if (fd >= 0) close(fd);
+  if (ptr == MAP_FAILED) {
+    BX_PANIC(("map_ram: unable to map " FMT_LL "u bytes of guest RAM", size));
+    return NULL;
+  }
+  BX_MEM_THIS ram_map_len = size;
+  BX_INFO(("mapped guest RAM at %p%s%s", ptr, (fd >= 0) ? ", file=" : "", path));
+  return (Bit8u*) ptr;
+}
+
+void BX_MEM_C::unmap_ram(void)
+{
+  if (BX_MEM_THIS ram_mapped) {
+    munmap(BX_MEM_THIS vector, (size_t)BX_MEM_THIS ram_map_len);
+    BX_MEM_THIS ram_mapped = 0;
+  }
+}
+#endif
+
 BX_MEM_C::~BX_MEM_C()
 {
 #if BX_LARGE_RAMFILE
@@ -95,21 +223,47 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
 
   if (BX_MEM_THIS actual_vector != NULL) {
     BX_INFO(("freeing existing memory vector"));
+    finish_snapshot();
+#if BX_HAVE_SYS_MMAN_H
+    unmap_ram();
+#endif
     delete [] BX_MEM_THIS actual_vector;
     BX_MEM_THIS actual_vector = NULL;
     BX_MEM_THIS vector = NULL;
     BX_MEM_THIS blocks = NULL;
   }
-  BX_MEM_THIS vector = alloc_vector_aligned(host + BIOSROMSZ + EXROMSIZE + 4096, BX_MEM_VECTOR_ALIGN);
-  BX_INFO(("allocated memory at %p. after alignment, vector=%p",
-        BX_MEM_THIS actual_vector, BX_MEM_THIS vector));
+#if BX_HAVE_SYS_MMAN_H
+  if (SIM->get_param_bool(BXPN_MEM_MMAP)->get()) {
+    // the whole guest RAM is mapped, the ROMs are allocated separately
+    BX_MEM_THIS vector = map_ram(guest);
+    BX_MEM_THIS ram_mapped = 1;
+    host = guest;
+    BX_MEM_THIS rom = alloc_vector_aligned(BIOSROMSZ + EXROMSIZE + 4096, BX_MEM_VECTOR_ALIGN);
+  }
+  else
+#endif
+  {
+    BX_MEM_THIS vector = alloc_vector_aligned(host + BIOSROMSZ + EXROMSIZE + 4096, BX_MEM_VECTOR_ALIGN);
+    BX_INFO(("allocated memory at %p. after alignment, vector=%p",
+          BX_MEM_THIS actual_vector, BX_MEM_THIS vector));
+    BX_MEM_THIS rom = &BX_MEM_THIS vector[host];
+  }
 
   BX_MEM_THIS len = guest;
   BX_MEM_THIS allocated = host;
-  BX_MEM_THIS rom = &BX_MEM_THIS vector[host];
-  BX_MEM_THIS bogus = &BX_MEM_THIS vector[host + BIOSROMSZ + EXROMSIZE];
+  BX_MEM_THIS bogus = &BX_MEM_THIS rom[BIOSROMSZ + EXROMSIZE];
   memset(BX_MEM_THIS rom, 0xff, BIOSROMSZ + EXROMSIZE + 4096);
 
+  BX_MEM_THIS num_pages = (Bit32u)(host >> 12);
+  delete [] BX_MEM_THIS dirty_map;
+  delete [] BX_MEM_THIS used_map;
+  BX_MEM_THIS dirty_map = new Bit32u[(BX_MEM_THIS num_pages + 31) / 32];
+  BX_MEM_THIS used_map = new Bit32u[(BX_MEM_THIS num_pages + 31) / 32];
+  memset(BX_MEM_THIS dirty_map, 0, ((BX_MEM_THIS num_pages + 31) / 32) * sizeof(Bit32u));
+  memset(BX_MEM_THIS used_map, 0, ((BX_MEM_THIS num_pages + 31) / 32) * sizeof(Bit32u));
+  delete [] BX_MEM_THIS last_checkpoint;
+  BX_MEM_THIS last_checkpoint = NULL;
+
   // block must be large enough to fit num_blocks in 32-bit
   BX_ASSERT((BX_MEM_THIS len / BX_MEM_BLOCK_LEN) <= 0xffffffff);
 
@@ -117,7 +271,7 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
   BX_INFO(("%.2fMB", (float)(BX_MEM_THIS len / (1024.0*1024.0))));
   BX_INFO(("mem block size = 0x%08x, blocks=%u", BX_MEM_BLOCK_LEN, num_blocks));
   BX_MEM_THIS blocks = new Bit8u* [num_blocks];
-  if (0) {
+  if (BX_MEM_THIS ram_mapped) {
     // all guest memory is allocated, just map it
     for (idx = 0; idx < num_blocks; idx++) {
       BX_MEM_THIS blocks[idx] = BX_MEM_THIS vector + (idx * BX_MEM_BLOCK_LEN);
@@ -132,9 +286,10 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
     BX_MEM_THIS used_blocks = 0;
   }
 
-  BX_MEM_THIS memory_handlers = new struct memory_handler_struct *[BX_MEM_HANDLERS];
-  for (idx = 0; idx < BX_MEM_HANDLERS; idx++)
-    BX_MEM_THIS memory_handlers[idx] = NULL;
+  BX_MEM_THIS memory_handler_tree = NULL;
+  BX_MEM_THIS memory_handler_map = new struct memory_handler_struct **[BX_MEM_HANDLER_TABLES];
+  for (idx = 0; idx < BX_MEM_HANDLER_TABLES; idx++)
+    BX_MEM_THIS memory_handler_map[idx] = NULL;
 
   BX_MEM_THIS pci_enabled = SIM->get_param_bool(BXPN_PCI_ENABLED)->get();
   BX_MEM_THIS bios_write_enabled = 0;
@@ -171,6 +326,19 @@ void BX_MEM_C::allocate_block(Bit32u block)
 {
   const Bit32u max_blocks = BX_MEM_THIS allocated / BX_MEM_BLOCK_LEN;
 
+  BX_LOCK_IO();
+
+#if BX_LARGE_RAMFILE
+  if (BX_MEM_THIS blocks[block] && (BX_MEM_THIS blocks[block] != BX_MEM_THIS swapped_out))
+#else
+  if (BX_MEM_THIS blocks[block])
+#endif
+  {
+    // already allocated by another CPU thread
+    BX_UNLOCK_IO();
+    return;
+  }
+
 #if BX_LARGE_RAMFILE
   /* 
    * Match block to vector address
@@ -234,6 +402,8 @@ void BX_MEM_C::allocate_block(Bit32u block)
   }
   BX_DEBUG(("allocate_block: used_blocks=0x%x of 0x%x", BX_MEM_THIS used_blocks, max_blocks));
 #endif
+
+  BX_UNLOCK_IO();
 }
 
 #if BX_LARGE_RAMFILE
@@ -291,11 +461,383 @@ void memory_param_restore_handler(void *devptr, bx_param_c *param, Bit64s val)
       }
       BX_MEM(0)->blocks[blk_index] = BX_MEM(0)->vector + val * BX_MEM_BLOCK_LEN;
 #if BX_LARGE_RAMFILE
-      BX_MEM(0)->read_block(blk_index);
+      if (! BX_MEM(0)->ram_mapped)
+        BX_MEM(0)->read_block(blk_index);
 #endif
   }
 }
 
+// ================================================
+// RAM snapshots
+// ================================================
+
+// slow path of mark_dirty(): first write to the page since the checkpoint
+void BX_MEM_C::dirty_page(Bit32u page)
+{
+  Bit32u mask = 1 << (page & 31);
+
+  if (BX_MEM_THIS snapshot != NULL) {
+    BX_LOCK(snapshot_mutex);
+    bx_mem_snapshot_t *snap = BX_MEM_THIS snapshot;
+    if (snap != NULL && (snap->pending[page >> 5] & mask)) {
+      // the page is not saved yet, preserve the checkpointed contents
+      snap->aside[page] = new Bit8u[4096];
+      memcpy(snap->aside[page], BX_MEM_THIS vector + ((Bit64u) page << 12), 4096);
+      snap->pending[page >> 5] &= ~mask;
+    }
+    BX_UNLOCK(snapshot_mutex);
+  }
+
+  // set the dirty bit last, other CPU threads write to the page without
+  // taking the slow path as soon as it is set
+  bx_atomic_or32(&BX_MEM_THIS used_map[page >> 5], mask);
+  bx_atomic_or32(&BX_MEM_THIS dirty_map[page >> 5], mask);
+}
+
+BX_THREAD_FUNC(snapshot_thread_func, arg)
+{
+  BX_MEM(0)->write_snapshot((bx_mem_snapshot_t *) arg);
+  BX_THREAD_EXIT;
+}
+
+// An incremental snapshot to 'path' is only possible if the checkpoint
+// chain of 'checkpoint' can be read and does not contain 'path'.  Saving
+// over one of its ancestors would turn the chain into a cycle.
+static bx_bool snapshot_delta_allowed(const char *checkpoint, const char *path)
+{
+  char name[BX_PATHNAME_LEN], fname[BX_PATHNAME_LEN];
+  bx_ram_snapshot_header_t header;
+  unsigned depth;
+
+  strncpy(name, checkpoint, BX_PATHNAME_LEN);
+  name[BX_PATHNAME_LEN - 1] = 0;
+  for (depth = 0; depth < BX_RAM_SNAPSHOT_MAX_DEPTH; depth++) {
+    if (! strcmp(name, path)) {
+      if (depth > 0)
+        BX_INFO(("'%s' is a parent of checkpoint '%s', saving a full snapshot", path, checkpoint));
+      return 0;
+    }
+    sprintf(fname, "%s/memory.ram", name);
+    FILE *fp = fopen(fname, "rb");
+    if (fp == NULL) return 0;
+    if ((fread(&header, sizeof(header), 1, fp) != 1) ||
+        memcmp(header.magic, BX_RAM_SNAPSHOT_MAGIC, 8) ||
+        (header.parent_len >= BX_PATHNAME_LEN) ||
+        (fread(name, 1, header.parent_len, fp) != header.parent_len)) {
+      fclose(fp);
+      return 0;
+    }
+    fclose(fp);
+    name[header.parent_len] = 0;
+    if (header.parent_len == 0) return 1;
+  }
+  return 0;
+}
+
+void BX_MEM_C::start_snapshot(const char *path)
+{
+  Bit32u words = (BX_MEM_THIS num_pages + 31) / 32, i;
+
+  // only one snapshot can be written at a time
+  finish_snapshot();
+  // the new snapshot may overwrite the files of the restored checkpoint
+  if (BX_MEM_THIS lazy_pages)
+    load_all_pages();
+
+  bx_mem_snapshot_t *snap = new bx_mem_snapshot_t;
+  snap->pages = new Bit32u[words];
+  snap->pending = new Bit32u[words];
+  snap->aside = new Bit8u*[BX_MEM_THIS num_pages];
+  memset(snap->aside, 0, BX_MEM_THIS num_pages * sizeof(Bit8u*));
+  strncpy(snap->path, path, BX_PATHNAME_LEN);
+  snap->path[BX_PATHNAME_LEN - 1] = 0;
+  snap->parent[0] = 0;
+
+  // an incremental snapshot only holds the pages written since the parent
+  // checkpoint, a full one all pages written since power-up
+  if (SIM->get_param_bool(BXPN_MEM_INCREMENTAL)->get() &&
+      BX_MEM_THIS last_checkpoint != NULL &&
+      snapshot_delta_allowed(BX_MEM_THIS last_checkpoint, path)) {
+    strncpy(snap->parent, BX_MEM_THIS last_checkpoint, BX_PATHNAME_LEN);
+    snap->parent[BX_PATHNAME_LEN - 1] = 0;
+    memcpy(snap->pages, BX_MEM_THIS dirty_map, words * sizeof(Bit32u));
+  }
+  else {
+    memcpy(snap->pages, BX_MEM_THIS used_map, words * sizeof(Bit32u));
+  }
+  memcpy(snap->pending, snap->pages, words * sizeof(Bit32u));
+  memset(BX_MEM_THIS dirty_map, 0, words * sizeof(Bit32u));
+
+  delete [] BX_MEM_THIS last_checkpoint;
+  BX_MEM_THIS last_checkpoint = new char[strlen(path) + 1];
+  strcpy(BX_MEM_THIS last_checkpoint, path);
+
+  BX_MEM_THIS snapshot = snap;
+
+  // all writes after the checkpoint must be seen by mark_dirty(), drop
+  // the direct host pointers cached in the TLBs
+  bx_pc_system.MemoryMappingChanged();
+  // the VMCS / VMCB pages are written through cached host pointers
+  for (i = 0; i < BX_SMP_PROCESSORS; i++) {
+#if BX_SUPPORT_VMX
+    if (BX_CPU(i)->vmcshostptr)
+      dirty_page((Bit32u)(((Bit8u*) BX_CPU(i)->vmcshostptr - BX_MEM_THIS vector) >> 12));
+#endif
+#if BX_SUPPORT_SVM
+    if (BX_CPU(i)->vmcbhostptr)
+      dirty_page((Bit32u)(((Bit8u*) BX_CPU(i)->vmcbhostptr - BX_MEM_THIS vector) >> 12));
+#endif
+  }
+
+  snapshot_thread_running = 1;
+  BX_THREAD_CREATE(snapshot_thread_func, snap, snapshot_thread);
+}
+
+void BX_MEM_C::write_snapshot(bx_mem_snapshot_t *snap)
+{
+  char fname[BX_PATHNAME_LEN];
+  bx_ram_snapshot_header_t header;
+  bx_ram_snapshot_run_t run;
+  Bit8u buffer[4096];
+  Bit32u page = 0, saved = 0;
+  bx_bool error = 0;
+
+  sprintf(fname, "%s/memory.ram", snap->path);
+  FILE *fp = fopen(fname, "wb");
+  if (fp == NULL) {
+    BX_ERROR(("write_snapshot: couldn't create '%s'", fname));
+    error = 1;
+  }
+  else {
+    memcpy(header.magic, BX_RAM_SNAPSHOT_MAGIC, 8);
+    header.num_pages = BX_MEM_THIS num_pages;
+    header.parent_len = strlen(snap->parent);
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(snap->parent, 1, header.parent_len, fp);
+  }
+
+  while (page < BX_MEM_THIS num_pages) {
+    if (! (snap->pages[page >> 5] & (1 << (page & 31)))) {
+      page++;
+      continue;
+    }
+    run.first_page = page;
+    run.num_pages = 0;
+    while ((page + run.num_pages) < BX_MEM_THIS num_pages &&
+           (snap->pages[(page + run.num_pages) >> 5] & (1 << ((page + run.num_pages) & 31))))
+      run.num_pages++;
+    if (fp != NULL) fwrite(&run, sizeof(run), 1, fp);
+
+    for (; page < run.first_page + run.num_pages; page++) {
+      Bit32u mask = 1 << (page & 31);
+      BX_LOCK(snapshot_mutex);
+      if (snap->pending[page >> 5] & mask) {
+        memcpy(buffer, BX_MEM_THIS vector + ((Bit64u) page << 12), 4096);
+        snap->pending[page >> 5] &= ~mask;
+      }
+      else {
+        memcpy(buffer, snap->aside[page], 4096);
+        delete [] snap->aside[page];
+        snap->aside[page] = NULL;
+      }
+      BX_UNLOCK(snapshot_mutex);
+      if (fp != NULL && fwrite(buffer, 4096, 1, fp) != 1) error = 1;
+      saved++;
+    }
+  }
+
+  if (fp != NULL) {
+    run.first_page = 0;
+    run.num_pages = 0;
+    fwrite(&run, sizeof(run), 1, fp);
+    if (fclose(fp) != 0) error = 1;
+  }
+
+  BX_LOCK(snapshot_mutex);
+  BX_MEM_THIS snapshot = NULL;
+  BX_UNLOCK(snapshot_mutex);
+
+  delete [] snap->pages;
+  delete [] snap->pending;
+  delete [] snap->aside;
+  if (error)
+    BX_ERROR(("write_snapshot: error writing RAM snapshot to '%s'", snap->path));
+  else
+    BX_INFO(("RAM snapshot '%s' written: %u pages%s%s", snap->path, saved,
+             snap->parent[0] ? ", parent=" : "", snap->parent));
+  delete snap;
+}
+
+// wait for the background writer to complete the pending snapshot
+void BX_MEM_C::finish_snapshot(void)
+{
+  if (snapshot_thread_running) {
+    BX_THREAD_JOIN(snapshot_thread);
+    snapshot_thread_running = 0;
+  }
+}
+
+// Only the page index of the snapshot chain is read here, the page contents
+// are loaded on first access through get_vector() (see load_page()).
+bx_bool BX_MEM_C::restore_snapshot(const char *path, unsigned depth)
+{
+  char parent[BX_PATHNAME_LEN], fname[BX_PATHNAME_LEN];
+  bx_ram_snapshot_header_t header;
+  bx_ram_snapshot_run_t run;
+  Bit32u page;
+
+  if (depth == 0) {
+    close_lazy_restore();
+    BX_MEM_THIS lazy_map = new Bit64u[BX_MEM_THIS num_pages];
+    memset(BX_MEM_THIS lazy_map, 0, BX_MEM_THIS num_pages * sizeof(Bit64u));
+    BX_MEM_THIS lazy_fds = new int[BX_RAM_SNAPSHOT_MAX_DEPTH + 1];
+  }
+
+  sprintf(fname, "%s/memory.ram", path);
+  int fd = open(fname, O_RDONLY
+#ifdef O_BINARY
+                | O_BINARY
+#endif
+           );
+  if (fd < 0) {
+    BX_PANIC(("restore_snapshot: couldn't open '%s'", fname));
+    return 0;
+  }
+  // the file stays open until all pages are loaded
+  unsigned file = BX_MEM_THIS lazy_num_fds++;
+  BX_MEM_THIS lazy_fds[file] = fd;
+
+  if ((read(fd, &header, sizeof(header)) != sizeof(header)) ||
+      memcmp(header.magic, BX_RAM_SNAPSHOT_MAGIC, 8)) {
+    BX_PANIC(("restore_snapshot: '%s' is not a RAM snapshot", path));
+    return 0;
+  }
+  if (header.num_pages != BX_MEM_THIS num_pages) {
+    BX_PANIC(("restore_snapshot: RAM size of '%s' does not match", path));
+    return 0;
+  }
+  if ((header.parent_len >= BX_PATHNAME_LEN) ||
+      (read(fd, parent, header.parent_len) != (int) header.parent_len)) {
+    BX_PANIC(("restore_snapshot: '%s' is corrupted", path));
+    return 0;
+  }
+  parent[header.parent_len] = 0;
+
+  if (header.parent_len > 0) {
+    // the delta is applied on top of the parent checkpoint
+    if (depth >= BX_RAM_SNAPSHOT_MAX_DEPTH) {
+      BX_PANIC(("restore_snapshot: too many nested checkpoints"));
+      return 0;
+    }
+    if (! restore_snapshot(parent, depth + 1)) return 0;
+  }
+  else if (! BX_MEM_THIS ram_mapped) {
+    // the pages not saved in the snapshot were never written
+    for (page = 0; page < BX_MEM_THIS num_pages; page++)
+      BX_MEM_THIS lazy_map[page] = BX_LAZY_ZERO_PAGE;
+  }
+
+  Bit64u offset = sizeof(header) + header.parent_len;
+  for (;;) {
+    if ((lseek(fd, (off_t) offset, SEEK_SET) == (off_t) -1) ||
+        (read(fd, &run, sizeof(run)) != sizeof(run))) {
+      BX_PANIC(("restore_snapshot: '%s' is truncated", path));
+      return 0;
+    }
+    if (run.num_pages == 0) break;
+    if ((run.first_page + run.num_pages) > BX_MEM_THIS num_pages ||
+        (run.first_page + run.num_pages) < run.first_page) {
+      BX_PANIC(("restore_snapshot: '%s' is corrupted", path));
+      return 0;
+    }
+    offset += sizeof(run);
+    for (page = run.first_page; page < run.first_page + run.num_pages; page++) {
+      BX_MEM_THIS lazy_map[page] = BX_LAZY_PAGE(file, offset);
+      BX_MEM_THIS used_map[page >> 5] |= 1 << (page & 31);
+      offset += 4096;
+    }
+  }
+
+  if (depth == 0) {
+    Bit32u pages = 0;
+    for (page = 0; page < BX_MEM_THIS num_pages; page++)
+      if (BX_MEM_THIS lazy_map[page]) pages++;
+    BX_MEM_THIS lazy_pages = pages;
+    if (pages == 0) close_lazy_restore();
+    BX_INFO(("RAM snapshot '%s' restored: %u pages loaded on demand", path, pages));
+  }
+
+  BX_DEBUG(("restored RAM snapshot '%s'", path));
+  return 1;
+}
+
+// slow path of page_in(): first access to a page of the restored checkpoint
+void BX_MEM_C::load_page(Bit32u page)
+{
+  BX_LOCK(lazy_mutex);
+  Bit64u src = BX_MEM_THIS lazy_map[page];
+  if (src != 0) {
+    Bit8u *hostAddr = BX_MEM_THIS vector + ((Bit64u) page << 12);
+    if (src == BX_LAZY_ZERO_PAGE) {
+      memset(hostAddr, 0, 4096);
+    }
+    else {
+      int fd = BX_MEM_THIS lazy_fds[(src >> 48) - 1];
+      if ((lseek(fd, (off_t)(src & BX_LAZY_OFFSET_MASK), SEEK_SET) == (off_t) -1) ||
+          (read(fd, hostAddr, 4096) != 4096))
+        BX_PANIC(("load_page: couldn't read page 0x%08x of the restored checkpoint", page));
+    }
+    // clear the entry last, other CPU threads access the page without
+    // taking the slow path as soon as it is cleared
+    BX_MEM_THIS lazy_map[page] = 0;
+    if (--BX_MEM_THIS lazy_pages == 0) {
+      for (unsigned i = 0; i < BX_MEM_THIS lazy_num_fds; i++)
+        close(BX_MEM_THIS lazy_fds[i]);
+      BX_MEM_THIS lazy_num_fds = 0;
+      BX_DEBUG(("all pages of the restored checkpoint are loaded"));
+    }
+  }
+  BX_UNLOCK(lazy_mutex);
+}
+
+void BX_MEM_C::load_all_pages(void)
+{
+  for (Bit32u page = 0; page < BX_MEM_THIS num_pages && BX_MEM_THIS lazy_pages; page++) {
+    if (BX_MEM_THIS lazy_map[page])
+      load_page(page);
+  }
+}
+
+void BX_MEM_C::close_lazy_restore(void)
+{
+  BX_MEM_THIS lazy_pages = 0;
+  for (unsigned i = 0; i < BX_MEM_THIS lazy_num_fds; i++)
+    close(BX_MEM_THIS lazy_fds[i]);
+  BX_MEM_THIS lazy_num_fds = 0;
+  delete [] BX_MEM_THIS lazy_fds;
+  BX_MEM_THIS lazy_fds = NULL;
+  delete [] BX_MEM_THIS lazy_map;
+  BX_MEM_THIS lazy_map = NULL;
+}
+
+void ram_snapshot_save_handler(void *devptr, FILE *fp)
+{
+  // the snapshot file is written by the background thread
+  BX_MEM(0)->start_snapshot(SIM->get_param_string(BXPN_RESTORE_PATH)->getptr());
+}
+
+void ram_snapshot_restore_handler(void *devptr, FILE *fp)
+{
+  const char *path = SIM->get_param_string(BXPN_RESTORE_PATH)->getptr();
+
+  if (BX_MEM(0)->restore_snapshot(path, 0)) {
+    memset(BX_MEM(0)->dirty_map, 0, ((BX_MEM(0)->num_pages + 31) / 32) * sizeof(Bit32u));
+    delete [] BX_MEM(0)->last_checkpoint;
+    BX_MEM(0)->last_checkpoint = new char[strlen(path) + 1];
+    strcpy(BX_MEM(0)->last_checkpoint, path);
+  }
+}
+
 void BX_MEM_C::register_state()
 {
   char param_name[15];
@@ -303,11 +845,16 @@ void BX_MEM_C::register_state()
   bx_list_c *list = new bx_list_c(SIM->get_bochs_root(), "memory", "Memory State");
   Bit32u num_blocks = BX_MEM_THIS len / BX_MEM_BLOCK_LEN;
 #if BX_LARGE_RAMFILE
-  bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram", &(BX_MEM_THIS overflow_file));
-  ramfile->set_sr_handlers(this, ramfile_save_handler, (filedata_restore_handler)NULL);
-#else
-  new bx_shadow_data_c(list, "ram", BX_MEM_THIS vector, BX_MEM_THIS allocated);
+  if (! BX_MEM_THIS ram_mapped) {
+    bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram", &(BX_MEM_THIS overflow_file));
+    ramfile->set_sr_handlers(this, ramfile_save_handler, (filedata_restore_handler)NULL);
+  }
+  else
 #endif
+  {
+    bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram", NULL);
+    ramfile->set_sr_handlers(this, ram_snapshot_save_handler, ram_snapshot_restore_handler);
+  }
   BXRS_DEC_PARAM_FIELD(list, len, BX_MEM_THIS len);
   BXRS_DEC_PARAM_FIELD(list, allocated, BX_MEM_THIS allocated);
   BXRS_DEC_PARAM_FIELD(list, used_blocks, BX_MEM_THIS used_blocks);
@@ -333,6 +880,11 @@ void BX_MEM_C::cleanup_memory()
   unsigned idx;
 
   if (BX_MEM_THIS vector != NULL) {
+    finish_snapshot();
+    close_lazy_restore();
+#if BX_HAVE_SYS_MMAN_H
+    unmap_ram();
+#endif
     delete [] BX_MEM_THIS actual_vector;
     BX_MEM_THIS actual_vector = NULL;
     BX_MEM_THIS vector = NULL;
@@ -341,19 +893,15 @@ void BX_MEM_C::cleanup_memory()
     delete [] BX_MEM_THIS blocks;
     BX_MEM_THIS blocks = 0;
     BX_MEM_THIS used_blocks = 0;
-    if (BX_MEM_THIS memory_handlers != NULL) {
-      for (idx = 0; idx < BX_MEM_HANDLERS; idx++) {
-        struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[idx];
-        struct memory_handler_struct *prev = NULL;
-        while (memory_handler) {
-          prev = memory_handler;
-          memory_handler = memory_handler->next;
-          delete prev;
-        }
+    if (BX_MEM_THIS memory_handler_map != NULL) {
+      for (idx = 0; idx < BX_MEM_HANDLER_TABLES; idx++) {
+        delete [] BX_MEM_THIS memory_handler_map[idx];
       }
-      delete [] BX_MEM_THIS memory_handlers;
-      BX_MEM_THIS memory_handlers = NULL;
+      delete [] BX_MEM_THIS memory_handler_map;
+      BX_MEM_THIS memory_handler_map = NULL;
     }
+    delete_memory_handlers(BX_MEM_THIS memory_handler_tree);
+    BX_MEM_THIS memory_handler_tree = NULL;
   }
 }
 
@@ -622,7 +1170,7 @@ bx_bool BX_MEM_C::dbg_set_mem(bx_phy_address addr, unsigned len, Bit8u *buf)
     // Write to standard PCI/ISA Video Mem / SMMRAM
     if (addr >= 0x000a0000 && addr < 0x000c0000) {
       if (BX_MEM_THIS smram_enable)
-        *(BX_MEM_THIS get_vector(addr)) = *buf;
+        *(BX_MEM_THIS get_vector_write(addr)) = *buf;
       else
         DEV_vga_mem_write(addr, *buf);
     }
@@ -632,7 +1180,7 @@ bx_bool BX_MEM_C::dbg_set_mem(bx_phy_address addr, unsigned len, Bit8u *buf)
       if (area > BX_MEM_AREA_F0000) area = BX_MEM_AREA_F0000;
       if (BX_MEM_THIS memory_type[area][1] == 1) {
         // Write to ShadowRAM
-        *(BX_MEM_THIS get_vector(addr)) = *buf;
+        *(BX_MEM_THIS get_vector_write(addr)) = *buf;
       } else {
         // Ignore write to ROM
       }
@@ -640,7 +1188,7 @@ bx_bool BX_MEM_C::dbg_set_mem(bx_phy_address addr, unsigned len, Bit8u *buf)
 #endif  // #if BX_SUPPORT_PCI
     else if ((addr < 0x000c0000 || addr >= 0x00100000) && (addr < (bx_phy_address)(~BIOS_MASK)))
     {
-      *(BX_MEM_THIS get_vector(addr)) = *buf;
+      *(BX_MEM_THIS get_vector_write(addr)) = *buf;
     }
     buf++;
     addr++;
@@ -722,16 +1270,20 @@ Bit8u *BX_MEM_C::getHostMemAddr(BX_CPU_C *cpu, bx_phy_address addr, unsigned rw)
   }
 #endif
 
-  struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-        memory_handler->end >= a20addr) {
-      if (memory_handler->da_handler)
+  // the caller accesses the whole page, so any handler within it counts
+  struct memory_handler_struct **table =
+    BX_MEM_THIS memory_handler_map[a20addr >> BX_MEM_HANDLER_TABLE_SHIFT];
+  if (table) {
+    struct memory_handler_struct *memory_handler =
+      table[(a20addr >> 12) & (BX_MEM_HANDLER_TABLE_PAGES-1)];
+    if (memory_handler) {
+      bx_phy_address page = a20addr & ~((bx_phy_address)(0xfff));
+      if (memory_handler->da_handler && memory_handler->begin <= page &&
+          memory_handler->end >= (page | 0xfff))
         return memory_handler->da_handler(a20addr, rw, memory_handler->param);
       else
         return(NULL); // Vetoed! memory handler for i/o apic, vram, mmio and PCI PnP
     }
-    memory_handler = memory_handler->next;
   }
 
   if (! write) {
@@ -803,7 +1355,7 @@ Bit8u *BX_MEM_C::getHostMemAddr(BX_CPU_C *cpu, bx_phy_address addr, unsigned rw)
     else
     {
       if (a20addr < 0x000c0000 || a20addr >= 0x00100000) {
-        return BX_MEM_THIS get_vector(a20addr);
+        return BX_MEM_THIS get_vector_write(a20addr);
       }
       else {
         return(NULL);  // Vetoed!  ROMs
@@ -812,6 +1364,49 @@ Bit8u *BX_MEM_C::getHostMemAddr(BX_CPU_C *cpu, bx_phy_address addr, unsigned rw)
   }
 }
 
+// Return the lowest range ending at or above a20addr (which might begin
+// above it). The ranges don't overlap, so they are ordered by end address too.
+struct memory_handler_struct *BX_MEM_C::find_memory_handler(bx_phy_address a20addr)
+{
+  struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handler_tree;
+  struct memory_handler_struct *found = NULL;
+
+  while (memory_handler) {
+    if (memory_handler->end >= a20addr) {
+      found = memory_handler;
+      memory_handler = memory_handler->left;
+    }
+    else {
+      memory_handler = memory_handler->right;
+    }
+  }
+  return found;
+}
+
+// Recompute the handler map entries of all pages within the given range
+void BX_MEM_C::update_memory_handler_map(bx_phy_address begin_addr, bx_phy_address end_addr)
+{
+  for (Bit32u page_idx = (Bit32u)(begin_addr >> 12); page_idx <= (Bit32u)(end_addr >> 12); page_idx++) {
+    bx_phy_address page = (bx_phy_address) page_idx << 12;
+    struct memory_handler_struct *memory_handler = find_memory_handler(page);
+    if (memory_handler && memory_handler->begin > (page | 0xfff))
+      memory_handler = NULL;
+
+    Bit32u table_idx = page_idx >> (BX_MEM_HANDLER_TABLE_SHIFT - 12);
+    struct memory_handler_struct **table = BX_MEM_THIS memory_handler_map[table_idx];
+    if (! table) {
+      if (! memory_handler) continue;
+      table = new struct memory_handler_struct *[BX_MEM_HANDLER_TABLE_PAGES];
+      memset(table, 0, BX_MEM_HANDLER_TABLE_PAGES * sizeof(struct memory_handler_struct *));
+      BX_MEM_THIS memory_handler_map[table_idx] = table;
+    }
+    table[page_idx & (BX_MEM_HANDLER_TABLE_PAGES-1)] = memory_handler;
+  }
+
+  // pages of the range might be cached as plain memory in the TLBs
+  bx_pc_system.MemoryMappingChanged();
+}
+
 /*
  * One needs to provide both a read_handler and a write_handler.
  */
@@ -825,63 +1420,70 @@ BX_MEM_C::registerMemoryHandlers(void *param, memory_handler_t read_handler,
   if (!read_handler || !write_handler) // allow NULL fetch handler
     return 0;
   BX_INFO(("Register memory access handlers: 0x" FMT_PHY_ADDRX " - 0x" FMT_PHY_ADDRX, begin_addr, end_addr));
-  for (Bit32u page_idx = (Bit32u)(begin_addr >> 20); page_idx <= (Bit32u)(end_addr >> 20); page_idx++) {
-    Bit16u bitmap = 0xffff;
-    if (begin_addr > (page_idx << 20)) {
-      bitmap &= (0xffff << ((begin_addr >> 16) & 0xf));
-    }
-    if (end_addr < ((page_idx + 1) << 20)) {
-      bitmap &= (0xffff >> (0x0f - ((end_addr >> 16) & 0xf)));
-    }
-    if (BX_MEM_THIS memory_handlers[page_idx] != NULL) {
-      if ((bitmap & BX_MEM_THIS memory_handlers[page_idx]->bitmap) != 0) {
-        BX_ERROR(("Register failed: overlapping memory handlers!"));
-        return 0;
-      } else {
-        bitmap |= BX_MEM_THIS memory_handlers[page_idx]->bitmap;
-      }
-    }
-    struct memory_handler_struct *memory_handler = new struct memory_handler_struct;
-    memory_handler->next = BX_MEM_THIS memory_handlers[page_idx];
-    BX_MEM_THIS memory_handlers[page_idx] = memory_handler;
-    memory_handler->read_handler = read_handler;
-    memory_handler->write_handler = write_handler;
-    memory_handler->da_handler = da_handler;
-    memory_handler->param = param;
-    memory_handler->begin = begin_addr;
-    memory_handler->end = end_addr;
-    memory_handler->bitmap = bitmap;
+  struct memory_handler_struct *memory_handler = find_memory_handler(begin_addr);
+  if (memory_handler && memory_handler->begin <= end_addr) {
+    BX_ERROR(("Register failed: overlapping memory handlers!"));
+    return 0;
+  }
+  memory_handler = new struct memory_handler_struct;
+  memory_handler->left = NULL;
+  memory_handler->right = NULL;
+  memory_handler->read_handler = read_handler;
+  memory_handler->write_handler = write_handler;
+  memory_handler->da_handler = da_handler;
+  memory_handler->param = param;
+  memory_handler->begin = begin_addr;
+  memory_handler->end = end_addr;
+
+  struct memory_handler_struct **link = &BX_MEM_THIS memory_handler_tree;
+  while (*link) {
+    if (begin_addr < (*link)->begin)
+      link = &(*link)->left;
+    else
+      link = &(*link)->right;
   }
+  *link = memory_handler;
+
+  update_memory_handler_map(begin_addr, end_addr);
   return 1;
 }
 
   bx_bool
 BX_MEM_C::unregisterMemoryHandlers(void *param, bx_phy_address begin_addr, bx_phy_address end_addr)
 {
-  bx_bool ret = 1;
   BX_INFO(("Memory access handlers unregistered: 0x" FMT_PHY_ADDRX " - 0x" FMT_PHY_ADDRX, begin_addr, end_addr));
-  for (Bit32u page_idx = (Bit32u)(begin_addr >> 20); page_idx <= (Bit32u)(end_addr >> 20); page_idx++) {
-    struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[page_idx];
-    struct memory_handler_struct *prev = NULL;
-    while (memory_handler &&
-         memory_handler->param != param &&
-         memory_handler->begin != begin_addr &&
-         memory_handler->end != end_addr)
-    {
-      prev = memory_handler;
-      memory_handler = memory_handler->next;
-    }
-    if (!memory_handler) {
-      ret = 0;  // we should have found it
-      continue; // anyway, try the other pages
-    }
-    if (prev)
-      prev->next = memory_handler->next;
+  struct memory_handler_struct **link = &BX_MEM_THIS memory_handler_tree;
+  while (*link && (*link)->begin != begin_addr) {
+    if (begin_addr < (*link)->begin)
+      link = &(*link)->left;
     else
-      BX_MEM_THIS memory_handlers[page_idx] = memory_handler->next;
-    delete memory_handler;
+      link = &(*link)->right;
   }
-  return ret;
+  struct memory_handler_struct *memory_handler = *link;
+  if (!memory_handler || memory_handler->param != param || memory_handler->end != end_addr)
+    return 0; // we should have found it
+
+  if (! memory_handler->left) {
+    *link = memory_handler->right;
+  }
+  else if (! memory_handler->right) {
+    *link = memory_handler->left;
+  }
+  else {
+    // replace the node by the lowest range of its right subtree
+    struct memory_handler_struct **next = &memory_handler->right;
+    while ((*next)->left)
+      next = &(*next)->left;
+    struct memory_handler_struct *successor = *next;
+    *next = successor->right;
+    successor->left = memory_handler->left;
+    successor->right = memory_handler->right;
+    *link = successor;
+  }
+  delete memory_handler;
+
+  update_memory_handler_map(begin_addr, end_addr);
+  return 1;
 }
 
 void BX_MEM_C::enable_smram(bx_bool enable, bx_bool restricted)
@@ -0,0 +1,221 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// bench-aes.cc
+//
+// Compares the host AES-NI / PCLMULQDQ paths of cpu/aes.cc with the
+// portable code for random operands and measures the time per
+// instruction of both.
+//
+// Compile in a configured and built source tree with:
+//   c++ -O2 -I. -Iinstrument/stubs -ffunction-sections -Wl,--gc-sections \
+//     -o bench-aes misc/bench-aes.cc osdep.o
+// The instruction handlers of cpu/aes.cc are not used, the linker drops
+// them.  Then run "bench-aes"; mismatches must be 0.
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "cpu/aes.cc"
+
+#include <time.h>
+
+#if BX_CPU_LEVEL >= 6 && BX_HOST_X86_INSN
+
+#define ITERATIONS 2000000
+
+static Bit64u rand64(void)
+{
+  return ((Bit64u) rand() << 42) ^ ((Bit64u) rand() << 21) ^ (Bit64u) rand();
+}
+
+static void rand_xmm(BxPackedXmmRegister &x)
+{
+  x.xmm64u(0) = rand64();
+  x.xmm64u(1) = rand64();
+}
+
+static int same(const BxPackedXmmRegister &a, const BxPackedXmmRegister &b)
+{
+  return a.xmm64u(0) == b.xmm64u(0) && a.xmm64u(1) == b.xmm64u(1);
+}
+
+static void add_round_key(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  op1.xmm64u(0) ^= op2.xmm64u(0);
+  op1.xmm64u(1) ^= op2.xmm64u(1);
+}
+
+// the portable code of the instruction handlers
+
+static void sw_aesenc(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  AES_ShiftRows(op1);
+  AES_SubstituteBytes(op1);
+  AES_MixColumns(op1);
+  add_round_key(op1, op2);
+}
+
+static void sw_aesenclast(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  AES_ShiftRows(op1);
+  AES_SubstituteBytes(op1);
+  add_round_key(op1, op2);
+}
+
+static void sw_aesdec(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  AES_InverseShiftRows(op1);
+  AES_InverseSubstituteBytes(op1);
+  AES_InverseMixColumns(op1);
+  add_round_key(op1, op2);
+}
+
+static void sw_aesdeclast(BxPackedXmmRegister &op1, const BxPackedXmmRegister &op2)
+{
+  AES_InverseShiftRows(op1);
+  AES_InverseSubstituteBytes(op1);
+  add_round_key(op1, op2);
+}
+
+static void sw_aeskeygen(BxPackedXmmRegister &op)
+{
+  op.xmm32u(1) = AES_SubWord(op.xmm32u(1));
+  op.xmm32u(3) = AES_SubWord(op.xmm32u(3));
+}
+
+static void hw_aeskeygen(BxPackedXmmRegister &op)
+{
+  host_aes_subbytes(op);
+}
+
+static void sw_pclmulqdq(BxPackedXmmRegister &r, Bit64u a0, Bit64u b)
+{
+  BxPackedXmmRegister a;
+
+  a.xmm64u(0) = a0;
+  a.xmm64u(1) = 0;
+  r.xmm64u(0) = 0;
+  r.xmm64u(1) = 0;
+  for (int n = 0; b && n < 64; n++) {
+    if (b & 1) {
+      r.xmm64u(0) ^= a.xmm64u(0);
+      r.xmm64u(1) ^= a.xmm64u(1);
+    }
+    a.xmm64u(1) = (a.xmm64u(1) << 1) | (a.xmm64u(0) >> 63);
+    a.xmm64u(0) <<= 1;
+    b >>= 1;
+  }
+}
+
+typedef void (*aes_round_t)(BxPackedXmmRegister &, const BxPackedXmmRegister &);
+typedef void (*aes_unary_t)(BxPackedXmmRegister &);
+
+static double elapsed_ns(clock_t start)
+{
+  return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ITERATIONS;
+}
+
+static int bench_round(const char *name, aes_round_t sw, aes_round_t hw)
+{
+  BxPackedXmmRegister a, k, x, y;
+  int n, mismatches = 0;
+  clock_t start;
+
+  for (n = 0; n < 100000; n++) {
+    rand_xmm(a); rand_xmm(k);
+    x = a; sw(x, k);
+    y = a; hw(y, k);
+    mismatches += !same(x, y);
+  }
+  rand_xmm(x); rand_xmm(y); rand_xmm(k);
+  start = clock();
+  for (n = 0; n < ITERATIONS; n++) sw(x, k);
+  double sw_ns = elapsed_ns(start);
+  start = clock();
+  for (n = 0; n < ITERATIONS; n++) hw(y, k);
+  double hw_ns = elapsed_ns(start);
+  printf("%-16s portable %7.1f ns  host %7.1f ns  mismatches=%d  (%08x)\n",
+    name, sw_ns, hw_ns, mismatches, x.xmm32u(0) ^ y.xmm32u(0));
+  return mismatches;
+}
+
+static int bench_unary(const char *name, aes_unary_t sw, aes_unary_t hw, int keygen)
+{
+  BxPackedXmmRegister a, x, y;
+  int n, mismatches = 0;
+  clock_t start;
+
+  for (n = 0; n < 100000; n++) {
+    rand_xmm(a);
+    x = a; sw(x);
+    y = a; hw(y);
+    if (keygen)
+      mismatches += (x.xmm32u(1) != y.xmm32u(1)) || (x.xmm32u(3) != y.xmm32u(3));
+    else
+      mismatches += !same(x, y);
+  }
+  rand_xmm(x); rand_xmm(y);
+  start = clock();
+  for (n = 0; n < ITERATIONS; n++) sw(x);
+  double sw_ns = elapsed_ns(start);
+  start = clock();
+  for (n = 0; n < ITERATIONS; n++) hw(y);
+  double hw_ns = elapsed_ns(start);
+  printf("%-16s portable %7.1f ns  host %7.1f ns  mismatches=%d  (%08x)\n",
+    name, sw_ns, hw_ns, mismatches, x.xmm32u(0) ^ y.xmm32u(0));
+  return mismatches;
+}
+
+static int bench_pclmulqdq(void)
+{
+  BxPackedXmmRegister x, y;
+  Bit64u a, b;
+  int n, mismatches = 0;
+  clock_t start;
+
+  for (n = 0; n < 100000; n++) {
+    a = rand64(); b = rand64();
+    sw_pclmulqdq(x, a, b);
+    host_pclmulqdq(y, a, b);
+    mismatches += !same(x, y);
+  }
+  a = rand64(); b = rand64() | BX_CONST64(0x8000000000000000);
+  start = clock();
+  for (n = 0; n < ITERATIONS; n++) { sw_pclmulqdq(x, a, b); a ^= x.xmm64u(0); }
+  double sw_ns = elapsed_ns(start);
+  start = clock();
+  for (n = 0; n < ITERATIONS; n++) { host_pclmulqdq(y, a, b); a ^= y.xmm64u(0); }
+  double hw_ns = elapsed_ns(start);
+  printf("%-16s portable %7.1f ns  host %7.1f ns  mismatches=%d  (%08x)\n",
+    "PCLMULQDQ", sw_ns, hw_ns, mismatches, (Bit32u) a);
+  return mismatches;
+}
+
+int main(void)
+{
+  int mismatches = 0;
+
+  printf("host AES-NI: %s, PCLMULQDQ: %s\n", host_has_aes ? "yes" : "no",
+    host_has_pclmul ? "yes" : "no");
+  if (host_has_aes) {
+    mismatches += bench_round("AESENC", sw_aesenc, host_aesenc);
+    mismatches += bench_round("AESENCLAST", sw_aesenclast, host_aesenclast);
+    mismatches += bench_round("AESDEC", sw_aesdec, host_aesdec);
+    mismatches += bench_round("AESDECLAST", sw_aesdeclast, host_aesdeclast);
+    mismatches += bench_unary("AESIMC", AES_InverseMixColumns, host_aesimc, 0);
+    mismatches += bench_unary("AESKEYGENASSIST", sw_aeskeygen, hw_aeskeygen, 1);
+  }
+  if (host_has_pclmul)
+    mismatches += bench_pclmulqdq();
+  printf("mismatches=%d\n", mismatches);
+  return mismatches != 0;
+}
+
+#else
+
+int main(void)
+{
+  printf("the host AES instructions are not used in this configuration\n");
+  return 0;
+}
+
+#endif
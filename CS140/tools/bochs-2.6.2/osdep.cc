@@ -371,3 +371,38 @@ Bit64u bx_get_realtime64_usec(void)
 }
 #endif
 #endif
+
+#if BX_HOST_X86_INSN
+#include <cpuid.h>
+
+static Bit32u bx_detect_host_cpu_features(void)
+{
+  unsigned eax, ebx, ecx, edx;
+  Bit32u features = 0;
+
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    if ((edx >> 26) & 1) features |= BX_HOST_CPU_SSE2;
+    if ((ecx >>  9) & 1) features |= BX_HOST_CPU_SSSE3;
+    if ((ecx >> 20) & 1) features |= BX_HOST_CPU_SSE4_2;
+    if ((ecx >> 25) & 1) features |= BX_HOST_CPU_AES;
+    if ((ecx >>  1) & 1) features |= BX_HOST_CPU_PCLMUL;
+    // AVX2 also needs the OS to save the YMM state (OSXSAVE and XCR0)
+    if (((ecx >> 27) & 1) && ((ecx >> 28) & 1) && (__get_cpuid_max(0, NULL) >= 7)) {
+      unsigned xcr0_lo, xcr0_hi;
+      __asm__ __volatile__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      if (((xcr0_lo & 0x6) == 0x6) && ((ebx >> 5) & 1))
+        features |= BX_HOST_CPU_AVX2;
+    }
+  }
+  return features;
+}
+
+// The static initializers of other modules may be the first callers,
+// so the features are detected on the first call.
+Bit32u bx_get_host_cpu_features(void)
+{
+  static Bit32u features = bx_detect_host_cpu_features();
+  return features;
+}
+#endif
@@ -336,6 +336,25 @@ BX_CPP_INLINE void bx_ppc_store_le64(Bit64u *p, Bit64u v)
 extern Bit64u bx_get_realtime64_usec (void);
 #endif
 
+// Host x86 instructions can be used through the compiler target attribute.
+// The code using them checks bx_get_host_cpu_features() at runtime and
+// falls back to the portable version.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define BX_HOST_X86_INSN 1
+
+#define BX_HOST_CPU_SSE2    (1 << 0)
+#define BX_HOST_CPU_SSSE3   (1 << 1)
+#define BX_HOST_CPU_SSE4_2  (1 << 2)
+#define BX_HOST_CPU_AES     (1 << 3)
+#define BX_HOST_CPU_PCLMUL  (1 << 4)
+#define BX_HOST_CPU_AVX2    (1 << 5)
+
+BOCHSAPI_MSVCONLY extern Bit32u bx_get_host_cpu_features(void);
+#else
+#define BX_HOST_X86_INSN 0
+#endif
+
 #ifdef WIN32
 #undef BX_HAVE_MSLEEP
 #define BX_HAVE_MSLEEP 1
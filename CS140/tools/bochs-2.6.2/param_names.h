@@ -39,6 +39,12 @@
 #define BXPN_CPU_MODEL                   "cpu.model"
 #define BXPN_IPS                         "cpu.ips"
 #define BXPN_SMP_QUANTUM                 "cpu.quantum"
+#define BXPN_SMP_THREADS                 "cpu.smp_threads"
+#define BXPN_ICACHE_SIZE                 "cpu.icache_size"
+#define BXPN_JIT_THRESHOLD               "cpu.jit_threshold"
+#define BXPN_TRACE_CACHE_PATH            "cpu.trace_cache"
+#define BXPN_TLB_SIZE                    "cpu.tlb_size"
+#define BXPN_TLB_L2_SIZE                 "cpu.tlb_l2_size"
 #define BXPN_RESET_ON_TRIPLE_FAULT       "cpu.reset_on_triple_fault"
 #define BXPN_IGNORE_BAD_MSRS             "cpu.ignore_bad_msrs"
 #define BXPN_CONFIGURABLE_MSRS_PATH      "cpu.msrs"
@@ -79,6 +85,9 @@
 #define BXPN_CPUID_SMAP                  "cpuid.smap"
 #define BXPN_MEM_SIZE                    "memory.standard.ram.size"
 #define BXPN_HOST_MEM_SIZE               "memory.standard.ram.host_size"
+#define BXPN_MEM_MMAP                    "memory.standard.ram.mmap"
+#define BXPN_MEM_FILE                    "memory.standard.ram.file"
+#define BXPN_MEM_INCREMENTAL             "memory.standard.ram.incremental"
 #define BXPN_ROM_PATH                    "memory.standard.rom.path"
 #define BXPN_ROM_ADDRESS                 "memory.standard.rom.addr"
 #define BXPN_VGA_ROM_PATH                "memory.standard.vgarom.path"
@@ -181,6 +190,9 @@
 #define BXPN_GDBSTUB                     "misc.gdbstub"
 #define BXPN_LOG_FILENAME                "log.filename"
 #define BXPN_LOG_PREFIX                  "log.prefix"
+#define BXPN_LOG_ASYNC                   "log.async"
+#define BXPN_LOG_FORMAT                  "log.format"
+#define BXPN_LOG_RATE_LIMIT              "log.rate_limit"
 #define BXPN_DEBUGGER_LOG_FILENAME       "log.debugger_filename"
 #define BXPN_MENU_DISK                   "menu.disk"
 #define BXPN_MENU_DISK_WIN32             "menu.disk_win32"
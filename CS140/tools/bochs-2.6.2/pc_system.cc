@@ -23,6 +23,8 @@
 #include "bochs.h"
 #include "cpu/cpu.h"
 #include "iodev/iodev.h"
+#include "iodev/virt_timer.h"
+#include "iodev/slowdown_timer.h"
 #define LOG_THIS bx_pc_system.
 
 #ifdef WIN32
@@ -42,8 +44,17 @@ double     m_ips; // Millions of Instructions Per Second
 #define SpewPeriodicTimerInfo 0
 #define MinAllowableTimerPeriod 1
 
+// Initial number of timer slots, grows on demand
+#define BX_TIMERS_INITIAL 16
+// heapPos value of a timer not in the timer heap
+#define BX_TIMER_NOT_QUEUED 0xffffffff
+
 const Bit64u bx_pc_system_c::NullTimerInterval = 0xffffffff;
 
+#if BX_SUPPORT_SMP
+static BX_MUTEX(io_mutex);
+#endif
+
   // constructor
 bx_pc_system_c::bx_pc_system_c()
 {
@@ -51,23 +62,41 @@ bx_pc_system_c::bx_pc_system_c()
 
   BX_ASSERT(numTimers == 0);
 
+  timer = NULL;
+  timerHeap = NULL;
+  firedTimers = NULL;
+  timersAllocated = 0;
+  heapSize = 0;
+  alloc_timer_slot(BX_TIMERS_INITIAL - 1);
+
   // Timer[0] is the null timer.  It is initialized as a special
   // case here.  It should never be turned off or modified, and its
   // duration should always remain the same.
   ticksTotal = 0; // Reset ticks since emulator started.
-  timer[0].inUse      = 1;
-  timer[0].period     = NullTimerInterval;
-  timer[0].active     = 1;
-  timer[0].continuous = 1;
-  timer[0].funct      = nullTimer;
-  timer[0].this_ptr   = this;
+  timer[0]->inUse      = 1;
+  timer[0]->period     = NullTimerInterval;
+  timer[0]->timeToFire = NullTimerInterval;
+  timer[0]->active     = 1;
+  timer[0]->continuous = 1;
+  timer[0]->funct      = nullTimer;
+  timer[0]->this_ptr   = this;
+  timer[0]->id         = strdup("null timer");
+  heap_insert(0);
   numTimers = 1; // So far, only the nullTimer.
+
+#if BX_SUPPORT_SMP
+  smp_threads = 0;
+  cpus_running = 0;
+  pending_reset = 0;
+  BX_INIT_MUTEX(io_mutex);
+#endif
 }
 
 void bx_pc_system_c::initialize(Bit32u ips)
 {
   ticksTotal = 0;
-  timer[0].timeToFire = NullTimerInterval;
+  timer[0]->timeToFire = NullTimerInterval;
+  heap_rebuild();
   currCountdown       = NullTimerInterval;
   currCountdownPeriod = NullTimerInterval;
   lastTimeUsec = 0;
@@ -180,18 +209,60 @@ bx_bool bx_pc_system_c::get_enable_a20(void)
 
 void bx_pc_system_c::MemoryMappingChanged(void)
 {
+#if BX_SUPPORT_SMP
+  if (smp_threads) {
+    // the TLBs are owned by the CPU threads, each CPU flushes its own TLB
+    // before executing the next trace
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+      BX_CPU(i)->post_remote_request(BX_REMOTE_REQ_TLB_FLUSH);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
     BX_CPU(i)->TLB_flush();
 }
 
 void bx_pc_system_c::invlpg(bx_address addr)
 {
+#if BX_SUPPORT_SMP
+  if (smp_threads) {
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+      BX_CPU(i)->post_remote_request(BX_REMOTE_REQ_TLB_FLUSH);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
     BX_CPU(i)->TLB_invlpg(addr);
 }
 
+#if BX_SUPPORT_SMP
+void bx_pc_system_c::io_mutex_lock(void)
+{
+  BX_LOCK(io_mutex);
+}
+
+void bx_pc_system_c::io_mutex_unlock(void)
+{
+  BX_UNLOCK(io_mutex);
+}
+#endif
+
 int bx_pc_system_c::Reset(unsigned type)
 {
+#if BX_SUPPORT_SMP
+  if (cpus_running) {
+    // requested by one of the CPU threads: the CPUs and devices could not
+    // be reset while the other CPUs are running, postpone until the end
+    // of the current time slice
+    BX_LOCK_IO();
+    if (pending_reset != BX_RESET_HARDWARE) pending_reset = type;
+    BX_UNLOCK_IO();
+    return(0);
+  }
+#endif
+
   // type is BX_RESET_HARDWARE or BX_RESET_SOFTWARE
   BX_INFO(("bx_pc_system_c::Reset(%s) called",type==BX_RESET_HARDWARE?"HARDWARE":"SOFTWARE"));
 
@@ -217,8 +288,22 @@ Bit8u bx_pc_system_c::IAC(void)
 
 void bx_pc_system_c::exit(void)
 {
+  print_timer_stats();
+
   // delete all registered timers (exception: null timer and APIC timer)
-  numTimers = 1 + BX_SUPPORT_APIC;
+  for (unsigned i = 1 + BX_SUPPORT_APIC; i < numTimers; i++) {
+    if (timer[i]->active) {
+      timer[i]->active = 0;
+      heap_remove(i);
+    }
+    timer[i]->inUse = 0;
+    if (timer[i]->id != NULL) {
+      free(timer[i]->id);
+      timer[i]->id = NULL;
+    }
+  }
+  if (numTimers > 1 + BX_SUPPORT_APIC)
+    numTimers = 1 + BX_SUPPORT_APIC;
   bx_devices.exit();
   if (bx_gui) {
     bx_gui->cleanup();
@@ -243,11 +328,123 @@ void bx_pc_system_c::register_state(void)
     char name[4];
     sprintf(name, "%d", i);
     bx_list_c *bxtimer = new bx_list_c(timers, name);
-    BXRS_PARAM_BOOL(bxtimer, inUse, timer[i].inUse);
-    BXRS_DEC_PARAM_FIELD(bxtimer, period, timer[i].period);
-    BXRS_DEC_PARAM_FIELD(bxtimer, timeToFire, timer[i].timeToFire);
-    BXRS_PARAM_BOOL(bxtimer, active, timer[i].active);
-    BXRS_PARAM_BOOL(bxtimer, continuous, timer[i].continuous);
+    BXRS_PARAM_BOOL(bxtimer, inUse, timer[i]->inUse);
+    BXRS_DEC_PARAM_FIELD(bxtimer, period, timer[i]->period);
+    BXRS_DEC_PARAM_FIELD(bxtimer, timeToFire, timer[i]->timeToFire);
+    BXRS_PARAM_BOOL(bxtimer, active, timer[i]->active);
+    BXRS_PARAM_BOOL(bxtimer, continuous, timer[i]->continuous);
+  }
+}
+
+void bx_pc_system_c::after_restore_state(void)
+{
+  // the restored times to fire and active flags bypassed the heap
+  heap_rebuild();
+}
+
+void bx_pc_system_c::print_timer_stats(void)
+{
+  for (unsigned i = 0; i < numTimers; i++) {
+    if (timer[i]->inUse && timer[i]->fireCount > 0) {
+      BX_INFO(("timer %u ('%s'): fired " FMT_LL "u times, " FMT_LL "u usec in callback",
+               i, timer[i]->id, timer[i]->fireCount, timer[i]->callbackUsec));
+    }
+  }
+}
+
+// ================================================
+// Timer heap management
+// ================================================
+
+void bx_pc_system_c::alloc_timer_slot(unsigned index)
+{
+  if (index < timersAllocated) return;
+
+  unsigned n = timersAllocated ? timersAllocated : BX_TIMERS_INITIAL;
+  while (n <= index) n *= 2;
+
+  bx_timer_t **new_timer = new bx_timer_t*[n];
+  unsigned *new_heap = new unsigned[n];
+  unsigned *new_fired = new unsigned[n];
+  if (timersAllocated > 0) {
+    memcpy(new_timer, timer, timersAllocated * sizeof(bx_timer_t*));
+    memcpy(new_heap, timerHeap, timersAllocated * sizeof(unsigned));
+    memcpy(new_fired, firedTimers, timersAllocated * sizeof(unsigned));
+    delete [] timer;
+    delete [] timerHeap;
+    delete [] firedTimers;
+  }
+  for (unsigned i = timersAllocated; i < n; i++) {
+    new_timer[i] = new bx_timer_t;
+    memset(new_timer[i], 0, sizeof(bx_timer_t));
+    new_timer[i]->heapPos = BX_TIMER_NOT_QUEUED;
+  }
+  timer = new_timer;
+  timerHeap = new_heap;
+  firedTimers = new_fired;
+  timersAllocated = n;
+}
+
+void bx_pc_system_c::heap_sift_up(unsigned pos)
+{
+  unsigned index = timerHeap[pos];
+  while (pos > 0) {
+    unsigned parent = (pos - 1) / 2;
+    if (! heap_before(index, timerHeap[parent])) break;
+    timerHeap[pos] = timerHeap[parent];
+    timer[timerHeap[pos]]->heapPos = pos;
+    pos = parent;
+  }
+  timerHeap[pos] = index;
+  timer[index]->heapPos = pos;
+}
+
+void bx_pc_system_c::heap_sift_down(unsigned pos)
+{
+  unsigned index = timerHeap[pos];
+  for (;;) {
+    unsigned child = 2 * pos + 1;
+    if (child >= heapSize) break;
+    if (child + 1 < heapSize && heap_before(timerHeap[child + 1], timerHeap[child]))
+      child++;
+    if (! heap_before(timerHeap[child], index)) break;
+    timerHeap[pos] = timerHeap[child];
+    timer[timerHeap[pos]]->heapPos = pos;
+    pos = child;
+  }
+  timerHeap[pos] = index;
+  timer[index]->heapPos = pos;
+}
+
+void bx_pc_system_c::heap_insert(unsigned index)
+{
+  BX_ASSERT(timer[index]->heapPos == BX_TIMER_NOT_QUEUED);
+  timerHeap[heapSize] = index;
+  heap_sift_up(heapSize++);
+}
+
+void bx_pc_system_c::heap_remove(unsigned index)
+{
+  unsigned pos = timer[index]->heapPos;
+  if (pos == BX_TIMER_NOT_QUEUED) return;
+
+  timer[index]->heapPos = BX_TIMER_NOT_QUEUED;
+  if (pos != --heapSize) {
+    // move the last entry into the hole and restore the heap order
+    unsigned moved = timerHeap[heapSize];
+    timerHeap[pos] = moved;
+    heap_sift_up(pos);
+    heap_sift_down(timer[moved]->heapPos);
+  }
+}
+
+void bx_pc_system_c::heap_rebuild(void)
+{
+  heapSize = 0;
+  for (unsigned i = 0; i < numTimers; i++) {
+    timer[i]->heapPos = BX_TIMER_NOT_QUEUED;
+    if (timer[i]->inUse && timer[i]->active)
+      heap_insert(i);
   }
 }
 
@@ -277,34 +474,39 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
     ticks = MinAllowableTimerPeriod;
   }
 
+  BX_LOCK_IO();
+
   // search for new timer for i=1, i=0 is reserved for NullTimer
   for (i=1; i < numTimers; i++) {
-    if (timer[i].inUse == 0)
+    if (timer[i]->inUse == 0)
       break;
   }
 
 #if BX_TIMER_DEBUG
   if (i==0)
     BX_PANIC(("register_timer: cannot register NullTimer again!"));
-  if (numTimers >= BX_MAX_TIMERS)
-    BX_PANIC(("register_timer: too many registered timers"));
   if (this_ptr == NULL)
     BX_PANIC(("register_timer_ticks: this_ptr is NULL!"));
   if (funct == NULL)
     BX_PANIC(("register_timer_ticks: funct is NULL!"));
 #endif
 
-  timer[i].inUse      = 1;
-  timer[i].period     = ticks;
-  timer[i].timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
-  timer[i].active     = active;
-  timer[i].continuous = continuous;
-  timer[i].funct      = funct;
-  timer[i].this_ptr   = this_ptr;
-  strncpy(timer[i].id, id, BxMaxTimerIDLen);
-  timer[i].id[BxMaxTimerIDLen-1] = 0; // Null terminate if not already.
+  // grow the timer table if all slots are in use
+  alloc_timer_slot(i);
+
+  timer[i]->inUse      = 1;
+  timer[i]->period     = ticks;
+  timer[i]->timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
+  timer[i]->active     = active;
+  timer[i]->continuous = continuous;
+  timer[i]->funct      = funct;
+  timer[i]->this_ptr   = this_ptr;
+  timer[i]->id         = strdup(id);
+  timer[i]->fireCount  = 0;
+  timer[i]->callbackUsec = 0;
 
   if (active) {
+    heap_insert(i);
     if (ticks < Bit64u(currCountdown)) {
       // This new timer needs to fire before the current countdown.
       // Skew the current countdown and countdown period to be smaller
@@ -319,15 +521,15 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
   if (i==numTimers)
     numTimers++; // One new timer installed.
 
+  BX_UNLOCK_IO();
+
   // Return timer id.
   return(i);
 }
 
 void bx_pc_system_c::countdownEvent(void)
 {
-  unsigned i;
-  Bit64u   minTimeToFire;
-  bx_bool  triggered[BX_MAX_TIMERS];
+  unsigned i, numFired = 0;
 
   // The countdown decremented to 0.  We need to service all the active
   // timers, and invoke callbacks from those timers which have fired.
@@ -339,36 +541,28 @@ void bx_pc_system_c::countdownEvent(void)
   // Increment global ticks counter by number of ticks which have
   // elapsed since the last update.
   ticksTotal += Bit64u(currCountdownPeriod);
-  minTimeToFire = (Bit64u) -1;
 
-  for (i=0; i < numTimers; i++) {
-    triggered[i] = 0; // Reset triggered flag.
-    if (timer[i].active) {
+  // Take all the timers ready to fire from the top of the heap.  Timers
+  // firing at the same tick are ordered by index, so the callbacks are
+  // invoked in the timer registration order.
+  while (timer[timerHeap[0]]->timeToFire <= ticksTotal) {
+    i = timerHeap[0];
 #if BX_TIMER_DEBUG
-      if (ticksTotal > timer[i].timeToFire)
-        BX_PANIC(("countdownEvent: ticksTotal > timeToFire[%u], D " FMT_LL "u", i,
-                  timer[i].timeToFire-ticksTotal));
+    if (ticksTotal > timer[i]->timeToFire)
+      BX_PANIC(("countdownEvent: ticksTotal > timeToFire[%u], D " FMT_LL "u", i,
+                ticksTotal-timer[i]->timeToFire));
 #endif
-      if (ticksTotal == timer[i].timeToFire) {
-        // This timer is ready to fire.
-        triggered[i] = 1;
-
-        if (timer[i].continuous==0) {
-          // If triggered timer is one-shot, deactive.
-          timer[i].active = 0;
-        }
-        else {
-          // Continuous timer, increment time-to-fire by period.
-          timer[i].timeToFire += timer[i].period;
-          if (timer[i].timeToFire < minTimeToFire)
-            minTimeToFire = timer[i].timeToFire;
-        }
-      }
-      else {
-        // This timer is not ready to fire yet.
-        if (timer[i].timeToFire < minTimeToFire)
-          minTimeToFire = timer[i].timeToFire;
-      }
+    heap_remove(i);
+    firedTimers[numFired++] = i;
+
+    if (timer[i]->continuous==0) {
+      // If triggered timer is one-shot, deactive.
+      timer[i]->active = 0;
+    }
+    else {
+      // Continuous timer, increment time-to-fire by period.
+      timer[i]->timeToFire += timer[i]->period;
+      heap_insert(i);
     }
   }
 
@@ -376,16 +570,20 @@ void bx_pc_system_c::countdownEvent(void)
   // any of the callbacks, as they may call timer features, which need
   // to be advanced to the next countdown cycle.
   currCountdown = currCountdownPeriod =
-      Bit32u(minTimeToFire - ticksTotal);
+      Bit32u(timer[timerHeap[0]]->timeToFire - ticksTotal);
 
-  for (i=0; i < numTimers; i++) {
+  for (unsigned n=0; n < numFired; n++) {
     // Call requested timer function.  It may request a different
-    // timer period or deactivate etc.
-    if (triggered[i]) {
-      triggeredTimer = i;
-      timer[i].funct(timer[i].this_ptr);
-      triggeredTimer = 0;
-    }
+    // timer period or deactivate etc.  The callback may also register
+    // new timers, so the fired timers list must be re-read each time.
+    i = firedTimers[n];
+    if (! timer[i]->inUse) continue;
+    triggeredTimer = i;
+    Bit64u start = bx_get_realtime64_usec();
+    timer[i]->funct(timer[i]->this_ptr);
+    timer[i]->callbackUsec += bx_get_realtime64_usec() - start;
+    timer[i]->fireCount++;
+    triggeredTimer = 0;
   }
 }
 
@@ -406,12 +604,13 @@ void bx_pc_system_c::nullTimer(void* this_ptr)
 #if SpewPeriodicTimerInfo
   BX_INFO(("==================================="));
   for (unsigned i=0; i < bx_pc_system.numTimers; i++) {
-    if (bx_pc_system.timer[i].active) {
+    if (bx_pc_system.timer[i]->active) {
       BX_INFO(("BxTimer(%s): period=" FMT_LL "u, continuous=%u",
-               bx_pc_system.timer[i].id, bx_pc_system.timer[i].period,
-               bx_pc_system.timer[i].continuous));
+               bx_pc_system.timer[i]->id, bx_pc_system.timer[i]->period,
+               bx_pc_system.timer[i]->continuous));
     }
   }
+  bx_pc_system.print_timer_stats();
 #endif
 }
 
@@ -459,6 +658,31 @@ Bit64u bx_pc_system_c::time_usec()
   return (Bit64u) (((double)(Bit64s)time_ticks()) / m_ips);
 }
 
+void bx_pc_system_c::idle(void)
+{
+  Bit32u ticks = currCountdown;
+
+  // With real time synchronization the host thread sleeps until the event
+  // is due, but not past the next virtual timer (which also polls the GUI).
+  Bit64u usec = (Bit64u) (((double) ticks) / m_ips);
+  Bit64u sleep_usec = bx_slowdown_timer.get_idle_usec(usec);
+  Bit64u virt_usec = bx_virt_timer.get_idle_usec();
+  if (virt_usec > 0) {
+    sleep_usec = BX_MIN(usec, virt_usec);
+  }
+  if (sleep_usec > 0) {
+#if BX_HAVE_USLEEP
+    usleep((Bit32u) BX_MIN(sleep_usec, 1000000));
+#elif BX_HAVE_MSLEEP
+    msleep((Bit32u) (BX_MIN(sleep_usec, 1000000) / 1000));
+#elif BX_HAVE_SLEEP
+    if (sleep_usec >= 1000000) sleep(1);
+#endif
+  }
+
+  tickn(ticks);
+}
+
 void bx_pc_system_c::start_timers(void) { }
 
 void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool continuous)
@@ -468,9 +692,9 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     BX_PANIC(("activate_timer_ticks: timer %u OOB", i));
   if (i == 0)
     BX_PANIC(("activate_timer_ticks: timer 0 is the NullTimer!"));
-  if (timer[i].period < MinAllowableTimerPeriod)
+  if (timer[i]->period < MinAllowableTimerPeriod)
     BX_PANIC(("activate_timer_ticks: timer[%u].period of " FMT_LL "u < min of %u",
-              i, timer[i].period, MinAllowableTimerPeriod));
+              i, timer[i]->period, MinAllowableTimerPeriod));
 #endif
 
   // If the timer frequency is rediculously low, make it more sane.
@@ -481,10 +705,15 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     ticks = MinAllowableTimerPeriod;
   }
 
-  timer[i].period = ticks;
-  timer[i].timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
-  timer[i].active     = 1;
-  timer[i].continuous = continuous;
+  BX_LOCK_IO();
+
+  timer[i]->period = ticks;
+  timer[i]->timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
+  timer[i]->active     = 1;
+  timer[i]->continuous = continuous;
+  // re-queue the timer with the new time to fire
+  heap_remove(i);
+  heap_insert(i);
 
   if (ticks < Bit64u(currCountdown)) {
     // This new timer needs to fire before the current countdown.
@@ -493,6 +722,8 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     currCountdownPeriod -= (currCountdown - Bit32u(ticks));
     currCountdown = Bit32u(ticks);
   }
+
+  BX_UNLOCK_IO();
 }
 
 void bx_pc_system_c::activate_timer(unsigned i, Bit32u useconds, bx_bool continuous)
@@ -509,7 +740,7 @@ void bx_pc_system_c::activate_timer(unsigned i, Bit32u useconds, bx_bool continu
   // if useconds = 0, use default stored in period field
   // else set new period from useconds
   if (useconds==0) {
-    ticks = timer[i].period;
+    ticks = timer[i]->period;
   }
   else {
     // convert useconds to number of ticks
@@ -523,7 +754,7 @@ void bx_pc_system_c::activate_timer(unsigned i, Bit32u useconds, bx_bool continu
       ticks = MinAllowableTimerPeriod;
     }
 
-    timer[i].period = ticks;
+    timer[i]->period = ticks;
   }
 
   activate_timer_ticks(i, ticks, continuous);
@@ -538,7 +769,10 @@ void bx_pc_system_c::deactivate_timer(unsigned i)
     BX_PANIC(("deactivate_timer: timer 0 is the nullTimer!"));
 #endif
 
-  timer[i].active = 0;
+  BX_LOCK_IO();
+  timer[i]->active = 0;
+  heap_remove(i);
+  BX_UNLOCK_IO();
 }
 
 bx_bool bx_pc_system_c::unregisterTimer(unsigned timerIndex)
@@ -548,25 +782,30 @@ bx_bool bx_pc_system_c::unregisterTimer(unsigned timerIndex)
     BX_PANIC(("unregisterTimer: timer %u OOB", timerIndex));
   if (timerIndex == 0)
     BX_PANIC(("unregisterTimer: timer 0 is the nullTimer!"));
-  if (timer[timerIndex].inUse == 0)
+  if (timer[timerIndex]->inUse == 0)
     BX_PANIC(("unregisterTimer: timer %u is not in-use!", timerIndex));
 #endif
 
-  if (timer[timerIndex].active) {
-    BX_PANIC(("unregisterTimer: timer '%s' is still active!", timer[timerIndex].id));
+  if (timer[timerIndex]->active) {
+    BX_PANIC(("unregisterTimer: timer '%s' is still active!", timer[timerIndex]->id));
     return(0); // Fail.
   }
 
+  BX_LOCK_IO();
+
   // Reset timer fields for good measure.
-  timer[timerIndex].inUse      = 0; // No longer registered.
-  timer[timerIndex].period     = BX_MAX_BIT64S; // Max value (invalid)
-  timer[timerIndex].timeToFire = BX_MAX_BIT64S; // Max value (invalid)
-  timer[timerIndex].continuous = 0;
-  timer[timerIndex].funct      = NULL;
-  timer[timerIndex].this_ptr   = NULL;
-  memset(timer[timerIndex].id, 0, BxMaxTimerIDLen);
+  timer[timerIndex]->inUse      = 0; // No longer registered.
+  timer[timerIndex]->period     = BX_MAX_BIT64S; // Max value (invalid)
+  timer[timerIndex]->timeToFire = BX_MAX_BIT64S; // Max value (invalid)
+  timer[timerIndex]->continuous = 0;
+  timer[timerIndex]->funct      = NULL;
+  timer[timerIndex]->this_ptr   = NULL;
+  free(timer[timerIndex]->id);
+  timer[timerIndex]->id = NULL;
 
   if (timerIndex == (numTimers-1)) numTimers--;
 
+  BX_UNLOCK_IO();
+
   return(1); // OK
 }
@@ -23,9 +23,11 @@
 #ifndef BX_PCSYS_H
 #define BX_PCSYS_H
 
-#define BX_MAX_TIMERS 64
 #define BX_NULL_TIMER_HANDLE 10000
 
+// Maximum length of the timer ID strings used by the virtual timers
+#define BxMaxTimerIDLen 32
+
 typedef void (*bx_timer_handler_t)(void *);
 
 BOCHSAPI extern class bx_pc_system_c bx_pc_system;
@@ -41,7 +43,9 @@ private:
   // Timer oriented private features
   // ===============================
 
-  struct {
+  // The timers are allocated on demand and never moved in memory, the
+  // save/restore code keeps pointers to the fields of each timer.
+  struct bx_timer_t {
     bx_bool inUse;      // Timer slot is in-use (currently registered).
     Bit64u  period;     // Timer periodocity in cpu ticks.
     Bit64u  timeToFire; // Time to fire next (in absolute ticks).
@@ -51,9 +55,22 @@ private:
                                //   timer fires.
     void *this_ptr;            // The this-> pointer for C++ callbacks
                                //   has to be stored as well.
-#define BxMaxTimerIDLen 32
-    char id[BxMaxTimerIDLen]; // String ID of timer.
-  } timer[BX_MAX_TIMERS];
+    char *id;                  // String ID of timer.
+    unsigned heapPos;          // Position in the timer heap (if active).
+    Bit64u  fireCount;         // Number of times the callback was called.
+    Bit64u  callbackUsec;      // Host time spent in the callback.
+  } **timer;
+
+  unsigned   timersAllocated; // Number of allocated timer slots.
+
+  // The active timers are kept in a binary min-heap ordered by the time
+  // to fire (and by timer index for timers firing at the same tick), so
+  // the next timer to fire is always at timerHeap[0].
+  unsigned  *timerHeap;
+  unsigned   heapSize;
+
+  // Timers which fired in the current countdown event, in index order
+  unsigned  *firedTimers;
 
   unsigned   numTimers;  // Number of currently allocated timers.
   unsigned   triggeredTimer;  // ID of the actually triggered timer.
@@ -81,6 +98,17 @@ private:
   // ticks finds that an event has occurred.
   void   countdownEvent(void);
 
+  void   alloc_timer_slot(unsigned index);
+  BX_CPP_INLINE bx_bool heap_before(unsigned a, unsigned b) const {
+    return (timer[a]->timeToFire < timer[b]->timeToFire) ||
+           (timer[a]->timeToFire == timer[b]->timeToFire && a < b);
+  }
+  void   heap_sift_up(unsigned pos);
+  void   heap_sift_down(unsigned pos);
+  void   heap_insert(unsigned index);
+  void   heap_remove(unsigned index);
+  void   heap_rebuild(void);
+
 public:
 
   // ==============================
@@ -113,6 +141,14 @@ public:
     // the remaining requested ticks and continue.
     bx_pc_system.currCountdown -= n;
   }
+#if BX_SUPPORT_JIT
+  // Translated CPU code decrements the countdown in place and calls
+  // countdownExpired() when it reaches zero.
+  static BX_CPP_INLINE Bit32u *getCountdownPtr(void) {
+    return &bx_pc_system.currCountdown;
+  }
+  static void countdownExpired(void) { bx_pc_system.countdownEvent(); }
+#endif
 
   int register_timer_ticks(void* this_ptr, bx_timer_handler_t, Bit64u ticks,
                            bx_bool continuous, bx_bool active, const char *id);
@@ -128,6 +164,9 @@ public:
   static BX_CPP_INLINE Bit32u  getNumCpuTicksLeftNextEvent(void) {
     return bx_pc_system.currCountdown;
   }
+  // Called when all processors are halted: advance the time to the next
+  // timer event at once.
+  void   idle(void);
 #if BX_DEBUGGER
   static void timebp_handler(void* this_ptr);
 #endif
@@ -175,6 +214,27 @@ public:
   void    invlpg(bx_address addr);    // flush TLB page in all CPUs
   void    exit(void);
   void    register_state(void);
+  void    after_restore_state(void);
+  void    print_timer_stats(void);
+
+#if BX_SUPPORT_SMP
+  // ==============================
+  // Threaded SMP simulation support
+  // ==============================
+
+  // Each CPU runs on its own host thread.  The CPUs execute time slices
+  // in lockstep, timers are only advanced by the main thread in between.
+  bx_bool smp_threads;
+  // Set while the CPU threads are executing a time slice
+  volatile bx_bool cpus_running;
+  // Reset requested by one of the CPU threads, performed after the slice
+  volatile unsigned pending_reset;
+
+  BX_CPP_INLINE void lock_io(void) { if (smp_threads) io_mutex_lock(); }
+  BX_CPP_INLINE void unlock_io(void) { if (smp_threads) io_mutex_unlock(); }
+  void io_mutex_lock(void);
+  void io_mutex_unlock(void);
+#endif
 };
 
 #endif
@@ -797,6 +797,36 @@ void bx_plugins_register_state()
   }
 }
 
+/***************************************************************************/
+/* Plugin system: Execute code before saving state of all plugin devices   */
+/***************************************************************************/
+
+void bx_plugins_before_save_state()
+{
+  device_t *device;
+
+  for (device = core_devices; device; device = device->next) {
+    device->devmodel->before_save_state();
+  }
+  for (device = devices; device; device = device->next) {
+    if (device->plugtype == PLUGTYPE_STANDARD) {
+      device->devmodel->before_save_state();
+    }
+  }
+  for (device = devices; device; device = device->next) {
+    if (device->plugtype == PLUGTYPE_OPTIONAL) {
+      device->devmodel->before_save_state();
+    }
+  }
+#if BX_PLUGINS
+  for (device = devices; device; device = device->next) {
+    if (device->plugtype == PLUGTYPE_USER) {
+      device->devmodel->before_save_state();
+    }
+  }
+#endif
+}
+
 /***************************************************************************/
 /* Plugin system: Execute code after restoring state of all plugin devices */
 /***************************************************************************/
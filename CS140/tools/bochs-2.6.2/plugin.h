@@ -132,6 +132,7 @@ extern "C" {
 #define DEV_init_devices() {bx_devices.init(BX_MEM(0)); }
 #define DEV_reset_devices(type) {bx_devices.reset(type); }
 #define DEV_register_state() {bx_devices.register_state(); }
+#define DEV_before_save_state() {bx_devices.before_save_state(); }
 #define DEV_after_restore_state() {bx_devices.after_restore_state(); }
 
 #define DEV_register_timer(a,b,c,d,e,f) bx_pc_system.register_timer(a,b,c,d,e,f)
@@ -226,12 +227,14 @@ extern "C" {
   (bx_devices.register_pci_handlers(a,b,c,d))
 #define DEV_pci_get_confAddr() bx_devices.pci_get_confAddr()
 #define DEV_pci_set_irq(a,b,c) bx_devices.pluginPci2IsaBridge->pci_set_irq(a,b,c)
-#define DEV_pci_set_base_mem(a,b,c,d,e,f) \
-  (bx_devices.pci_set_base_mem(a,b,c,d,e,f))
+#define DEV_pci_set_base_mem(a,b,c,d,e,f,g) \
+  (bx_devices.pci_set_base_mem(a,b,c,d,e,f,g))
 #define DEV_pci_set_base_io(a,b,c,d,e,f,g,h) \
   (bx_devices.pci_set_base_io(a,b,c,d,e,f,g,h))
 #define DEV_ide_bmdma_present() bx_devices.pluginPciIdeController->bmdma_present()
 #define DEV_ide_bmdma_set_irq(a) bx_devices.pluginPciIdeController->bmdma_set_irq(a)
+#define DEV_ide_bmdma_start_transfer(a) \
+  bx_devices.pluginPciIdeController->bmdma_start_transfer(a)
 #define DEV_acpi_generate_smi(a) bx_devices.pluginACPIController->generate_smi(a)
 
 ///////// Speaker macros
@@ -239,8 +242,8 @@ extern "C" {
 #define DEV_speaker_beep_off() bx_devices.pluginSpeaker->beep_off()
 
 ///////// Memory macros
-#define DEV_register_memory_handlers(param,rh,wh,b,e) \
-    bx_devices.mem->registerMemoryHandlers(param,rh,wh,b,e)
+#define DEV_register_memory_handlers(param,rh,wh,da,b,e) \
+    bx_devices.mem->registerMemoryHandlers(param,rh,wh,da,b,e)
 #define DEV_unregister_memory_handlers(param,b,e) \
     bx_devices.mem->unregisterMemoryHandlers(param,b,e)
 #define DEV_mem_set_memory_type(a,b,c) \
@@ -349,6 +352,7 @@ extern void bx_reset_plugins(unsigned);
 extern void bx_unload_plugins(void);
 extern void bx_unload_core_plugins(void);
 extern void bx_plugins_register_state(void);
+extern void bx_plugins_before_save_state(void);
 extern void bx_plugins_after_restore_state(void);
 
 #if !BX_PLUGINS